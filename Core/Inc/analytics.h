@@ -15,6 +15,49 @@
 /******************************************************************************
  * Defines
  *****************************************************************************/
+// Current calculation
+#define CALC_ADCVOLTRESOLUTION	(float)(0.0008056640625) ///< Volt per digit
+#define CALC_AMPOPAMP			(float)(95)	///< Amplification of circuit
+#define CALC_AMPHALLSENS		(float)(90) ///< Amplification of hall sensor
+#define CALC_PIDANDPERM			(float)(4998556.330) ///< Pi and permutation
+
+// Distance conversion
+#define CALC_LUTSIZE			11 ///< Look up table size
+#define CALC_LUTMAXSIZE			256 ///< Maximum calibration points per LUT
+#define CALC_MODES				3 ///< Cable modes L, LN and LNPE
+
+// Angle estimation
+#define CALC_SENSORSPACING		(float)(40) ///< Left to right sensor [mm]
+#define CALC_HALLRADIUS			(float)(5) ///< Hall sensor to conductor [mm]
+#define CALC_HALLMIN			(float)(20) ///< Hall amplitude used [digits]
+#define CALC_ANGLEAGREE			(float)(15) ///< Wpc/hall disagreement [deg]
+#define CALC_ASINSTEPS			64 ///< Segments of the arcsine table
+
+/** ***************************************************************************
+ * Acquire wpc and hall inputs in one simultaneous triple ADC scan.
+ * @attention
+ * Comment this \#define to use the sequential wpc and hall scans of ADC3.
+ *****************************************************************************/
+#define ANA_QUAD_SCAN
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Distance LUT with precomputed linear segments */
+typedef struct {
+	const float* strength;	///< Strength per point, non-increasing
+	uint16_t size;			///< Number of points, 0 if invalid
+	float nearest;			///< Distance at and above the first strength
+	float farthest;			///< Distance at and below the last strength
+	float slope[CALC_LUTMAXSIZE-1];		///< Distance per digit of segment
+	float intercept[CALC_LUTMAXSIZE-1];	///< Distance at zero strength
+} CALC_lut_t;
+
+/** Angle of the cable with the confidence of the estimate */
+typedef struct {
+	float angle;			///< Angle [deg], positive towards the right sensor
+	float confidence;		///< 0 unusable to 1 consistent
+} CALC_angle_t;
 
 /******************************************************************************
  * Variables
@@ -24,20 +67,41 @@ extern bool ANA_inMeasReady;   ///< Input button pushed event
 extern bool ANA_inBtn;		   ///< Input measurement ready event
 extern uint32_t ANA_inAmpLeft; ///< Input raw amplitude left
 extern uint32_t ANA_inAmpRight;///< Input raw amplitude right
+extern uint32_t ANA_inHallLeft;///< Input raw hall amplitude left (quad scan)
+extern uint32_t ANA_inHallRight;///< Input raw hall amplitude right (quad scan)
 extern uint16_t ANA_inOptn[4]; ///< Input Mode,DataType,MeasuringType,Accuracy
 
 //outputs
 extern bool ANA_outStartHALL;  ///< Output start hall measurement event
 extern bool ANA_outStartWPC;   ///< Output start wpc measurement event
+extern bool ANA_outStartQUAD;  ///< Output start wpc and hall measurement event
+extern bool ANA_outStartStream;///< Output start continuous streaming event
+extern bool ANA_outStopStream; ///< Output stop continuous streaming event
 extern bool ANA_outDataReady;  ///< Output data ready event
+extern float ANA_inPhase;	   ///< Input phase wpc right to left [rad]
 extern float ANA_outResults[4];///< Output analysed results
+extern float ANA_outConfidence;///< Output confidence of the angle, 0 to 1
 extern bool ANA_measBusy;	   ///< Output measurement state
 
+//look up tables
+extern float CALC_distanceLUT[CALC_LUTSIZE];///< Distances of the LUTs [mm]
+extern float* CALC_wpcLeft[3]; ///< Wpc left strength LUT per mode
+extern float* CALC_wpcRight[3];///< Wpc right strength LUT per mode
+extern CALC_lut_t CALC_lutLeft[CALC_MODES]; ///< Wpc left engine per mode
+extern CALC_lut_t CALC_lutRight[CALC_MODES];///< Wpc right engine per mode
+
 
 /******************************************************************************
  * Functions
  *****************************************************************************/
+void ANA_Init(void);
 void ANA_Handler(void);
+bool ANA_Pending(void);
+bool CALC_LutInit(CALC_lut_t* lut, const float* lutDistance,
+		const float* lutStrength, uint16_t size);
+float CALC_Distance(const CALC_lut_t* lut, float measurement);
+CALC_angle_t CALC_Angle(float left, float right, float resolution,
+		float hallLeft, float hallRight, float phase, uint16_t mode);
 
 
 
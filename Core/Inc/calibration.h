@@ -0,0 +1,100 @@
+/** ***************************************************************************
+ * @file
+ * @brief See calibration.c
+ *
+ * Prefix CAL
+ *
+ *****************************************************************************/
+
+#ifndef INC_CALIBRATION_H_
+#define INC_CALIBRATION_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "analytics.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define CAL_MAGIC			0x4C414343	///< "CCAL", start of a record
+#define CAL_VERSION			1			///< Format of CAL_record_t
+#define CAL_SECTOR_ADDR		0x081E0000	///< Flash sector 23, see linker script
+#define CAL_SECTOR_SIZE		0x20000		///< Bytes of the sector
+#define CAL_SLOT_SIZE		512			///< Bytes reserved per record
+#define CAL_SLOTS	(CAL_SECTOR_SIZE/CAL_SLOT_SIZE)	///< Records per sector
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Calibration of all modes as stored in flash */
+typedef struct {
+	uint32_t magic;						///< CAL_MAGIC
+	uint16_t version;					///< CAL_VERSION
+	uint16_t points;					///< Points per table, CALC_LUTSIZE
+	uint32_t sequence;					///< Incremented by every save
+	float distance[CALC_LUTSIZE];		///< Distances of the points
+	float left[CALC_MODES][CALC_LUTSIZE];	///< Wpc left strength per mode
+	float right[CALC_MODES][CALC_LUTSIZE];	///< Wpc right strength per mode
+	uint32_t crc;						///< CRC-32 of all fields above
+} CAL_record_t;
+
+/** States of the calibration wizard */
+typedef enum {
+	CAL_IDLE = 0,		///< Not calibrating
+	CAL_WAIT,			///< Waiting for the cable at the next distance
+	CAL_CAPTURE,		///< Averaging the amplitudes of a point
+	CAL_SAVED,			///< All points taken, tables stored in flash
+	CAL_FAILED			///< All points taken, storing failed
+} CAL_state_t;
+
+/** Progress of the calibration wizard */
+typedef struct {
+	CAL_state_t state;					///< Current step
+	uint16_t mode;						///< Cable mode being calibrated
+	uint16_t point;						///< Index of the current point
+	uint32_t count;						///< Frames averaged for the point
+	float sumLeft;						///< Sum of the wpc left amplitudes
+	float sumRight;						///< Sum of the wpc right amplitudes
+	float left[CALC_LUTSIZE];			///< Measured wpc left strength
+	float right[CALC_LUTSIZE];			///< Measured wpc right strength
+} CAL_wizard_t;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern CAL_wizard_t CAL_wizard;			///< Progress of the wizard
+extern uint32_t CAL_sequence;			///< Sequence of the loaded record
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+uint32_t CAL_crc32(const void* data, uint32_t size);
+void CAL_fit(float* strength, uint16_t size);
+bool CAL_record_valid(const CAL_record_t* record);
+void CAL_record_fill(CAL_record_t* record, uint32_t sequence);
+void CAL_record_apply(const CAL_record_t* record);
+
+bool CAL_load(void);
+bool CAL_save(void);
+
+// Flash sector access, calibration_flash.c on the target, a RAM model on
+// the host
+const void* CAL_flash_read(uint32_t offset);
+bool CAL_flash_erase(void);
+bool CAL_flash_write(uint32_t offset, const uint32_t* words, uint32_t count);
+
+void CAL_wizard_start(uint16_t mode);
+void CAL_wizard_capture(void);
+void CAL_wizard_sample(uint32_t left, uint32_t right);
+void CAL_wizard_complete(void);
+
+
+#endif /* INC_CALIBRATION_H_ */
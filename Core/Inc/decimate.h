@@ -0,0 +1,53 @@
+/** ***************************************************************************
+ * @file
+ * @brief See decimate.c
+ *
+ * Prefix DEC
+ *
+ *****************************************************************************/
+
+#ifndef INC_DECIMATE_H_
+#define INC_DECIMATE_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define DEC_CIC_ORDER		3		///< Stages, unrolled in DEC_process()
+#define DEC_CIC_RATIO		20		///< Decimation of the CIC
+#define DEC_FIR_RATIO		2		///< Decimation of the compensation FIR
+#define DEC_FIR_TAPS		21		///< Taps of the compensation FIR
+#define DEC_RATIO	(DEC_CIC_RATIO*DEC_FIR_RATIO)	///< Total decimation
+#define DEC_BLOCK			(6*DEC_RATIO)	///< Input samples per DMA half
+/** Output samples until the filters have settled after DEC_init() */
+#define DEC_SETTLE	((DEC_CIC_ORDER+DEC_FIR_TAPS+1)/DEC_FIR_RATIO)
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** State of the decimation of one channel */
+typedef struct {
+	uint32_t integrator[DEC_CIC_ORDER];	///< CIC integrators, wrap around
+	uint32_t comb[DEC_CIC_ORDER];		///< CIC comb delays
+	uint32_t cicPhase;					///< Inputs since last CIC output
+	float line[2*DEC_FIR_TAPS];			///< FIR delay line, stored twice
+	uint32_t head;						///< Newest entry of the delay line
+	uint32_t firPhase;					///< CIC outputs since last output
+} DEC_t;
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void DEC_init(DEC_t* dec);
+uint32_t DEC_process(DEC_t* dec, const uint16_t* in, uint32_t count,
+					 uint32_t stride, uint16_t* out);
+
+
+#endif /* INC_DECIMATE_H_ */
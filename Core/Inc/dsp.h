@@ -0,0 +1,26 @@
+/** ***************************************************************************
+ * @file
+ * @brief See dsp.c
+ *
+ * Prefix DSP
+ *
+ *****************************************************************************/
+
+#ifndef INC_DSP_H_
+#define INC_DSP_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "stdint.h"
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+float DSP_mean_f32(const float* src, uint32_t count);
+float DSP_var_f32(const float* src, uint32_t count);
+void DSP_cmplx_mag_f32(const float* src, float* dst, uint32_t count);
+
+
+#endif /* INC_DSP_H_ */
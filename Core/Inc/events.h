@@ -0,0 +1,66 @@
+/** ***************************************************************************
+ * @file
+ * @brief See events.c
+ *
+ * Prefix EVT
+ *
+ *****************************************************************************/
+
+#ifndef INC_EVENTS_H_
+#define INC_EVENTS_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Events posted to the main loop by the ISRs and by the loop itself */
+typedef enum {
+	EVT_NONE = 0,			///< Queue empty
+	EVT_TICK,				///< Periodic tick of EVT_TICK_PERIOD
+	EVT_BUTTON,				///< User pushbutton pressed
+	EVT_TOUCH,				///< Touch controller interrupt
+	EVT_TOUCH_DATA,			///< Touch controller transfer finished
+	EVT_MEAS,				///< Measurement frame queued
+	EVT_ANALYTICS			///< Analytics handler has a step to take
+} EVT_t;
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define EVT_QUEUE_SIZE		16		///< Events in the queue, power of two
+#define EVT_TICK_PERIOD		20		///< Period of EVT_TICK [ms]
+#define EVT_LOAD_WINDOW		1000	///< Window of the idle accounting [ms]
+
+/** ***************************************************************************
+ * Account the cycles spent outside of the sleep to get the idle percentage.
+ * @attention
+ * Comment this \#define to leave the DWT cycle counter untouched.
+ *****************************************************************************/
+#define EVT_IDLE_ACCOUNTING
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t EVT_overflow;		///< Events lost on a full queue
+extern float EVT_idle_percent;		///< Idle time of the last window [%]
+extern uint32_t EVT_pass_cycles;	///< Cycles of the last main loop pass
+extern uint32_t EVT_pass_max;		///< Longest main loop pass [cycles]
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void EVT_init(void);
+void EVT_post(EVT_t event);
+EVT_t EVT_wait(void);
+void EVT_tick(void);
+
+
+#endif /* INC_EVENTS_H_ */
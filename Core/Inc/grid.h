@@ -0,0 +1,50 @@
+/** ***************************************************************************
+ * @file
+ * @brief See grid.c
+ *
+ * Prefix GRID
+ *
+ *****************************************************************************/
+
+#ifndef INC_GRID_H_
+#define INC_GRID_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "measuring.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define GRID_MIN_AMPLITUDE	10		///< Mains amplitude needed [digits]
+#define GRID_TRACK_RANGE	4.0f	///< Largest deviation followed [Hz]
+#define GRID_GAIN			0.5f	///< Share of the deviation corrected
+#define GRID_DEADBAND		0.01f	///< Smaller corrections are skipped [Hz]
+#define GRID_DETECT			5		///< Frames to decide between 50/60 Hz
+#define GRID_SMOOTH			0.2f	///< Weight of a new reported frequency
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern float GRID_frequency;	///< Measured mains frequency, 0 unknown [Hz]
+extern uint32_t GRID_nominal;	///< Nominal mains frequency, 50 or 60 [Hz]
+extern float GRID_track;		///< Frequency the sampling is tuned to [Hz]
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void GRID_init(uint32_t nominal);
+void GRID_phase(const uint16_t* wave, uint32_t count, uint32_t bin,
+				float* amplitude, float* phase);
+bool GRID_update(const MEAS_frame_t* frame);
+void GRID_settle(uint32_t sequence);
+
+
+#endif /* INC_GRID_H_ */
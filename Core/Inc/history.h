@@ -0,0 +1,52 @@
+/** ***************************************************************************
+ * @file
+ * @brief See history.c
+ *
+ * Prefix HIST
+ *
+ *****************************************************************************/
+
+#ifndef INC_HISTORY_H_
+#define INC_HISTORY_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Timestamped result of the analytics */
+typedef struct {
+	uint32_t tick;						///< HAL tick of the result [ms]
+	float distance;						///< Distance [mm], negative if unusable
+	float current;						///< Current [A], negative if unusable
+	float angle;						///< Angle [deg]
+} HIST_entry_t;
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define HIST_BASE		0xD0100000	///< SDRAM above the LCD frame buffers
+#define HIST_SIZE		65536		///< Entries in the ring, power of two
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t HIST_total;			///< Entries added since reset
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void HIST_init(void);
+void HIST_add(uint32_t tick, float distance, float current, float angle);
+uint32_t HIST_count(void);
+const HIST_entry_t* HIST_get(uint32_t age);
+
+
+#endif /* INC_HISTORY_H_ */
@@ -43,7 +43,8 @@ typedef struct {
 
 /** Enumeration of possible sites */
 typedef enum {
-	SITE_NONE = 0, SITE_MEAS, SITE_OPTN, SITE_CALI, SITE_HINT, SITE_MAIN
+	SITE_NONE = 0, SITE_MEAS, SITE_OPTN, SITE_CALI, SITE_HINT, SITE_MAIN,
+	SITE_DEBUG, SITE_SCOPE, SITE_TREND
 } GUI_site_t;
 
 /** Enumeration of possible TS inputs */
@@ -51,9 +52,27 @@ typedef enum {
 	TOUCH_NONE = 0, TOUCH_GENERAL, TOUCH_MODE, TOUCH_OPTN, TOUCH_OPTN_CHANGE
 } GUI_touch_t;
 
+/** Steps of the non-blocking touch controller readout */
+typedef enum {
+	TSREAD_IDLE = 0,	///< No transfer running
+	TSREAD_CTRL,		///< Read touch status
+	TSREAD_XYZ,			///< Read one sample out of the FIFO
+	TSREAD_FIFO_RESET,	///< Reset FIFO, drop older samples
+	TSREAD_FIFO_ENABLE,	///< Enable FIFO again
+	TSREAD_INT_CLEAR	///< Acknowledge the interrupts, release INT line
+} GUI_tsread_t;
+
+/** Retained text row, only repainted when its text changes */
+typedef struct {
+	char text[25];						///< Text on screen, empty if cleared
+} GUI_row_t;
+
 /******************************************************************************
  * Defines
  *****************************************************************************/
+#define GUI_SCOPE_CHANNELS	4	///< Traces of the scope, as MEAS_WAVE_CHANNELS
+#define GUI_SCOPE_SAMPLES	60	///< Samples per trace, as MEAS_WAVE_SAMPLES
+
 //Mode and Cable detected
 extern bool GUI_cable_detected;		///< Input true if cable was detected
 extern bool GUI_cable_not_detected; ///< Input true if cable was not detected
@@ -61,6 +80,7 @@ extern GUI_mode_t GUI_mode;			///< Output default measurement mode
 
 //General measurements
 extern float GUI_angle;				///< Input angle value to display
+extern float GUI_angleConfidence;	///< Input confidence of the angle, 0 to 1
 extern float GUI_distance;			///< Input distance value to display
 extern float GUI_distanceDeviation; ///< Input standard deviation of distance
 extern float GUI_current;			///< Input current to display
@@ -74,14 +94,27 @@ extern float GUI_rawWpcRight;		///< Input for raw value
 //Current options
 extern OPTN_entry_t GUI_options[3]; ///< Output option settings
 
+//Raw waveforms
+extern uint16_t GUI_scopeWave[GUI_SCOPE_CHANNELS][GUI_SCOPE_SAMPLES];///< Input
+
 //GUI triggers
 extern bool GUI_inputBtn;			///< Input button pushed event
 extern bool GUI_inputMeasReady;		///< Input measurement ready event
+extern bool GUI_inputTSInt;			///< Input touch controller interrupt
+extern bool GUI_inputTick;			///< Input periodic tick
+extern bool GUI_inputScope;			///< Input new waveforms
+extern uint32_t GUI_TSerrors;		///< Failed touch controller transfers
+extern uint32_t GUI_redrawArea;		///< Pixels repainted, for profiling
+extern uint32_t GUI_renderCycles;	///< Cycles to draw the last frame
+extern uint32_t GUI_renderMax;		///< Longest frame drawn [cycles]
+extern uint32_t GUI_flipLatency;	///< Cycles from flip request to reload
+extern uint32_t GUI_flipCount;		///< Frames shown
 extern bool GUI_outOptn;			///< Output option change event
 
 /******************************************************************************
  * Functions
  *****************************************************************************/
+void GUI_LCD_Init(void);
 void GUI_DrawHint(void);
 void GUI_DrawModeSel(void);
 void GUI_DrawTopMode(void);
@@ -89,8 +122,13 @@ void GUI_DrawTopOptions(void);
 void GUI_DrawMeasurement(void);
 void GUI_DrawOptions(void);
 void GUI_DrawRaw(void);
+void GUI_DrawDebug(void);
+void GUI_DrawScope(void);
+void GUI_DrawTrend(void);
+void GUI_DrawCalibration(void);
 void GUI_SiteHandler(void);
 void GUI_TSHandler(void);
+void GUI_TSEvaluate(bool touched, uint16_t X, uint16_t Y);
 
 
 #endif /* INC_LCD_GUI_H_ */
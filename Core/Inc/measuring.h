@@ -14,14 +14,101 @@
  * Includes
  *****************************************************************************/
 #include <stdbool.h>
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Enumeration of amplitude estimators */
+typedef enum {
+	MEAS_ENGINE_PEAK = 0,	///< Mean of the highest and lowest samples
+	MEAS_ENGINE_GOERTZEL	///< Magnitude of the mains bin (Goertzel)
+} MEAS_engine_t;
+
+/** Channel sequences of the triple mode */
+typedef enum {
+	MEAS_SEQ_QUAD = 0,		///< Wpc and hall pair, two conversions per trigger
+	MEAS_SEQ_WPC			///< Wpc pair only, one conversion per trigger
+} MEAS_sequence_t;
+
+/** Acquisition configuration */
+typedef struct {
+	uint32_t rate;					///< Sampling frequency [Hz]
+	uint16_t samples;				///< Samples per channel and frame
+	MEAS_sequence_t sequence;		///< Channels of the triple mode
+} MEAS_config_t;
+
+/** Presets of MEAS_presets */
+typedef enum {
+	MEAS_PRESET_STANDARD = 0,	///< 600 Hz, 100 ms frames, wpc and hall
+	MEAS_PRESET_FAST,			///< 1200 Hz, 2 mains periods, wpc only
+	MEAS_PRESET_PRECISION,		///< 1200 Hz, 200 ms frames, wpc and hall
+	MEAS_PRESET_COUNT			///< Number of presets
+} MEAS_preset_t;
+
+#define MEAS_WAVE_SAMPLES	60		///< Raw samples per channel and frame
+#define MEAS_WAVE_RATE		600		///< Sampling frequency of the raw samples
+#define MEAS_WAVE_CHANNELS	4		///< Channels of the triple mode
+
+/** Timestamped result of one measurement */
+typedef struct {
+	uint32_t sequence;				///< Frame number, gaps if dropped
+	uint32_t tick;					///< HAL tick at completion [ms]
+	bool continued;					///< Sampled right after the previous one
+	uint32_t amplitude_left;		///< Amplitude of the left channel
+	uint32_t amplitude_right;		///< Amplitude of the right channel
+	uint32_t amplitude_hall_in11;	///< Amplitude of hall IN11, right (quad scan)
+	uint32_t amplitude_hall_in6;	///< Amplitude of hall IN6, left (quad scan)
+	float phase_left;				///< Phase of the left channel [rad]
+	float phase_right;				///< Phase of the right channel [rad]
+	float phase_hall_in11;			///< Phase of hall IN11 (quad scan) [rad]
+	float phase_hall_in6;			///< Phase of hall IN6 (quad scan) [rad]
+	uint16_t wave[MEAS_WAVE_CHANNELS][MEAS_WAVE_SAMPLES];///< Raw samples as
+									///< above, hall rows 0 in dual scans
+} MEAS_frame_t;
 
 
 /******************************************************************************
  * Defines
  *****************************************************************************/
-extern bool MEAS_data_ready;			///< New data is ready
-extern uint32_t MEAS_amplitude_left;	///< Amplitude of the left channel
-extern uint32_t MEAS_amplitude_right;	///< Amplitude of the right channel
+/** ***************************************************************************
+ * Amplitude estimator used after reset, can be changed with MEAS_engine.
+ *****************************************************************************/
+#define MEAS_DEFAULT_ENGINE	MEAS_ENGINE_PEAK
+/** ***************************************************************************
+ * Triple mode sampled at DEC_RATIO times MEAS_config.rate and decimated
+ * after reset, can be changed with MEAS_oversampling.
+ *****************************************************************************/
+#define MEAS_DEFAULT_OVERSAMPLING	false
+#define MEAS_MAINS_FREQ		50		///< Mains frequency after reset [Hz]
+#define MEAS_QUEUE_SIZE		8		///< Frames in the queue, power of two
+#define MEAS_MIN_SAMPLES	12		///< Minimum samples per frame
+#define MEAS_MAX_SAMPLES	480		///< Maximum samples per frame
+#define MEAS_RATE_MIN		MEAS_WAVE_RATE	///< Minimum sampling frequency [Hz]
+#define MEAS_RATE_MAX		20000	///< Maximum sampling frequency [Hz]
+
+/** ***************************************************************************
+ * Replace the ADC inputs of the triple mode by the cable field simulator.
+ * @attention
+ * Uncomment this \#define to run without sensors and cable, see sim.c.
+ *****************************************************************************/
+//#define MEAS_SIMULATION
+
+// Layout of one trigger in the triple mode buffer (ADC1, ADC2, ADC3 twice)
+#define MEAS_QUAD_STRIDE	6		///< Conversions per trigger in triple mode
+#define MEAS_QUAD_WPC_LEFT	0		///< ADC1 first conversion = IN13
+#define MEAS_QUAD_WPC_RIGHT	2		///< ADC3 first conversion = IN4
+#define MEAS_QUAD_HALL_IN11	4		///< ADC2 second conversion = IN11
+#define MEAS_QUAD_HALL_IN6	5		///< ADC3 second conversion = IN6
+
+extern MEAS_engine_t MEAS_engine;		///< Selected amplitude estimator
+extern bool MEAS_oversampling;			///< Oversampled triple mode
+extern uint32_t MEAS_frame_count;		///< Frames completed, next sequence
+extern uint32_t MEAS_frames_dropped;	///< Frames dropped on a full queue
+extern const MEAS_config_t MEAS_presets[MEAS_PRESET_COUNT];	///< Presets
+extern MEAS_config_t MEAS_config;		///< Acquisition in use
+extern uint32_t MEAS_nominal;			///< Nominal mains frequency [Hz]
 
 
 /******************************************************************************
@@ -29,11 +116,25 @@ extern uint32_t MEAS_amplitude_right;	///< Amplitude of the right channel
  *****************************************************************************/
 void MEAS_GPIO_analog_init(void);
 void MEAS_timer_init(void);
+void MEAS_goertzel_init(float frequency);
+bool MEAS_timer_calc(uint32_t rate, uint32_t* psc, uint32_t* arr);
+bool MEAS_config_valid(const MEAS_config_t* config);
+bool MEAS_config_whole(const MEAS_config_t* config, uint32_t nominal);
+bool MEAS_config_set(const MEAS_config_t* config);
+bool MEAS_config_preset(MEAS_preset_t preset);
+uint32_t MEAS_track(float frequency, uint32_t nominal);
 void ADC_reset(void);
 void ADC3_IN13_IN4_scan_init(void);
 void ADC3_IN11_IN6_scan_init(void);
 void ADC3_dual_scan_start(void);
+void ADC123_quad_scan_init(void);
+void ADC123_triple_scan_start(void);
+void ADC123_quad_stream_init(void);
+void ADC123_stream_stop(void);
 
-void MEAS_analyse_data(void);
+void MEAS_analyse_data(const uint16_t* samples, MEAS_frame_t* frame);
+void MEAS_analyse_quad(const uint16_t* samples, MEAS_frame_t* frame);
+bool MEAS_frame_read(MEAS_frame_t* frame);
+void MEAS_frame_flush(void);
 
 #endif
@@ -0,0 +1,113 @@
+/** ***************************************************************************
+ * @file
+ * @brief See profile.c
+ *
+ * Prefix PROF
+ *
+ *****************************************************************************/
+
+#ifndef INC_PROFILE_H_
+#define INC_PROFILE_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+#if defined(__arm__)
+#include "stm32f4xx.h"
+#else
+#include <time.h>
+#endif
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Instrumented code sections */
+typedef enum {
+	PROF_MEAS_ANALYSE = 0,	///< MEAS_analyse_data(), MEAS_analyse_quad()
+	PROF_MEAS_ISR,			///< ADC and DMA interrupt handlers of measuring
+	PROF_MEAS_DECIMATE,		///< DEC_process() of one oversampled DMA block
+	PROF_ANA_HANDLER,		///< ANA_Handler()
+	PROF_GUI_SITE,			///< GUI_SiteHandler()
+	PROF_GUI_TS,			///< GUI_TSHandler()
+	PROF_COUNT				///< Number of probes
+} PROF_probe_t;
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define PROF_BINS		16		///< Histogram bins per probe
+#define PROF_BIN_FIRST	7		///< Bin 0 below 2^7 counts, then powers of 2
+
+/** ***************************************************************************
+ * Record the probes, PROF_BEGIN() and PROF_END() are empty otherwise.
+ * @attention
+ * Comment this \#define to remove all probes from the code.
+ *****************************************************************************/
+#define PROF_ENABLE
+
+#if defined(__arm__)
+#define PROF_CLOCK		SystemCoreClock	///< Counts per second, core clock
+#else
+#define PROF_CLOCK		1000000000		///< Counts per second, nanoseconds
+#endif
+
+#ifdef PROF_ENABLE
+/** Start a probe, opens a scope variable for PROF_END() */
+#define PROF_BEGIN(probe)	uint32_t PROF_start_##probe = PROF_now()
+/** Stop a probe started in the same scope and record the duration */
+#define PROF_END(probe)		PROF_record(probe, PROF_now()-PROF_start_##probe)
+#else
+#define PROF_BEGIN(probe)
+#define PROF_END(probe)
+#endif
+
+/** Statistics of one probe */
+typedef struct {
+	uint32_t count;						///< Recorded runs
+	uint32_t min;						///< Shortest run [counts]
+	uint32_t max;						///< Longest run [counts]
+	uint64_t sum;						///< All runs [counts]
+	uint32_t histogram[PROF_BINS];		///< Runs per power of 2 bin
+} PROF_stat_t;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern PROF_stat_t PROF_stats[PROF_COUNT];	///< Statistics of all probes
+extern const char* const PROF_name[PROF_COUNT];	///< Short probe names
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+/** ***************************************************************************
+ * @brief Current time stamp, DWT cycle counter or host monotonic clock
+ * @return counts, wrapping at 2^32
+ *****************************************************************************/
+static inline uint32_t PROF_now(void)
+{
+#if defined(__arm__)
+	return DWT->CYCCNT;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec*1000000000u + now.tv_nsec);
+#endif
+}
+
+void PROF_init(void);
+void PROF_reset(void);
+void PROF_record(PROF_probe_t probe, uint32_t counts);
+float PROF_us(uint32_t counts);
+float PROF_mean_us(PROF_probe_t probe);
+uint32_t PROF_csv_header(char* buffer, uint32_t size);
+uint32_t PROF_csv_probe(PROF_probe_t probe, const char* name, char* buffer,
+						uint32_t size);
+uint32_t PROF_csv(char* buffer, uint32_t size);
+
+
+#endif /* INC_PROFILE_H_ */
@@ -0,0 +1,54 @@
+/** ***************************************************************************
+ * @file
+ * @brief See sim.c
+ *
+ * Prefix SIM
+ *
+ *****************************************************************************/
+
+#ifndef INC_SIM_H_
+#define INC_SIM_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "stdint.h"
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Struct with the parameters of a simulated cable */
+typedef struct {
+	uint16_t mode;						///< Cable type 0=L, 1=LN, 2=LNPE
+	float distance;						///< Distance cable to device [mm]
+	float angle;						///< Angle of the cable [deg]
+	float current;						///< Load current [A]
+	float frequency;					///< Mains frequency [Hz]
+	float harmonic;						///< 3rd harmonic rel. to fundamental
+	float noise;						///< Standard deviation of noise [digits]
+	float drift;						///< Change of the mains freq. [Hz/s]
+} SIM_scenario_t;
+
+/** Enumeration of simulated sensors */
+typedef enum {
+	SIM_WPC_LEFT = 0, SIM_WPC_RIGHT, SIM_HALL_IN11, SIM_HALL_IN6, SIM_SENSORS
+} SIM_sensor_t;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern SIM_scenario_t SIM_scenario;	///< Scenario used in simulation mode
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void SIM_amplitudes(const SIM_scenario_t* scenario, float* amplitudes);
+void SIM_quad_frame(const SIM_scenario_t* scenario, uint16_t* frame,
+					uint32_t count, uint32_t stride, float fs);
+void SIM_reset(uint32_t seed);
+
+
+#endif /* INC_SIM_H_ */
@@ -0,0 +1,92 @@
+/** ***************************************************************************
+ * @file
+ * @brief See telemetry.c
+ *
+ * Prefix TEL
+ *
+ *****************************************************************************/
+
+#ifndef INC_TELEMETRY_H_
+#define INC_TELEMETRY_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "measuring.h"
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Message types, the payloads are little endian and packed */
+typedef enum {
+	TEL_MSG_FRAME = 1,		///< TEL_frame_msg_t, every measurement frame
+	TEL_MSG_RESULT,			///< TEL_result_msg_t, every analysed result
+	TEL_MSG_WAVE,			///< TEL_wave_msg_t, raw samples if TEL_WAVES
+	TEL_MSG_TEXT			///< ASCII text, profile report as CSV
+} TEL_msg_t;
+
+/** Payload of TEL_MSG_FRAME */
+typedef struct __attribute__((packed)) {
+	uint32_t sequence;					///< Frame number, gaps if dropped
+	uint32_t tick;						///< HAL tick at completion [ms]
+	uint32_t amplitude[4];				///< WPC left, right, hall left, right
+} TEL_frame_msg_t;
+
+/** Payload of TEL_MSG_RESULT */
+typedef struct __attribute__((packed)) {
+	uint32_t tick;						///< HAL tick of the result [ms]
+	float distance;						///< Distance [mm], -1 if unusable
+	float angle;						///< Angle [deg], 100 if unusable
+	float current;						///< Current [A], -1 if unusable
+	float deviation;					///< Standard deviation of distance [mm]
+	uint8_t mode;						///< Cable type 0=L, 1=LN, 2=LNPE
+	uint8_t detected;					///< 1 if the cable was detected
+	float confidence;					///< Confidence of the angle, 0 to 1
+} TEL_result_msg_t;
+
+/** Payload of TEL_MSG_WAVE */
+typedef struct __attribute__((packed)) {
+	uint32_t sequence;					///< Frame number of the samples
+	uint16_t wave[MEAS_WAVE_CHANNELS][MEAS_WAVE_SAMPLES];	///< Raw samples
+} TEL_wave_msg_t;
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEL_SYNC0			0xA5	///< First sync byte of a message
+#define TEL_SYNC1			0x5A	///< Second sync byte of a message
+#define TEL_BAUDRATE		921600	///< USART1 to the ST-LINK virtual COM port
+#define TEL_BUFFER_SIZE		4096	///< Bytes in the transmit ring, power of 2
+#define TEL_PROFILE_TICKS	500		///< Ticks between profile reports
+
+/** ***************************************************************************
+ * Send the raw samples of every frame in addition, about 5 kB/s.
+ * @attention
+ * Uncomment this \#define to log the waveforms.
+ *****************************************************************************/
+//#define TEL_WAVES
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t TEL_dropped;		///< Messages dropped on a full ring
+extern uint32_t TEL_bytes;			///< Bytes queued for transmission
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void TEL_init(void);
+bool TEL_send(TEL_msg_t type, const void* payload, uint16_t length);
+void TEL_frame(const MEAS_frame_t* frame);
+void TEL_result(const TEL_result_msg_t* result);
+void TEL_tick(void);
+
+
+#endif /* INC_TELEMETRY_H_ */
@@ -9,6 +9,7 @@
  * - Collect measuring data when ready
  * - Start measurements
  * - Calculate angle, distance, standard deviation and current
+ * - Continuous angle with confidence from wpc distances and hall ratio
  *
  * ----------------------------------------------------------------------------
  * @author  Jonas Bollhalder, bollhjon@students.zhaw.ch
@@ -20,23 +21,14 @@
 /******************************************************************************
  * Includes
  *****************************************************************************/
-#include "stm32f4xx.h"
-#include "stm32f429i_discovery.h"
-
 #include "math.h"
 #include "analytics.h"
+#include "dsp.h"
 
 /******************************************************************************
  * Defines
  *****************************************************************************/
-// Current calculation
-#define CALC_ADCVOLTRESOLUTION	(float)(0.0008056640625) ///< Volt per digit
-#define CALC_AMPOPAMP			(float)(95)	///< Amplification of circuit
-#define CALC_AMPHALLSENS		(float)(90) ///< Amplification of hall sensor
-#define CALC_PIDANDPERM			(float)(4998556.330) ///< Pi and permutation
-
-// Distance conversion
-#define CALC_LUTSIZE			11 ///< Look up table size
+#define CALC_PI			(float)(3.14159265358979) ///< Pi
 
 /******************************************************************************
  * Variables
@@ -45,24 +37,35 @@ bool ANA_inBtn = false;			///< Input button pushed event
 bool ANA_inMeasReady = false;	///< Input measurement ready event
 uint32_t ANA_inAmpLeft = 0;		///< Input raw amplitude left
 uint32_t ANA_inAmpRight = 0;	///< Input raw amplitude right
+uint32_t ANA_inHallLeft = 0;	///< Input raw hall amplitude left (quad scan)
+uint32_t ANA_inHallRight = 0;	///< Input raw hall amplitude right (quad scan)
+float ANA_inPhase = 0;			///< Input phase wpc right to left [rad]
 uint16_t ANA_inOptn[4]={0,0,0,1};///< Input Mode,DataType,MeasuringType,Accuracy
 bool ANA_outStartHALL = false;	///< Output hall start event
 bool ANA_outStartWPC = false;	///< Output wpc start event
+bool ANA_outStartQUAD = false;	///< Output wpc and hall start event
+bool ANA_outStartStream = false;///< Output continuous streaming start event
+bool ANA_outStopStream = false;	///< Output continuous streaming stop event
 float ANA_outResults[4];		///< Output values
 								// angle,distance,std.dev.,current
 								// or
 								// raw hall right, hall left, wpc right, wpc left
+float ANA_outConfidence = 0;	///< Output confidence of the angle, 0 to 1
 bool ANA_outDataReady = false;	///< Output analysed data ready event
 
 bool ANA_measBusy = false;		///< Status general measurement
 bool ANA_wpcBusy = false;		///< Status wpc measurement
 bool ANA_hallBusy = false;		///< Status hall measurement
+bool ANA_quadBusy = false;		///< Status combined wpc and hall measurement
+bool ANA_streamBusy = false;	///< Status continuous streaming
 uint16_t ANA_cycle = 0;			///< Current measurement cycle count
 
 float ANA_wpcLeft[10];			///< Measurement buffer wpc left
 float ANA_wpcRight[10];			///< Measurement buffer wpc right
 float ANA_hallLeft[10];			///< Measurement buffer hall left
 float ANA_hallRight[10];		///< Measurement buffer hall right
+float ANA_wpcPhase[10];			///< Measurement buffer phase wpc right to left
+float ANA_wpcStep[10];			///< Distance resolution left plus right [mm]
 
 // Look up tables
 // Distance [cm]
@@ -79,33 +82,84 @@ float CALC_wpcLeftLNPE[CALC_LUTSIZE] = {315,292,280,263,260,255,242,235,220,211,
 // Array to LUTs
 float* CALC_wpcLeft[3] = {CALC_wpcLeftL,CALC_wpcLeftLN,CALC_wpcLeftLNPE};
 float* CALC_wpcRight[3] = {CALC_wpcRightL,CALC_wpcRightLN,CALC_wpcRightLNPE};
+// Segment engines built from the LUTs by ANA_Init()
+CALC_lut_t CALC_lutLeft[CALC_MODES];
+CALC_lut_t CALC_lutRight[CALC_MODES];
+// Arcsine [deg] of 0 to 1 in CALC_ASINSTEPS steps, built by ANA_Init()
+static float CALC_asin[CALC_ASINSTEPS+1];
 
 /******************************************************************************
  * Functions
  *****************************************************************************/
 
 /** ***************************************************************************
- * @brief Aproximate Angle with three length inputs
- * @param [in] distance left
- * @param [in] distance right
- * @param [in] distance midle
- * @return Angle between -45° and 45°
+ * @brief Arcsine from the precomputed table
+ * @param [in] ratio, limited to -1 to 1
+ * @return angle [deg]
  *****************************************************************************/
-float CALC_Angle(float left, float right, float middle){
-	left = left / middle;
-	right = right / middle;
-	middle = 1;
-	float x;
-	if (left < (middle-0.2)) {
-		x = -30;
-		//-45° to 0°
-	} else if (right < (middle-0.2)){
-		//0° - 45°
-		x = 30;
-	} else {
-		x = 0;
+static float CALC_Asin(float ratio){
+	float x = fminf(fabsf(ratio), 1)*CALC_ASINSTEPS;
+	int i = (int)x;
+	if (i >= CALC_ASINSTEPS) {
+		i = CALC_ASINSTEPS-1;
 	}
-	return x;
+	float angle = CALC_asin[i] + (x-i)*(CALC_asin[i+1]-CALC_asin[i]);
+	return (ratio < 0) ? -angle : angle;
+}
+
+
+/** ***************************************************************************
+ * @brief Estimate the angle of the cable
+ * @param [in] distance left [mm]
+ * @param [in] distance right [mm]
+ * @param [in] resolution, change of left plus right distance per digit [mm]
+ * @param [in] hall amplitude left, IN6
+ * @param [in] hall amplitude right, IN11
+ * @param [in] phase of wpc right minus wpc left [rad]
+ * @param [in] selected mode
+ * @return angle between -90° and 90° and its confidence
+ *
+ * The cable is turned by the angle around the middle of the sensors, so
+ * its distances differ by CALC_SENSORSPACING*sin(angle).
+ * @n With enough current the ratio of the hall amplitudes gives a second
+ * estimate. The field falls with 1/r for a single conductor and with 1/r^2
+ * for a conductor pair, r counted from the conductor. Both estimates are
+ * averaged.
+ * @n The confidence drops if one digit moves the angle by a lot (flat LUT
+ * segments), if the distances differ by more than the sensor spacing, if
+ * the wpc signals are out of phase (not a single cable) and if the wpc and
+ * hall estimates disagree. Each effect halves it at about CALC_ANGLEAGREE.
+ *****************************************************************************/
+CALC_angle_t CALC_Angle(float left, float right, float resolution,
+		float hallLeft, float hallRight, float phase, uint16_t mode){
+	CALC_angle_t result = {0, 0};
+	if ((left < 0) | (right < 0)) {
+		return result;
+	}
+	float ratio = (left-right)/CALC_SENSORSPACING;
+	result.angle = CALC_Asin(ratio);
+	result.confidence = fmaxf(cosf(phase), 0);
+	if (fabsf(ratio) > 1) {
+		result.confidence /= ratio*ratio;
+	}
+	float cosine = fmaxf(cosf(result.angle*CALC_PI/180), 0.2f);
+	float step = resolution*180/(CALC_PI*CALC_SENSORSPACING*cosine)
+			   / CALC_ANGLEAGREE;		// Angle per digit
+	result.confidence /= 1 + step*step;
+
+	// Second estimate from the hall sensors
+	if ((hallLeft >= CALC_HALLMIN) & (hallRight >= CALC_HALLMIN)) {
+		float k = hallRight/hallLeft;	// Radius left to right
+		if (mode > 0) {
+			k = sqrtf(k);
+		}
+		float sum = left + right + 2*CALC_HALLRADIUS;
+		float hallAngle = CALC_Asin(sum*(k-1)/((k+1)*CALC_SENSORSPACING));
+		float d = (result.angle - hallAngle)/CALC_ANGLEAGREE;
+		result.confidence /= 1 + d*d;
+		result.angle = (result.angle + hallAngle)/2;
+	}
+	return result;
 }
 
 
@@ -129,51 +183,78 @@ float CALC_ElCurrent(float amplitude, float distance){
 
 
 /** ***************************************************************************
- * @brief Convert amplitude strength to distance
+ * @brief Precompute the linear segments of a distance LUT
+ * @param [out] LUT engine
  * @param [in] pointer to distance LUT
- * @param [in] pointer to amplitude strength LUT
- * @param [in] measurement
- * @return calculated distance
+ * @param [in] pointer to amplitude strength LUT, kept by the engine
+ * @param [in] number of points, 2 to CALC_LUTMAXSIZE
+ * @return true if the LUT is valid
  *
- * Look up distance values corresponding to strength, if value is between two
- * entries calculate exact distance with a linear function.
+ * The strength has to be non-increasing with distance. Segments of equal
+ * strength are never selected by CALC_Distance() and get a zero slope.
  *****************************************************************************/
-float CALC_Distance(float* lutDistance, float* lutStrenght, float measurement){
-	int t,d,s;
-	float distance = -1;
-	t=0;
-	s=-10;
-	d=-10;
-
-	// Catch to high and to low values
-	if(lutStrenght[CALC_LUTSIZE-1]>measurement){
-		measurement = lutStrenght[CALC_LUTSIZE-1];
-	} else if (measurement>lutStrenght[0]) {
-		measurement = lutStrenght[0];
+bool CALC_LutInit(CALC_lut_t* lut, const float* lutDistance,
+		const float* lutStrength, uint16_t size){
+	lut->size = 0;
+	if ((size < 2) | (size > CALC_LUTMAXSIZE)) {
+		return false;
 	}
-
-	// Go through LUT
-	for(int i=0; i < CALC_LUTSIZE ; i++ ){
-		if (measurement == lutStrenght[i]){
-			t = i;
-			s=t;
+	for (int i = 0; i < size-1; ++i) {
+		if (lutStrength[i+1] > lutStrength[i]) {
+			return false;
 		}
-		if ( (measurement < lutStrenght[i])&& (measurement > lutStrenght[i+1])){
-			t = i;
-			d=t;
+		if (lutStrength[i+1] == lutStrength[i]) {
+			lut->slope[i] = 0;
+			lut->intercept[i] = lutDistance[i];
+		} else {
+			lut->slope[i] = (lutDistance[i+1]-lutDistance[i])
+						  / (lutStrength[i+1]-lutStrength[i]);
+			lut->intercept[i] = lutDistance[i] - lut->slope[i]*lutStrength[i];
 		}
 	}
+	lut->strength = lutStrength;
+	lut->nearest = lutDistance[0];
+	lut->farthest = lutDistance[size-1];
+	lut->size = size;
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Convert amplitude strength to distance
+ * @param [in] LUT engine
+ * @param [in] measurement
+ * @return calculated distance, -1 if the LUT is invalid
+ *
+ * Binary search for the segment containing the strength, then evaluate its
+ * linear function. Values matching an entry return its distance, values out
+ * of range are limited to the first and last distance.
+ *****************************************************************************/
+float CALC_Distance(const CALC_lut_t* lut, float measurement){
+	if (lut->size < 2) {
+		return -1;
+	}
 
-	if(t==d){
-		float a = (lutDistance[t+1]-lutDistance[t])/(lutStrenght[t+1]-lutStrenght[t]);
-		distance = a*(measurement-lutStrenght[t]) + lutDistance[t];
+	// Catch to high and to low values
+	if (measurement >= lut->strength[0]) {
+		return lut->nearest;
+	} else if (measurement <= lut->strength[lut->size-1]) {
+		return lut->farthest;
 	}
 
-	if(t==s){
-		distance = lutDistance[t];
+	// Last entry with strength >= measurement, strength[hi] < measurement
+	uint16_t lo = 0;
+	uint16_t hi = lut->size-1;
+	while (hi-lo > 1) {
+		uint16_t mid = (lo+hi)/2;
+		if (lut->strength[mid] >= measurement) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
 	}
 
-	return distance;
+	return lut->slope[lo]*measurement + lut->intercept[lo];
 }
 
 
@@ -186,19 +267,64 @@ float CALC_Distance(float* lutDistance, float* lutStrenght, float measurement){
  *****************************************************************************/
 float CALC_DistanceMode(float measurement, uint16_t mode, bool right){
 	float distance;
-	float* lut;
+	CALC_lut_t* lut;
 	// Select left or right
 	if (right) {
-		lut = CALC_wpcRight[mode];
+		lut = &CALC_lutRight[mode];
 	} else {
-		lut = CALC_wpcLeft[mode];
+		lut = &CALC_lutLeft[mode];
 	}
 	// Calculate distance with correct mode
-	distance = CALC_Distance(CALC_distanceLUT, lut, measurement);
+	distance = CALC_Distance(lut, measurement);
 	return distance;
 }
 
 
+/** ***************************************************************************
+ * @brief Change of the distance per digit of the measurement
+ * @param [in] measurement value
+ * @param [in] selected mode
+ * @param [in] channel selection, if true right side
+ * @return resolution [mm]
+ *****************************************************************************/
+float CALC_DistanceStep(float measurement, uint16_t mode, bool right){
+	return fabsf(CALC_DistanceMode(measurement+0.5f, mode, right)
+			   - CALC_DistanceMode(measurement-0.5f, mode, right));
+}
+
+
+
+/** ***************************************************************************
+ * @brief Initialize the analytics
+ *
+ * Build the distance engines of all modes from the LUTs and the arcsine
+ * table of the angle estimation.
+ *****************************************************************************/
+void ANA_Init(void){
+	for (int i = 0; i <= CALC_ASINSTEPS; ++i) {
+		CALC_asin[i] = asinf((float)i/CALC_ASINSTEPS)*180/CALC_PI;
+	}
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		CALC_LutInit(&CALC_lutLeft[mode], CALC_distanceLUT,
+				CALC_wpcLeft[mode], CALC_LUTSIZE);
+		CALC_LutInit(&CALC_lutRight[mode], CALC_distanceLUT,
+				CALC_wpcRight[mode], CALC_LUTSIZE);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Check if the analytics handler has a step to take right away
+ * @return true if ANA_Handler() has to run again without new input
+ *
+ * A finished measurement cycle starts the next one only in the following
+ * call of ANA_Handler(), the main loop must not sleep until then.
+ *****************************************************************************/
+bool ANA_Pending(void){
+	return ANA_measBusy & !ANA_wpcBusy & !ANA_hallBusy & !ANA_quadBusy
+		& (ANA_cycle < ANA_inOptn[3]);
+}
+
 
 /** ***************************************************************************
  * @brief Analytics handler
@@ -218,13 +344,38 @@ void ANA_Handler(void){
 	if (ANA_wpcBusy & ANA_inMeasReady) {
 		ANA_wpcLeft[ANA_cycle]=(float)ANA_inAmpLeft;
 		ANA_wpcRight[ANA_cycle]=(float)ANA_inAmpRight;
+		ANA_wpcPhase[ANA_cycle]=ANA_inPhase;
 	} else if (ANA_hallBusy & ANA_inMeasReady){
-		ANA_hallLeft[ANA_cycle]=(float)ANA_inAmpLeft;
-		ANA_hallRight[ANA_cycle]=(float)ANA_inAmpRight;
+		// ADC3 converts IN11 (right) first and IN6 (left) second
+		ANA_hallLeft[ANA_cycle]=(float)ANA_inAmpRight;
+		ANA_hallRight[ANA_cycle]=(float)ANA_inAmpLeft;
+	} else if (ANA_quadBusy & ANA_inMeasReady){
+		ANA_wpcLeft[ANA_cycle]=(float)ANA_inAmpLeft;
+		ANA_wpcRight[ANA_cycle]=(float)ANA_inAmpRight;
+		ANA_wpcPhase[ANA_cycle]=ANA_inPhase;
+		ANA_hallLeft[ANA_cycle]=(float)ANA_inHallLeft;
+		ANA_hallRight[ANA_cycle]=(float)ANA_inHallRight;
 	}
 
 	//while meas busy, start measurements
 	if (ANA_measBusy){
+#ifdef ANA_QUAD_SCAN
+		//start wpc and hall, in continuous mode keep streaming
+		if ((ANA_cycle < ANA_inOptn[3])&(!ANA_quadBusy)) {
+			if (ANA_streamBusy) {
+				//next frame is already on its way
+			} else if (ANA_inOptn[2]==1) {
+				ANA_outStartStream = true;
+				ANA_streamBusy = true;
+			} else {
+				ANA_outStartQUAD = true;
+			}
+			ANA_quadBusy = true;
+		} else if (ANA_quadBusy & ANA_inMeasReady){
+			ANA_quadBusy = false;
+			ANA_cycle ++;
+		}
+#else
 		//start wpc
 		if ((ANA_cycle < ANA_inOptn[3])&(!ANA_wpcBusy)&(!ANA_hallBusy)) {
 			ANA_outStartWPC = true;
@@ -238,71 +389,65 @@ void ANA_Handler(void){
 			ANA_hallBusy = false;
 			ANA_cycle ++;
 		}
+#endif
 	}
 
 	//When cycles finished or in continuous mode and single cycle is completed
-	if ((ANA_cycle == ANA_inOptn[3])&(!ANA_wpcBusy)&(!ANA_hallBusy)) {
+	if ((ANA_cycle == ANA_inOptn[3])&(!ANA_wpcBusy)&(!ANA_hallBusy)
+		&(!ANA_quadBusy)) {
 		//Analyse data
-		float mean,stdDeviation,angle,current;
+		float mean,stdDeviation,angle,confidence,current;
 		mean = 0;
 		stdDeviation = 0;
 		angle = 0;
+		confidence = 0;
 		current = 0;
 		if (ANA_inOptn[1]==0) {
 			int accuracy = ANA_inOptn[3];
 			// Calculate distance
 			for (int i = 0; i < accuracy; ++i) {
+				ANA_wpcStep[i]=CALC_DistanceStep(ANA_wpcLeft[i], ANA_inOptn[0], false)
+							  +CALC_DistanceStep(ANA_wpcRight[i], ANA_inOptn[0], true);
 				ANA_wpcLeft[i]=CALC_DistanceMode(ANA_wpcLeft[i], ANA_inOptn[0], false);
 				ANA_wpcRight[i]=CALC_DistanceMode(ANA_wpcRight[i], ANA_inOptn[0], true);
 			}
-			// Sum
-			float sumLeft,sumRight;
-			for (int i = 0; i < accuracy; ++i) {
-				sumLeft = sumLeft+ANA_wpcLeft[i];
-				sumRight = sumRight+ANA_wpcRight[i];
-			}
 			// Mean
 			float meanLeft,meanRight;
-			meanLeft = sumLeft/accuracy;
-			meanRight = sumRight/accuracy;
-			mean = (sumLeft+sumRight)/(2*accuracy);
+			meanLeft = DSP_mean_f32(ANA_wpcLeft, accuracy);
+			meanRight = DSP_mean_f32(ANA_wpcRight, accuracy);
+			mean = (meanLeft+meanRight)/2;
 
-			// Standard Deviation
+			// Standard Deviation of the distances of both sides
 			if (accuracy>1){
-				// Deviations
-				float deviation[2*accuracy];
+				float distances[2*accuracy];
 				for (int i = 0; i < accuracy; ++i) {
-					// Left
-					deviation[i]=ANA_wpcLeft[i]-mean;
-					deviation[i]=deviation[i]*deviation[i];
-					// Right
-					deviation[i*2]=ANA_wpcRight[i]-mean;
-					deviation[i*2]=deviation[i*2]*deviation[i*2];
-				}
-				// Variation
-				float var = 0;
-				for (int i = 0; i < 2*accuracy; ++i) {
-					var = var + deviation[1];
+					distances[i]=ANA_wpcLeft[i];
+					distances[accuracy+i]=ANA_wpcRight[i];
 				}
-				var = var/(accuracy*2);
-				// Standard Deviation
-				stdDeviation = sqrtf(var);
+				stdDeviation = sqrtf(DSP_var_f32(distances, 2*accuracy));
 			}
 
-			// Angle
-			angle = CALC_Angle(meanRight, meanLeft, mean);
+			// Angle of each frame, weighted by its confidence
+			for (int i = 0; i < accuracy; ++i) {
+				CALC_angle_t estimate = CALC_Angle(ANA_wpcLeft[i],
+						ANA_wpcRight[i], ANA_wpcStep[i], ANA_hallLeft[i],
+						ANA_hallRight[i], ANA_wpcPhase[i], ANA_inOptn[0]);
+				angle += estimate.confidence*estimate.angle;
+				confidence += estimate.confidence;
+			}
+			if (confidence > 0) {
+				angle = angle/confidence;
+			}
+			confidence = confidence/accuracy;
 
 			// Current
 			if ((mean<10)&(mean>0)) {
 				// Mean of hall sensor
-				float sumHall;
-				for (int i = 0; i < accuracy; ++i) {
-					sumHall = ANA_hallLeft[i]+sumHall;
-					sumHall = ANA_hallRight[i]+sumHall;
-				}
-				sumHall = sumHall/(2*accuracy);
+				float meanHall;
+				meanHall = (DSP_mean_f32(ANA_hallLeft, accuracy)
+						 + DSP_mean_f32(ANA_hallRight, accuracy))/2;
 
-				current = CALC_ElCurrent(sumHall, (mean/1000));
+				current = CALC_ElCurrent(meanHall, (mean/1000));
 			}
 
 			// Transfer results
@@ -310,28 +455,18 @@ void ANA_Handler(void){
 			ANA_outResults[1]=mean; // Distance
 			ANA_outResults[2]=stdDeviation; //Standard deviation
 			ANA_outResults[3]=current; //Current
+			ANA_outConfidence=confidence;
 			ANA_outDataReady = true;
 
 		} else { //transfer raw data
 			// Calculate means of all 4 inputs
 			float meanWPCright, meanWPCleft, meanHALLright, meanHALLleft;
-			meanHALLleft = 0;
-			meanHALLright = 0;
-			meanWPCleft = 0;
-			meanWPCright = 0;
-
 			int accuracy = ANA_inOptn[3];
 
-			for (int i = 0; i < accuracy; ++i) {
-				meanHALLleft = meanHALLleft + ANA_hallLeft[i];
-				meanHALLright = meanHALLright + ANA_hallRight[i];
-				meanWPCleft = meanWPCleft + ANA_wpcLeft[i];
-				meanWPCright = meanWPCright + ANA_wpcRight[i];
-			}
-			meanHALLleft = meanHALLleft / accuracy;
-			meanHALLright = meanHALLright / accuracy;
-			meanWPCleft = meanWPCleft / accuracy;
-			meanWPCright = meanWPCright / accuracy;
+			meanHALLleft = DSP_mean_f32(ANA_hallLeft, accuracy);
+			meanHALLright = DSP_mean_f32(ANA_hallRight, accuracy);
+			meanWPCleft = DSP_mean_f32(ANA_wpcLeft, accuracy);
+			meanWPCright = DSP_mean_f32(ANA_wpcRight, accuracy);
 
 			// Transfer results
 			ANA_outResults[0]=meanHALLright; // HallRight
@@ -349,6 +484,14 @@ void ANA_Handler(void){
 		ANA_measBusy = false;
 	}
 
+	//stop streaming when measurement ended
+	if (ANA_streamBusy & !ANA_measBusy) {
+		ANA_outStopStream = true;
+		ANA_streamBusy = false;
+		ANA_quadBusy = false;
+		ANA_cycle = 0;
+	}
+
 	// Set cycles to zero if measurement finished
 	if (ANA_cycle == ANA_inOptn[3]) {
 		ANA_cycle = 0;
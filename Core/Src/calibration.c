@@ -0,0 +1,288 @@
+/** ***************************************************************************
+ * @file
+ * @brief Calibration of the distance LUTs, stored in on-chip flash
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Record format with magic, version, sequence and CRC-32
+ * - Monotonic fit of measured strengths for the distance engines
+ * - Wear levelled storage in flash sector 23
+ * - Wizard taking one point per distance of CALC_distanceLUT
+ *
+ * The sector is used as a log of CAL_SLOTS records. A save writes the next
+ * erased slot, the sector is only erased when all slots are used. At boot
+ * the valid record with the highest sequence is loaded, so an interrupted
+ * save falls back to the previous calibration.
+ * @n The wizard averages all frames measured between the button press and
+ * the analytics result, use the single measurement mode. After the last
+ * point both tables of the mode are fitted, the distance engines rebuilt
+ * and the record saved.
+ * @n Only the flash access depends on the target, it is done by the
+ * CAL_flash_ functions of calibration_flash.c. Everything else also builds on
+ * a host, with a RAM model of the sector.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+#include "calibration.h"
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+CAL_wizard_t CAL_wizard = {CAL_IDLE};	///< Progress of the wizard
+uint32_t CAL_sequence = 0;				///< Sequence of the loaded record
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief CRC-32 as used by zlib (reflected 0xEDB88320)
+ * @param [in] data
+ * @param [in] size in bytes
+ * @return crc
+ *****************************************************************************/
+uint32_t CAL_crc32(const void* data, uint32_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint32_t crc = 0xFFFFFFFF;
+	for (uint32_t i = 0; i < size; ++i) {
+		crc ^= bytes[i];
+		for (int b = 0; b < 8; ++b) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+		}
+	}
+	return ~crc;
+}
+
+
+/** ***************************************************************************
+ * @brief Fit measured strengths to a non-increasing table
+ * @param [in,out] strength per point, nearest distance first
+ * @param [in] number of points
+ *
+ * Least squares fit under the constraint required by CALC_LutInit(), done
+ * by pooling adjacent violators: every rising run is replaced by its mean.
+ *****************************************************************************/
+void CAL_fit(float* strength, uint16_t size)
+{
+	float mean[CALC_LUTMAXSIZE];
+	uint16_t weight[CALC_LUTMAXSIZE];
+	int blocks = 0;
+
+	for (int i = 0; i < size; ++i) {
+		mean[blocks] = strength[i];
+		weight[blocks] = 1;
+		blocks++;
+		//merge while the last block is stronger than its predecessor
+		while ((blocks > 1) && (mean[blocks-1] > mean[blocks-2])) {
+			uint16_t w = weight[blocks-2] + weight[blocks-1];
+			mean[blocks-2] = (mean[blocks-2]*weight[blocks-2]
+							+ mean[blocks-1]*weight[blocks-1]) / w;
+			weight[blocks-2] = w;
+			blocks--;
+		}
+	}
+	for (int b = 0, i = 0; b < blocks; ++b) {
+		for (int j = 0; j < weight[b]; ++j) {
+			strength[i++] = mean[b];
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Check a record
+ * @param [in] record
+ * @return true if magic, version, size and CRC match
+ *****************************************************************************/
+bool CAL_record_valid(const CAL_record_t* record)
+{
+	return (record->magic == CAL_MAGIC)
+		&& (record->version == CAL_VERSION)
+		&& (record->points == CALC_LUTSIZE)
+		&& (record->crc == CAL_crc32(record, offsetof(CAL_record_t, crc)));
+}
+
+
+/** ***************************************************************************
+ * @brief Fill a record with the tables in use
+ * @param [out] record
+ * @param [in] sequence of the record
+ *****************************************************************************/
+void CAL_record_fill(CAL_record_t* record, uint32_t sequence)
+{
+	memset(record, 0, sizeof(*record));
+	record->magic = CAL_MAGIC;
+	record->version = CAL_VERSION;
+	record->points = CALC_LUTSIZE;
+	record->sequence = sequence;
+	memcpy(record->distance, CALC_distanceLUT, sizeof(record->distance));
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		memcpy(record->left[mode], CALC_wpcLeft[mode], sizeof(record->left[0]));
+		memcpy(record->right[mode], CALC_wpcRight[mode],
+			   sizeof(record->right[0]));
+	}
+	record->crc = CAL_crc32(record, offsetof(CAL_record_t, crc));
+}
+
+
+/** ***************************************************************************
+ * @brief Use the tables of a record
+ * @param [in] valid record
+ *
+ * The distance engines have to be rebuilt by ANA_Init() afterwards.
+ *****************************************************************************/
+void CAL_record_apply(const CAL_record_t* record)
+{
+	memcpy(CALC_distanceLUT, record->distance, sizeof(record->distance));
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		memcpy(CALC_wpcLeft[mode], record->left[mode], sizeof(record->left[0]));
+		memcpy(CALC_wpcRight[mode], record->right[mode],
+			   sizeof(record->right[0]));
+	}
+	CAL_sequence = record->sequence;
+}
+
+
+/** ***************************************************************************
+ * @brief Load the newest valid record from flash
+ * @return false if there is none, the built-in tables stay in use
+ *
+ * Call before ANA_Init().
+ *****************************************************************************/
+bool CAL_load(void)
+{
+	const CAL_record_t* newest = NULL;
+	for (uint32_t slot = 0; slot < CAL_SLOTS; ++slot) {
+		const CAL_record_t* record = CAL_flash_read(slot*CAL_SLOT_SIZE);
+		if (CAL_record_valid(record)
+			&& ((newest == NULL) || (record->sequence > newest->sequence))) {
+			newest = record;
+		}
+	}
+	if (newest == NULL) {
+		return false;
+	}
+	CAL_record_apply(newest);
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Store the tables in use as a new record
+ * @return false if erasing or programming failed
+ *
+ * Blocks while programming, and for about 2 s if the sector is erased.
+ *****************************************************************************/
+bool CAL_save(void)
+{
+	CAL_record_t record;
+	uint32_t offset = CAL_SECTOR_SIZE;
+	bool ok = true;
+
+	CAL_record_fill(&record, CAL_sequence+1);
+	//first slot still erased
+	for (uint32_t slot = 0; (slot < CAL_SLOTS) && (offset == CAL_SECTOR_SIZE);
+		 ++slot) {
+		const uint32_t* word = CAL_flash_read(slot*CAL_SLOT_SIZE);
+		bool erased = true;
+		for (uint32_t i = 0; i < sizeof(record)/4; ++i) {
+			erased = erased && (word[i] == 0xFFFFFFFF);
+		}
+		if (erased) {
+			offset = slot*CAL_SLOT_SIZE;
+		}
+	}
+
+	if (offset == CAL_SECTOR_SIZE) {	// All slots used, start over
+		ok = CAL_flash_erase();
+		offset = 0;
+	}
+	ok = ok && CAL_flash_write(offset, (const uint32_t*)&record,
+							   sizeof(record)/4);
+
+	if (!ok || !CAL_record_valid(CAL_flash_read(offset))) {
+		return false;
+	}
+	CAL_sequence = record.sequence;
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Start the wizard for one cable mode
+ * @param [in] mode 0=L, 1=LN, 2=LNPE
+ *****************************************************************************/
+void CAL_wizard_start(uint16_t mode)
+{
+	memset(&CAL_wizard, 0, sizeof(CAL_wizard));
+	CAL_wizard.mode = mode;
+	CAL_wizard.state = CAL_WAIT;
+}
+
+
+/** ***************************************************************************
+ * @brief Start averaging the current point, the button was pressed
+ *
+ *****************************************************************************/
+void CAL_wizard_capture(void)
+{
+	if (CAL_wizard.state == CAL_WAIT) {
+		CAL_wizard.count = 0;
+		CAL_wizard.sumLeft = 0;
+		CAL_wizard.sumRight = 0;
+		CAL_wizard.state = CAL_CAPTURE;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Add the amplitudes of one measurement frame
+ * @param [in] wpc left amplitude
+ * @param [in] wpc right amplitude
+ *****************************************************************************/
+void CAL_wizard_sample(uint32_t left, uint32_t right)
+{
+	if (CAL_wizard.state == CAL_CAPTURE) {
+		CAL_wizard.sumLeft += left;
+		CAL_wizard.sumRight += right;
+		CAL_wizard.count++;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Finish the current point, the analytics result is ready
+ *
+ * After the last point the tables are fitted, used and saved.
+ *****************************************************************************/
+void CAL_wizard_complete(void)
+{
+	uint16_t mode = CAL_wizard.mode;
+	if ((CAL_wizard.state != CAL_CAPTURE) || (CAL_wizard.count == 0)) {
+		return;
+	}
+	CAL_wizard.left[CAL_wizard.point] = CAL_wizard.sumLeft/CAL_wizard.count;
+	CAL_wizard.right[CAL_wizard.point] = CAL_wizard.sumRight/CAL_wizard.count;
+	CAL_wizard.point++;
+	if (CAL_wizard.point < CALC_LUTSIZE) {
+		CAL_wizard.state = CAL_WAIT;
+		return;
+	}
+
+	CAL_fit(CAL_wizard.left, CALC_LUTSIZE);
+	CAL_fit(CAL_wizard.right, CALC_LUTSIZE);
+	memcpy(CALC_wpcLeft[mode], CAL_wizard.left, sizeof(CAL_wizard.left));
+	memcpy(CALC_wpcRight[mode], CAL_wizard.right, sizeof(CAL_wizard.right));
+	ANA_Init();
+	CAL_wizard.state = CAL_save() ? CAL_SAVED : CAL_FAILED;
+}
@@ -0,0 +1,75 @@
+/** ***************************************************************************
+ * @file
+ * @brief Flash sector 23 of the STM32F429, storage of the calibration
+ *
+ * The only target dependent part of calibration.c. The sector is read
+ * through its memory mapping and programmed word by word with the HAL.
+ * Test/mock/flash.c replaces this file on a host.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "stm32f4xx.h"
+
+#include "calibration.h"
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Address of a location in the sector
+ * @param [in] offset in bytes
+ * @return pointer into the memory mapped flash
+ *****************************************************************************/
+const void* CAL_flash_read(uint32_t offset)
+{
+	return (const void*)(CAL_SECTOR_ADDR + offset);
+}
+
+
+/** ***************************************************************************
+ * @brief Erase the whole sector
+ * @return false if the HAL reported an error
+ *
+ * Blocks for about 2 s.
+ *****************************************************************************/
+bool CAL_flash_erase(void)
+{
+	FLASH_EraseInitTypeDef erase = {0};
+	uint32_t error;
+	HAL_StatusTypeDef status;
+
+	erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+	erase.Sector = FLASH_SECTOR_23;
+	erase.NbSectors = 1;
+	erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+	HAL_FLASH_Unlock();
+	status = HAL_FLASHEx_Erase(&erase, &error);
+	HAL_FLASH_Lock();
+	return status == HAL_OK;
+}
+
+
+/** ***************************************************************************
+ * @brief Program erased words of the sector
+ * @param [in] offset in bytes, word aligned
+ * @param [in] words
+ * @param [in] count of words
+ * @return false if the HAL reported an error
+ *****************************************************************************/
+bool CAL_flash_write(uint32_t offset, const uint32_t* words, uint32_t count)
+{
+	HAL_StatusTypeDef status = HAL_OK;
+
+	HAL_FLASH_Unlock();
+	for (uint32_t i = 0; (i < count) && (status == HAL_OK); ++i) {
+		status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD,
+								   CAL_SECTOR_ADDR + offset + 4*i, words[i]);
+	}
+	HAL_FLASH_Lock();
+	return status == HAL_OK;
+}
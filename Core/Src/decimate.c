@@ -0,0 +1,135 @@
+/** ***************************************************************************
+ * @file
+ * @brief Decimation of oversampled ADC channels
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - CIC decimator in integer arithmetic
+ * - Compensation FIR, corrects the CIC droop and removes what would alias
+ * - Incremental processing of DMA blocks, state kept per channel
+ *
+ * The CIC decimates by DEC_CIC_RATIO with only additions per input sample.
+ * Its integrators may overflow, the wrap around cancels in the combs as
+ * long as the gain DEC_CIC_RATIO^DEC_CIC_ORDER times the input range fits
+ * into 32 bit.
+ * @n The FIR runs at the CIC output rate and decimates by DEC_FIR_RATIO.
+ * It is flat up to 1/3 of the output rate (0.1 dB) and attenuates from 2/3
+ * to 4/3 of the output rate by more than 60 dB. Beyond, the FIR passes again
+ * around multiples of twice the output rate and only the CIC attenuates,
+ * by at least 40 dB for what folds into the passband.
+ * The coefficients are designed by Tools/dec_design.py, which also models
+ * the SNR gain over sampling at the output rate directly.
+ * @n The output is in ADC units again, so it can be analysed like samples
+ * taken at the output rate.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+
+#include "decimate.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define DEC_CIC_GAIN	(DEC_CIC_RATIO*DEC_CIC_RATIO*DEC_CIC_RATIO)	///< R^N
+#define DEC_OUT_MAX		4095		///< Largest output, ADC full scale
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+/** Compensation FIR, unity gain at DC, see Tools/dec_design.py */
+static const float DEC_fir[DEC_FIR_TAPS] = {
+		0.00191892f, 0.00396972f, -0.00530949f, -0.01623087f, 0.00949950f,
+		0.04507251f, -0.01066751f, -0.11046239f, -0.00947206f, 0.32766177f,
+		0.52803977f, 0.32766177f, -0.00947206f, -0.11046239f, -0.01066751f,
+		0.04507251f, 0.00949950f, -0.01623087f, -0.00530949f, 0.00396972f,
+		0.00191892f,
+};
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Reset the state of one channel
+ * @param [out] dec
+ *
+ * The first DEC_SETTLE outputs afterwards are not valid yet.
+ *****************************************************************************/
+void DEC_init(DEC_t* dec)
+{
+	memset(dec, 0, sizeof(*dec));
+}
+
+
+/** ***************************************************************************
+ * @brief Decimate a block of one channel
+ * @param [in,out] dec state of the channel
+ * @param [in] in first sample of the channel
+ * @param [in] count samples of the channel in the block
+ * @param [in] stride distance of two samples of the channel
+ * @param [out] out decimated samples, count/DEC_RATIO+1 at most
+ * @return number of decimated samples
+ *
+ * The block may end at any sample, the next call continues seamlessly.
+ *****************************************************************************/
+uint32_t DEC_process(DEC_t* dec, const uint16_t* in, uint32_t count,
+					 uint32_t stride, uint16_t* out)
+{
+	uint32_t produced = 0;
+	uint32_t i1 = dec->integrator[0];
+	uint32_t i2 = dec->integrator[1];
+	uint32_t i3 = dec->integrator[2];
+
+	for (uint32_t i = 0; i < count; ++i) {
+		i1 += in[i*stride];				// Integrators at the input rate
+		i2 += i1;
+		i3 += i2;
+		if (++dec->cicPhase < DEC_CIC_RATIO) {
+			continue;
+		}
+		dec->cicPhase = 0;
+
+		//combs at the CIC output rate
+		uint32_t c1 = i3 - dec->comb[0];
+		uint32_t c2 = c1 - dec->comb[1];
+		uint32_t c3 = c2 - dec->comb[2];
+		dec->comb[0] = i3;
+		dec->comb[1] = c1;
+		dec->comb[2] = c2;
+
+		//FIR delay line stored twice, so the taps are contiguous
+		float value = (float)c3 * (1.0f/DEC_CIC_GAIN);
+		dec->head = (dec->head == 0) ? DEC_FIR_TAPS-1 : dec->head-1;
+		dec->line[dec->head] = value;
+		dec->line[dec->head+DEC_FIR_TAPS] = value;
+		if (++dec->firPhase < DEC_FIR_RATIO) {
+			continue;
+		}
+		dec->firPhase = 0;
+
+		const float* line = &dec->line[dec->head];
+		float sum = 0;
+		for (int k = 0; k < DEC_FIR_TAPS; ++k) {
+			sum += DEC_fir[k]*line[k];
+		}
+		if (sum < 0) {
+			sum = 0;
+		} else if (sum > DEC_OUT_MAX) {
+			sum = DEC_OUT_MAX;
+		}
+		out[produced++] = (uint16_t)(sum + 0.5f);
+	}
+
+	dec->integrator[0] = i1;
+	dec->integrator[1] = i2;
+	dec->integrator[2] = i3;
+	return produced;
+}
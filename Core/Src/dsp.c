@@ -0,0 +1,104 @@
+/** ***************************************************************************
+ * @file
+ * @brief Signal processing kernels used by measuring and analytics
+ *
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Mean and variance of float samples
+ * - Magnitude of complex values
+ *
+ * On the target (ARM_MATH_CM4 defined) the kernels map to the CMSIS-DSP
+ * library linked from Drivers/CMSIS/Lib/GCC/libarm_cortexM4lf_math.a.
+ * @n Without ARM_MATH_CM4, e.g. when compiled for a PC, portable C versions
+ * with the same definitions are used, so results can be compared.
+ *
+ * @note arm_math.h expects non-const source pointers, the kernels do not
+ * modify the source data.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "dsp.h"
+
+#ifdef ARM_MATH_CM4
+#include "stm32f4xx.h"
+#include "arm_math.h"
+#else
+#include "math.h"
+#endif
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Mean of a block of samples
+ * @param [in] samples
+ * @param [in] number of samples
+ * @return mean, 0 without samples
+ *****************************************************************************/
+float DSP_mean_f32(const float* src, uint32_t count){
+	float mean;
+	if (count == 0) {
+		return 0;
+	}
+#ifdef ARM_MATH_CM4
+	arm_mean_f32((float32_t*)src, count, &mean);
+#else
+	float sum = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		sum += src[i];
+	}
+	mean = sum / count;
+#endif
+	return mean;
+}
+
+
+/** ***************************************************************************
+ * @brief Sample variance of a block of samples
+ * @param [in] samples
+ * @param [in] number of samples
+ * @return variance, normalised with count-1 like arm_var_f32(), 0 for less
+ * than 2 samples
+ *****************************************************************************/
+float DSP_var_f32(const float* src, uint32_t count){
+	float var;
+	if (count < 2) {
+		return 0;
+	}
+#ifdef ARM_MATH_CM4
+	arm_var_f32((float32_t*)src, count, &var);
+#else
+	float sum = 0;
+	float sumOfSquares = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		sum += src[i];
+		sumOfSquares += src[i]*src[i];
+	}
+	var = (sumOfSquares - (sum*sum)/count) / (count-1);
+#endif
+	return var;
+}
+
+
+/** ***************************************************************************
+ * @brief Magnitude of complex values
+ * @param [in] interleaved real and imaginary parts
+ * @param [out] magnitudes
+ * @param [in] number of complex values
+ *****************************************************************************/
+void DSP_cmplx_mag_f32(const float* src, float* dst, uint32_t count){
+#ifdef ARM_MATH_CM4
+	arm_cmplx_mag_f32((float32_t*)src, dst, count);
+#else
+	for (uint32_t i = 0; i < count; ++i) {
+		dst[i] = sqrtf(src[2*i]*src[2*i] + src[2*i+1]*src[2*i+1]);
+	}
+#endif
+}
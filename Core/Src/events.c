@@ -0,0 +1,166 @@
+/** ***************************************************************************
+ * @file
+ * @brief Event queue between the interrupt handlers and the main loop
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Post events from interrupt handlers of any priority
+ * - Sleep with WFI while no event is pending
+ * - Periodic tick event derived from the SysTick
+ * - Idle percentage and main loop pass time from the DWT cycle counter
+ *
+ * The main loop takes one event at a time with EVT_wait(). The queue is
+ * checked with the interrupts masked, an interrupt arriving right before
+ * the WFI then still ends the sleep and is served after unmasking.
+ *
+ * The core clock may be stopped during the sleep, so only the cycles
+ * between wake up and the next sleep are counted. The idle percentage
+ * is the remainder of EVT_LOAD_WINDOW.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "stm32f4xx.h"
+
+#include "events.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define EVT_QUEUE_MASK	(EVT_QUEUE_SIZE-1)	///< Index mask of the queue
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+uint32_t EVT_overflow = 0;				///< Events lost on a full queue
+float EVT_idle_percent = 0;				///< Idle time of the last window [%]
+uint32_t EVT_pass_cycles = 0;			///< Cycles of the last main loop pass
+uint32_t EVT_pass_max = 0;				///< Longest main loop pass [cycles]
+
+static uint8_t EVT_queue[EVT_QUEUE_SIZE];	///< Pending events
+static volatile uint32_t EVT_head = 0;	///< Next event to write
+static volatile uint32_t EVT_tail = 0;	///< Next event to read
+static uint32_t EVT_ticks = 0;			///< Milliseconds since last tick event
+#ifdef EVT_IDLE_ACCOUNTING
+static uint32_t EVT_window = 0;			///< Milliseconds of the current window
+static uint32_t EVT_wake = 0;			///< Cycle count at the last wake up
+static uint32_t EVT_busy_cycles = 0;	///< Cycles awake in the current window
+static uint32_t EVT_pass_start = 0;		///< Cycle count at start of the pass
+#endif
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Initialize the event queue and the cycle counter
+ *
+ *****************************************************************************/
+void EVT_init(void)
+{
+	EVT_head = 0;
+	EVT_tail = 0;
+#ifdef EVT_IDLE_ACCOUNTING
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;	// Enable trace and DWT
+	DWT->CYCCNT = 0;					// Reset cycle counter
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;// Enable cycle counter
+	EVT_wake = DWT->CYCCNT;
+	EVT_pass_start = EVT_wake;
+	EVT_busy_cycles = 0;
+	EVT_window = 0;
+#endif
+}
+
+
+/** ***************************************************************************
+ * @brief Post an event to the main loop
+ * @param [in] event
+ *
+ * May be called from any interrupt handler. A full queue drops the event.
+ *****************************************************************************/
+void EVT_post(EVT_t event)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();					// Producers of different priority
+	if ((EVT_head - EVT_tail) < EVT_QUEUE_SIZE) {
+		EVT_queue[EVT_head & EVT_QUEUE_MASK] = (uint8_t)event;
+		EVT_head++;
+	} else {
+		EVT_overflow++;
+	}
+	__set_PRIMASK(primask);
+}
+
+
+/** ***************************************************************************
+ * @brief Take the next event, sleep while there is none
+ * @return oldest pending event
+ *
+ * Called from the main loop only, the time between two calls is accounted
+ * as one pass of the main loop.
+ *****************************************************************************/
+EVT_t EVT_wait(void)
+{
+	EVT_t event;
+#ifdef EVT_IDLE_ACCOUNTING
+	EVT_pass_cycles = DWT->CYCCNT - EVT_pass_start;
+	if (EVT_pass_cycles > EVT_pass_max) {
+		EVT_pass_max = EVT_pass_cycles;
+	}
+#endif
+	while (1) {
+		__disable_irq();				// No event may slip in before WFI
+		if (EVT_head != EVT_tail) {
+			event = (EVT_t)EVT_queue[EVT_tail & EVT_QUEUE_MASK];
+			EVT_tail++;
+			__enable_irq();
+#ifdef EVT_IDLE_ACCOUNTING
+			EVT_pass_start = DWT->CYCCNT;
+#endif
+			return event;
+		}
+#ifdef EVT_IDLE_ACCOUNTING
+		EVT_busy_cycles += DWT->CYCCNT - EVT_wake;
+		__WFI();						// Sleep until the next interrupt
+		EVT_wake = DWT->CYCCNT;
+#else
+		__WFI();						// Sleep until the next interrupt
+#endif
+		__enable_irq();					// Serve the pending interrupt
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Count one millisecond, called by the SysTick handler
+ *
+ * Posts EVT_TICK every EVT_TICK_PERIOD and updates the idle percentage
+ * every EVT_LOAD_WINDOW.
+ *****************************************************************************/
+void EVT_tick(void)
+{
+	if (++EVT_ticks >= EVT_TICK_PERIOD) {
+		EVT_ticks = 0;
+		EVT_post(EVT_TICK);
+	}
+#ifdef EVT_IDLE_ACCOUNTING
+	if (++EVT_window >= EVT_LOAD_WINDOW) {
+		uint32_t now = DWT->CYCCNT;
+		float busy = (float)(EVT_busy_cycles + (now - EVT_wake));
+		float total = (float)SystemCoreClock / 1000 * EVT_LOAD_WINDOW;
+		EVT_idle_percent = 100 - (100 * busy / total);
+		if (EVT_idle_percent < 0) {
+			EVT_idle_percent = 0;
+		}
+		EVT_busy_cycles = 0;
+		EVT_wake = now;
+		EVT_window = 0;
+	}
+#endif
+}
@@ -0,0 +1,236 @@
+/** ***************************************************************************
+ * @file
+ * @brief Mains frequency tracking for coherent sampling
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Amplitude and phase of the mains bin of a raw waveform
+ * - Frequency from the phase advance between gap-free frames, its wrap
+ *   resolved within the frame
+ * - Sampling frequency retuned so frames span whole mains periods
+ * - Detection of 50 Hz or 60 Hz mains
+ *
+ * The sampling is tuned to GRID_track, so a frame spans a whole number P
+ * of its periods. If the mains runs at f instead, the phase of the mains
+ * bin advances from one frame to the next by 2*pi*P*(f/GRID_track-1).
+ * This is unambiguous for deviations up to GRID_track/(2*P), 5 Hz for the
+ * standard acquisition, but only 2.5 Hz for the precision one.
+ * @n The wrap is resolved with a coarse estimate from the raw waveform of
+ * the frame itself: the phase advance between its first and its last two
+ * periods. The waveform spans 5 periods at 50 Hz, so this is unambiguous up
+ * to GRID_track/6, GRID_track/8 at 60 Hz, beyond GRID_TRACK_RANGE. Frames
+ * shorter than the waveform repeat in it and give no estimate, they span
+ * few periods and need none.
+ * @n After a retune the frame being sampled mixes both frequencies, the
+ * phase reference is taken again from the first frame after it, see
+ * GRID_settle(). A new stream counts its frames from 0 again and is sampled
+ * at the new rate from the start, so it ends the wait for that frame.
+ * @n If the bin of the other nominal frequency is clearly stronger for
+ * GRID_DETECT frames, the nominal frequency is switched. Only if the frames
+ * of the acquisition in use span whole periods of it too, otherwise the
+ * nominal frequency stays, see MEAS_config_whole().
+ * @n Only the raw waveforms of the frames are used, so the tracking also
+ * runs on the host with simulated frames.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+
+#include "grid.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define GRID_PI			3.14159265358979f	///< Pi
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+float GRID_frequency = 0;		///< Measured mains frequency, 0 unknown [Hz]
+uint32_t GRID_nominal = MEAS_MAINS_FREQ;///< Nominal mains frequency [Hz]
+float GRID_track = MEAS_MAINS_FREQ;		///< Frequency of the sampling [Hz]
+
+static bool GRID_valid = false;		///< Phase reference available
+static float GRID_lastPhase;		///< Phase of the reference frame [rad]
+static uint32_t GRID_lastSequence;	///< Sequence of the reference frame
+static uint32_t GRID_settleSequence = 0;	///< First frame after a retune
+static uint32_t GRID_nextSequence = 0;	///< Sequence after the last frame
+static uint32_t GRID_votes = 0;		///< Frames favouring the other nominal
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start tracking
+ * @param [in] nominal mains frequency, 50 or 60 [Hz]
+ *****************************************************************************/
+void GRID_init(uint32_t nominal)
+{
+	GRID_nominal = nominal;
+	GRID_track = nominal;
+	GRID_frequency = 0;
+	GRID_valid = false;
+	GRID_settleSequence = 0;
+	GRID_nextSequence = 0;
+	GRID_votes = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Amplitude and phase of one DFT bin
+ * @param [in] wave samples
+ * @param [in] count of samples
+ * @param [in] bin periods within the samples
+ * @param [out] amplitude in the unit of MEAS_goertzel_amplitude()
+ * @param [out] phase relative to the first sample [rad]
+ *
+ * The rotating phasor is advanced by multiplication, so there is only one
+ * cosf() and sinf() per call.
+ *****************************************************************************/
+void GRID_phase(const uint16_t* wave, uint32_t count, uint32_t bin,
+				float* amplitude, float* phase)
+{
+	float w = 2*GRID_PI*bin/count;
+	float stepCos = cosf(w);
+	float stepSin = sinf(w);
+	float c = 1;
+	float s = 0;
+	float re = 0;
+	float im = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		float t;
+		re += wave[i]*c;
+		im -= wave[i]*s;
+		t = c*stepCos - s*stepSin;
+		s = s*stepCos + c*stepSin;
+		c = t;
+	}
+	*amplitude = 2*sqrtf(re*re + im*im)/count;
+	*phase = atan2f(im, re);
+}
+
+
+/** ***************************************************************************
+ * @brief Coarse mains frequency from the raw waveform of one frame
+ * @param [in] wave samples of MEAS_WAVE_SAMPLES at MEAS_WAVE_RATE
+ * @param [in] periods of GRID_nominal spanned by the frame
+ * @param [out] frequency [Hz]
+ * @return false if the waveform repeats a shorter frame
+ *
+ * Compares the phases of the first and the last two periods of the
+ * waveform, which are D = 3 periods apart at 50 Hz, 4 at 60 Hz.
+ *****************************************************************************/
+static bool GRID_coarse(const uint16_t* wave, float periods, float* frequency)
+{
+	uint32_t window = 2*MEAS_WAVE_RATE/GRID_nominal;	// Two periods
+	uint32_t distance = MEAS_WAVE_SAMPLES*GRID_nominal/MEAS_WAVE_RATE - 2;
+	float amplitude, first, last;
+
+	if (periods < distance + 2) {
+		return false;
+	}
+	GRID_phase(wave, window, 2, &amplitude, &first);
+	GRID_phase(&wave[distance*window/2], window, 2, &amplitude, &last);
+	float advance = last - first;
+	advance -= 2*GRID_PI*floorf((advance + GRID_PI)/(2*GRID_PI));
+	*frequency = GRID_track*(1 + advance/(2*GRID_PI*distance));
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Evaluate a frame
+ * @param [in] frame taken from the measurement queue
+ * @return true if the sampling has to be retuned to GRID_track
+ *
+ * After retuning, pass the first clean sequence to GRID_settle().
+ *****************************************************************************/
+bool GRID_update(const MEAS_frame_t* frame)
+{
+	uint32_t other = (GRID_nominal == 50) ? 60 : 50;
+	uint32_t bin = GRID_nominal*MEAS_WAVE_SAMPLES/MEAS_WAVE_RATE;
+	uint32_t binOther = other*MEAS_WAVE_SAMPLES/MEAS_WAVE_RATE;
+	float periods = (float)(MEAS_config.samples*GRID_nominal)/MEAS_config.rate;
+	float amplitude, phase, amplitudeOther, phaseOther;
+
+	GRID_phase(frame->wave[0], MEAS_WAVE_SAMPLES, bin, &amplitude, &phase);
+	GRID_phase(frame->wave[0], MEAS_WAVE_SAMPLES, binOther, &amplitudeOther,
+			   &phaseOther);
+	if (frame->sequence < GRID_nextSequence) {
+		GRID_settleSequence = 0;		// Stream restarted at the new rate
+	}
+	GRID_nextSequence = frame->sequence + 1;
+
+	//switch to the other nominal frequency if it dominates and fits
+	if ((amplitudeOther > GRID_MIN_AMPLITUDE)
+		&& (amplitudeOther > 2*amplitude)) {
+		if ((++GRID_votes >= GRID_DETECT)
+			&& MEAS_config_whole(&MEAS_config, other)) {
+			GRID_init(other);
+			return true;
+		}
+	} else {
+		GRID_votes = 0;
+	}
+
+	if ((amplitude < GRID_MIN_AMPLITUDE)
+		|| (frame->sequence < GRID_settleSequence)) {
+		GRID_valid = false;				// No usable phase
+		return false;
+	}
+	if (!GRID_valid || !frame->continued
+		|| (frame->sequence != GRID_lastSequence+1)) {
+		GRID_valid = true;				// New phase reference
+		GRID_lastPhase = phase;
+		GRID_lastSequence = frame->sequence;
+		return false;
+	}
+
+	//phase advance wrapped to +-pi
+	float advance = phase - GRID_lastPhase;
+	advance -= 2*GRID_PI*floorf((advance + GRID_PI)/(2*GRID_PI));
+	GRID_lastPhase = phase;
+	GRID_lastSequence = frame->sequence;
+	float measured = GRID_track*(1 + advance/(2*GRID_PI*periods));
+
+	//aliases are GRID_track/periods apart, take the one of the coarse value
+	float coarse;
+	if (GRID_coarse(frame->wave[0], periods, &coarse)) {
+		float alias = GRID_track/periods;
+		measured += alias*roundf((coarse - measured)/alias);
+	}
+
+	if (GRID_frequency == 0) {
+		GRID_frequency = measured;
+	} else {
+		GRID_frequency += GRID_SMOOTH*(measured - GRID_frequency);
+	}
+
+	float target = GRID_track + GRID_GAIN*(measured - GRID_track);
+	target = fminf(fmaxf(target, GRID_nominal - GRID_TRACK_RANGE),
+				   GRID_nominal + GRID_TRACK_RANGE);
+	if (fabsf(target - GRID_track) < GRID_DEADBAND) {
+		return false;
+	}
+	GRID_track = target;
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Set the first frame sampled completely after a retune
+ * @param [in] sequence
+ *****************************************************************************/
+void GRID_settle(uint32_t sequence)
+{
+	GRID_settleSequence = sequence;
+	GRID_valid = false;
+}
@@ -0,0 +1,94 @@
+/** ***************************************************************************
+ * @file
+ * @brief History of the measurement results in the external SDRAM
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Ring of HIST_SIZE timestamped results at HIST_BASE
+ * - Access by age, 0 is the newest result
+ *
+ * The ring takes 1 MB of the 8 MB SDRAM, the LCD frame buffers below
+ * HIST_BASE are left untouched. The SDRAM is initialized by BSP_LCD_Init(),
+ * which has to be called before HIST_init().
+ * @n Results are added and read by the main loop only, no locking needed.
+ * When the ring is full the oldest result is overwritten.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stddef.h>
+
+#include "history.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define HIST_MASK		(HIST_SIZE-1)	///< Index mask of the ring
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+uint32_t HIST_total = 0;				///< Entries added since reset
+
+static HIST_entry_t* const HIST_ring = (HIST_entry_t*)HIST_BASE;///< In SDRAM
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Empty the history
+ *
+ *****************************************************************************/
+void HIST_init(void)
+{
+	HIST_total = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Add a result as the newest entry
+ * @param [in] HAL tick [ms]
+ * @param [in] distance [mm], negative if unusable
+ * @param [in] current [A], negative if unusable
+ * @param [in] angle [deg]
+ *****************************************************************************/
+void HIST_add(uint32_t tick, float distance, float current, float angle)
+{
+	HIST_entry_t* entry = &HIST_ring[HIST_total & HIST_MASK];
+	entry->tick = tick;
+	entry->distance = distance;
+	entry->current = current;
+	entry->angle = angle;
+	HIST_total++;
+}
+
+
+/** ***************************************************************************
+ * @brief Number of entries available
+ * @return entries, at most HIST_SIZE
+ *****************************************************************************/
+uint32_t HIST_count(void)
+{
+	return (HIST_total < HIST_SIZE) ? HIST_total : HIST_SIZE;
+}
+
+
+/** ***************************************************************************
+ * @brief Get an entry by its age
+ * @param [in] age, 0 is the newest entry
+ * @return entry, NULL if not available
+ *****************************************************************************/
+const HIST_entry_t* HIST_get(uint32_t age)
+{
+	if (age >= HIST_count()) {
+		return NULL;
+	}
+	return &HIST_ring[(HIST_total-1-age) & HIST_MASK];
+}
@@ -6,8 +6,11 @@
  * Contained functionality
  *==============================================
  *
- * - Wrapper functions to enable rotation of the screen
+ * - Double buffered layers, flipped in the vertical blanking
+ * - Filled rectangles counted as redrawn area
+ * - Text output with glyphs expanded once and copied by the DMA2D
  * - Functions to draw elements of the GUI
+ * - Retained rows and widgets, only changed content is repainted
  * - Manager to evaluate touch screen inputs
  * - Manager to coordinate the graphical user interface (GUI)
  *
@@ -19,6 +22,14 @@
  * Option view
  *@image html gui_optn.jpg
  *
+ * Both LTDC layers cover the whole screen with their own frame buffer, only
+ * one is visible. A frame is drawn into the hidden layer and shown by
+ * swapping the visibility at the next vertical blanking. The new hidden
+ * layer is updated by a DMA2D copy before the next frame, so the retained
+ * content stays valid. The debug site is opened by the user button on the
+ * options site, further presses show the scope site, the trend site, the
+ * calibration wizard and the options again.
+ *
  * ----------------------------------------------------------------------------
  * @author  Jonas Bollhalder, bollhjon@students.zhaw.ch
  * @author  Tarik Durmaz, durmatar@students.zhaw.ch
@@ -30,12 +41,19 @@
  *****************************************************************************/
 #include "lcd_gui.h"
 
+#include "math.h"
 #include "stdio.h"
+#include "string.h"
 
 #include "stm32f4xx.h"
 #include "stm32f429i_discovery.h"
 #include "stm32f429i_discovery_lcd.h"
 #include "stm32f429i_discovery_ts.h"
+#include "events.h"
+#include "history.h"
+#include "profile.h"
+#include "calibration.h"
+#include "grid.h"
 
 
 /******************************************************************************
@@ -51,6 +69,42 @@
 #define TOP_HEIGHT			40		///< Height of top bar
 #define	TOP_MARGIN			2		///< Margin around top bar elements
 
+#define MEAS_ROW_COUNT		6		///< Text rows of the measurement site
+#define RAW_ROW_COUNT		4		///< Value rows of the raw site
+#define OPTN_COUNT			3		///< Option groups of the options site
+#define ANGLE_X				120		///< Centre of the angle indicator
+#define ANGLE_Y				110		///< Centre of the angle indicator
+#define ANGLE_LENGTH		55		///< Length of the angle line
+#define DEBUG_ROW_COUNT		(7+PROF_COUNT)	///< Value rows of the debug site
+#define DEBUG_REFRESH		25		///< Ticks between debug site updates
+#define SCOPE_Y				40		///< Top of the first scope lane
+#define SCOPE_LANE			60		///< Height of a scope lane
+#define SCOPE_LABEL			12		///< Label rows at the top of a lane
+#define SCOPE_TRACE	(SCOPE_LANE-SCOPE_LABEL)	///< Trace rows of a lane
+#define SCOPE_SPAN			48		///< Samples shown after the trigger
+#define SCOPE_STEP			5		///< Columns per sample, 240/SCOPE_SPAN
+#define SCOPE_PERIOD		12		///< Samples per mains period
+#define SCOPE_FULL			4095	///< ADC full scale
+#define TREND_WIDTH			240		///< Columns of the trend charts
+#define TREND_PLOT			90		///< Rows of a trend chart
+#define TREND_DIST_Y		65		///< Top of the distance chart
+#define TREND_CURR_Y		185		///< Top of the current chart
+#define TREND_DIST_MAX		300.0f	///< Distance at the top of the chart [mm]
+#define TREND_CURR_MAX		16.0f	///< Current at the top of the chart [A]
+#define TREND_ROW_COUNT		2		///< Value rows of the trend site
+#define CALI_ROW_COUNT		5		///< Value rows of the calibration site
+
+#define LCD_BUFFER_SIZE		(240*320*4)	///< Bytes of one ARGB8888 frame
+
+#define GLYPH_COUNT			95		///< Printable ASCII characters per font
+#define GLYPH_FONT_COUNT	5		///< Fonts in the glyph cache
+#define GLYPH_CACHE_SIZE	12288	///< Bytes of expanded glyphs
+#define GLYPH_NONE			0xFFFF	///< Glyph not expanded yet
+
+#define TS_XRAW_CENTER		3000	///< Raw X of the corrections below
+#define TS_YRAW_OFFSET		360		///< Raw Y offset, as BSP_TS_GetState()
+#define TS_HOLDOFF			200		///< Touches ignored after options [ms]
+
 
 /******************************************************************************
  * Variables
@@ -68,6 +122,7 @@ GUI_mode_t GUI_mode = MODE_L;	///< Default measurement mode
 
 // General measurements
 float GUI_angle = 0;			///< Angle value to display
+float GUI_angleConfidence = 0;	///< Confidence of the angle, 0 to 1
 float GUI_distance = 0; 		///< Distance value to display
 float GUI_distanceDeviation = 0; ///< Standard deviation of distance
 float GUI_current = 0;			///< Current to display
@@ -90,9 +145,21 @@ bool GUI_outOptn = false; ///< Output for option changes
 GUI_site_t GUI_currentSite = SITE_NONE; ///< Current site
 GUI_site_t GUI_previousSite = SITE_NONE; ///< Previous site
 
+// Raw waveforms of the scope site
+uint16_t GUI_scopeWave[GUI_SCOPE_CHANNELS][GUI_SCOPE_SAMPLES];///< Raw samples
+static const char* GUI_scopeName[GUI_SCOPE_CHANNELS] = {	///< Lane labels
+		"WPC left", "WPC right", "Hall right", "Hall left"
+};
+static const uint32_t GUI_scopeColor[GUI_SCOPE_CHANNELS] = {///< Trace colours
+		LCD_COLOR_RED, LCD_COLOR_BLUE, LCD_COLOR_DARKGREEN, LCD_COLOR_MAGENTA
+};
+
 // GUI trigger inputs
 bool GUI_inputBtn = false; ///< Button input
 bool GUI_inputTS = false;  ///< Touch screen input
+bool GUI_inputTSInt = false; ///< Touch controller interrupt input
+bool GUI_inputTick = false; ///< Periodic tick input
+bool GUI_inputScope = false; ///< New waveforms input
 bool GUI_inputMeasReady = false; ///< Measurement input
 
 // Touch screen manager
@@ -100,130 +167,397 @@ TS_StateTypeDef GUI_currentTSstate;  ///< Current touch screen state
 TS_StateTypeDef GUI_previousTSstate; ///< Previous touch screen state
 GUI_touch_t GUI_TSinputType = TOUCH_NONE; ///< Type of Touch screen input
 
+// Touch controller readout
+extern I2C_HandleTypeDef I2cHandle;	///< Touch controller bus of the BSP
+uint32_t GUI_TSerrors = 0;		///< Failed touch controller transfers
+static GUI_tsread_t GUI_TSread = TSREAD_IDLE; ///< Current readout step
+static volatile bool GUI_TSstepDone = false; ///< Transfer of step completed
+static volatile bool GUI_TSstepError = false;///< Transfer of step failed
+static uint8_t GUI_TSbuffer[4];	///< Receive buffer of the readout
+static uint8_t GUI_TSvalue;		///< Register value written by the step
+static bool GUI_TSholding = false;	///< Touches ignored after options
+static uint32_t GUI_TSholdStart;	///< Tick of the option area touch
+
+// Double buffered frame
+uint32_t GUI_renderCycles = 0;	///< Cycles to draw the last frame
+uint32_t GUI_renderMax = 0;		///< Longest frame drawn [cycles]
+uint32_t GUI_flipLatency = 0;	///< Cycles from flip request to reload
+uint32_t GUI_flipCount = 0;		///< Frames shown
+static const uint32_t GUI_layerAddress[2] = {	///< Frame buffer of the layers
+		LCD_FRAME_BUFFER, LCD_FRAME_BUFFER+LCD_BUFFER_SIZE
+};
+static uint32_t GUI_backLayer = LCD_FOREGROUND_LAYER;	///< Hidden layer
+static bool GUI_backStale = false;	///< Hidden layer misses last frame
+static volatile bool GUI_flipPending = false;	///< Waiting for reload
+static uint32_t GUI_frameStart;		///< Cycle count at start of frame
+static uint32_t GUI_flipRequest;	///< Cycle count at flip request
+
+// Glyph cache of the text output, L8 with 2 entry CLUT
+static sFONT* GUI_glyphFonts[GLYPH_FONT_COUNT] = {
+		&Font8, &Font12, &Font16, &Font20, &Font24
+};
+static uint16_t GUI_glyphOffset[GLYPH_FONT_COUNT][GLYPH_COUNT];///< In cache
+static uint8_t GUI_glyphCache[GLYPH_CACHE_SIZE];	///< Expanded glyphs
+static uint32_t GUI_glyphUsed = 0;	///< Bytes used in the glyph cache
+static uint8_t GUI_glyphScratch[17*24];	///< Glyph if the cache is full
+static uint32_t GUI_glyphClut[2];	///< Back and text colour
+static bool GUI_glyphClutValid = false;	///< CLUT loaded into the DMA2D
+static bool GUI_glyphInit = false;	///< Glyph offsets initialized
+
+// Retained content of the sites
+uint32_t GUI_redrawArea = 0;	///< Pixels repainted, for profiling
+static bool GUI_topValid = false;	///< Top mode field on screen
+static GUI_mode_t GUI_topMode;	///< Mode shown in top mode field
+static uint32_t GUI_topColor;	///< Background of top mode field
+static bool GUI_measValid = false;	///< Measurement site on screen
+static uint8_t GUI_measLayout;	///< Visible rows of measurement site
+static bool GUI_measAngleShown;	///< Angle line on screen
+static uint16_t GUI_measAngleX;	///< End point of angle line
+static uint16_t GUI_measAngleY;	///< End point of angle line
+static GUI_row_t GUI_measRows[MEAS_ROW_COUNT];	///< Measurement text rows
+static bool GUI_rawValid = false;	///< Raw site on screen
+static GUI_row_t GUI_rawRows[RAW_ROW_COUNT];	///< Raw value rows
+static bool GUI_debugValid = false;	///< Debug site on screen
+static GUI_row_t GUI_debugRows[DEBUG_ROW_COUNT];	///< Debug value rows
+static uint32_t GUI_debugTicks = 0;	///< Ticks since last debug update
+static bool GUI_scopeValid = false;	///< Scope lanes on screen
+static bool GUI_trendValid = false;	///< Trend charts on screen
+static uint32_t GUI_trendShown = 0;	///< HIST_total of the charts on screen
+static GUI_row_t GUI_trendRows[TREND_ROW_COUNT];	///< Latest value rows
+static bool GUI_caliValid = false;	///< Calibration site on screen
+static GUI_row_t GUI_caliRows[CALI_ROW_COUNT];	///< Wizard state rows
+static bool GUI_optnValid = false;	///< Options site on screen
+static uint16_t GUI_optnActive[OPTN_COUNT];	///< Active option on screen
+static bool GUI_optnDisabled[OPTN_COUNT];	///< Disabled state on screen
+
 
 /******************************************************************************
  * Functions
  *****************************************************************************/
 
 /** ***************************************************************************
- * @brief Wrapper for touch screen sate
- * @param pointer to TS_State
+ * @brief Initialize both layers for double buffering
  *
- * Enable use of BSP_TS_GetState() function with 180° rotated display
+ * The background layer is shown first, the foreground layer is drawn.
  *****************************************************************************/
-void GUI_TS_GetState(TS_StateTypeDef* TS_State){
-	//readout TS state
-	BSP_TS_GetState(TS_State);
-	//translate to correct coordinate system
-	TS_State->X = BSP_LCD_GetXSize()-TS_State->X;
+void GUI_LCD_Init(void){
+	for (uint32_t layer = 0; layer < 2; ++layer) {
+		BSP_LCD_LayerDefaultInit(layer, GUI_layerAddress[layer]);
+		BSP_LCD_SelectLayer(layer);
+		BSP_LCD_Clear(LCD_COLOR_WHITE);
+	}
+	BSP_LCD_SetLayerVisible(LCD_FOREGROUND_LAYER, DISABLE);
+	GUI_backLayer = LCD_FOREGROUND_LAYER;
+	GUI_backStale = false;
+
+	LTDC->ICR = LTDC_ICR_CRRIF;			// Clear register reload flag
+	LTDC->IER |= LTDC_IER_RRIE;			// Enable register reload interrupt
+	NVIC_ClearPendingIRQ(LTDC_IRQn);	// Clear pending LTDC interrupt
+	NVIC_EnableIRQ(LTDC_IRQn);			// Enable LTDC interrupt in the NVIC
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw filled rectangle
+ * @brief Prepare the hidden layer for drawing a frame
+ *
+ * Waits until the last flip is done, the hidden layer is still visible
+ * before. Then the visible frame is copied to the hidden layer by the DMA2D.
+ *****************************************************************************/
+static void GUI_LCD_BeginFrame(void){
+	while (GUI_flipPending) { ; }		// Reload in next vertical blanking
+	if (GUI_backStale) {
+		while (DMA2D->CR & DMA2D_CR_START) { ; }	// Wait for last transfer
+		DMA2D->FGMAR = GUI_layerAddress[GUI_backLayer ^ 1];	// Visible
+		DMA2D->FGOR = 0;
+		DMA2D->FGPFCCR = 0;				// ARGB8888 input
+		DMA2D->OMAR = GUI_layerAddress[GUI_backLayer];	// Hidden
+		DMA2D->OOR = 0;
+		DMA2D->OPFCCR = 0;				// ARGB8888 output
+		DMA2D->NLR = (BSP_LCD_GetXSize() << DMA2D_NLR_PL_Pos)
+				   | BSP_LCD_GetYSize();
+		DMA2D->CR = DMA2D_CR_START;		// M2M without conversion
+		while (DMA2D->CR & DMA2D_CR_START) { ; }
+		GUI_backStale = false;
+	}
+	BSP_LCD_SelectLayer(GUI_backLayer);
+	GUI_frameStart = DWT->CYCCNT;
+}
+
+
+/** ***************************************************************************
+ * @brief Show the frame drawn into the hidden layer
+ *
+ * The visibility of both layers is swapped in the shadow registers and
+ * reloaded by the LTDC in the next vertical blanking, see LTDC_IRQHandler().
+ *****************************************************************************/
+static void GUI_LCD_EndFrame(void){
+	GUI_renderCycles = DWT->CYCCNT - GUI_frameStart;
+	if (GUI_renderCycles > GUI_renderMax) {
+		GUI_renderMax = GUI_renderCycles;
+	}
+	BSP_LCD_SetLayerVisible_NoReload(GUI_backLayer, ENABLE);
+	BSP_LCD_SetLayerVisible_NoReload(GUI_backLayer ^ 1, DISABLE);
+	GUI_flipPending = true;
+	GUI_flipRequest = DWT->CYCCNT;
+	LTDC->SRCR = LTDC_SRCR_VBR;			// Reload in vertical blanking
+	GUI_backLayer ^= 1;
+	GUI_backStale = true;
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt handler of the LTDC, register reload done
+ *
+ * The requested layer visibility is active, the old layer may be drawn.
+ *****************************************************************************/
+void LTDC_IRQHandler(void){
+	if (LTDC->ISR & LTDC_ISR_RRIF) {
+		LTDC->ICR = LTDC_ICR_CRRIF;		// Clear register reload flag
+		if (GUI_flipPending) {
+			GUI_flipLatency = DWT->CYCCNT - GUI_flipRequest;
+			GUI_flipCount++;
+			GUI_flipPending = false;
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw a vertical span directly into the hidden layer
  * @param [in] X position
+ * @param [in] first row
+ * @param [in] last row, not above the first
+ * @param [in] colour
+ *****************************************************************************/
+static void GUI_LCD_DrawColumn(uint16_t Xpos, uint16_t yFirst, uint16_t yLast,
+							   uint32_t color){
+	uint32_t xSize = BSP_LCD_GetXSize();
+	uint32_t* pixel = (uint32_t*)GUI_layerAddress[GUI_backLayer]
+					  + yFirst*xSize + Xpos;
+	for (uint32_t row = yFirst; row <= yLast; ++row) {
+		*pixel = color;
+		pixel += xSize;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Scroll a band of the screen to the left
  * @param [in] Y position
- * @param [in] width
  * @param [in] height
+ * @param [in] columns to scroll, below the screen width
  *
- * Enable use of BSP_LCD_FillRect() function with 180° rotated display
+ * The visible layer is copied shifted into the hidden layer by the DMA2D,
+ * so source and destination never overlap. The rightmost columns keep the
+ * old content and have to be drawn afterwards.
  *****************************************************************************/
-void GUI_LCD_FillRect(uint16_t Xpos, uint16_t Ypos,
-					  uint16_t Width, uint16_t Height){
-	//calculate diagonal corner coordinates and translate to other system
-	Xpos = BSP_LCD_GetXSize()-(Xpos+Width);
-	Ypos = BSP_LCD_GetYSize()-(Ypos+Height);
-	//draw rectangular shape
-	BSP_LCD_FillRect(Xpos, Ypos, Width, Height);
+static void GUI_LCD_ScrollLeft(uint16_t Ypos, uint16_t Height, uint16_t Shift){
+	uint32_t xSize = BSP_LCD_GetXSize();
+	while (DMA2D->CR & DMA2D_CR_START) { ; }	// Wait for last transfer
+	DMA2D->FGMAR = GUI_layerAddress[GUI_backLayer ^ 1]	// Visible
+				 + 4*(Ypos*xSize + Shift);
+	DMA2D->FGOR = Shift;				// Skip scrolled out columns
+	DMA2D->FGPFCCR = 0;					// ARGB8888 input
+	DMA2D->OMAR = GUI_layerAddress[GUI_backLayer] + 4*Ypos*xSize;	// Hidden
+	DMA2D->OOR = Shift;					// Skip columns drawn afterwards
+	DMA2D->OPFCCR = 0;					// ARGB8888 output
+	DMA2D->NLR = ((xSize-Shift) << DMA2D_NLR_PL_Pos) | Height;
+	DMA2D->CR = DMA2D_CR_START;			// M2M without conversion
+	while (DMA2D->CR & DMA2D_CR_START) { ; }
+	GUI_redrawArea += (xSize-Shift)*Height;
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw rectangle
+ * @brief Wrapper to draw filled rectangle
  * @param [in] X position
  * @param [in] Y position
  * @param [in] width
  * @param [in] height
  *
- * Enable use of BSP_LCD_DrawRect() function with 180° rotated display
+ * Same as BSP_LCD_FillRect(), the area is added to GUI_redrawArea
  *****************************************************************************/
-void GUI_LCD_DrawRect(uint16_t Xpos, uint16_t Ypos,
+void GUI_LCD_FillRect(uint16_t Xpos, uint16_t Ypos,
 					  uint16_t Width, uint16_t Height){
-	//calculate diagonal corner coordinates and translate to other system
-	Xpos = BSP_LCD_GetXSize()-(Xpos+Width);
-	Ypos = BSP_LCD_GetYSize()-(Ypos+Height);
-	//draw rectangular shape
-	BSP_LCD_DrawRect(Xpos, Ypos, Width, Height);
+	BSP_LCD_FillRect(Xpos, Ypos, Width, Height);
+	GUI_redrawArea += Width*Height;
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw horizontal line
- * @param [in] X position
- * @param [in] Y position
- * @param [in] length
+ * @brief Get a glyph expanded to one byte per pixel
+ * @param [in] font
+ * @param [in] ASCII character, printable
+ * @return glyph of Width*Height bytes, 1 = text, 0 = background
  *
- * Enable use of BSP_LCD_DrawHLine() function with 180° rotated display
+ * Glyphs are expanded on first use and kept in the cache.
  *****************************************************************************/
-void GUI_LCD_DrawHLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length){
-	//translate to other system
-	Xpos = BSP_LCD_GetXSize()-(Xpos+Length);
-	Ypos = BSP_LCD_GetYSize()-Ypos;
-	//draw rectangular shape
-	BSP_LCD_DrawHLine(Xpos, Ypos, Length);
+static const uint8_t* GUI_GetGlyph(sFONT* font, uint8_t ascii){
+	uint32_t bytes = (font->Width+7)/8;
+	uint32_t size = font->Width*font->Height;
+	uint32_t offset = 8*bytes - font->Width;
+	const uint8_t* table = &font->table[(ascii-' ')*font->Height*bytes];
+	uint16_t* cached = NULL;
+	uint8_t* glyph = GUI_glyphScratch;
+
+	if (!GUI_glyphInit) {
+		memset(GUI_glyphOffset, 0xFF, sizeof(GUI_glyphOffset));
+		GUI_glyphInit = true;
+	}
+	for (int f = 0; f < GLYPH_FONT_COUNT; ++f) {
+		if (GUI_glyphFonts[f] == font) {
+			cached = &GUI_glyphOffset[f][ascii-' '];
+		}
+	}
+	if ((cached != NULL) && (*cached != GLYPH_NONE)) {
+		return &GUI_glyphCache[*cached];
+	}
+	if ((cached != NULL) && (GUI_glyphUsed+size <= GLYPH_CACHE_SIZE)) {
+		*cached = GUI_glyphUsed;
+		glyph = &GUI_glyphCache[GUI_glyphUsed];
+		GUI_glyphUsed += size;
+	} else if (size > sizeof(GUI_glyphScratch)) {
+		return NULL;
+	}
+
+	//expand bits like DrawChar() of the BSP
+	for (int i = 0; i < font->Height; ++i) {
+		const uint8_t* pchar = &table[bytes*i];
+		uint32_t line = pchar[0];
+		for (uint32_t b = 1; b < bytes; ++b) {
+			line = (line<<8) | pchar[b];
+		}
+		for (int j = 0; j < font->Width; ++j) {
+			glyph[i*font->Width+j] =
+				(line & (1<<(font->Width-j+offset-1))) ? 1 : 0;
+		}
+	}
+	return glyph;
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw vertical line
+ * @brief Wrapper to display a character
  * @param [in] X position
  * @param [in] Y position
- * @param [in] length
+ * @param [in] ASCII character
  *
- * Enable use of BSP_LCD_DrawVLine() function with 180° rotated display
+ * Same output as BSP_LCD_DisplayChar(), but the glyph is converted from L8
+ * to ARGB8888 by the DMA2D using the text and back colour as CLUT instead of
+ * writing every pixel by the CPU.
  *****************************************************************************/
-void GUI_LCD_DrawVLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length){
-	//translate to other system
-	Xpos = BSP_LCD_GetXSize()-Xpos;
-	Ypos = BSP_LCD_GetYSize()-(Ypos+Length);
-	//draw rectangular shape
-	BSP_LCD_DrawHLine(Xpos, Ypos, Length);
+void GUI_LCD_DisplayChar(uint16_t Xpos, uint16_t Ypos, uint8_t Ascii){
+	sFONT* font = BSP_LCD_GetFont();
+	const uint8_t* glyph = NULL;
+
+	if ((Ascii >= ' ') & (Ascii < ' '+GLYPH_COUNT)
+		& (Xpos+font->Width <= BSP_LCD_GetXSize())
+		& (Ypos+font->Height <= BSP_LCD_GetYSize())) {
+		glyph = GUI_GetGlyph(font, Ascii);
+	}
+	if (glyph == NULL) {
+		BSP_LCD_DisplayChar(Xpos, Ypos, Ascii);
+		return;
+	}
+	while (DMA2D->CR & DMA2D_CR_START) { ; }	// Wait for previous transfer
+	//BSP_LCD_FillRect() changes the input format, the CLUT itself stays
+	DMA2D->FGPFCCR = (1 << DMA2D_FGPFCCR_CS_Pos)	// 2 CLUT entries, ARGB
+				   | (5 << DMA2D_FGPFCCR_CM_Pos);	// L8 input
+	if ((GUI_glyphClut[0] != BSP_LCD_GetBackColor())
+		| (GUI_glyphClut[1] != BSP_LCD_GetTextColor()) | !GUI_glyphClutValid) {
+		GUI_glyphClut[0] = BSP_LCD_GetBackColor();
+		GUI_glyphClut[1] = BSP_LCD_GetTextColor();
+		GUI_glyphClutValid = true;
+		DMA2D->FGCMAR = (uint32_t)GUI_glyphClut;// CLUT address
+		DMA2D->FGPFCCR |= DMA2D_FGPFCCR_START;	// Load CLUT
+		while (DMA2D->FGPFCCR & DMA2D_FGPFCCR_START) { ; }
+	}
+	DMA2D->FGMAR = (uint32_t)glyph;		// Source, continuous lines
+	DMA2D->FGOR = 0;
+	DMA2D->OMAR = GUI_layerAddress[GUI_backLayer]	// Destination
+				+ 4*(Ypos*BSP_LCD_GetXSize()+Xpos);
+	DMA2D->OOR = BSP_LCD_GetXSize()-font->Width;// Skip rest of the line
+	DMA2D->OPFCCR = 0;					// ARGB8888 output
+	DMA2D->NLR = (font->Width << DMA2D_NLR_PL_Pos) | font->Height;
+	DMA2D->CR = DMA2D_CR_MODE_0 | DMA2D_CR_START;	// M2M with PFC
+	while (DMA2D->CR & DMA2D_CR_START) { ; }	// BSP may reconfigure DMA2D
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw circle
+ * @brief Wrapper to display a string
  * @param [in] X position
  * @param [in] Y position
- * @param [in] radius
+ * @param [in] text
+ * @param [in] alignment
  *
- * Enable use of BSP_LCD_DrawCircle() function with 180° rotated display
+ * Same layout as BSP_LCD_DisplayStringAt(), see GUI_LCD_DisplayChar().
  *****************************************************************************/
-void GUI_LCD_DrawCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius){
-	//translate to other system
-	Xpos = BSP_LCD_GetXSize()-Xpos;
-	Ypos = BSP_LCD_GetYSize()-Ypos;
-	//draw rectangular shape
-	BSP_LCD_DrawCircle(Xpos, Ypos, Radius);
+void GUI_LCD_DisplayStringAt(uint16_t X, uint16_t Y, uint8_t* pText,
+							 Text_AlignModeTypdef mode){
+	uint16_t width = BSP_LCD_GetFont()->Width;
+	uint16_t refcolumn;
+	uint32_t size = strlen((char*)pText);
+	uint32_t xsize = BSP_LCD_GetXSize()/width;
+	uint32_t i = 0;
+
+	switch (mode) {
+		case CENTER_MODE:
+			refcolumn = X+((xsize-size)*width)/2;
+			break;
+		case RIGHT_MODE:
+			refcolumn = X+((xsize-size)*width);
+			break;
+		default:
+			refcolumn = X;
+			break;
+	}
+	while ((*pText != 0)
+		   & (((BSP_LCD_GetXSize()-(i*width)) & 0xFFFF) >= width)) {
+		GUI_LCD_DisplayChar(refcolumn, Y, *pText);
+		refcolumn += width;
+		pText++;
+		i++;
+	}
 }
 
 
 /** ***************************************************************************
- * @brief Wrapper to draw filled circle
+ * @brief Draw a retained text row
+ * @param [in,out] row with the text currently on screen
  * @param [in] X position
  * @param [in] Y position
- * @param [in] radius
+ * @param [in] text, empty to erase the row
  *
- * Enable use of BSP_LCD_FillCircle() function with 180° rotated display
+ * Nothing is drawn if the text did not change. A shorter text is padded
+ * with spaces to overwrite the previous one. Uses the current font.
+ *****************************************************************************/
+static void GUI_DrawRow(GUI_row_t* row, uint16_t x, uint16_t y,
+						const char* text){
+	char line[sizeof(row->text)];
+	if (strcmp(row->text, text) == 0) {
+		return;
+	}
+	snprintf(line, sizeof(line), "%-*s", (int)strlen(row->text), text);
+	GUI_LCD_DisplayStringAt(x, y, (uint8_t *)line, LEFT_MODE);
+	GUI_redrawArea += strlen(line)*BSP_LCD_GetFont()->Width
+					 *BSP_LCD_GetFont()->Height;
+	strncpy(row->text, text, sizeof(row->text)-1);
+}
+
+
+/** ***************************************************************************
+ * @brief Mark rows as erased
+ * @param [out] rows
+ * @param [in] row count
  *****************************************************************************/
-void GUI_LCD_FillCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius){
-	//translate to other system
-	Xpos = BSP_LCD_GetXSize()-Xpos;
-	Ypos = BSP_LCD_GetYSize()-Ypos;
-	//draw rectangular shape
-	BSP_LCD_FillCircle(Xpos, Ypos, Radius);
+static void GUI_ClearRows(GUI_row_t* rows, uint32_t count){
+	for (uint32_t i = 0; i < count; ++i) {
+		rows[i].text[0] = '\0';
+	}
 }
 
+
 /** ***************************************************************************
  * @brief Draw hint
  *
@@ -233,16 +567,16 @@ void GUI_DrawHint(void){
 	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
 	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
 	BSP_LCD_SetFont(&Font24);
-	BSP_LCD_DisplayStringAt(5,10,(uint8_t *)"Cable-Monitor",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,10,(uint8_t *)"Cable-Monitor",LEFT_MODE);
 	BSP_LCD_SetFont(&Font16);
-	BSP_LCD_DisplayStringAt(5,60,(uint8_t *)"Touch on screen or",LEFT_MODE);
-	BSP_LCD_DisplayStringAt(5,80,(uint8_t *)"press blue button",LEFT_MODE);
-	BSP_LCD_DisplayStringAt(5,100,(uint8_t *)"to proceed to",LEFT_MODE);
-	BSP_LCD_DisplayStringAt(5,120,(uint8_t *)"the main sceen",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,60,(uint8_t *)"Touch on screen or",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,80,(uint8_t *)"press blue button",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,100,(uint8_t *)"to proceed to",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,120,(uint8_t *)"the main sceen",LEFT_MODE);
 	BSP_LCD_SetFont(&Font12);
-	BSP_LCD_DisplayStringAt(5,290,
+	GUI_LCD_DisplayStringAt(5,290,
 						   (uint8_t *)"(c)bollhjon & durmatar",LEFT_MODE);
-	BSP_LCD_DisplayStringAt(5,305,(uint8_t *)"Version 27.12.2021",LEFT_MODE);
+	GUI_LCD_DisplayStringAt(5,305,(uint8_t *)"Version 27.12.2021",LEFT_MODE);
 }
 
 
@@ -264,10 +598,10 @@ void GUI_DrawModeSel(void){
 		BSP_LCD_SetTextColor(MODE_entry[i].back_color);
 		GUI_LCD_FillRect(x+m, y+m, w-2*m, h-2*m);
 		BSP_LCD_SetTextColor(MODE_entry[i].frame_color);
-		GUI_LCD_DrawRect(x+m, y+m, w-2*m, h-2*m);
+		BSP_LCD_DrawRect(x+m, y+m, w-2*m, h-2*m);
 		BSP_LCD_SetBackColor(MODE_entry[i].back_color);
 		BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-		BSP_LCD_DisplayStringAt(x+7*m, y+6*m,
+		GUI_LCD_DisplayStringAt(x+7*m, y+6*m,
 							   (uint8_t*)MODE_entry[i].line, LEFT_MODE);
 	}
 }
@@ -279,47 +613,55 @@ void GUI_DrawModeSel(void){
  * Display currently selected mode. Background is coloured green if cable was
  * detected, red if no cable was not detected and white if no measurement was
  * conducted
+ * @n The field is only repainted if mode or background changed.
  *****************************************************************************/
 void GUI_DrawTopMode(void){
 	BSP_LCD_SetFont(TOP_FONT);
-	uint32_t x, y, m, w, h;
+	uint32_t x, y, m, w, h, color;
 	x = 0;
 	y = 0;
 	m = TOP_MARGIN;
 	w = (BSP_LCD_GetXSize()/3);
 	h = TOP_HEIGHT;
 
-	// Display framed mode and colour background
+	// Select background colour
 	if (GUI_cable_detected){
-		BSP_LCD_SetTextColor(LCD_COLOR_LIGHTGREEN);
-		BSP_LCD_SetBackColor(LCD_COLOR_LIGHTGREEN);
+		color = LCD_COLOR_LIGHTGREEN;
 		GUI_cable_detected = false;
 	} else if (GUI_cable_not_detected){
-		BSP_LCD_SetTextColor(LCD_COLOR_LIGHTRED);
-		BSP_LCD_SetBackColor(LCD_COLOR_LIGHTRED);
+		color = LCD_COLOR_LIGHTRED;
 		GUI_cable_not_detected = false;
 	} else {
-		BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-		BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+		color = LCD_COLOR_WHITE;
 	}
+	if (GUI_topValid & (GUI_topMode == GUI_mode) & (GUI_topColor == color)) {
+		return;
+	}
+	GUI_topValid = true;
+	GUI_topMode = GUI_mode;
+	GUI_topColor = color;
+
+	// Display framed mode and colour background
+	BSP_LCD_SetTextColor(color);
+	BSP_LCD_SetBackColor(color);
 	GUI_LCD_FillRect(x+m, y+m, (w*2)-2*m, h-2*m);
 	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-	GUI_LCD_DrawRect(x+m, y+m, (w*2)-2*m, h-2*m);
+	BSP_LCD_DrawRect(x+m, y+m, (w*2)-2*m, h-2*m);
 	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-	BSP_LCD_DisplayStringAt(x+3*m, y+6*m, (uint8_t*)"Mode:", LEFT_MODE);
+	GUI_LCD_DisplayStringAt(x+3*m, y+6*m, (uint8_t*)"Mode:", LEFT_MODE);
 	BSP_LCD_SetTextColor(LCD_COLOR_DARKGRAY);
 	// Display current mode
 	switch (GUI_mode) {
 		case MODE_L:
-			BSP_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
+			GUI_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
 								   (uint8_t*)"L", LEFT_MODE);
 			break;
 		case MODE_LN:
-			BSP_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
+			GUI_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
 								   (uint8_t*)"LN", LEFT_MODE);
 			break;
 		case MODE_LNPE:
-			BSP_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
+			GUI_LCD_DisplayStringAt(x+3*m+12*7, y+6*m,
 								   (uint8_t*)"LNPE", LEFT_MODE);
 			break;
 		default:
@@ -347,14 +689,16 @@ void GUI_DrawTopOptions(void){
 	GUI_LCD_FillRect(x+m+2*w, y+m, w-2*m, h-2*m);
 	BSP_LCD_SetBackColor(LCD_COLOR_LIGHTGRAY);
 	// Display according to site state
-	if (GUI_currentSite != SITE_OPTN) {
+	if ((GUI_currentSite != SITE_OPTN) & (GUI_currentSite != SITE_DEBUG)
+		& (GUI_currentSite != SITE_SCOPE) & (GUI_currentSite != SITE_TREND)
+		& (GUI_currentSite != SITE_CALI)) {
 		BSP_LCD_SetTextColor(LCD_COLOR_DARKGRAY);
-		BSP_LCD_DisplayStringAt(x+7*m+2*w, y+6*m, (uint8_t*)"OPTN", LEFT_MODE);
-		GUI_LCD_DrawRect(x+m+2*w, y+m, w-2*m, h-2*m);
+		GUI_LCD_DisplayStringAt(x+7*m+2*w, y+6*m, (uint8_t*)"OPTN", LEFT_MODE);
+		BSP_LCD_DrawRect(x+m+2*w, y+m, w-2*m, h-2*m);
 	} else {
 		BSP_LCD_SetTextColor(LCD_COLOR_RED);
-		BSP_LCD_DisplayStringAt(x+7*m+2*w, y+6*m, (uint8_t*)"BACK", LEFT_MODE);
-		GUI_LCD_DrawRect(x+m+2*w, y+m, w-2*m, h-2*m);
+		GUI_LCD_DisplayStringAt(x+7*m+2*w, y+6*m, (uint8_t*)"BACK", LEFT_MODE);
+		BSP_LCD_DrawRect(x+m+2*w, y+m, w-2*m, h-2*m);
 	}
 }
 
@@ -363,11 +707,60 @@ void GUI_DrawTopOptions(void){
  * @brief Clear centre of the screen
  *
  * Clear centre of the screen to erase artifacts of previous sites or
- * measurements
+ * measurements. The retained content of all sites is invalidated.
+ * @n The text colour is kept, the sites call this after choosing it.
  *****************************************************************************/
 void GUI_ClearSite(void){
+	uint32_t color = BSP_LCD_GetTextColor();
 	BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
 	GUI_LCD_FillRect(0, 40, 240, 240);
+	BSP_LCD_SetTextColor(color);
+	GUI_measValid = false;
+	GUI_rawValid = false;
+	GUI_optnValid = false;
+	GUI_debugValid = false;
+	GUI_scopeValid = false;
+	GUI_trendValid = false;
+	GUI_caliValid = false;
+}
+
+
+/** ***************************************************************************
+ * @brief Draw the angle line of the measurement site
+ *
+ * Erase the previous line, restore the axes it crossed and draw the line
+ * for GUI_angle if it is between -45° and 45°. The line is turned by the
+ * angle from the vertical axis, positive to the right.
+ *****************************************************************************/
+static void GUI_DrawAngle(void){
+	bool shown = (-46<GUI_angle)&(GUI_angle<46);
+	uint16_t x = 0;
+	uint16_t y = 0;
+	if (shown) {
+		float rad = GUI_angle*3.14159265f/180;
+		x=(uint16_t)(ANGLE_X+(int)(ANGLE_LENGTH*sinf(rad)));
+		y=(uint16_t)(ANGLE_Y-(int)(ANGLE_LENGTH*cosf(rad)));
+	}
+	if ((shown == GUI_measAngleShown) & (x == GUI_measAngleX)
+		& (y == GUI_measAngleY)) {
+		return;
+	}
+	//erase previous line
+	if (GUI_measAngleShown) {
+		BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+		BSP_LCD_DrawLine(ANGLE_X, ANGLE_Y, GUI_measAngleX, GUI_measAngleY);
+		BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+		BSP_LCD_DrawLine(60, ANGLE_Y, 180, ANGLE_Y);
+		BSP_LCD_DrawLine(ANGLE_X, 50, ANGLE_X, ANGLE_Y);
+	}
+	//display angle direction
+	if (shown) {
+		BSP_LCD_SetTextColor(LCD_COLOR_RED);
+		BSP_LCD_DrawLine(ANGLE_X, ANGLE_Y, x, y);
+	}
+	GUI_measAngleShown = shown;
+	GUI_measAngleX = x;
+	GUI_measAngleY = y;
 }
 
 
@@ -380,36 +773,40 @@ void GUI_ClearSite(void){
  * Always display angle, distance and type of measurement. If accuracy is set
  * higher than one display standard deviation and current accuracy settings.
  * If distance is closer than 10mm display current.
+ * @n The angle indicator is drawn once per visit of the site, afterwards only
+ * the angle line and changed rows are repainted. If rows appear or disappear
+ * the text area is cleared, because the rows below move.
  *****************************************************************************/
 void GUI_DrawMeasurement(void){
-	GUI_ClearSite();
-	//display angle
-	BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-	GUI_LCD_FillRect(0, 45, 240, 70);
-	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
-	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-	BSP_LCD_DrawCircle(120, 110, 50);
-	BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-	GUI_LCD_FillRect(0, 110, 240, 60);
-	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-	BSP_LCD_DrawLine(60, 110, 180, 110);
-	BSP_LCD_DrawLine(120, 50, 120, 110);
-	//display angle direction
-	if ((-46>GUI_angle)&(GUI_angle<46)) {
-		BSP_LCD_SetTextColor(LCD_COLOR_RED);
-		uint16_t x,y;
-		float dx,dy;
-		dx = 0.888;
-		dy = 0.333;
-		if (GUI_angle>0) {
-			x=(uint16_t)(120+(int)(dx*GUI_angle));
-			y=(uint16_t)(55+(int)(dy*GUI_angle));
-		} else {
-			x=(uint16_t)(120+(int)(dx*GUI_angle));
-			y=(uint16_t)(55-(int)(dy*GUI_angle));
-		}
-		BSP_LCD_DrawLine(120, 110, x, y);
+	bool angleShown = (-46<GUI_angle)&(GUI_angle<46);
+	bool distanceShown = GUI_distance > -1;
+	bool deviationShown = distanceShown & (GUI_options[2].active > 0);
+	bool currentShown = (GUI_distance <= 10)&(GUI_distance > -1);
+	uint8_t layout = angleShown | (distanceShown<<1) | (deviationShown<<2)
+					 | (currentShown<<3);
+
+	if (!GUI_measValid) {
+		GUI_ClearSite();
+		//display angle
+		BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+		BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+		BSP_LCD_DrawCircle(ANGLE_X, ANGLE_Y, 50);
+		BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+		GUI_LCD_FillRect(0, ANGLE_Y, 240, 60);
+		BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+		BSP_LCD_DrawLine(60, ANGLE_Y, 180, ANGLE_Y);
+		BSP_LCD_DrawLine(ANGLE_X, 50, ANGLE_X, ANGLE_Y);
+		GUI_measAngleShown = false;
+		GUI_ClearRows(GUI_measRows, MEAS_ROW_COUNT);
+		GUI_measLayout = layout;
+		GUI_measValid = true;
+	} else if (layout != GUI_measLayout) {
+		BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+		GUI_LCD_FillRect(0, 120, 240, 160);
+		GUI_ClearRows(GUI_measRows, MEAS_ROW_COUNT);
+		GUI_measLayout = layout;
 	}
+	GUI_DrawAngle();
 
 	//Display Text
 	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
@@ -419,25 +816,25 @@ void GUI_DrawMeasurement(void){
 	uint32_t x = 30;
 	uint32_t y = 125;
 	//Angle
-	if ((-46>GUI_angle)&(GUI_angle<46)) {
-		snprintf(text,24,"Angle:    %4ddeg", (int)(GUI_angle));
-		BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+	if (angleShown) {
+		snprintf(text,24,"Angle: %4ddeg%4d%%", (int)(GUI_angle),
+				(int)(100*GUI_angleConfidence));
+		GUI_DrawRow(&GUI_measRows[0], x, y, text);
 	}
 	y = y+30;
 	//Distance
-	if (GUI_distance > -1) {
+	if (distanceShown) {
 		snprintf(text,24,"Distance: %4.1fmm", (float)(GUI_distance));
-		BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+		GUI_DrawRow(&GUI_measRows[1], x, y, text);
 
-		if (GUI_options[2].active > 0) {
+		if (deviationShown) {
 			//Standard deviation
 			y = y+20;
 			snprintf(text,24,"Std.Dev.: %4.1fmm",
 					(float)(GUI_distanceDeviation));
-			BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+			GUI_DrawRow(&GUI_measRows[2], x, y, text);
 			//Measurement count
 			y = y+20;
-			BSP_LCD_SetFont(&Font16);
 			int t = 1;
 			if(GUI_options[2].active==1){
 				t = 5;
@@ -445,24 +842,21 @@ void GUI_DrawMeasurement(void){
 				t = 10;
 			}
 			snprintf(text,24,"Accuracy: %4dx", t);
-			BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+			GUI_DrawRow(&GUI_measRows[3], x, y, text);
 		}
 	}
 	//Current
-	if ((GUI_distance <= 10)&(GUI_distance > -1)) {
+	if (currentShown) {
 		y = y+30;
-		BSP_LCD_SetFont(&Font16);
 		snprintf(text,24,"Current:  %4.1fA",(float)(GUI_current));
-		BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+		GUI_DrawRow(&GUI_measRows[4], x, y, text);
 	}
 	//Display measuring type
 	y = y+30;
 	if (GUI_options[1].active==0) {
-		BSP_LCD_DisplayStringAt(x, y,
-							   (uint8_t *)"Meas.Type:   sng", LEFT_MODE);
+		GUI_DrawRow(&GUI_measRows[5], x, y, "Meas.Type:   sng");
 	} else {
-		BSP_LCD_DisplayStringAt(x, y,
-							   (uint8_t *)"Meas.Type:  cont", LEFT_MODE);
+		GUI_DrawRow(&GUI_measRows[5], x, y, "Meas.Type:  cont");
 	}
 }
 
@@ -475,13 +869,21 @@ void GUI_DrawMeasurement(void){
  *  - Meassuring Accuracy (1x, 5x, 10x)
  *  - Continous Meassuring (single, continous)
  *  - Display values (analysed, raw)
+ * @n Only option groups whose setting changed are repainted.
  *****************************************************************************/
 void GUI_DrawOptions(void){
 	uint32_t x, y, m, w, h;
 	x = 0;
 	m = 4;
 	h = 40;
-	for (int i = 0; i < 3; ++i) {
+	for (int i = 0; i < OPTN_COUNT; ++i) {
+		//repaint changed option groups only
+		if (GUI_optnValid & (GUI_optnActive[i] == GUI_options[i].active)
+			& (GUI_optnDisabled[i] == GUI_options[i].disabled)) {
+			continue;
+		}
+		GUI_optnActive[i] = GUI_options[i].active;
+		GUI_optnDisabled[i] = GUI_options[i].disabled;
 		y=38+i*80;
 		w=240;
 		BSP_LCD_SetTextColor(LCD_COLOR_LIGHTGRAY);
@@ -489,9 +891,9 @@ void GUI_DrawOptions(void){
 
 		BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
 		BSP_LCD_SetBackColor(LCD_COLOR_LIGHTGRAY);
-		GUI_LCD_DrawRect(x+m, y+m, w-2*m, h);
+		BSP_LCD_DrawRect(x+m, y+m, w-2*m, h);
 		BSP_LCD_SetFont(&Font20);
-		BSP_LCD_DisplayStringAt(x+3*m, y+3*m,
+		GUI_LCD_DisplayStringAt(x+3*m, y+3*m,
 							   (uint8_t *)GUI_options[i].title, LEFT_MODE);
 
 		for (int j = 0; j < GUI_options[i].optnCount; ++j) {
@@ -509,7 +911,7 @@ void GUI_DrawOptions(void){
 			} else {
 				BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
 			}
-			GUI_LCD_DrawRect(x+m+j*w, y+m+h, w, h-m);
+			BSP_LCD_DrawRect(x+m+j*w, y+m+h, w, h-m);
 			uint8_t * text;
 			switch (j) {
 				case 0:
@@ -524,9 +926,10 @@ void GUI_DrawOptions(void){
 				default:
 					break;
 			}
-			BSP_LCD_DisplayStringAt(x+3*m+j*w, y+4*m+h, text, LEFT_MODE);
+			GUI_LCD_DisplayStringAt(x+3*m+j*w, y+4*m+h, text, LEFT_MODE);
 		}
 	}
+	GUI_optnValid = true;
 }
 
 
@@ -534,36 +937,368 @@ void GUI_DrawOptions(void){
  * @brief Display raw measurements
  *
  * Display raw amplitude values of all sensors
+ * @n The titles are drawn once per visit of the site, afterwards only
+ * changed values are repainted.
  *****************************************************************************/
 void GUI_DrawRaw(void){
-	GUI_ClearSite();
+	uint32_t x = 30;
+	uint32_t y = 60;
+	char text[25];
 	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
 	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
 
-	char text[25];
-	uint32_t x = 30;
-	uint32_t y = 60;
+	if (!GUI_rawValid) {
+		GUI_ClearSite();
+		BSP_LCD_SetFont(&Font20);
+		GUI_LCD_DisplayStringAt(x, y, (uint8_t *)"Hall Sensors:", LEFT_MODE);
+		GUI_LCD_DisplayStringAt(x, y+75, (uint8_t *)"WPC Sensors:", LEFT_MODE);
+		GUI_ClearRows(GUI_rawRows, RAW_ROW_COUNT);
+		GUI_rawValid = true;
+	}
+
 	//Hall Sensors
-	BSP_LCD_SetFont(&Font20);
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)"Hall Sensors:", LEFT_MODE);
-	y = y+20;
 	BSP_LCD_SetFont(&Font16);
+	y = y+20;
 	snprintf(text,24,"Right:    %5.2f",(GUI_rawHallRight));
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+	GUI_DrawRow(&GUI_rawRows[0], x, y, text);
 	y = y+20;
 	snprintf(text,24,"Left:     %5.2f",(GUI_rawHallLeft));
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+	GUI_DrawRow(&GUI_rawRows[1], x, y, text);
 	y = y+35;
 	//WPC Sensors
-	BSP_LCD_SetFont(&Font20);
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)"WPC Sensors:", LEFT_MODE);
 	y = y+20;
-	BSP_LCD_SetFont(&Font16);
 	snprintf(text,24,"Right:    %5.2f",(GUI_rawWpcRight));
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+	GUI_DrawRow(&GUI_rawRows[2], x, y, text);
 	y = y+20;
 	snprintf(text,24,"Left:     %5.2f",(GUI_rawWpcLeft));
-	BSP_LCD_DisplayStringAt(x, y, (uint8_t *)text, LEFT_MODE);
+	GUI_DrawRow(&GUI_rawRows[3], x, y, text);
+}
+
+
+/** ***************************************************************************
+ * @brief Draw debug site
+ *
+ * Show the statistics of the double buffered frames, the load of the main
+ * loop, the mains frequency and the run time probes, see profile.c.
+ *****************************************************************************/
+void GUI_DrawDebug(void){
+	uint32_t x = 5;
+	uint32_t y = 45;
+	uint32_t row = 0;
+	float ms = SystemCoreClock/1000.0f;
+	char text[25];
+	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+	BSP_LCD_SetFont(&Font12);
+
+	if (!GUI_debugValid) {
+		GUI_ClearSite();
+		GUI_LCD_DisplayStringAt(x, y+14*7, (uint8_t *)"Probe      mean     max us",
+								LEFT_MODE);
+		GUI_ClearRows(GUI_debugRows, DEBUG_ROW_COUNT);
+		GUI_debugValid = true;
+	}
+
+	//display
+	snprintf(text,24,"Render %6.2f/%6.2fms",GUI_renderCycles/ms,
+			 GUI_renderMax/ms);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	y = y+14;
+	snprintf(text,24,"Flip %6.2fms %9lu",GUI_flipLatency/ms,GUI_flipCount);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	y = y+14;
+	snprintf(text,24,"Pixels %16lu",GUI_redrawArea);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	//main loop
+	y = y+14;
+	snprintf(text,24,"Idle     %6.1f%%",EVT_idle_percent);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	y = y+14;
+	snprintf(text,24,"Pass max %6.2fms",EVT_pass_max/ms);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	y = y+14;
+	snprintf(text,24,"TS errors %6lu",GUI_TSerrors);
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	//mains
+	y = y+14;
+	if (GRID_frequency > 0) {
+		snprintf(text,24,"Mains  %6.2fHz nom %2lu",GRID_frequency,GRID_nominal);
+	} else {
+		snprintf(text,24,"Mains     ---Hz nom %2lu",GRID_nominal);
+	}
+	GUI_DrawRow(&GUI_debugRows[row++], x, y, text);
+	//probes, below their header
+	for (int i = 0; i < PROF_COUNT; ++i) {
+		PROF_stat_t* stat = &PROF_stats[i];
+		float mean = (stat->count > 0) ? (float)stat->sum/stat->count : 0;
+		snprintf(text,24,"%-8s%7.1f%8.1f",PROF_name[i],PROF_us(mean),
+				 PROF_us(stat->max));
+		GUI_DrawRow(&GUI_debugRows[row++], x, y+14*(i+2), text);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw one waveform as columns into the hidden layer
+ * @param [in] samples from the trigger on, SCOPE_SPAN+1 are used
+ * @param [in] top row of the trace area
+ * @param [in] colour
+ *
+ * Each column gets one vertical span from the previous to the current
+ * interpolated value, written directly to the frame buffer. This joins
+ * the samples like a polyline without the per pixel cost of DrawLine().
+ *****************************************************************************/
+static void GUI_DrawTrace(const uint16_t* samples, uint16_t top,
+						  uint32_t color){
+	int32_t previous = -1;
+
+	for (uint32_t x = 0; x < SCOPE_SPAN*SCOPE_STEP; ++x) {
+		uint32_t i = x/SCOPE_STEP;
+		int32_t value = samples[i] + ((int32_t)(samples[i+1]-samples[i])
+						* (int32_t)(x%SCOPE_STEP))/SCOPE_STEP;
+		int32_t y = top + (SCOPE_TRACE-1)
+					- (value*(SCOPE_TRACE-1))/SCOPE_FULL;
+		int32_t yMin = y;
+		int32_t yMax = y;
+		if (previous >= 0) {
+			yMin = (previous < y) ? previous : y;
+			yMax = (previous > y) ? previous : y;
+		}
+		GUI_LCD_DrawColumn(x, yMin, yMax, color);
+		previous = y;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw scope site
+ *
+ * Show the raw samples of the last frame for all channels at full ADC scale,
+ * so clipping and offsets are visible. The traces start at the first rising
+ * zero crossing of the WPC left channel, the zero being the frame average.
+ *****************************************************************************/
+void GUI_DrawScope(void){
+	uint32_t trigger = 0;
+	uint32_t mean = 0;
+	uint16_t top;
+	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+
+	if (!GUI_scopeValid) {
+		GUI_ClearSite();
+		BSP_LCD_SetFont(&Font12);
+		for (int c = 0; c < GUI_SCOPE_CHANNELS; ++c) {
+			BSP_LCD_SetTextColor(GUI_scopeColor[c]);
+			GUI_LCD_DisplayStringAt(4, SCOPE_Y+c*SCOPE_LANE,
+									(uint8_t *)GUI_scopeName[c], LEFT_MODE);
+		}
+		GUI_scopeValid = true;
+	}
+
+	//trigger on rising zero crossing within the first period
+	for (int i = 0; i < GUI_SCOPE_SAMPLES; ++i) {
+		mean += GUI_scopeWave[0][i];
+	}
+	mean = mean/GUI_SCOPE_SAMPLES;
+	for (int i = 0; i < SCOPE_PERIOD; ++i) {
+		if ((GUI_scopeWave[0][i] < mean) & (GUI_scopeWave[0][i+1] >= mean)) {
+			trigger = i;
+			break;
+		}
+	}
+
+	for (int c = 0; c < GUI_SCOPE_CHANNELS; ++c) {
+		top = SCOPE_Y+c*SCOPE_LANE+SCOPE_LABEL;
+		BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+		GUI_LCD_FillRect(0, top, BSP_LCD_GetXSize(), SCOPE_TRACE);
+		BSP_LCD_SetTextColor(LCD_COLOR_LIGHTGRAY);
+		GUI_LCD_FillRect(0, top+SCOPE_TRACE/2, BSP_LCD_GetXSize(), 1);
+		GUI_DrawTrace(&GUI_scopeWave[c][trigger], top, GUI_scopeColor[c]);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw the columns of both trend charts
+ * @param [in] first column
+ * @param [in] column count, the rightmost column shows the newest entry
+ *
+ * Each column connects the entry to its predecessor, unusable results
+ * leave a gap.
+ *****************************************************************************/
+static void GUI_DrawTrendColumns(uint16_t first, uint16_t count){
+	const HIST_entry_t* entry;
+	const HIST_entry_t* previous;
+	float value[2], last[2];
+	const uint16_t top[2] = {TREND_DIST_Y, TREND_CURR_Y};
+	const float scale[2] = {TREND_DIST_MAX, TREND_CURR_MAX};
+	const uint32_t color[2] = {LCD_COLOR_BLUE, LCD_COLOR_RED};
+
+	BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+	GUI_LCD_FillRect(first, TREND_DIST_Y, count, TREND_PLOT);
+	GUI_LCD_FillRect(first, TREND_CURR_Y, count, TREND_PLOT);
+	BSP_LCD_SetTextColor(LCD_COLOR_LIGHTGRAY);
+	GUI_LCD_FillRect(first, TREND_DIST_Y+TREND_PLOT/2, count, 1);
+	GUI_LCD_FillRect(first, TREND_CURR_Y+TREND_PLOT/2, count, 1);
+
+	for (uint16_t x = first; x < first+count; ++x) {
+		entry = HIST_get(TREND_WIDTH-1-x);
+		previous = HIST_get(TREND_WIDTH-x);
+		if (entry == NULL) {
+			continue;
+		}
+		value[0] = entry->distance;
+		value[1] = entry->current;
+		last[0] = (previous != NULL) ? previous->distance : -1;
+		last[1] = (previous != NULL) ? previous->current : -1;
+		for (int c = 0; c < 2; ++c) {
+			int32_t y, yLast;
+			if (value[c] < 0) {
+				continue;
+			}
+			if (value[c] > scale[c]) {
+				value[c] = scale[c];
+			}
+			y = top[c] + (TREND_PLOT-1)
+				- (int32_t)(value[c]*(TREND_PLOT-1)/scale[c]);
+			yLast = y;
+			if (last[c] >= 0) {
+				if (last[c] > scale[c]) {
+					last[c] = scale[c];
+				}
+				yLast = top[c] + (TREND_PLOT-1)
+						- (int32_t)(last[c]*(TREND_PLOT-1)/scale[c]);
+			}
+			GUI_LCD_DrawColumn(x, (yLast < y) ? yLast : y,
+							   (yLast > y) ? yLast : y, color[c]);
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw trend site
+ *
+ * Show distance and current of the last TREND_WIDTH results. The charts are
+ * only drawn completely when the site is opened. For new results the charts
+ * are scrolled and only the new columns are drawn.
+ *****************************************************************************/
+void GUI_DrawTrend(void){
+	uint32_t x = 10;
+	uint32_t fresh = HIST_total - GUI_trendShown;
+	const HIST_entry_t* newest = HIST_get(0);
+	char text[25];
+	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+
+	if (!GUI_trendValid) {
+		GUI_ClearSite();
+		GUI_ClearRows(GUI_trendRows, TREND_ROW_COUNT);
+		GUI_DrawTrendColumns(0, TREND_WIDTH);
+		GUI_trendValid = true;
+	} else if (fresh >= TREND_WIDTH) {
+		GUI_DrawTrendColumns(0, TREND_WIDTH);
+	} else if (fresh > 0) {
+		GUI_LCD_ScrollLeft(TREND_DIST_Y, TREND_PLOT, fresh);
+		GUI_LCD_ScrollLeft(TREND_CURR_Y, TREND_PLOT, fresh);
+		GUI_DrawTrendColumns(TREND_WIDTH-fresh, fresh);
+	}
+	GUI_trendShown = HIST_total;
+
+	BSP_LCD_SetFont(&Font16);
+	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+	if ((newest != NULL) && (newest->distance >= 0)) {
+		snprintf(text,24,"Distance: %5.1fmm",newest->distance);
+		GUI_DrawRow(&GUI_trendRows[0], x, TREND_DIST_Y-20, text);
+		snprintf(text,24,"Current:  %5.1fA",newest->current);
+		GUI_DrawRow(&GUI_trendRows[1], x, TREND_CURR_Y-20, text);
+	} else {
+		GUI_DrawRow(&GUI_trendRows[0], x, TREND_DIST_Y-20, "Distance:   ---");
+		GUI_DrawRow(&GUI_trendRows[1], x, TREND_CURR_Y-20, "Current:    ---");
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Draw calibration site
+ *
+ * Show the progress of the calibration wizard, see calibration.c. The cable
+ * is placed at the shown distance and the user button measures the point.
+ *****************************************************************************/
+void GUI_DrawCalibration(void){
+	uint32_t x = 10;
+	uint32_t y = 50;
+	uint16_t point = CAL_wizard.point;
+	char text[25];
+	BSP_LCD_SetBackColor(LCD_COLOR_WHITE);
+	BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+	BSP_LCD_SetFont(&Font16);
+
+	if (!GUI_caliValid) {
+		GUI_ClearSite();
+		GUI_LCD_DisplayStringAt(x, y, (uint8_t *)"Calibration", LEFT_MODE);
+		GUI_ClearRows(GUI_caliRows, CALI_ROW_COUNT);
+		GUI_caliValid = true;
+	}
+
+	y = y+30;
+	snprintf(text,24,"Mode:  %s",MODE_entry[CAL_wizard.mode].line);
+	GUI_DrawRow(&GUI_caliRows[0], x, y, text);
+	y = y+25;
+	if (point < CALC_LUTSIZE) {
+		snprintf(text,24,"Point: %2u/%u %5.0fmm",point+1,CALC_LUTSIZE,
+				 CALC_distanceLUT[point]);
+	} else {
+		snprintf(text,24,"Point: done");
+	}
+	GUI_DrawRow(&GUI_caliRows[1], x, y, text);
+	y = y+25;
+	if (point > 0) {
+		snprintf(text,24,"Left:  %7.1f",CAL_wizard.left[point-1]);
+		GUI_DrawRow(&GUI_caliRows[2], x, y, text);
+		y = y+25;
+		snprintf(text,24,"Right: %7.1f",CAL_wizard.right[point-1]);
+		GUI_DrawRow(&GUI_caliRows[3], x, y, text);
+	} else {
+		GUI_DrawRow(&GUI_caliRows[2], x, y, "Left:      ---");
+		y = y+25;
+		GUI_DrawRow(&GUI_caliRows[3], x, y, "Right:     ---");
+	}
+	y = y+40;
+	switch (CAL_wizard.state) {
+		case CAL_WAIT:
+			GUI_DrawRow(&GUI_caliRows[4], x, y, "Press button");
+			break;
+		case CAL_CAPTURE:
+			GUI_DrawRow(&GUI_caliRows[4], x, y, "Measuring...");
+			break;
+		case CAL_SAVED:
+			GUI_DrawRow(&GUI_caliRows[4], x, y, "Saved to flash");
+			break;
+		case CAL_FAILED:
+			GUI_DrawRow(&GUI_caliRows[4], x, y, "Saving failed");
+			break;
+		default:
+			GUI_DrawRow(&GUI_caliRows[4], x, y, "");
+			break;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Show the measurement site after options or a debug site
+ *****************************************************************************/
+static void GUI_ShowMeasSite(void){
+	GUI_currentSite = SITE_MEAS;
+	GUI_ClearSite();
+	if(GUI_options[0].active==0){
+		//analysed
+		GUI_DrawMeasurement();
+		GUI_DrawTopMode();
+	} else {
+		//Raw
+		GUI_DrawRaw();
+		GUI_DrawTopMode();
+	}
+	GUI_DrawTopOptions();
 }
 
 
@@ -572,9 +1307,25 @@ void GUI_DrawRaw(void){
  *
  * Read out GUI_inputs and display sites accordingly
  * This Function needs to be called every cycle
+ * Everything is drawn into the hidden layer and shown at once afterwards.
  *****************************************************************************/
 void GUI_SiteHandler(void){
+	bool refresh = false;
+	bool draw;
+	PROF_BEGIN(PROF_GUI_TS);
 	GUI_TSHandler();
+	PROF_END(PROF_GUI_TS);
+	if (GUI_inputTick & (GUI_currentSite == SITE_DEBUG)
+		& (++GUI_debugTicks >= DEBUG_REFRESH)) {
+		GUI_debugTicks = 0;
+		refresh = true;
+	}
+	draw = GUI_inputBtn | GUI_inputTS | GUI_inputMeasReady | refresh
+		   | (GUI_inputScope & (GUI_currentSite == SITE_SCOPE))
+		   | (GUI_currentSite == SITE_NONE);
+	if (draw) {
+		GUI_LCD_BeginFrame();
+	}
 	//Init LCD with hint when no site is selected
 	switch (GUI_currentSite) {
 		case SITE_NONE:
@@ -584,6 +1335,7 @@ void GUI_SiteHandler(void){
 		case SITE_HINT:
 			if(GUI_inputBtn | GUI_inputTS){
 				BSP_LCD_Clear(LCD_COLOR_WHITE);
+				GUI_topValid = false;
 				GUI_DrawTopMode();
 				GUI_DrawTopOptions();
 				GUI_DrawModeSel();
@@ -647,57 +1399,329 @@ void GUI_SiteHandler(void){
 				if (GUI_TSinputType == TOUCH_MODE) {
 					GUI_DrawTopMode();
 				} else if (GUI_TSinputType == TOUCH_OPTN) {
-					GUI_currentSite = SITE_MEAS;
-					GUI_ClearSite();
-					if(GUI_options[0].active==0){
-						//analysed
-						GUI_DrawMeasurement();
-						GUI_DrawTopMode();
-					} else {
-						//Raw
-						GUI_DrawRaw();
-						GUI_DrawTopMode();
-					}
-					GUI_DrawTopOptions();
+					GUI_ShowMeasSite();
 				} else if (GUI_TSinputType == TOUCH_OPTN_CHANGE){
 					GUI_DrawOptions();
 				}
+			} else if (GUI_inputBtn) {
+				//Show debug site
+				GUI_currentSite = SITE_DEBUG;
+				GUI_ClearSite();
+				GUI_DrawDebug();
+				GUI_DrawTopOptions();
+			}
+			break;
+		case SITE_DEBUG:
+			if(GUI_inputTS){
+			//Display updated mode or go back to main screen
+				if (GUI_TSinputType == TOUCH_MODE) {
+					GUI_DrawTopMode();
+				} else if (GUI_TSinputType == TOUCH_OPTN) {
+					GUI_ShowMeasSite();
+				}
+			} else if (GUI_inputBtn) {
+				//Show scope site
+				GUI_currentSite = SITE_SCOPE;
+				GUI_ClearSite();
+				GUI_DrawScope();
+				GUI_DrawTopOptions();
+			} else if (refresh) {
+				GUI_DrawDebug();
+			}
+			break;
+		case SITE_SCOPE:
+			if(GUI_inputTS){
+			//Display updated mode or go back to main screen
+				if (GUI_TSinputType == TOUCH_MODE) {
+					GUI_DrawTopMode();
+				} else if (GUI_TSinputType == TOUCH_OPTN) {
+					GUI_ShowMeasSite();
+				}
+			} else if (GUI_inputBtn) {
+				//Show trend site
+				GUI_currentSite = SITE_TREND;
+				GUI_ClearSite();
+				GUI_DrawTrend();
+				GUI_DrawTopOptions();
+			} else if (GUI_inputScope) {
+				GUI_DrawScope();
+			}
+			break;
+		case SITE_TREND:
+			if(GUI_inputTS){
+			//Display updated mode or go back to main screen
+				if (GUI_TSinputType == TOUCH_MODE) {
+					GUI_DrawTopMode();
+				} else if (GUI_TSinputType == TOUCH_OPTN) {
+					GUI_ShowMeasSite();
+				}
+			} else if (GUI_inputBtn) {
+				//Start calibration of the selected mode
+				GUI_currentSite = SITE_CALI;
+				CAL_wizard_start(GUI_mode);
+				GUI_ClearSite();
+				GUI_DrawCalibration();
+				GUI_DrawTopOptions();
+			} else if (GUI_inputMeasReady) {
+				GUI_DrawTrend();
+			}
+			break;
+		case SITE_CALI:
+			if(GUI_inputTS){
+			//Restart with the new mode or go back to main screen
+				if (GUI_TSinputType == TOUCH_MODE) {
+					GUI_DrawTopMode();
+					CAL_wizard_start(GUI_mode);
+					GUI_DrawCalibration();
+				} else if (GUI_TSinputType == TOUCH_OPTN) {
+					CAL_wizard.state = CAL_IDLE;
+					GUI_ShowMeasSite();
+				}
+			} else if (GUI_inputBtn & (CAL_wizard.state >= CAL_SAVED)) {
+				//Show options again
+				CAL_wizard.state = CAL_IDLE;
+				GUI_currentSite = SITE_OPTN;
+				GUI_ClearSite();
+				GUI_DrawOptions();
+				GUI_DrawTopOptions();
+			} else if (GUI_inputBtn) {
+				//Measure the current point
+				CAL_wizard_capture();
+				GUI_DrawCalibration();
+			} else if (GUI_inputMeasReady) {
+				GUI_DrawCalibration();
 			}
+			break;
 		default:
 			break;
 	}
+	if (draw) {
+		GUI_LCD_EndFrame();
+	}
 
 	//Reset Inputs
 	GUI_inputBtn = false;
 	GUI_inputTS = false;
 	GUI_inputMeasReady = false;
+	GUI_inputTick = false;
+	GUI_inputScope = false;
 	GUI_TSinputType = TOUCH_NONE;
 }
 
 
+/** ***************************************************************************
+ * @brief Start one transfer of the touch controller readout
+ * @param [in] readout step
+ * @param [in] register address
+ * @param [in] size to read, 0 to write GUI_TSvalue
+ *
+ * The transfer runs in the I2C3 event interrupt, which the BSP enables
+ * in I2Cx_MspInit(). Completion is signalled by the HAL callbacks below.
+ * @n The BSP links DMA streams to the bus only for its EEPROM, the few bytes
+ * of a step are moved by the interrupt.
+ *****************************************************************************/
+static void GUI_TSTransfer(GUI_tsread_t step, uint16_t reg, uint16_t size){
+	HAL_StatusTypeDef status;
+	GUI_TSread = step;
+	if (size > 0) {
+		status = HAL_I2C_Mem_Read_IT(&I2cHandle, TS_I2C_ADDRESS, reg,
+				I2C_MEMADD_SIZE_8BIT, GUI_TSbuffer, size);
+	} else {
+		status = HAL_I2C_Mem_Write_IT(&I2cHandle, TS_I2C_ADDRESS, reg,
+				I2C_MEMADD_SIZE_8BIT, &GUI_TSvalue, 1);
+	}
+	if (status != HAL_OK) {
+		GUI_TSstepError = true;
+		EVT_post(EVT_TOUCH_DATA);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Convert a raw FIFO sample to GUI coordinates
+ * @param [in] 4 bytes of TSC_DATA_XYZ
+ * @param [out] touch screen state
+ *
+ * Same corrections as BSP_TS_GetState(), then rotated by 180° like the
+ * display.
+ *****************************************************************************/
+static void GUI_TSDecode(const uint8_t* data, TS_StateTypeDef* state){
+	uint32_t xyz = (data[0]<<24)|(data[1]<<16)|(data[2]<<8)|data[3];
+	int32_t x = (xyz>>20) & 0x0FFF;
+	int32_t y = (xyz>>8) & 0x0FFF;
+	int32_t xSize = BSP_LCD_GetXSize();
+	int32_t ySize = BSP_LCD_GetYSize();
+
+	//Y correction
+	y = (y-TS_YRAW_OFFSET)/11;
+	if (y < 0) {
+		y = 0;
+	} else if (y > ySize) {
+		y = ySize-1;
+	}
+	//X correction
+	if (x <= TS_XRAW_CENTER) {
+		x = 3870-x;
+	} else {
+		x = 3800-x;
+	}
+	x = x/15;
+	if (x < 0) {
+		x = 0;
+	} else if (x > xSize) {
+		x = xSize-1;
+	}
+	//translate to correct coordinate system
+	state->X = xSize-x;
+	state->Y = y;
+}
+
+
 /** ***************************************************************************
  * @brief Handle touch screen inputs
  *
- * Determine touch input from Touch position and current site.
- * This Function needs to be called every cycle
+ * Read the touch screen state without blocking and evaluate it.
+ * @n A readout starts on the touch controller interrupt and, while the
+ * screen is touched, with every tick until the release is seen. Each call
+ * advances the readout by one step once the previous transfer completed.
+ * The last step acknowledges the interrupts, so the INT line can signal
+ * the next touch.
  *****************************************************************************/
 void GUI_TSHandler(void){
-	GUI_TS_GetState(&GUI_currentTSstate);
+	bool start;
+	if (GUI_TSstepError) {
+		//abort and retry with the next pass
+		GUI_TSstepError = false;
+		GUI_TSstepDone = false;
+		GUI_TSread = TSREAD_IDLE;
+		GUI_TSerrors++;
+		GUI_inputTSInt = true;
+	} else if (GUI_TSstepDone) {
+		GUI_TSstepDone = false;
+		switch (GUI_TSread) {
+			case TSREAD_CTRL:
+				GUI_currentTSstate.TouchDetected =
+					(GUI_TSbuffer[0] & STMPE811_TS_CTRL_STATUS) != 0;
+				if (GUI_currentTSstate.TouchDetected) {
+					GUI_TSTransfer(TSREAD_XYZ, STMPE811_REG_TSC_DATA_NON_INC, 4);
+					break;
+				}
+				GUI_TSvalue = 0x01;
+				GUI_TSTransfer(TSREAD_FIFO_RESET, STMPE811_REG_FIFO_STA, 0);
+				break;
+			case TSREAD_XYZ:
+				GUI_TSDecode(GUI_TSbuffer, &GUI_currentTSstate);
+				GUI_TSvalue = 0x01;
+				GUI_TSTransfer(TSREAD_FIFO_RESET, STMPE811_REG_FIFO_STA, 0);
+				break;
+			case TSREAD_FIFO_RESET:
+				GUI_TSvalue = 0x00;
+				GUI_TSTransfer(TSREAD_FIFO_ENABLE, STMPE811_REG_FIFO_STA, 0);
+				break;
+			case TSREAD_FIFO_ENABLE:
+				GUI_TSvalue = STMPE811_TS_IT;
+				GUI_TSTransfer(TSREAD_INT_CLEAR, STMPE811_REG_INT_STA, 0);
+				break;
+			case TSREAD_INT_CLEAR:
+				GUI_TSread = TSREAD_IDLE;
+				GUI_TSEvaluate(GUI_currentTSstate.TouchDetected,
+							   GUI_currentTSstate.X, GUI_currentTSstate.Y);
+				break;
+			default:
+				break;
+		}
+	}
+
+	//start on a new touch, while touched with the tick
+	if (GUI_previousTSstate.TouchDetected) {
+		start = GUI_inputTick;
+	} else {
+		start = GUI_inputTSInt;
+	}
+	if (start & (GUI_TSread == TSREAD_IDLE)) {
+		GUI_inputTSInt = false;
+		GUI_TSTransfer(TSREAD_CTRL, STMPE811_REG_TSC_CTRL, 1);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief I2C memory read completed, called by the HAL from the I2C ISR
+ * @param [in] I2C handle
+ *****************************************************************************/
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){
+	(void)hi2c;
+	GUI_TSstepDone = true;
+	EVT_post(EVT_TOUCH_DATA);
+}
+
+
+/** ***************************************************************************
+ * @brief I2C memory write completed, called by the HAL from the I2C ISR
+ * @param [in] I2C handle
+ *****************************************************************************/
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c){
+	(void)hi2c;
+	GUI_TSstepDone = true;
+	EVT_post(EVT_TOUCH_DATA);
+}
+
+
+/** ***************************************************************************
+ * @brief I2C transfer failed, called by the HAL
+ * @param [in] I2C handle
+ *****************************************************************************/
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c){
+	(void)hi2c;
+	GUI_TSstepError = true;
+	EVT_post(EVT_TOUCH_DATA);
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt handler of the touch controller INT line
+ *
+ * The STMPE811 pulls PA15 low on touch events, see BSP_TS_ITConfig().
+ *****************************************************************************/
+void EXTI15_10_IRQHandler(void){
+	if (EXTI->PR & EXTI_PR_PR15) {		// Check if interrupt on line 15
+		EXTI->PR = EXTI_PR_PR15;		// Clear pending interrupt on line 15
+		EVT_post(EVT_TOUCH);			// Wake up the main loop
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Evaluate a touch screen state
+ * @param [in] touch detected
+ * @param [in] X position in GUI coordinates
+ * @param [in] Y position in GUI coordinates
+ *
+ * Determine touch input from Touch position and current site.
+ * @n Does not access the touch controller, so any source of touch states
+ * can be evaluated. After a touch of the option area new touches are
+ * ignored for TS_HOLDOFF, the event loop keeps running meanwhile.
+ *****************************************************************************/
+void GUI_TSEvaluate(bool touched, uint16_t X, uint16_t Y){
+	//ignore touches during the hold-off
+	if (GUI_TSholding && ((HAL_GetTick() - GUI_TSholdStart) >= TS_HOLDOFF)) {
+		GUI_TSholding = false;
+	}
 	//detect rising edge of touch input
-	if ((GUI_currentTSstate.TouchDetected==1) &
-		(GUI_previousTSstate.TouchDetected==0)) {
+	if (touched & (GUI_previousTSstate.TouchDetected==0) & !GUI_TSholding) {
 		//set touch input to true
 		GUI_inputTS = true;
-		uint16_t X,Y;
-		X = GUI_currentTSstate.X;
-		Y = GUI_currentTSstate.Y;
 		if (GUI_currentSite == SITE_HINT) {
 			GUI_TSinputType = TOUCH_GENERAL;
 		}
 		//detect mode change
 		if ((GUI_currentSite == SITE_MAIN)|
 			(GUI_currentSite == SITE_MEAS)|
-			(GUI_currentSite == SITE_OPTN)) {
+			(GUI_currentSite == SITE_OPTN)|
+			(GUI_currentSite == SITE_DEBUG)|
+			(GUI_currentSite == SITE_SCOPE)|
+			(GUI_currentSite == SITE_TREND)|
+			(GUI_currentSite == SITE_CALI)) {
 			if ((Y>280) & (X<80) & (GUI_mode != MODE_L)) {
 				GUI_TSinputType = TOUCH_MODE;
 				GUI_mode = MODE_L;
@@ -711,7 +1735,8 @@ void GUI_TSHandler(void){
 			//detect option area
 			if ((Y<40) & (X>160)) {
 				GUI_TSinputType = TOUCH_OPTN;
-				HAL_Delay(200);
+				GUI_TSholding = true;
+				GUI_TSholdStart = HAL_GetTick();
 			}
 		}
 		//detect option changes
@@ -762,10 +1787,9 @@ void GUI_TSHandler(void){
 		GUI_outOptn = true;
 	}
 	//save current TS state as previous state
-	GUI_previousTSstate.TouchDetected = GUI_currentTSstate.TouchDetected;
-	GUI_previousTSstate.X = GUI_currentTSstate.X;
-	GUI_previousTSstate.Y = GUI_currentTSstate.Y;
-	GUI_previousTSstate.Z = GUI_currentTSstate.Z;
+	GUI_previousTSstate.TouchDetected = touched;
+	GUI_previousTSstate.X = X;
+	GUI_previousTSstate.Y = Y;
 }
 
 
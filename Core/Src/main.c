@@ -6,6 +6,7 @@
  * and the LCD display with the touchscreen.
  * @n Then the code enters an infinite while-loop, where the data transferring
  * is managed and the analytics and lcd_gui handler gets called regularly.
+ * @n The loop sleeps until an interrupt posts an event, see events.c.
  *
  * @author  Jonas Bollhalder, bollhjon@students.zhaw.ch
  * @author  Tarik Durmaz, durmatar@students.zhaw.ch
@@ -20,12 +21,19 @@
 #include "stm32f429i_discovery.h"
 #include "stm32f429i_discovery_lcd.h"
 #include "stm32f429i_discovery_ts.h"
+#include "string.h"
 
 #include "main.h"
 #include "pushbutton.h"
 #include "measuring.h"
 #include "lcd_gui.h"
 #include "analytics.h"
+#include "events.h"
+#include "history.h"
+#include "profile.h"
+#include "telemetry.h"
+#include "calibration.h"
+#include "grid.h"
 
 
 /******************************************************************************
@@ -52,17 +60,20 @@ static void gyro_disable(void);			///< Disable the onboard gyroscope
  * Initialization and infinite while loop
  *****************************************************************************/
 int main(void) {
+	MEAS_frame_t frame;				// Measurement taken from the queue
+	TEL_result_msg_t result;		// Analysed result for the telemetry
+
 	HAL_Init();						// Initialize the system
 
 	SystemClock_Config();			// Configure system clocks
 
 	BSP_LCD_Init();					// Initialize the LCD display
-	BSP_LCD_LayerDefaultInit(LCD_FOREGROUND_LAYER, LCD_FRAME_BUFFER);
-	BSP_LCD_SelectLayer(LCD_FOREGROUND_LAYER);
+	GUI_LCD_Init();					// Both layers, one shown, one drawn
 	BSP_LCD_DisplayOn();
-	BSP_LCD_Clear(LCD_COLOR_WHITE);
+	HIST_init();					// Result history in SDRAM
 
 	BSP_TS_Init(BSP_LCD_GetXSize(), BSP_LCD_GetYSize());	// Touchscreen
+	BSP_TS_ITConfig();				// Touch controller interrupt on PA15
 
 	PB_init();						// Initialize the user pushbutton
 	PB_enableIRQ();					// Enable interrupt on user pushbutton
@@ -74,22 +85,78 @@ int main(void) {
 
 	MEAS_GPIO_analog_init();		// Configure GPIOs in analog mode
 	MEAS_timer_init();				// Configure the timer
+	GRID_init(MEAS_MAINS_FREQ);		// Sample coherently to the mains
+	CAL_load();						// Stored calibration, if there is one
+	ANA_Init();						// Build the distance LUT engines
+	EVT_init();						// Event queue and idle accounting
+	PROF_init();					// Run time probes
+	TEL_init();						// Telemetry to the virtual COM port
 
 	/* Infinite while loop */
 	while (1) {						// Infinitely loop in main function
-		BSP_LED_Toggle(LED3);		// Visual feedback when running
-
-		if (PB_pressed()) {			// Check if user pushbutton was pressed
-			ANA_inBtn = true;		// Send to analytics handler
-			GUI_inputBtn = true;	// Send to site handler
+		switch (EVT_wait()) {		// Sleep until an event is pending
+			case EVT_TICK:
+				BSP_LED_Toggle(LED3);	// Visual feedback when running
+				GUI_inputTick = true;	// Let site handler poll touch screen
+				TEL_tick();				// Periodic profile report
+				break;
+			case EVT_BUTTON:
+				if (PB_pressed()) {		// Check if user pushbutton was pressed
+					ANA_inBtn = true;	// Send to analytics handler
+					GUI_inputBtn = true;// Send to site handler
+				}
+				break;
+			case EVT_TOUCH:
+				GUI_inputTSInt = true;	// Let site handler read touch screen
+				break;
+			default:	// EVT_MEAS, EVT_TOUCH_DATA, EVT_ANALYTICS: see below
+				break;
 		}
 
-		if (MEAS_data_ready) {		// Analyse data if new data available
+		if (MEAS_frame_read(&frame)) {	// Analyse data if new data available
+			if (GRID_update(&frame)) {	// Mains frequency moved
+				GRID_settle(MEAS_track(GRID_track, GRID_nominal));
+			}
 			// Transfer data to analytics handler
-			ANA_inAmpLeft = MEAS_amplitude_left;
-			ANA_inAmpRight = MEAS_amplitude_right;
+			ANA_inAmpLeft = frame.amplitude_left;
+			ANA_inAmpRight = frame.amplitude_right;
+			ANA_inHallLeft = frame.amplitude_hall_in6;
+			ANA_inHallRight = frame.amplitude_hall_in11;
+			ANA_inPhase = frame.phase_right - frame.phase_left;
 			ANA_inMeasReady = true;		// Send to analytics handler
-			MEAS_data_ready = false;	// Reset meas data ready bit
+			// Transfer raw waveforms to scope site
+			memcpy(GUI_scopeWave, frame.wave, sizeof(GUI_scopeWave));
+			GUI_inputScope = true;
+			TEL_frame(&frame);			// Log every frame
+			CAL_wizard_sample(frame.amplitude_left, frame.amplitude_right);
+		}
+
+		if (GUI_outOptn) {						// Check if Options were changed
+			ANA_inOptn[0]=GUI_mode;				// Transfer mode
+			ANA_inOptn[1]=GUI_options[0].active;// Transfer data type
+			ANA_inOptn[2]=GUI_options[1].active;// Transfer measuring type
+			switch (GUI_options[2].active) {	// Transfer accuracy
+				case 0:
+					ANA_inOptn[3]=1;
+					break;
+				case 1:
+					ANA_inOptn[3]=5;
+					break;
+				case 2:
+					ANA_inOptn[3]=10;
+					break;
+				default:
+					break;
+			}
+			GUI_outOptn = false;				// Reset option bit
+		}
+
+		//Analytics handler, its requests are served in this pass
+		PROF_BEGIN(PROF_ANA_HANDLER);
+		ANA_Handler();
+		PROF_END(PROF_ANA_HANDLER);
+		if (ANA_Pending()) {			// Next step needs no new input
+			EVT_post(EVT_ANALYTICS);	// Run the next pass without sleeping
 		}
 
 		if (ANA_outStartHALL) {		// Start hall measurement
@@ -104,13 +171,33 @@ int main(void) {
 			ANA_outStartWPC = false; // Reset wpc start event
 		}
 
+		if (ANA_outStartQUAD) {		// Start wpc and hall measurement
+			ADC123_quad_scan_init();
+			ADC123_triple_scan_start();
+			ANA_outStartQUAD = false; // Reset quad start event
+		}
+
+		if (ANA_outStartStream) {	// Start continuous wpc and hall stream
+			ADC123_quad_stream_init();
+			ADC123_triple_scan_start();
+			ANA_outStartStream = false; // Reset stream start event
+		}
+
+		if (ANA_outStopStream) {	// Stop continuous stream
+			ADC123_stream_stop();
+			MEAS_frame_flush();			// Discard frames in flight
+			ANA_outStopStream = false; // Reset stream stop event
+		}
+
 		if (ANA_outDataReady) {		// Analytics data ready
+			CAL_wizard_complete();		// Point of the calibration wizard
 			// Transfer Data
 			if (ANA_inOptn[1]==0) {
 				// Analysed
 				if (ANA_outResults[1]<300) {
 					// Data usable
 					GUI_angle = ANA_outResults[0];
+					GUI_angleConfidence = ANA_outConfidence;
 					GUI_distance = ANA_outResults[1];
 					GUI_distanceDeviation = ANA_outResults[2];
 					GUI_current = ANA_outResults[3];
@@ -118,11 +205,22 @@ int main(void) {
 				} else {
 					// Data unusable
 					GUI_angle = 100;
+					GUI_angleConfidence = 0;
 					GUI_distance = -1;
 					GUI_distanceDeviation = -1;
 					GUI_current = -1;
 					GUI_cable_not_detected = true;
 				}
+				HIST_add(HAL_GetTick(), GUI_distance, GUI_current, GUI_angle);
+				result.tick = HAL_GetTick();
+				result.distance = GUI_distance;
+				result.angle = GUI_angle;
+				result.confidence = GUI_angleConfidence;
+				result.current = GUI_current;
+				result.deviation = GUI_distanceDeviation;
+				result.mode = ANA_inOptn[0];
+				result.detected = (ANA_outResults[1]<300);
+				TEL_result(&result);	// Log every result
 
 
 			} else {
@@ -143,31 +241,10 @@ int main(void) {
 			BSP_LED_Off(LED4);
 		}
 
-		if (GUI_outOptn) {						// Check if Options were changed
-			ANA_inOptn[0]=GUI_mode;				// Transfer mode
-			ANA_inOptn[1]=GUI_options[0].active;// Transfer data type
-			ANA_inOptn[2]=GUI_options[1].active;// Transfer measuring type
-			switch (GUI_options[2].active) {	// Transfer accuracy
-				case 0:
-					ANA_inOptn[3]=1;
-					break;
-				case 1:
-					ANA_inOptn[3]=5;
-					break;
-				case 2:
-					ANA_inOptn[3]=10;
-					break;
-				default:
-					break;
-			}
-			GUI_outOptn = false;				// Reset option bit
-		}
-
-		//Analytics handler
-		ANA_Handler();
-
 		//Site handler
+		PROF_BEGIN(PROF_GUI_SITE);
 		GUI_SiteHandler();
+		PROF_END(PROF_GUI_SITE);
 	}
 }
 
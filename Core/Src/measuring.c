@@ -5,11 +5,18 @@
  * Contained functionality:
  * ==============================================================
  *
- * - ADC triggered by a timer and with interrupt after end of conversion
+ * - ADC triggered by a timer
  * - ADC combined with DMA (Direct Memory Access) to fill a buffer
  * - Dual mode = simultaneous sampling of two inputs by two ADCs
+ * - Triple mode = simultaneous sampling of all four inputs by ADC1/2/3
+ * - Gap-free streaming of triple mode frames with DMA double buffering
  * - Analog mode configuration for GPIOs
  * - Analyse collected samples
+ * - Hand timestamped results to the main loop through a lock-free queue
+ * - Amplitude by peak averaging or by the Goertzel algorithm (mains bin)
+ * - Sampling frequency, frame length and channel sequence set at runtime
+ * - Oversampled triple mode, decimated block by block to the analysis rate
+ * - Sampling frequency retuned to follow the mains frequency
  *
  * Peripherals @ref HowTo
  *
@@ -27,6 +34,35 @@
  * The information on which bits have to be set to get a specific behavior
  * is documented in the <b>reference manual</b> of the microcontroller.
  *
+ * Acquisition configuration
+ * =========================
+ *
+ * The sampling frequency, the samples per frame and the channel sequence of
+ * the triple mode are taken from MEAS_config, see MEAS_presets. TIM2 counts
+ * the undivided timer clock, so every divisor of TIM_CLOCK is hit exactly.
+ * @n The raw waveforms of a frame are always given at MEAS_WAVE_RATE. As
+ * frames span whole mains periods, shorter frames are repeated to fill
+ * MEAS_WAVE_SAMPLES.
+ *
+ * Oversampling
+ * ============
+ *
+ * With MEAS_oversampling the triple mode is triggered at DEC_RATIO times
+ * the sampling frequency. The DMA runs circular over two halves of
+ * DEC_BLOCK triggers, each half is decimated in the half or full transfer
+ * interrupt, see decimate.c. The decimated samples are collected in the
+ * triple mode layout and analysed like a frame sampled directly. The first
+ * DEC_SETTLE samples after the start are dropped.
+ *
+ * Mains tracking
+ * ==============
+ *
+ * MEAS_track() scales the sampling frequency by the ratio of the measured
+ * to the nominal mains frequency, see grid.c. The frames then keep spanning
+ * whole mains periods and the mains bin stays where it is. TIM2 preloads
+ * the auto reload register, so a running acquisition takes the new period
+ * at the next trigger without a glitch.
+ *
  * ----------------------------------------------------------------------------
  * @author  Jonas Bollhalder, bollhjon@students.zhaw.ch
  * @author  Tarik Durmaz, durmatar@students.zhaw.ch
@@ -38,36 +74,85 @@
  * Includes
  *****************************************************************************/
 #include <stdio.h>
+#include <math.h>
 #include "stm32f4xx.h"
 #include "stm32f429i_discovery.h"
 #include "stm32f429i_discovery_lcd.h"
 #include "stm32f429i_discovery_ts.h"
 
 #include "measuring.h"
+#include "dsp.h"
+#include "events.h"
+#include "profile.h"
+#include "decimate.h"
+#ifdef MEAS_SIMULATION
+#include "sim.h"
+#endif
 
 /******************************************************************************
  * Defines
  *****************************************************************************/
 #define ADC_DAC_RES		12			///< Resolution
 #define ADC_MAX_VALUE   4095		///< Maximum value of ADC output
-#define ADC_NUMS		60			///< Number of samples
-#define ADC_FS			600	///< Sampling freq. => 12 samples for a 50Hz period
+#define ADC_NUMS		(MEAS_config.samples)	///< Number of samples
+#define ADC_FS			(MEAS_config.rate)		///< Sampling freq.
 #define ADC_CLOCK		84000000	///< APB2 peripheral clock frequency
 #define ADC_CLOCKS_PS	15			///< Clocks/sample: 3 hold + 12 conversion
 #define TIM_CLOCK		84000000	///< APB1 timer clock frequency
-#define TIM_TOP			9			///< Timer top value
-#define TIM_PRESCALE	(TIM_CLOCK/ADC_FS/(TIM_TOP+1)-1) ///< Clock prescaler
+#define MEAS_WPC_STRIDE	3			///< Conversions per trigger, wpc sequence
 #define MEAS_INPUT_COUNT 2			///< Input count per measurement
+#define MEAS_PEAK_COUNT	5			///< Peaks per polarity for the amplitude
+#define MEAS_PI			3.14159265358979f	///< Pi
+#define MEAS_QUEUE_MASK	(MEAS_QUEUE_SIZE-1)	///< Index mask of the queue
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Precomputed constants of one Goertzel frequency bin */
+typedef struct {
+	float coeff;						///< 2*cos(w)
+	float cosine;						///< cos(w)
+	float sine;							///< sin(w)
+	float cosineN;						///< cos(w*ADC_NUMS), phase reference
+	float sineN;						///< sin(w*ADC_NUMS), phase reference
+} MEAS_bin_t;
 
 /******************************************************************************
  * Variables
  *****************************************************************************/
-bool MEAS_data_ready = false;			///< New data is ready
-uint32_t MEAS_amplitude_left = 0;		///< Amplitude of the left channel
-uint32_t MEAS_amplitude_right = 0;		///< Amplitude of the right channel
+MEAS_engine_t MEAS_engine = MEAS_DEFAULT_ENGINE;///< Selected amplitude engine
+bool MEAS_oversampling = MEAS_DEFAULT_OVERSAMPLING;	///< Oversampled triple m.
+uint32_t MEAS_frame_count = 0;			///< Frames completed, next sequence
+uint32_t MEAS_frames_dropped = 0;		///< Frames dropped on a full queue
 
-static uint32_t ADC_sample_count = 0;	///< Index for buffer
-static uint32_t ADC_samples[2*ADC_NUMS];///< ADC values of max. 2 input channels
+/** Presets of the acquisition, rate [Hz], samples, sequence */
+const MEAS_config_t MEAS_presets[MEAS_PRESET_COUNT] = {
+		{600, 60, MEAS_SEQ_QUAD},		// Standard: 100 ms
+		{1200, 2*1200/MEAS_MAINS_FREQ, MEAS_SEQ_WPC},	// Fast: 2 periods
+		{1200, 240, MEAS_SEQ_QUAD}		// Precision: 200 ms
+};
+MEAS_config_t MEAS_config = {600, 60, MEAS_SEQ_QUAD};	///< Acquisition
+uint32_t MEAS_nominal = MEAS_MAINS_FREQ;///< Nominal mains frequency [Hz]
+
+static uint16_t ADC_samples[2*MEAS_MAX_SAMPLES];///< ADC values of 2 inputs
+static uint16_t ADC_quad_samples[2][MEAS_QUAD_STRIDE*MEAS_MAX_SAMPLES];///< Tr.
+static uint32_t MEAS_stride = MEAS_QUAD_STRIDE;	///< Conversions per trigger
+static uint16_t ADC_os_samples[2*DEC_BLOCK*MEAS_QUAD_STRIDE];///< Circular
+static DEC_t MEAS_dec[MEAS_WAVE_CHANNELS];	///< Decimation per channel
+static bool MEAS_os_active = false;		///< Triple mode runs oversampled
+static uint32_t MEAS_os_count = 0;		///< Decimated triggers in the frame
+static uint32_t MEAS_os_skip = 0;		///< Decimated triggers still dropped
+static bool MEAS_streaming = false;		///< Triple mode runs double buffered
+static float MEAS_ratio = 1;			///< Tracked to nominal mains frequency
+static MEAS_bin_t MEAS_mains_bin;		///< Goertzel constants of the mains bin
+static MEAS_frame_t MEAS_queue[MEAS_QUEUE_SIZE];///< Frames for the main loop
+static volatile uint32_t MEAS_queue_head = 0;	///< Written by the ISRs only
+static volatile uint32_t MEAS_queue_tail = 0;	///< Written by main loop only
+#ifdef MEAS_SIMULATION
+static bool MEAS_sim_active = false;	///< Simulator replaces the triple mode
+static uint32_t MEAS_sim_count = 0;		///< Simulated triggers of the frame
+#endif
 
 
 /******************************************************************************
@@ -107,6 +192,31 @@ void ADC_reset(void) {
 
 
 
+/** ***************************************************************************
+ * @brief Auto reload register for a trigger frequency
+ * @param [in] rate [Hz], valid by MEAS_config_valid()
+ * @return top value of TIM2
+ *
+ * The rate is scaled by the tracked mains frequency, see MEAS_track().
+ *****************************************************************************/
+static uint32_t MEAS_timer_top(uint32_t rate)
+{
+	return (uint32_t)(TIM_CLOCK/(rate*MEAS_ratio) + 0.5f) - 1;
+}
+
+
+/** ***************************************************************************
+ * @brief Set the trigger frequency of the stopped timer
+ * @param [in] rate [Hz], valid by MEAS_config_valid()
+ *****************************************************************************/
+static void MEAS_timer_rate(uint32_t rate)
+{
+	TIM2->ARR = MEAS_timer_top(rate);	// Auto reload = counter top value
+	TIM2->EGR = TIM_EGR_UG;				// Load top value, clear counter
+	TIM2->SR &= ~TIM_SR_UIF;			// Discard the update of the load
+}
+
+
 /** ***************************************************************************
  * @brief Configure the timer to trigger the ADC(s)
  *
@@ -114,14 +224,160 @@ void ADC_reset(void) {
  *****************************************************************************/
 void MEAS_timer_init(void)
 {
+	uint32_t psc, arr;
+	MEAS_timer_calc(MEAS_config.rate, &psc, &arr);
 	__HAL_RCC_TIM2_CLK_ENABLE();		// Enable Clock for TIM2
-	TIM2->PSC = TIM_PRESCALE;			// Prescaler for clock freq. = 1MHz
-	TIM2->ARR = TIM_TOP;				// Auto reload = counter top value
+	TIM2->PSC = psc;					// Prescaler, 0 = full timer clock
+	TIM2->CR1 |= TIM_CR1_ARPE;			// Preload auto reload, see MEAS_track
+	MEAS_timer_rate(MEAS_config.rate);	// Top value and load the prescaler
 	TIM2->CR2 |= TIM_CR2_MMS_1; 		// TRGO on update
 	/* If timer interrupt is not needed, comment the following lines */
 	TIM2->DIER |= TIM_DIER_UIE;			// Enable update interrupt
 	NVIC_ClearPendingIRQ(TIM2_IRQn);	// Clear pending interrupt on line 0
 	NVIC_EnableIRQ(TIM2_IRQn);			// Enable interrupt line 0 in the NVIC
+	MEAS_goertzel_init(MEAS_nominal);	// Mains bin for the sampling freq.
+}
+
+
+/** ***************************************************************************
+ * @brief Calculate the TIM2 registers for a sampling frequency
+ * @param [in] rate sampling frequency [Hz]
+ * @param [out] psc prescaler register
+ * @param [out] arr auto reload register
+ * @return true if the frequency is hit exactly
+ *
+ * TIM2 is a 32 bit timer, so the prescaler stays 0 for the best resolution.
+ *****************************************************************************/
+bool MEAS_timer_calc(uint32_t rate, uint32_t* psc, uint32_t* arr)
+{
+	if ((rate == 0) || (rate > TIM_CLOCK/2)) {
+		return false;
+	}
+	*psc = 0;
+	*arr = TIM_CLOCK/rate - 1;
+	return (TIM_CLOCK % rate) == 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Check an acquisition configuration
+ * @param [in] config
+ * @return true if it can be applied
+ *
+ * The timer has to hit the sampling frequency exactly, also oversampled,
+ * the frame has to fit the buffers and to span whole mains periods. The
+ * conversions of one trigger have to be done before the next trigger.
+ * The raw waveforms take every n-th sample, so the rate has to be a
+ * multiple of MEAS_WAVE_RATE.
+ *****************************************************************************/
+bool MEAS_config_valid(const MEAS_config_t* config)
+{
+	uint32_t psc, arr;
+	uint32_t conversions = (config->sequence == MEAS_SEQ_WPC) ? 1 : 2;
+	uint32_t adc_rate = ADC_CLOCK/4/ADC_CLOCKS_PS/conversions;	// APB2/4
+	return (config->rate >= MEAS_RATE_MIN) && (config->rate <= MEAS_RATE_MAX)
+		&& MEAS_timer_calc(config->rate, &psc, &arr)
+		&& MEAS_timer_calc(config->rate*DEC_RATIO, &psc, &arr)
+		&& (config->samples >= MEAS_MIN_SAMPLES)
+		&& (config->samples <= MEAS_MAX_SAMPLES)
+		&& (config->sequence <= MEAS_SEQ_WPC)
+		&& ((config->rate % MEAS_WAVE_RATE) == 0)
+		&& (config->rate*DEC_RATIO <= adc_rate)
+		&& MEAS_config_whole(config, MEAS_nominal);
+}
+
+
+/** ***************************************************************************
+ * @brief Check if the frames of a configuration span whole mains periods
+ * @param [in] config
+ * @param [in] nominal mains frequency [Hz]
+ * @return true if a frame is a whole number of periods long
+ *****************************************************************************/
+bool MEAS_config_whole(const MEAS_config_t* config, uint32_t nominal)
+{
+	return (config->samples*nominal) % config->rate == 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Change the acquisition configuration
+ * @param [in] config
+ * @return false if the configuration is invalid or a measurement is running
+ *
+ * The new configuration is used by the next ..._scan_init() call.
+ *****************************************************************************/
+bool MEAS_config_set(const MEAS_config_t* config)
+{
+	if (!MEAS_config_valid(config) || (TIM2->CR1 & TIM_CR1_CEN)
+		|| MEAS_streaming) {
+		return false;
+	}
+	MEAS_config = *config;
+	MEAS_timer_init();
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Change the acquisition configuration to a preset
+ * @param [in] preset
+ * @return false if a measurement is running
+ *****************************************************************************/
+bool MEAS_config_preset(MEAS_preset_t preset)
+{
+	if (preset >= MEAS_PRESET_COUNT) {
+		return false;
+	}
+	return MEAS_config_set(&MEAS_presets[preset]);
+}
+
+
+/** ***************************************************************************
+ * @brief Follow the mains frequency
+ * @param [in] frequency of the mains to sample coherently [Hz]
+ * @param [in] nominal mains frequency, 50 or 60 [Hz]
+ * @return sequence of the first frame sampled completely at the new rate
+ *
+ * May be called while measuring. The new period is preloaded and takes
+ * effect at the next trigger, the frame being sampled mixes both rates.
+ * A changed nominal frequency moves the mains bin of the Goertzel engine
+ * right away, with the ISRs masked, so the next frame analysed uses it.
+ *****************************************************************************/
+uint32_t MEAS_track(float frequency, uint32_t nominal)
+{
+	uint32_t rate = MEAS_os_active ? ADC_FS*DEC_RATIO : ADC_FS;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();					// ISRs stop the timer and change rate
+	MEAS_ratio = frequency/nominal;
+	if (nominal != MEAS_nominal) {
+		MEAS_nominal = nominal;
+		MEAS_goertzel_init(nominal);
+	}
+	if (TIM2->CR1 & TIM_CR1_CEN) {
+		TIM2->ARR = MEAS_timer_top(rate);	// Preloaded, next update
+	} else {
+		MEAS_timer_rate(rate);
+	}
+	uint32_t sequence = MEAS_frame_count + 1;
+	__set_PRIMASK(primask);
+	return sequence;
+}
+
+
+/** ***************************************************************************
+ * @brief Precompute the Goertzel constants for a frequency bin
+ * @param [in] frequency of the bin [Hz]
+ *
+ * Has to be called whenever the sampling frequency changes.
+ *****************************************************************************/
+void MEAS_goertzel_init(float frequency)
+{
+	float w = 2*MEAS_PI*frequency/ADC_FS;	// Normalised angular frequency
+	MEAS_mains_bin.coeff = 2*cosf(w);
+	MEAS_mains_bin.cosine = cosf(w);
+	MEAS_mains_bin.sine = sinf(w);
+	MEAS_mains_bin.cosineN = cosf(w*ADC_NUMS);
+	MEAS_mains_bin.sineN = sinf(w*ADC_NUMS);
 }
 
 
@@ -152,8 +408,8 @@ void ADC3_IN13_IN4_scan_init(void)
 	DMA2->LIFCR |= DMA_LIFCR_CTCIF1;	// Clear transfer complete interrupt fl.
 	DMA2_Stream1->CR |= (2UL << DMA_SxCR_CHSEL_Pos);	// Select channel 2
 	DMA2_Stream1->CR |= DMA_SxCR_PL_1;		// Priority high
-	DMA2_Stream1->CR |= DMA_SxCR_MSIZE_1;	// Memory data size = 32 bit
-	DMA2_Stream1->CR |= DMA_SxCR_PSIZE_1;	// Peripheral data size = 32 bit
+	DMA2_Stream1->CR |= DMA_SxCR_MSIZE_0;	// Memory data size = 16 bit
+	DMA2_Stream1->CR |= DMA_SxCR_PSIZE_0;	// Peripheral data size = 16 bit
 	DMA2_Stream1->CR |= DMA_SxCR_MINC;	// Increment memory address pointer
 	DMA2_Stream1->CR |= DMA_SxCR_TCIE;	// Transfer complete interrupt enable
 	DMA2_Stream1->NDTR = 2*ADC_NUMS;	// Number of data items to transfer
@@ -190,8 +446,8 @@ void ADC3_IN11_IN6_scan_init(void)
 	DMA2->LIFCR |= DMA_LIFCR_CTCIF1;	// Clear transfer complete interrupt fl.
 	DMA2_Stream1->CR |= (2UL << DMA_SxCR_CHSEL_Pos);	// Select channel 2
 	DMA2_Stream1->CR |= DMA_SxCR_PL_1;		// Priority high
-	DMA2_Stream1->CR |= DMA_SxCR_MSIZE_1;	// Memory data size = 32 bit
-	DMA2_Stream1->CR |= DMA_SxCR_PSIZE_1;	// Peripheral data size = 32 bit
+	DMA2_Stream1->CR |= DMA_SxCR_MSIZE_0;	// Memory data size = 16 bit
+	DMA2_Stream1->CR |= DMA_SxCR_PSIZE_0;	// Peripheral data size = 16 bit
 	DMA2_Stream1->CR |= DMA_SxCR_MINC;	// Increment memory address pointer
 	DMA2_Stream1->CR |= DMA_SxCR_TCIE;	// Transfer complete interrupt enable
 	DMA2_Stream1->NDTR = 2*ADC_NUMS;	// Number of data items to transfer
@@ -216,35 +472,294 @@ void ADC3_dual_scan_start(void)
 
 
 /** ***************************************************************************
- * @brief Interrupt handler for the timer 2
+ * @brief Initialize ADC1/2/3, timer and DMA for a combined WPC/HALL measurement
  *
- * @note This interrupt handler was only used for debugging purposes
- * and to increment the DAC value.
+ * Uses ADC1, ADC2 and ADC3 in triple regular simultaneous mode
+ * and DMA2_Stream0 channel0
+ * @n The ADC1 (master) trigger is set to TIM2 TRGO event,
+ * ADC2 and ADC3 are started by the master.
+ * @n At each trigger a sequence of two conversions runs on all three ADCs:
+ * - ADC1: IN13 (wpc left), IN13
+ * - ADC2: IN11 (hall right), IN11
+ * - ADC3: IN4 (wpc right), IN6 (hall left)
+ *
+ * @n The wpc pair is taken from the first and the hall pair from the second
+ * conversion, so both pairs are sampled at exactly the same time.
+ * @n DMA mode 1 transfers the common data register once per conversion
+ * in the order ADC1, ADC2, ADC3, which gives MEAS_QUAD_STRIDE halfwords
+ * per trigger.
+ * @n The MEAS_SEQ_WPC sequence only runs the first conversion, the wpc
+ * pair keeps its position in the MEAS_WPC_STRIDE halfwords per trigger.
+ * @n The DMA triggers the transfer complete interrupt when all data is ready.
  *****************************************************************************/
-void TIM2_IRQHandler(void)
+void ADC123_quad_scan_init(void)
 {
-	TIM2->SR &= ~TIM_SR_UIF;			// Clear pending interrupt flag
+	bool hall = (MEAS_config.sequence == MEAS_SEQ_QUAD);
+	MEAS_stride = hall ? MEAS_QUAD_STRIDE : MEAS_WPC_STRIDE;
+	__HAL_RCC_ADC1_CLK_ENABLE();		// Enable Clock for ADC1
+	__HAL_RCC_ADC2_CLK_ENABLE();		// Enable Clock for ADC2
+	__HAL_RCC_ADC3_CLK_ENABLE();		// Enable Clock for ADC3
+	if (hall) {
+		ADC1->SQR1 |= ADC_SQR1_L_0;		// Convert 2 inputs
+		ADC2->SQR1 |= ADC_SQR1_L_0;		// Convert 2 inputs
+		ADC3->SQR1 |= ADC_SQR1_L_0;		// Convert 2 inputs
+	}									// else first conversions only
+	ADC1->SQR3 |= (13UL << ADC_SQR3_SQ1_Pos);	// Input 13 = first conversion
+	ADC1->SQR3 |= (13UL << ADC_SQR3_SQ2_Pos);	// Input 13 = second conversion
+	ADC1->CR1 |= ADC_CR1_SCAN;			// Enable scan mode
+	ADC1->CR2 |= (1UL << ADC_CR2_EXTEN_Pos);	// En. ext. trigger on rising e.
+	ADC1->CR2 |= (6UL << ADC_CR2_EXTSEL_Pos);	// Timer 2 TRGO event
+	ADC2->SQR3 |= (11UL << ADC_SQR3_SQ1_Pos);	// Input 11 = first conversion
+	ADC2->SQR3 |= (11UL << ADC_SQR3_SQ2_Pos);	// Input 11 = second conversion
+	ADC2->CR1 |= ADC_CR1_SCAN;			// Enable scan mode
+	ADC3->SQR3 |= (4UL << ADC_SQR3_SQ1_Pos);	// Input 4 = first conversion
+	ADC3->SQR3 |= (6UL << ADC_SQR3_SQ2_Pos);	// Input 6 = second conversion
+	ADC3->CR1 |= ADC_CR1_SCAN;			// Enable scan mode
+	ADC->CCR |= ADC_CCR_ADCPRE_0;		// ADC clock = APB2/4, reset by ADC_reset
+	ADC->CCR |= (22UL << ADC_CCR_MULTI_Pos);	// Triple regular simultaneous
+	ADC->CCR |= ADC_CCR_DMA_0;			// DMA mode 1 = one halfword per request
+	__HAL_RCC_DMA2_CLK_ENABLE();		// Enable Clock for DMA2
+	DMA2_Stream0->CR &= ~DMA_SxCR_EN;	// Disable the DMA stream 0
+	while (DMA2_Stream0->CR & DMA_SxCR_EN) { ; }	// Wait for DMA to finish
+	DMA2->LIFCR |= DMA_LIFCR_CTCIF0;	// Clear transfer complete interrupt fl.
+	DMA2_Stream0->CR &= ~DMA_SxCR_CHSEL;	// Select channel 0
+	DMA2_Stream0->CR |= DMA_SxCR_PL_1;		// Priority high
+	DMA2_Stream0->CR |= DMA_SxCR_MSIZE_0;	// Memory data size = 16 bit
+	DMA2_Stream0->CR |= DMA_SxCR_PSIZE_0;	// Peripheral data size = 16 bit
+	DMA2_Stream0->CR |= DMA_SxCR_MINC;	// Increment memory address pointer
+	DMA2_Stream0->CR |= DMA_SxCR_TCIE;	// Transfer complete interrupt enable
+	DMA2_Stream0->NDTR = MEAS_stride*ADC_NUMS;	// Number of data items
+	DMA2_Stream0->PAR = (uint32_t)&ADC->CDR;	// Peripheral register address
+	DMA2_Stream0->M0AR = (uint32_t)ADC_quad_samples[0];// Buffer memory address
+	MEAS_streaming = false;
+	MEAS_os_active = false;
+#ifndef MEAS_SIMULATION
+	if (MEAS_oversampling) {
+		ADC->CCR |= ADC_CCR_DDS;		// Keep DMA requests after last transfer
+		DMA2_Stream0->CR |= DMA_SxCR_CIRC;	// Circular over both halves
+		DMA2_Stream0->CR |= DMA_SxCR_HTIE;	// Half transfer interrupt enable
+		DMA2_Stream0->NDTR = 2*DEC_BLOCK*MEAS_stride;	// Number of data items
+		DMA2_Stream0->M0AR = (uint32_t)ADC_os_samples;	// Circular buffer
+		MEAS_timer_rate(ADC_FS*DEC_RATIO);	// Trigger oversampled
+		for (int c = 0; c < MEAS_WAVE_CHANNELS; ++c) {
+			DEC_init(&MEAS_dec[c]);
+		}
+		MEAS_os_count = 0;
+		MEAS_os_skip = DEC_SETTLE;
+		MEAS_os_active = true;
+	}
+#endif
+}
+
+
+/** ***************************************************************************
+ * @brief Initialize the triple mode for continuous streaming
+ *
+ * Same configuration as ADC123_quad_scan_init() but the ADCs keep issuing
+ * DMA requests and the DMA2_Stream0 runs in double buffer mode.
+ * @n While the DMA fills one frame buffer (M0AR or M1AR) the other,
+ * completed one is analysed in the transfer complete interrupt.
+ * @n Neither the timer nor the ADCs are stopped between frames,
+ * so sampling is gap-free until ADC123_stream_stop() is called.
+ * @n Oversampled, the circular DMA of ADC123_quad_scan_init() just keeps
+ * running.
+ *****************************************************************************/
+void ADC123_quad_stream_init(void)
+{
+	ADC123_quad_scan_init();
+	if (MEAS_os_active) {
+		MEAS_frame_count = 0;
+		MEAS_frames_dropped = 0;
+		MEAS_streaming = true;
+		return;
+	}
+	ADC->CCR |= ADC_CCR_DDS;			// Keep DMA requests after last transfer
+	DMA2_Stream0->CR |= DMA_SxCR_DBM;	// Double buffer mode (implies circular)
+	DMA2_Stream0->CR &= ~DMA_SxCR_CT;	// Start with memory 0
+	DMA2_Stream0->M1AR = (uint32_t)ADC_quad_samples[1];// Second buffer address
+	MEAS_frame_count = 0;
+	MEAS_frames_dropped = 0;
+	MEAS_streaming = true;
+}
+
+
+/** ***************************************************************************
+ * @brief Stop the continuous streaming of the triple mode
+ *
+ *****************************************************************************/
+void ADC123_stream_stop(void)
+{
+	NVIC_DisableIRQ(DMA2_Stream0_IRQn);	// Disable DMA interrupt in the NVIC
+	DMA2_Stream0->CR &= ~DMA_SxCR_EN;	// Disable the DMA
+	while (DMA2_Stream0->CR & DMA_SxCR_EN) { ; }	// Wait for DMA to finish
+	DMA2->LIFCR |= DMA_LIFCR_CTCIF0;	// Clear transfer complete interrupt fl.
+	NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);// Clear pending DMA interrupt
+	TIM2->CR1 &= ~TIM_CR1_CEN;			// Disable timer
+	ADC1->CR2 &= ~ADC_CR2_ADON;			// Disable ADC1
+	ADC2->CR2 &= ~ADC_CR2_ADON;			// Disable ADC2
+	ADC3->CR2 &= ~ADC_CR2_ADON;			// Disable ADC3
+	ADC_reset();
+	DMA2_Stream0->CR &= ~DMA_SxCR_DBM;	// Back to single buffer mode
+	DMA2_Stream0->CR &= ~DMA_SxCR_CIRC;	// Back to normal mode
+	DMA2_Stream0->CR &= ~DMA_SxCR_HTIE;	// Disable half transfer interrupt
+	DMA2->LIFCR |= DMA_LIFCR_CHTIF0;	// Clear half transfer interrupt flag
+	if (MEAS_os_active) {
+		MEAS_timer_rate(ADC_FS);		// Trigger at the sampling freq. again
+		MEAS_os_active = false;
+	}
+	MEAS_streaming = false;
+#ifdef MEAS_SIMULATION
+	MEAS_sim_active = false;
+#endif
+}
+
+
+/** ***************************************************************************
+ * @brief Start DMA, ADCs and timer of the triple mode
+ *
+ * With MEAS_SIMULATION only the timer is started, its update interrupt
+ * paces the simulated conversions.
+ *****************************************************************************/
+void ADC123_triple_scan_start(void)
+{
+#ifdef MEAS_SIMULATION
+	MEAS_sim_count = 0;
+	MEAS_sim_active = true;
+	TIM2->CR1 |= TIM_CR1_CEN;			// Enable timer
+	return;
+#endif
+	DMA2_Stream0->CR |= DMA_SxCR_EN;	// Enable DMA
+	NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);	// Clear pending DMA interrupt
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);	// Enable DMA interrupt in the NVIC
+	ADC3->CR2 |= ADC_CR2_ADON;			// Enable ADC3 (slave)
+	ADC2->CR2 |= ADC_CR2_ADON;			// Enable ADC2 (slave)
+	ADC1->CR2 |= ADC_CR2_ADON;			// Enable ADC1 (master)
+	TIM2->CR1 |= TIM_CR1_CEN;			// Enable timer
 }
 
 
 /** ***************************************************************************
- * @brief Interrupt handler for the ADCs
+ * @brief Reserve the next free frame of the queue
+ * @return frame to be filled, NULL if the queue is full
  *
- * Reads one sample from the ADC3 DataRegister and transfers it to a buffer.
- * @n Stops when ADC_NUMS samples have been read.
+ * Called from the ISRs, which are the only producer. A full queue drops the
+ * new frame, the sequence number is still consumed so the gap is visible.
  *****************************************************************************/
-void ADC_IRQHandler(void)
+static MEAS_frame_t* MEAS_frame_reserve(void)
 {
-	if (ADC3->SR & ADC_SR_EOC) {		// Check if ADC3 end of conversion
-		ADC_samples[ADC_sample_count++] = ADC3->DR;	// Read input channel 1 only
-		if (ADC_sample_count >= ADC_NUMS) {		// Buffer full
+	uint32_t head = MEAS_queue_head;
+	MEAS_frame_t* frame;
+	if ((head - MEAS_queue_tail) >= MEAS_QUEUE_SIZE) {	// Main loop behind
+		MEAS_frames_dropped++;
+		MEAS_frame_count++;
+		return NULL;
+	}
+	frame = &MEAS_queue[head & MEAS_QUEUE_MASK];
+	frame->sequence = MEAS_frame_count++;
+	frame->continued = MEAS_streaming && (frame->sequence > 0);
+	return frame;
+}
+
+
+/** ***************************************************************************
+ * @brief Publish a frame filled after MEAS_frame_reserve()
+ *****************************************************************************/
+static void MEAS_frame_commit(MEAS_frame_t* frame)
+{
+	frame->tick = HAL_GetTick();
+	__DMB();							// Frame written before index moves
+	MEAS_queue_head++;
+	EVT_post(EVT_MEAS);					// Wake up the main loop
+}
+
+
+/** ***************************************************************************
+ * @brief Hand a completed triple mode frame to the main loop
+ * @param [in] triple mode frame
+ *****************************************************************************/
+static void MEAS_quad_complete(const uint16_t* samples)
+{
+	MEAS_frame_t* frame = MEAS_frame_reserve();
+	if (frame != NULL) {
+		PROF_BEGIN(PROF_MEAS_ANALYSE);
+		MEAS_analyse_quad(samples, frame);
+		PROF_END(PROF_MEAS_ANALYSE);
+		MEAS_frame_commit(frame);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Hand a completed dual mode or single ADC frame to the main loop
+ * @param [in] interleaved samples of both channels
+ *****************************************************************************/
+static void MEAS_data_complete(const uint16_t* samples)
+{
+	MEAS_frame_t* frame = MEAS_frame_reserve();
+	if (frame != NULL) {
+		PROF_BEGIN(PROF_MEAS_ANALYSE);
+		MEAS_analyse_data(samples, frame);
+		PROF_END(PROF_MEAS_ANALYSE);
+		MEAS_frame_commit(frame);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Take the oldest frame out of the queue
+ * @param [out] copy of the frame
+ * @return true if a frame was available
+ *
+ * Called from the main loop, which is the only consumer.
+ *****************************************************************************/
+bool MEAS_frame_read(MEAS_frame_t* frame)
+{
+	uint32_t tail = MEAS_queue_tail;
+	if (tail == MEAS_queue_head) {		// Queue empty
+		return false;
+	}
+	__DMB();							// Index read before frame
+	*frame = MEAS_queue[tail & MEAS_QUEUE_MASK];
+	__DMB();							// Frame copied before slot is freed
+	MEAS_queue_tail = tail + 1;
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Discard all frames in the queue
+ *
+ * Called from the main loop, e.g. after a stream was stopped.
+ *****************************************************************************/
+void MEAS_frame_flush(void)
+{
+	MEAS_queue_tail = MEAS_queue_head;
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt handler for the timer 2
+ *
+ * @note This interrupt handler was only used for debugging purposes
+ * and to increment the DAC value.
+ * @n With MEAS_SIMULATION it completes a simulated triple mode frame
+ * after ADC_NUMS triggers, like the DMA would.
+ *****************************************************************************/
+void TIM2_IRQHandler(void)
+{
+	TIM2->SR &= ~TIM_SR_UIF;			// Clear pending interrupt flag
+#ifdef MEAS_SIMULATION
+	if (MEAS_sim_active && (++MEAS_sim_count >= ADC_NUMS)) {
+		MEAS_sim_count = 0;
+		SIM_quad_frame(&SIM_scenario, ADC_quad_samples[0], ADC_NUMS,
+					   MEAS_stride, ADC_FS*MEAS_ratio);
+		if (!MEAS_streaming) {
 			TIM2->CR1 &= ~TIM_CR1_CEN;	// Disable timer
-			ADC3->CR2 &= ~ADC_CR2_ADON;	// Disable ADC3
-			ADC_reset();
-			MEAS_data_ready = true;
+			MEAS_sim_active = false;
 		}
-
+		MEAS_quad_complete(ADC_quad_samples[0]);
 	}
+#endif
 }
 
 
@@ -256,6 +771,7 @@ void ADC_IRQHandler(void)
  *****************************************************************************/
 void DMA2_Stream1_IRQHandler(void)
 {
+	PROF_BEGIN(PROF_MEAS_ISR);
 	if (DMA2->LISR & DMA_LISR_TCIF1) {	// Stream1 transfer compl. interrupt f.
 		NVIC_DisableIRQ(DMA2_Stream1_IRQn);	// Disable DMA interrupt in the NVIC
 		NVIC_ClearPendingIRQ(DMA2_Stream1_IRQn);// Clear pending DMA interrupt
@@ -266,93 +782,313 @@ void DMA2_Stream1_IRQHandler(void)
 		ADC3->CR2 &= ~ADC_CR2_ADON;		// Disable ADC3
 		ADC3->CR2 &= ~ADC_CR2_DMA;		// Disable DMA mode
 		ADC_reset();
-		MEAS_analyse_data();
-		MEAS_data_ready = true;
+		MEAS_data_complete(ADC_samples);
 	}
+	PROF_END(PROF_MEAS_ISR);
 }
 
+
 /** ***************************************************************************
- * @brief Analyse data to detect amplitude strength
+ * @brief Decimate one half of the oversampled triple mode buffer
+ * @param [in] DEC_BLOCK triggers
  *
- * Get 10 highest and lowest measurements, convert lowest values to highest,
- * calculate a mean and save the results.
+ * The decimated triggers are collected in ADC_quad_samples[0], a full frame
+ * is analysed and queued. A single scan is stopped after its first frame.
  *****************************************************************************/
-void MEAS_analyse_data(void)
+static void MEAS_os_block(const uint16_t* block)
 {
-	uint32_t buffer_left_channel[ADC_NUMS];
-	uint32_t buffer_right_channel[ADC_NUMS];
-	for (int i = 0; i < ADC_NUMS; ++i) {
-		buffer_left_channel[i] = ADC_samples[2*i];
-		buffer_right_channel[i] = ADC_samples[((2*i)+1)];
+	static const uint32_t offset[MEAS_WAVE_CHANNELS] = {
+		MEAS_QUAD_WPC_LEFT, MEAS_QUAD_WPC_RIGHT,
+		MEAS_QUAD_HALL_IN11, MEAS_QUAD_HALL_IN6
+	};
+	uint16_t out[MEAS_WAVE_CHANNELS][DEC_BLOCK/DEC_RATIO+1];
+	uint32_t channels = (MEAS_stride == MEAS_QUAD_STRIDE) ? 4 : 2;
+	uint32_t count = 0;
+
+	PROF_BEGIN(PROF_MEAS_DECIMATE);
+	for (uint32_t c = 0; c < channels; ++c) {
+		count = DEC_process(&MEAS_dec[c], &block[offset[c]], DEC_BLOCK,
+							MEAS_stride, out[c]);
 	}
+	PROF_END(PROF_MEAS_DECIMATE);
 
-	//sort arrays from low to high
-	uint32_t temp_left;
-	uint32_t temp_right;
-	for (int i = 0; i < ADC_NUMS; ++i) {
-		for (int j = i+1; j < ADC_NUMS; ++j) {
-			if (buffer_left_channel[i]>buffer_left_channel[j]) {
-				temp_left = buffer_left_channel[i];
-				buffer_left_channel[i]=buffer_left_channel[j];
-				buffer_left_channel[j]=temp_left;
-			}
-			if (buffer_right_channel[i]>buffer_right_channel[j]) {
-				temp_right = buffer_right_channel[i];
-				buffer_right_channel[i]=buffer_right_channel[j];
-				buffer_right_channel[j]=temp_right;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (MEAS_os_skip > 0) {			// Filters not settled yet
+			MEAS_os_skip--;
+			continue;
+		}
+		for (uint32_t c = 0; c < channels; ++c) {
+			ADC_quad_samples[0][(MEAS_stride*MEAS_os_count)+offset[c]] =
+				out[c][i];
+		}
+		if (++MEAS_os_count >= ADC_NUMS) {
+			MEAS_os_count = 0;
+			if (!MEAS_streaming) {		// Single scan done
+				ADC123_stream_stop();
+				MEAS_quad_complete(ADC_quad_samples[0]);
+				return;
 			}
+			MEAS_quad_complete(ADC_quad_samples[0]);
 		}
 	}
+}
 
 
-	uint32_t values_left[10];
-	uint32_t values_right[10];
-	//select 5 lowest values
-	for (int i = 0; i < 5; ++i) {
-		values_left[i]=buffer_left_channel[i];
-		values_right[i]=buffer_right_channel[i];
+/** ***************************************************************************
+ * @brief Interrupt handler for DMA2 Stream0
+ *
+ * The samples from the ADC1/2/3 triple mode have been transfered to memory
+ * by the DMA2 Stream0 and are ready for processing.
+ * @n While streaming, the DMA has already switched to the other buffer
+ * (CT bit), so the buffer not targeted is complete and analysed.
+ * @n Oversampled, the half and full transfer interrupts each hand one half
+ * of the circular buffer to the decimation.
+ *****************************************************************************/
+void DMA2_Stream0_IRQHandler(void)
+{
+	PROF_BEGIN(PROF_MEAS_ISR);
+	if (MEAS_os_active) {				// Oversampled, decimate each half
+		if (DMA2->LISR & DMA_LISR_HTIF0) {	// First half complete
+			DMA2->LIFCR |= DMA_LIFCR_CHTIF0;// Clear half transfer interrupt f.
+			MEAS_os_block(&ADC_os_samples[0]);
+		}
+		if (MEAS_os_active && (DMA2->LISR & DMA_LISR_TCIF0)) {	// Second half
+			DMA2->LIFCR |= DMA_LIFCR_CTCIF0;// Clear transfer complete interr. f.
+			MEAS_os_block(&ADC_os_samples[DEC_BLOCK*MEAS_stride]);
+		}
+	} else if ((DMA2->LISR & DMA_LISR_TCIF0) && MEAS_streaming) {
+		DMA2->LIFCR |= DMA_LIFCR_CTCIF0;// Clear transfer complete interrupt fl.
+		if (DMA2_Stream0->CR & DMA_SxCR_CT) {	// DMA is filling memory 1
+			MEAS_quad_complete(ADC_quad_samples[0]);
+		} else {								// DMA is filling memory 0
+			MEAS_quad_complete(ADC_quad_samples[1]);
+		}
+	} else if (DMA2->LISR & DMA_LISR_TCIF0) {	// Stream0 transfer complete
+		NVIC_DisableIRQ(DMA2_Stream0_IRQn);	// Disable DMA interrupt in the NVIC
+		NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);// Clear pending DMA interrupt
+		DMA2_Stream0->CR &= ~DMA_SxCR_EN;	// Disable the DMA
+		while (DMA2_Stream0->CR & DMA_SxCR_EN) { ; }	// Wait for DMA to finish
+		DMA2->LIFCR |= DMA_LIFCR_CTCIF0;// Clear transfer complete interrupt fl.
+		TIM2->CR1 &= ~TIM_CR1_CEN;		// Disable timer
+		ADC1->CR2 &= ~ADC_CR2_ADON;		// Disable ADC1
+		ADC2->CR2 &= ~ADC_CR2_ADON;		// Disable ADC2
+		ADC3->CR2 &= ~ADC_CR2_ADON;		// Disable ADC3
+		ADC_reset();
+		MEAS_quad_complete(ADC_quad_samples[0]);
 	}
+	PROF_END(PROF_MEAS_ISR);
+}
 
-	//select 5 highest values
-	for (int i = 0; i < 5; ++i) {
-		values_left[i+5]=buffer_left_channel[i+55];
-		values_right[i+5]=buffer_right_channel[i+55];
+/** ***************************************************************************
+ * @brief Calculate the amplitude of one channel
+ * @param [in] first sample of the channel
+ * @param [in] distance of two samples of the channel
+ * @return amplitude
+ *
+ * Get MEAS_PEAK_COUNT highest and lowest measurements, convert lowest values
+ * to highest and calculate a mean.
+ * @n The peaks are collected in a single pass with two small sorted lists
+ * instead of sorting the whole buffer, so the cost is linear in ADC_NUMS.
+ * As only the sums of the peaks are used, the result is identical to
+ * picking them from the fully sorted buffer.
+ *****************************************************************************/
+static uint32_t MEAS_peak_amplitude(const uint16_t* samples, uint32_t stride)
+{
+	uint32_t lows[MEAS_PEAK_COUNT];		// Ascending, largest at the end
+	uint32_t highs[MEAS_PEAK_COUNT];	// Ascending, smallest at the start
+	for (int i = 0; i < MEAS_PEAK_COUNT; ++i) {
+		lows[i] = UINT32_MAX;
+		highs[i] = 0;
 	}
 
-	//check if values mean around middle of ADC range
-	uint32_t check_sum_left = 0;
-	uint32_t check_sum_right = 0;
-	for (int i = 0; i < 10; ++i) {
-		check_sum_left += values_left[i];
-		check_sum_right += values_right[i];
+	for (int i = 0; i < ADC_NUMS; ++i) {
+		uint32_t value = samples[i*stride];
+		//insert into lowest values, dropping the largest one
+		if (value < lows[MEAS_PEAK_COUNT-1]) {
+			int j = MEAS_PEAK_COUNT-1;
+			while ((j > 0) && (lows[j-1] > value)) {
+				lows[j] = lows[j-1];
+				j--;
+			}
+			lows[j] = value;
+		}
+		//insert into highest values, dropping the smallest one
+		if (value > highs[0]) {
+			int j = 0;
+			while ((j < MEAS_PEAK_COUNT-1) && (highs[j+1] < value)) {
+				highs[j] = highs[j+1];
+				j++;
+			}
+			highs[j] = value;
+		}
 	}
-	check_sum_left = check_sum_left / 10;
-	check_sum_right = check_sum_right / 10;
 
-	//convert low values to high values
-	for (int i = 0; i < 5; ++i) {
-		values_left[i] = ADC_MAX_VALUE - values_left[i];
-		values_right[i] = ADC_MAX_VALUE - values_right[i];
+	//convert low values to high values and calculate mean of all values
+	uint32_t sum = 0;
+	for (int i = 0; i < MEAS_PEAK_COUNT; ++i) {
+		sum += ADC_MAX_VALUE - lows[i];
+		sum += highs[i];
 	}
+	sum = sum / (2*MEAS_PEAK_COUNT);
+
+	return sum-(ADC_MAX_VALUE/2);
+}
+
 
-	//calculate mean of all 10 values
-	uint32_t sum_left = 0;
-	uint32_t sum_right = 0;
-	for (int i = 0; i < 10; ++i) {
-		sum_left += values_left[i];
-		sum_right += values_right[i];
+/** ***************************************************************************
+ * @brief Calculate amplitude and phase of one channel with Goertzel
+ * @param [in] first sample of the channel
+ * @param [in] distance of two samples of the channel
+ * @param [in] constants of the frequency bin
+ * @param [out] phase of the bin relative to the first sample [rad]
+ * @return amplitude
+ *
+ * Evaluates a single DFT bin with the second order Goertzel recursion.
+ * @n The DC offset of the ADC inputs falls into bin 0 and does not leak
+ * into the mains bin as long as the frame spans whole periods.
+ * Harmonics and broadband noise are rejected by the bin selectivity,
+ * which makes the result steadier than the peak average.
+ * @n The amplitude 2*|X|/ADC_NUMS is in the same unit as the peak engine.
+ *****************************************************************************/
+static uint32_t MEAS_goertzel_amplitude(const uint16_t* samples,
+										uint32_t stride, const MEAS_bin_t* bin,
+										float* phase)
+{
+	float s0;
+	float s1 = 0;
+	float s2 = 0;
+	for (int i = 0; i < ADC_NUMS; ++i) {
+		s0 = (float)samples[i*stride] + bin->coeff*s1 - s2;
+		s2 = s1;
+		s1 = s0;
 	}
-	sum_left = sum_left / 10;
-	sum_right = sum_right / 10;
+	//one more step with zero input, then y = s(N) - exp(-jw)*s(N-1)
+	s0 = bin->coeff*s1 - s2;
+	float re = s0 - bin->cosine*s1;
+	float im = bin->sine*s1;
+	//rotate by exp(-jwN) to get the DFT bin X
+	float x[2];
+	x[0] = re*bin->cosineN + im*bin->sineN;
+	x[1] = im*bin->cosineN - re*bin->sineN;
 
-	MEAS_amplitude_left = sum_left-(ADC_MAX_VALUE/2);
-	MEAS_amplitude_right = sum_right-(ADC_MAX_VALUE/2);
+	float magnitude;
+	DSP_cmplx_mag_f32(x, &magnitude, 1);
+	*phase = atan2f(x[1], x[0]);
+	return (uint32_t)(2*magnitude/ADC_NUMS + 0.5f);
 }
 
 
+/** ***************************************************************************
+ * @brief Calculate the amplitude of one channel with the selected engine
+ * @param [in] first sample of the channel
+ * @param [in] distance of two samples of the channel
+ * @param [out] phase of the mains bin [rad], 0 for the peak engine
+ * @return amplitude
+ *
+ * The channel is read in place from the interleaved frame, no copy needed.
+ *****************************************************************************/
+static uint32_t MEAS_channel_amplitude(const uint16_t* samples,
+									   uint32_t stride, float* phase)
+{
+	if (MEAS_engine == MEAS_ENGINE_GOERTZEL) {
+		return MEAS_goertzel_amplitude(samples, stride, &MEAS_mains_bin,
+									   phase);
+	}
+	*phase = 0;
+	return MEAS_peak_amplitude(samples, stride);
+}
+
 
+/** ***************************************************************************
+ * @brief Resample one channel to the raw waveform of a frame
+ * @param [in] first sample of the channel
+ * @param [in] distance of two samples of the channel
+ * @param [out] wave of MEAS_WAVE_SAMPLES samples at MEAS_WAVE_RATE
+ *
+ * Every n-th sample is taken, MEAS_config_valid() makes the rate a
+ * multiple of MEAS_WAVE_RATE. A short frame is repeated from its start.
+ *****************************************************************************/
+static void MEAS_wave(const uint16_t* samples, uint32_t stride,
+					  uint16_t* wave)
+{
+	uint32_t step = ADC_FS/MEAS_WAVE_RATE;
+	uint32_t index = 0;
+	for (int i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+		wave[i] = samples[index*stride];
+		index += step;
+		if (index >= ADC_NUMS) {
+			index -= ADC_NUMS;
+		}
+	}
+}
 
 
+/** ***************************************************************************
+ * @brief Analyse data to detect amplitude strength
+ * @param [in] interleaved samples of both channels, one pair per trigger
+ * @param [out] frame receiving amplitudes and phases
+ *
+ * Calculate the amplitude of each channel from the interleaved samples.
+ *****************************************************************************/
+void MEAS_analyse_data(const uint16_t* samples, MEAS_frame_t* frame)
+{
+	MEAS_wave(&samples[0], MEAS_INPUT_COUNT, frame->wave[0]);
+	MEAS_wave(&samples[1], MEAS_INPUT_COUNT, frame->wave[1]);
+	for (int i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+		frame->wave[2][i] = 0;
+		frame->wave[3][i] = 0;
+	}
 
+	frame->amplitude_left = MEAS_channel_amplitude(&samples[0],
+												   MEAS_INPUT_COUNT,
+												   &frame->phase_left);
+	frame->amplitude_right = MEAS_channel_amplitude(&samples[1],
+													MEAS_INPUT_COUNT,
+													&frame->phase_right);
+	frame->amplitude_hall_in11 = 0;
+	frame->amplitude_hall_in6 = 0;
+	frame->phase_hall_in11 = 0;
+	frame->phase_hall_in6 = 0;
+}
 
 
+/** ***************************************************************************
+ * @brief Analyse data of the triple mode to detect amplitude strength
+ * @param [in] triple mode samples
+ * @param [out] frame receiving amplitudes and phases
+ *
+ * The wpc pair is taken from the first, the hall pair from the second
+ * conversion of each trigger. The hall pair is ordered like the results of
+ * ADC3_IN11_IN6_scan_init() so both acquisition paths are interchangeable.
+ * @n The wpc sequence has no hall conversions, their results are 0.
+ *****************************************************************************/
+void MEAS_analyse_quad(const uint16_t* samples, MEAS_frame_t* frame)
+{
+	const uint16_t* channel = &samples[MEAS_QUAD_WPC_LEFT];
+	frame->amplitude_left = MEAS_channel_amplitude(channel, MEAS_stride,
+												   &frame->phase_left);
+	MEAS_wave(channel, MEAS_stride, frame->wave[0]);	// Keep raw waveforms
+	channel = &samples[MEAS_QUAD_WPC_RIGHT];
+	frame->amplitude_right = MEAS_channel_amplitude(channel, MEAS_stride,
+													&frame->phase_right);
+	MEAS_wave(channel, MEAS_stride, frame->wave[1]);
+	if (MEAS_stride == MEAS_WPC_STRIDE) {	// No hall conversions
+		frame->amplitude_hall_in11 = 0;
+		frame->amplitude_hall_in6 = 0;
+		frame->phase_hall_in11 = 0;
+		frame->phase_hall_in6 = 0;
+		for (int i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+			frame->wave[2][i] = 0;
+			frame->wave[3][i] = 0;
+		}
+		return;
+	}
+	channel = &samples[MEAS_QUAD_HALL_IN11];
+	frame->amplitude_hall_in11 = MEAS_channel_amplitude(channel, MEAS_stride,
+														&frame->phase_hall_in11);
+	MEAS_wave(channel, MEAS_stride, frame->wave[2]);
+	channel = &samples[MEAS_QUAD_HALL_IN6];
+	frame->amplitude_hall_in6 = MEAS_channel_amplitude(channel, MEAS_stride,
+													   &frame->phase_hall_in6);
+	MEAS_wave(channel, MEAS_stride, frame->wave[3]);
+}
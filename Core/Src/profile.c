@@ -0,0 +1,202 @@
+/** ***************************************************************************
+ * @file
+ * @brief Run time probes based on the DWT cycle counter
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - PROF_BEGIN() and PROF_END() markers around code sections
+ * - Count, min, max, mean and a power of 2 histogram per probe
+ * - Report of all probes or of single ones as CSV
+ *
+ * The markers open a local variable, so begin and end of a probe have to
+ * be in the same scope. Every probe is recorded from one context only,
+ * either the main loop or one interrupt handler, so no locking is needed.
+ * @n On the target the counts are core clock cycles of the DWT. Host
+ * builds use the monotonic clock in nanoseconds instead, so host code
+ * can share the same instrumentation. PROF_CLOCK gives the counts per
+ * second.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+PROF_stat_t PROF_stats[PROF_COUNT];		///< Statistics of all probes
+
+/// Short probe names, at most 8 characters
+const char* const PROF_name[PROF_COUNT] = {
+		"Analyse", "Meas ISR", "Decim", "ANA", "GUI", "Touch"
+};
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start the cycle counter and reset the statistics
+ *
+ * The counter is not reset, it may be used by the idle accounting.
+ *****************************************************************************/
+void PROF_init(void)
+{
+#if defined(__arm__)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;	// Enable trace and DWT
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;// Enable cycle counter
+#endif
+	PROF_reset();
+}
+
+
+/** ***************************************************************************
+ * @brief Reset the statistics of all probes
+ *
+ *****************************************************************************/
+void PROF_reset(void)
+{
+	memset(PROF_stats, 0, sizeof(PROF_stats));
+	for (int i = 0; i < PROF_COUNT; ++i) {
+		PROF_stats[i].min = UINT32_MAX;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Record one run of a probe
+ * @param [in] probe
+ * @param [in] counts duration of the run
+ *
+ * Bin 0 holds runs below 2^PROF_BIN_FIRST counts, bin n the runs from
+ * 2^(PROF_BIN_FIRST+n-1) on. The last bin takes all longer runs.
+ *****************************************************************************/
+void PROF_record(PROF_probe_t probe, uint32_t counts)
+{
+	PROF_stat_t* stat = &PROF_stats[probe];
+	int32_t bin = 0;
+
+	stat->count++;
+	stat->sum += counts;
+	if (counts < stat->min) {
+		stat->min = counts;
+	}
+	if (counts > stat->max) {
+		stat->max = counts;
+	}
+	if (counts >= (1u << PROF_BIN_FIRST)) {
+		bin = 31 - __builtin_clz(counts) - PROF_BIN_FIRST + 1;
+		if (bin >= PROF_BINS) {
+			bin = PROF_BINS-1;
+		}
+	}
+	stat->histogram[bin]++;
+}
+
+
+/** ***************************************************************************
+ * @brief Convert counts to microseconds
+ * @param [in] counts
+ * @return microseconds
+ *****************************************************************************/
+float PROF_us(uint32_t counts)
+{
+	return counts / (PROF_CLOCK / 1000000.0f);
+}
+
+
+/** ***************************************************************************
+ * @brief Mean run time of a probe
+ * @param [in] probe
+ * @return microseconds, 0 without runs
+ *****************************************************************************/
+float PROF_mean_us(PROF_probe_t probe)
+{
+	PROF_stat_t* stat = &PROF_stats[probe];
+	if (stat->count == 0) {
+		return 0;
+	}
+	return ((float)stat->sum / stat->count) / (PROF_CLOCK / 1000000.0f);
+}
+
+
+/** ***************************************************************************
+ * @brief Write the CSV header line
+ * @param [out] buffer
+ * @param [in] size of the buffer
+ * @return characters written without the terminating 0
+ *****************************************************************************/
+uint32_t PROF_csv_header(char* buffer, uint32_t size)
+{
+	uint32_t length = 0;
+
+	length += snprintf(buffer, size, "probe,count,min_us,mean_us,max_us");
+	for (int b = 0; (b < PROF_BINS) && (length < size); ++b) {
+		length += snprintf(&buffer[length], size-length, ",bin%d", b);
+	}
+	if (length < size) {
+		length += snprintf(&buffer[length], size-length, "\n");
+	}
+	return (length < size) ? length : size-1;
+}
+
+
+/** ***************************************************************************
+ * @brief Write the CSV line of one probe
+ * @param [in] probe
+ * @param [in] name in the first column
+ * @param [out] buffer
+ * @param [in] size of the buffer
+ * @return characters written without the terminating 0
+ *
+ * The host benchmarks reuse the probes for their own code and name the
+ * lines after it.
+ *****************************************************************************/
+uint32_t PROF_csv_probe(PROF_probe_t probe, const char* name, char* buffer,
+						uint32_t size)
+{
+	PROF_stat_t* stat = &PROF_stats[probe];
+	uint32_t min = (stat->count > 0) ? stat->min : 0;
+	uint32_t length = 0;
+
+	length += snprintf(buffer, size, "%s,%lu,%.2f,%.2f,%.2f", name,
+			(unsigned long)stat->count, PROF_us(min), PROF_mean_us(probe),
+			PROF_us(stat->max));
+	for (int b = 0; (b < PROF_BINS) && (length < size); ++b) {
+		length += snprintf(&buffer[length], size-length, ",%lu",
+						   (unsigned long)stat->histogram[b]);
+	}
+	if (length < size) {
+		length += snprintf(&buffer[length], size-length, "\n");
+	}
+	return (length < size) ? length : size-1;
+}
+
+
+/** ***************************************************************************
+ * @brief Write the statistics of all probes as CSV
+ * @param [out] buffer
+ * @param [in] size of the buffer
+ * @return characters written without the terminating 0
+ *
+ * One header line and one line per probe, times in microseconds.
+ * Output that does not fit into the buffer is cut off.
+ *****************************************************************************/
+uint32_t PROF_csv(char* buffer, uint32_t size)
+{
+	uint32_t length = PROF_csv_header(buffer, size);
+
+	for (int i = 0; (i < PROF_COUNT) && (length+1 < size); ++i) {
+		length += PROF_csv_probe((PROF_probe_t)i, PROF_name[i],
+								 &buffer[length], size-length);
+	}
+	return length;
+}
@@ -18,6 +18,7 @@
 #include "stm32f429i_discovery.h"
 
 #include "pushbutton.h"
+#include "events.h"
 
 
 /******************************************************************************
@@ -88,6 +89,7 @@ void EXTI0_IRQHandler(void)
 	if (EXTI->PR & EXTI_PR_PR0) {		// Check if interrupt on line 0
 		EXTI->PR |= EXTI_PR_PR0;		// Clear pending interrupt on line 0
 		PB_pressed_flag = true;			// Set flag
+		EVT_post(EVT_BUTTON);			// Wake up the main loop
 	}
 }
 
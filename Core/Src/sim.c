@@ -0,0 +1,198 @@
+/** ***************************************************************************
+ * @file
+ * @brief Cable field simulator generating wpc and hall sample frames
+ *
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Sensor amplitudes for cable type, distance, angle and load current
+ * - Interleaved sample frames in the layout of the triple ADC mode
+ * - Harmonic content and gaussian noise
+ * - Mains frequency drifting at a constant rate
+ *
+ * The wpc amplitudes follow the distance LUTs measured for each mode
+ * (CALC_wpcLeft, CALC_wpcRight).
+ * @n The hall amplitudes are derived from the magnetic field of the cable,
+ * B = I/(CALC_PIDANDPERM*r) for a single conductor, converted to digits
+ * with the same gains as CALC_ElCurrent(). In LN and LNPE cables the
+ * return current in N cancels most of the field, which leaves the field
+ * of a conductor pair with spacing SIM_CONDUCTOR_SPACING.
+ * @n The angle moves the cable closer to one of the sensors, which are
+ * SIM_SENSOR_SPACING apart.
+ *
+ * The generator does not access any peripheral. With MEAS_SIMULATION
+ * defined in measuring.h it replaces the ADC inputs, so measuring,
+ * analytics and GUI can be exercised without a cable.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "math.h"
+
+#include "sim.h"
+#include "analytics.h"
+#include "measuring.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define SIM_PI					3.14159265358979f	///< Pi
+#define SIM_ADC_OFFSET			2048	///< ADC value of a 0V signal
+#define SIM_ADC_MAX				4095	///< Maximum value of ADC output
+#define SIM_SENSOR_SPACING		40.0f	///< Distance left to right sensor [mm]
+#define SIM_CONDUCTOR_SPACING	5.0f	///< Distance of L and N in cable [mm]
+#define SIM_MIN_RADIUS			5.0f	///< Closest sensor to conductor [mm]
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+/// Scenario used in simulation mode
+SIM_scenario_t SIM_scenario = {0, 50.0f, 0.0f, 5.0f, 50.0f, 0.05f, 3.0f, 0.0f};
+
+static float SIM_phase = 0;				///< Phase of the next sample [rad]
+static float SIM_drifted = 0;			///< Frequency change by drift [Hz]
+static uint32_t SIM_random = 2463534242;///< State of the noise generator
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Restart time and noise of the simulation
+ * @param [in] seed of the noise generator, not 0
+ *****************************************************************************/
+void SIM_reset(uint32_t seed)
+{
+	SIM_phase = 0;
+	SIM_drifted = 0;
+	SIM_random = seed;
+}
+
+
+/** ***************************************************************************
+ * @brief Gaussian noise sample
+ * @return noise with standard deviation 1
+ *
+ * Sum of four uniform xorshift values, close enough to gaussian for noise.
+ *****************************************************************************/
+static float SIM_gauss(void)
+{
+	float sum = 0;
+	for (int i = 0; i < 4; ++i) {
+		SIM_random ^= SIM_random << 13;
+		SIM_random ^= SIM_random >> 17;
+		SIM_random ^= SIM_random << 5;
+		sum += (float)SIM_random / 4294967296.0f;
+	}
+	return (sum - 2.0f) * 1.7320508f;	// Variance of the sum is 4/12
+}
+
+
+/** ***************************************************************************
+ * @brief Wpc strength at a distance, inverse of CALC_Distance()
+ * @param [in] strength LUT
+ * @param [in] distance [mm]
+ * @return strength
+ *****************************************************************************/
+static float SIM_wpc_strength(const float* lut, float distance)
+{
+	if (distance <= CALC_distanceLUT[0]) {
+		return lut[0];
+	}
+	for (int i = 1; i < CALC_LUTSIZE; ++i) {
+		if (distance <= CALC_distanceLUT[i]) {
+			float a = (distance - CALC_distanceLUT[i-1])
+					/ (CALC_distanceLUT[i] - CALC_distanceLUT[i-1]);
+			return lut[i-1] + a*(lut[i] - lut[i-1]);
+		}
+	}
+	return lut[CALC_LUTSIZE-1];
+}
+
+
+/** ***************************************************************************
+ * @brief Hall amplitude at a distance
+ * @param [in] cable type
+ * @param [in] load current [A]
+ * @param [in] distance [mm]
+ * @return amplitude [digits]
+ *****************************************************************************/
+static float SIM_hall_amplitude(uint16_t mode, float current, float distance)
+{
+	float r = distance + SIM_MIN_RADIUS;
+	float B;
+	if (mode == 0) {
+		B = current / (CALC_PIDANDPERM * (r/1000));
+	} else {
+		B = current * (SIM_CONDUCTOR_SPACING/1000)
+		  / (CALC_PIDANDPERM * (r/1000) * (r/1000));
+	}
+	return (B*CALC_AMPHALLSENS*CALC_AMPOPAMP) / CALC_ADCVOLTRESOLUTION;
+}
+
+
+/** ***************************************************************************
+ * @brief Sensor amplitudes of a scenario
+ * @param [in] scenario
+ * @param [out] SIM_SENSORS amplitudes [digits], ordered like SIM_sensor_t
+ *****************************************************************************/
+void SIM_amplitudes(const SIM_scenario_t* scenario, float* amplitudes)
+{
+	float shift = (SIM_SENSOR_SPACING/2) * sinf(scenario->angle*SIM_PI/180);
+	float left = fmaxf(scenario->distance + shift, 0);
+	float right = fmaxf(scenario->distance - shift, 0);
+	uint16_t mode = scenario->mode;
+
+	amplitudes[SIM_WPC_LEFT] = SIM_wpc_strength(CALC_wpcLeft[mode], left);
+	amplitudes[SIM_WPC_RIGHT] = SIM_wpc_strength(CALC_wpcRight[mode], right);
+	amplitudes[SIM_HALL_IN11] = SIM_hall_amplitude(mode, scenario->current,
+												   right);
+	amplitudes[SIM_HALL_IN6] = SIM_hall_amplitude(mode, scenario->current,
+												  left);
+}
+
+
+/** ***************************************************************************
+ * @brief Generate an interleaved frame in the layout of the triple mode
+ * @param [in] scenario
+ * @param [out] frame of count*stride samples
+ * @param [in] number of triggers in the frame
+ * @param [in] conversions per trigger, MEAS_QUAD_STRIDE or less
+ * @param [in] sampling frequency [Hz]
+ *
+ * Consecutive frames continue the waveforms without phase jumps. The
+ * mains frequency changes by the drift of the scenario after each frame.
+ * Samples are clipped to the ADC range like the real inputs.
+ *****************************************************************************/
+void SIM_quad_frame(const SIM_scenario_t* scenario, uint16_t* frame,
+					uint32_t count, uint32_t stride, float fs)
+{
+	static const uint8_t slots[MEAS_QUAD_STRIDE] = {
+			SIM_WPC_LEFT, SIM_HALL_IN11, SIM_WPC_RIGHT,		// First conversion
+			SIM_WPC_LEFT, SIM_HALL_IN11, SIM_HALL_IN6		// Second conversion
+	};
+	float amplitudes[SIM_SENSORS];
+	SIM_amplitudes(scenario, amplitudes);
+	float w = 2*SIM_PI*(scenario->frequency + SIM_drifted)/fs;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		float wave = sinf(SIM_phase) + scenario->harmonic*sinf(3*SIM_phase);
+		for (uint32_t j = 0; j < stride; ++j) {
+			float value = SIM_ADC_OFFSET + amplitudes[slots[j]]*wave
+						+ scenario->noise*SIM_gauss();
+			value = fminf(fmaxf(value, 0), SIM_ADC_MAX);
+			frame[(stride*i)+j] = (uint16_t)(value + 0.5f);
+		}
+		SIM_phase += w;
+		if (SIM_phase >= 2*SIM_PI) {	// Keep phase small for precision
+			SIM_phase -= 2*SIM_PI;
+		}
+	}
+	SIM_drifted += scenario->drift*count/fs;
+}
@@ -28,6 +28,10 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_it.h"
 #include "stm32f4xx_hal.h"
+#include "events.h"
+
+/* Variables -----------------------------------------------------------------*/
+extern I2C_HandleTypeDef I2cHandle;		// Touch controller bus of the BSP
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -138,6 +142,7 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
 	HAL_IncTick();
+	EVT_tick();
 }
 
 
@@ -148,6 +153,24 @@ void SysTick_Handler(void)
 /*  file (startup_stm32f40xx.s/startup_stm32f427x.s/startup_stm32f429x.s).    */
 /******************************************************************************/
 
-/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
+/**
+ * @brief  This function handles the I2C3 event interrupt.
+ * @param  None
+ * @retval None
+ */
+void I2C3_EV_IRQHandler(void)
+{
+	HAL_I2C_EV_IRQHandler(&I2cHandle);
+}
 
+/**
+ * @brief  This function handles the I2C3 error interrupt.
+ * @param  None
+ * @retval None
+ */
+void I2C3_ER_IRQHandler(void)
+{
+	HAL_I2C_ER_IRQHandler(&I2cHandle);
+}
 
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
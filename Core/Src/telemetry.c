@@ -0,0 +1,248 @@
+/** ***************************************************************************
+ * @file
+ * @brief Binary telemetry over USART1 with DMA
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - USART1 on PA9 to the virtual COM port of the ST-LINK
+ * - Transmit ring sent by DMA2 Stream7, the main loop never waits
+ * - Framed messages with CRC for measurement frames, results, raw samples
+ *   and the profile report
+ *
+ * Message layout, multi byte fields little endian:
+ * | Bytes | Content                                                 |
+ * |-------|---------------------------------------------------------|
+ * | 2     | TEL_SYNC0, TEL_SYNC1                                    |
+ * | 1     | type, see TEL_msg_t                                     |
+ * | 2     | payload length                                          |
+ * | n     | payload                                                 |
+ * | 2     | CRC-16/CCITT (0x1021, start 0xFFFF) of type to payload  |
+ *
+ * A message that does not fit into the ring is dropped completely and
+ * counted in TEL_dropped, so the stream never holds partial messages.
+ * @n Messages are queued by the main loop only. The DMA sends the ring up
+ * to its end or up to the last queued byte and restarts from the transfer
+ * complete interrupt. The decoder on the host is Tools/tel_decode.py.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+
+#include "stm32f4xx.h"
+
+#include "telemetry.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEL_MASK		(TEL_BUFFER_SIZE-1)	///< Index mask of the ring
+#define TEL_OVERHEAD	7					///< Sync, type, length and CRC
+#define TEL_APB2_CLOCK	84000000			///< Clock of USART1
+#define TEL_TEXT_SIZE	1024				///< Longest text message
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+uint32_t TEL_dropped = 0;				///< Messages dropped on a full ring
+uint32_t TEL_bytes = 0;					///< Bytes queued for transmission
+
+static uint8_t TEL_buffer[TEL_BUFFER_SIZE];	///< Transmit ring
+static volatile uint32_t TEL_head = 0;	///< Next byte to write, main loop
+static volatile uint32_t TEL_tail = 0;	///< Next byte to send, DMA interrupt
+static volatile uint32_t TEL_chunk = 0;	///< Bytes in the DMA, 0 if idle
+static uint32_t TEL_ticks = 0;			///< Ticks since last profile report
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Configure USART1 and its transmit DMA
+ *
+ * PA9 is USART1_TX (AF7), DMA2 Stream7 channel 4 is USART1_TX.
+ *****************************************************************************/
+void TEL_init(void)
+{
+	__HAL_RCC_GPIOA_CLK_ENABLE();		// Enable clock for GPIO port A
+	__HAL_RCC_USART1_CLK_ENABLE();		// Enable clock for USART1
+	__HAL_RCC_DMA2_CLK_ENABLE();		// Enable clock for DMA2
+	GPIOA->MODER &= ~GPIO_MODER_MODER9_Msk;
+	GPIOA->MODER |= (2u << GPIO_MODER_MODER9_Pos);	// PA9 alternate function
+	GPIOA->OSPEEDR |= (2u << GPIO_OSPEEDR_OSPEED9_Pos);	// High speed
+	GPIOA->AFR[1] &= ~GPIO_AFRH_AFSEL9_Msk;
+	GPIOA->AFR[1] |= (7u << GPIO_AFRH_AFSEL9_Pos);	// AF7 = USART1
+
+	USART1->CR1 = 0;					// Disable while configuring
+	USART1->BRR = (TEL_APB2_CLOCK + TEL_BAUDRATE/2) / TEL_BAUDRATE;
+	USART1->CR3 = USART_CR3_DMAT;		// Transmit by DMA
+	USART1->CR1 = USART_CR1_UE | USART_CR1_TE;	// Enable, transmitter only
+
+	DMA2_Stream7->CR = 0;				// Disable while configuring
+	while (DMA2_Stream7->CR & DMA_SxCR_EN) { ; }	// Wait for DMA to stop
+	DMA2_Stream7->CR = (4u << DMA_SxCR_CHSEL_Pos)	// Channel 4 = USART1_TX
+					 | DMA_SxCR_MINC	// Increment memory address
+					 | DMA_SxCR_DIR_0	// Memory to peripheral
+					 | DMA_SxCR_TCIE;	// Transfer complete interrupt
+	DMA2_Stream7->PAR = (uint32_t)&USART1->DR;	// Peripheral address
+	DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7
+				| DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;	// Clear flags
+
+	TEL_head = 0;
+	TEL_tail = 0;
+	TEL_chunk = 0;
+	NVIC_ClearPendingIRQ(DMA2_Stream7_IRQn);	// Clear pending DMA interrupt
+	NVIC_EnableIRQ(DMA2_Stream7_IRQn);	// Enable DMA interrupt in the NVIC
+}
+
+
+/** ***************************************************************************
+ * @brief Start the DMA for the queued bytes if it is idle
+ *
+ * Called with the DMA interrupt masked or from the DMA interrupt itself.
+ *****************************************************************************/
+static void TEL_start(void)
+{
+	uint32_t tail = TEL_tail & TEL_MASK;
+	uint32_t count = TEL_head - TEL_tail;
+	if ((TEL_chunk != 0) || (count == 0)) {
+		return;
+	}
+	if (count > TEL_BUFFER_SIZE - tail) {	// Send up to the end of the ring
+		count = TEL_BUFFER_SIZE - tail;
+	}
+	TEL_chunk = count;
+	DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7
+				| DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;	// Clear flags
+	DMA2_Stream7->M0AR = (uint32_t)&TEL_buffer[tail];	// Memory address
+	DMA2_Stream7->NDTR = count;			// Number of bytes to transfer
+	DMA2_Stream7->CR |= DMA_SxCR_EN;	// Enable the DMA
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt handler for DMA2 Stream7, transfer to USART1 complete
+ *
+ *****************************************************************************/
+void DMA2_Stream7_IRQHandler(void)
+{
+	if (DMA2->HISR & DMA_HISR_TCIF7) {
+		DMA2->HIFCR = DMA_HIFCR_CTCIF7;	// Clear transfer complete flag
+		TEL_tail += TEL_chunk;
+		TEL_chunk = 0;
+		TEL_start();					// Continue with bytes queued meanwhile
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Update a CRC-16/CCITT with one byte
+ * @param [in] crc so far
+ * @param [in] byte
+ * @return updated crc
+ *****************************************************************************/
+static uint16_t TEL_crc(uint16_t crc, uint8_t byte)
+{
+	crc ^= (uint16_t)byte << 8;
+	for (int i = 0; i < 8; ++i) {
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	}
+	return crc;
+}
+
+
+/** ***************************************************************************
+ * @brief Queue one message for transmission
+ * @param [in] message type
+ * @param [in] payload
+ * @param [in] payload length
+ * @return false if the message was dropped on a full ring
+ *****************************************************************************/
+bool TEL_send(TEL_msg_t type, const void* payload, uint16_t length)
+{
+	const uint8_t* data = (const uint8_t*)payload;
+	uint32_t head = TEL_head;
+	uint32_t size = (uint32_t)length + TEL_OVERHEAD;
+	uint16_t crc = 0xFFFF;
+	uint8_t header[5] = {TEL_SYNC0, TEL_SYNC1, (uint8_t)type,
+						 (uint8_t)length, (uint8_t)(length >> 8)};
+
+	if ((TEL_BUFFER_SIZE - (head - TEL_tail)) < size) {
+		TEL_dropped++;
+		return false;
+	}
+	for (int i = 0; i < 5; ++i) {
+		TEL_buffer[head++ & TEL_MASK] = header[i];
+		if (i >= 2) {
+			crc = TEL_crc(crc, header[i]);
+		}
+	}
+	for (uint32_t i = 0; i < length; ++i) {
+		TEL_buffer[head++ & TEL_MASK] = data[i];
+		crc = TEL_crc(crc, data[i]);
+	}
+	TEL_buffer[head++ & TEL_MASK] = (uint8_t)crc;
+	TEL_buffer[head++ & TEL_MASK] = (uint8_t)(crc >> 8);
+	TEL_bytes += size;
+
+	__DMB();							// Message written before index moves
+	NVIC_DisableIRQ(DMA2_Stream7_IRQn);	// DMA interrupt also starts the DMA
+	TEL_head = head;
+	TEL_start();
+	NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Send a measurement frame, with its raw samples if TEL_WAVES
+ * @param [in] frame
+ *****************************************************************************/
+void TEL_frame(const MEAS_frame_t* frame)
+{
+	TEL_frame_msg_t msg;
+	msg.sequence = frame->sequence;
+	msg.tick = frame->tick;
+	msg.amplitude[0] = frame->amplitude_left;
+	msg.amplitude[1] = frame->amplitude_right;
+	msg.amplitude[2] = frame->amplitude_hall_in6;
+	msg.amplitude[3] = frame->amplitude_hall_in11;
+	TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg));
+#ifdef TEL_WAVES
+	static TEL_wave_msg_t wave;			// Too large for the stack
+	wave.sequence = frame->sequence;
+	memcpy(wave.wave, frame->wave, sizeof(wave.wave));
+	TEL_send(TEL_MSG_WAVE, &wave, sizeof(wave));
+#endif
+}
+
+
+/** ***************************************************************************
+ * @brief Send an analysed result
+ * @param [in] result
+ *****************************************************************************/
+void TEL_result(const TEL_result_msg_t* result)
+{
+	TEL_send(TEL_MSG_RESULT, result, sizeof(*result));
+}
+
+
+/** ***************************************************************************
+ * @brief Count one tick, sends the profile report every TEL_PROFILE_TICKS
+ *
+ *****************************************************************************/
+void TEL_tick(void)
+{
+	static char text[TEL_TEXT_SIZE];
+	if (++TEL_ticks >= TEL_PROFILE_TICKS) {
+		TEL_ticks = 0;
+		TEL_send(TEL_MSG_TEXT, text, PROF_csv(text, sizeof(text)));
+	}
+}
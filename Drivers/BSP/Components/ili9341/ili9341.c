@@ -173,7 +173,8 @@ void ili9341_Init(void)
   ili9341_WriteData(0xC2);
   ili9341_WriteReg(LCD_DFC);
   ili9341_WriteData(0x0A);
-  ili9341_WriteData(0xA7);
+  /* GS=1, SS=0: gate and source scan reversed, display rotated by 180° */
+  ili9341_WriteData(0xC7);
   ili9341_WriteData(0x27);
   ili9341_WriteData(0x04);
   
@@ -0,0 +1,304 @@
+/** ***************************************************************************
+ * @file
+ * @brief Frequency response, SNR gain and run time of the decimation
+ *
+ * Sines of 2000 digits around mid scale are sampled at DEC_RATIO times the
+ * standard rate of 600 Hz and decimated by DEC_process(). The amplitude of
+ * the output at the frequency the input appears at, after folding by the
+ * output rate, gives the response:
+ * - passband up to 1/3 of the output rate, flat within 0.1 dB
+ * - 2/3 to 4/3 of the output rate, the FIR stopband, at least 60 dB down
+ * - everything else that folds into the passband, up to the input Nyquist
+ *   frequency, at least 40 dB down. Least at 1000 Hz, where the FIR passes
+ *   again and only the CIC attenuates.
+ *
+ * The SNR gain repeats the model of Tools/dec_design.py: mains with a 3rd
+ * harmonic, an interferer at 650 Hz and noise of 20 digits rms. The
+ * amplitude of the mains bin of one frame is compared for direct sampling
+ * at 600 Hz and for the decimated oversampled input.
+ * @n The run time is that of one DMA half block of the triple mode, four
+ * channels interleaved like in the firmware. It is measured with the
+ * "Decim" probe, as on the debug site of the target, and its statistics
+ * are printed as CSV.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+
+#include "unit.h"
+#include "decimate.h"
+#include "measuring.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define BENCH_PI		3.14159265358979	///< Pi
+#define BENCH_RATE		600				///< Output rate [Hz], standard preset
+#define BENCH_IN_RATE	(BENCH_RATE*DEC_RATIO)	///< Input rate [Hz]
+#define BENCH_MID		2048			///< Mid scale of the ADC
+#define BENCH_AMPLITUDE	2000			///< Amplitude of the test sines
+#define BENCH_OUT		BENCH_RATE		///< Outputs analysed, 1 s
+#define BENCH_STEP		5				///< Step of the sweep [Hz]
+#define BENCH_PASS		(BENCH_RATE/3)	///< Passband edge [Hz]
+#define BENCH_STOP		(2*BENCH_RATE/3)	///< FIR stopband edge [Hz]
+#define BENCH_MAINS		50				///< Mains frequency [Hz]
+#define BENCH_SAMPLES	60				///< Samples of a frame
+#define BENCH_TRIALS	400				///< Frames of the SNR model
+#define BENCH_BLOCKS	20000			///< Half blocks timed
+#define BENCH_CHANNELS	4				///< Channels of the triple mode
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t BENCH_input[DEC_BLOCK];	///< One block of one channel
+/// Decimated samples, with room for the outputs of the last block
+static uint16_t BENCH_output[DEC_SETTLE+BENCH_OUT+DEC_BLOCK/DEC_RATIO+1];
+/// Two halves of the triple mode buffer
+static uint16_t BENCH_quad[2][MEAS_QUAD_STRIDE*DEC_BLOCK];
+static volatile uint16_t BENCH_sink;	///< Keeps results alive
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Frequency an input appears at after decimation
+ * @param [in] frequency of the input [Hz]
+ * @return alias in 0 to half the output rate [Hz]
+ *****************************************************************************/
+static double BENCH_alias(double frequency)
+{
+	double alias = fmod(frequency, BENCH_RATE);
+	return fmin(alias, BENCH_RATE - alias);
+}
+
+
+/** ***************************************************************************
+ * @brief Amplitude of one frequency in a block of samples
+ * @param [in] samples
+ * @param [in] count of samples
+ * @param [in] frequency [Hz]
+ * @param [in] rate of the samples [Hz]
+ * @return amplitude [digits]
+ *
+ * The block has to span whole periods of the frequency.
+ *****************************************************************************/
+static double BENCH_amplitude(const uint16_t* samples, uint32_t count,
+							  double frequency, double rate)
+{
+	double re = 0, im = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		double w = 2*BENCH_PI*frequency*i/rate;
+		re += samples[i]*cos(w);
+		im += samples[i]*sin(w);
+	}
+	return 2*hypot(re, im)/count;
+}
+
+
+/** ***************************************************************************
+ * @brief Gain of the decimation for a sine
+ * @param [in] frequency of the input [Hz], not a multiple of BENCH_RATE
+ * @return gain [dB]
+ *****************************************************************************/
+static double BENCH_gain(double frequency)
+{
+	DEC_t dec;
+	uint32_t produced = 0;
+	uint32_t n = 0;
+
+	DEC_init(&dec);
+	while (produced < DEC_SETTLE + BENCH_OUT) {
+		for (uint32_t i = 0; i < DEC_BLOCK; ++i, ++n) {
+			double t = (double)n/BENCH_IN_RATE;
+			BENCH_input[i] = (uint16_t)lround(BENCH_MID + BENCH_AMPLITUDE
+										* sin(2*BENCH_PI*frequency*t + 0.3));
+		}
+		produced += DEC_process(&dec, BENCH_input, DEC_BLOCK, 1,
+								&BENCH_output[produced]);
+	}
+	double amplitude = BENCH_amplitude(&BENCH_output[DEC_SETTLE], BENCH_OUT,
+									   BENCH_alias(frequency), BENCH_RATE);
+	return 20*log10(amplitude/BENCH_AMPLITUDE + 1e-12);
+}
+
+
+/** ***************************************************************************
+ * @brief Normal distributed noise, Box-Muller
+ * @return sample with standard deviation 1
+ *****************************************************************************/
+static double BENCH_gauss(void)
+{
+	double u = (rand() + 1.0)/(RAND_MAX + 2.0);
+	double v = (rand() + 1.0)/(RAND_MAX + 2.0);
+	return sqrt(-2*log(u))*cos(2*BENCH_PI*v);
+}
+
+
+/** ***************************************************************************
+ * @brief Noisy ADC sample of the model of Tools/dec_design.py
+ * @param [in] t time [s]
+ * @param [in] phase of the mains [rad]
+ * @return ADC value
+ *
+ * Mains of 300 digits, 3rd harmonic, interferer at BENCH_RATE+BENCH_MAINS
+ * and 20 digits rms noise.
+ *****************************************************************************/
+static uint16_t BENCH_model(double t, double phase)
+{
+	double w = 2*BENCH_PI*BENCH_MAINS;
+	double value = BENCH_MID + 300*sin(w*t + phase)
+				 + 60*sin(3*w*t + 2*phase)
+				 + 90*sin(2*BENCH_PI*(BENCH_RATE + BENCH_MAINS)*t)
+				 + 20*BENCH_gauss();
+	return (uint16_t)fmin(fmax(lround(value), 0), 4095);
+}
+
+
+/** ***************************************************************************
+ * @brief Response in the pass- and stopband
+ *****************************************************************************/
+static void test_response(void)
+{
+	double ripple = 0;
+	double fir = -INFINITY;
+	double fold = -INFINITY;
+	double foldAt = 0;
+
+	for (int f = BENCH_STEP; f <= BENCH_PASS; f += BENCH_STEP) {
+		ripple = fmax(ripple, fabs(BENCH_gain(f)));
+	}
+	for (int f = BENCH_STOP; f <= BENCH_IN_RATE/2; f += BENCH_STEP) {
+		if ((BENCH_alias(f) > BENCH_PASS) || (f % BENCH_RATE == 0)) {
+			continue;					// Not in the passband, or at DC
+		}
+		double gain = BENCH_gain(f);
+		if (f <= 2*BENCH_STOP) {
+			fir = fmax(fir, gain);
+		} else if (gain > fold) {
+			fold = gain;
+			foldAt = f;
+		}
+	}
+	printf("  passband 0-%d Hz:       ripple %5.2f dB\n", BENCH_PASS, ripple);
+	printf("  FIR stopband %d-%d Hz: %6.1f dB\n", BENCH_STOP, 2*BENCH_STOP,
+		   fir);
+	printf("  folding into passband:  %6.1f dB at %.0f Hz\n", fold, foldAt);
+	CHECK(ripple <= 0.1);
+	CHECK(fir <= -60);
+	CHECK(fold <= -40);
+}
+
+
+/** ***************************************************************************
+ * @brief Error of the mains amplitude, direct and oversampled
+ *****************************************************************************/
+static void test_snr(void)
+{
+	uint16_t direct[BENCH_SAMPLES];
+	double gain = pow(10, BENCH_gain(BENCH_MAINS)/20);
+	double errorDirect = 0, errorOs = 0;
+
+	srand(1);
+	for (int trial = 0; trial < BENCH_TRIALS; ++trial) {
+		double phase = 2*BENCH_PI*rand()/RAND_MAX;
+		double start = (double)rand()/RAND_MAX;
+		DEC_t dec;
+		uint32_t produced = 0;
+		uint32_t n = 0;
+
+		for (int i = 0; i < BENCH_SAMPLES; ++i) {
+			direct[i] = BENCH_model(start + (double)i/BENCH_RATE, phase);
+		}
+		double a = BENCH_amplitude(direct, BENCH_SAMPLES, BENCH_MAINS,
+								   BENCH_RATE) - 300;
+		errorDirect += a*a;
+
+		DEC_init(&dec);
+		while (produced < DEC_SETTLE + BENCH_SAMPLES) {
+			for (uint32_t i = 0; i < DEC_BLOCK; ++i, ++n) {
+				BENCH_input[i] = BENCH_model(start + (double)n/BENCH_IN_RATE,
+											 phase);
+			}
+			produced += DEC_process(&dec, BENCH_input, DEC_BLOCK, 1,
+									&BENCH_output[produced]);
+		}
+		a = BENCH_amplitude(&BENCH_output[DEC_SETTLE], BENCH_SAMPLES,
+							BENCH_MAINS, BENCH_RATE)/gain - 300;
+		errorOs += a*a;
+	}
+	double snrDirect = 20*log10(300/sqrt(errorDirect/BENCH_TRIALS));
+	double snrOs = 20*log10(300/sqrt(errorOs/BENCH_TRIALS));
+	printf("  SNR direct %d Hz %5.1f dB, oversampled %d Hz %5.1f dB, "
+		   "gain %4.1f dB\n", BENCH_RATE, snrDirect, BENCH_IN_RATE, snrOs,
+		   snrOs - snrDirect);
+	CHECK(snrOs - snrDirect >= 30);
+}
+
+
+/** ***************************************************************************
+ * @brief Time to decimate the half blocks of the triple mode
+ *****************************************************************************/
+static void test_time(void)
+{
+	static const uint32_t offset[BENCH_CHANNELS] = {
+		MEAS_QUAD_WPC_LEFT, MEAS_QUAD_WPC_RIGHT,
+		MEAS_QUAD_HALL_IN11, MEAS_QUAD_HALL_IN6
+	};
+	DEC_t dec[BENCH_CHANNELS];
+	uint16_t out[DEC_BLOCK/DEC_RATIO+1];
+	uint32_t produced = 0;
+	char csv[512];
+
+	srand(2);
+	for (int h = 0; h < 2; ++h) {
+		for (int i = 0; i < MEAS_QUAD_STRIDE*DEC_BLOCK; ++i) {
+			BENCH_quad[h][i] = (uint16_t)(BENCH_MID + rand() % 2001 - 1000);
+		}
+	}
+	for (int c = 0; c < BENCH_CHANNELS; ++c) {
+		DEC_init(&dec[c]);
+	}
+
+	PROF_reset();
+	for (int b = 0; b < BENCH_BLOCKS; ++b) {
+		PROF_BEGIN(PROF_MEAS_DECIMATE);
+		for (int c = 0; c < BENCH_CHANNELS; ++c) {
+			produced += DEC_process(&dec[c], &BENCH_quad[b & 1][offset[c]],
+									DEC_BLOCK, MEAS_QUAD_STRIDE, out);
+			BENCH_sink = out[0];
+		}
+		PROF_END(PROF_MEAS_DECIMATE);
+	}
+	double block = PROF_mean_us(PROF_MEAS_DECIMATE)*1e-6;
+	double period = (double)DEC_BLOCK/BENCH_IN_RATE;
+	printf("  %.1f ns per input sample, %.1f us per half block of %.0f ms "
+		   "(%.2f %%)\n", block*1e9/(BENCH_CHANNELS*DEC_BLOCK), block*1e6,
+		   period*1e3, 100*block/period);
+	uint32_t length = PROF_csv_header(csv, sizeof(csv));
+	PROF_csv_probe(PROF_MEAS_DECIMATE, "Decim", &csv[length],
+				   sizeof(csv) - length);
+	printf("%s", csv);
+	CHECK_EQUAL(produced, BENCH_BLOCKS*BENCH_CHANNELS*DEC_BLOCK/DEC_RATIO);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_response);
+	UNIT_RUN(test_snr);
+	UNIT_RUN(test_time);
+	UNIT_EXIT();
+}
@@ -0,0 +1,183 @@
+/** ***************************************************************************
+ * @file
+ * @brief Spread of the peak and the Goertzel amplitude over noisy frames
+ *
+ * Both engines measure the same frames of the standard preset, 50 Hz sines
+ * of amplitude BENCH_AMPLITUDE at a random phase with gaussian noise, a
+ * third harmonic or a mains frequency off the bin. The bench prints mean
+ * and standard deviation of the amplitudes and the time per frame, taken
+ * with the "Analyse" probe like on the target. The statistics of the probe
+ * follow as CSV.
+ * @n The peak engine averages only 10 samples, the Goertzel engine
+ * correlates all of them with the mains frequency. With noise its spread
+ * must be smaller, and a harmonic must not bias it.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define BENCH_FRAMES		2000	///< Frames per case
+#define BENCH_AMPLITUDE		500		///< Amplitude of the fundamental
+#define BENCH_SAMPLES		60		///< Samples per channel of the standard
+#define BENCH_PI			3.14159265358979	///< Pi
+#define BENCH_CSV_SIZE		4096	///< Characters of the CSV report
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Signal of one case */
+typedef struct {
+	const char* name;				///< Description
+	double noise;					///< Standard deviation [digits]
+	double harmonic;				///< 3rd harmonic rel. to fundamental
+	double frequency;				///< Mains frequency [Hz]
+} BENCH_case_t;
+
+/** Amplitude statistics of one engine */
+typedef struct {
+	double mean;					///< Mean amplitude
+	double deviation;				///< Standard deviation
+	double us;						///< Time per frame [us]
+} BENCH_result_t;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t BENCH_samples[BENCH_FRAMES][2*BENCH_SAMPLES];	///< Frames
+static char BENCH_csv[BENCH_CSV_SIZE];			///< CSV report
+static uint32_t BENCH_csvLength;				///< Characters in BENCH_csv
+
+static const BENCH_case_t BENCH_cases[] = {
+		{"pure", 0, 0, 50},
+		{"noise 2", 2, 0, 50},
+		{"noise 5", 5, 0, 50},
+		{"noise 10", 10, 0, 50},
+		{"noise 20", 20, 0, 50},
+		{"noise 50", 50, 0, 50},
+		{"harmonic 5%", 0, 0.05, 50},
+		{"harmonic 5% noise 10", 10, 0.05, 50},
+		{"49.8 Hz noise 10", 10, 0, 49.8},
+};
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Gaussian random number
+ * @return sample with standard deviation 1
+ *****************************************************************************/
+static double BENCH_gauss(void)
+{
+	double u = (rand() + 1.0)/(RAND_MAX + 2.0);
+	double v = (rand() + 1.0)/(RAND_MAX + 2.0);
+	return sqrt(-2*log(u))*cos(2*BENCH_PI*v);
+}
+
+
+/** ***************************************************************************
+ * @brief Generate the frames of a case, both channels with own noise
+ * @param [in] signal
+ *****************************************************************************/
+static void BENCH_fill(const BENCH_case_t* signal)
+{
+	for (int f = 0; f < BENCH_FRAMES; ++f) {
+		double phase = 2*BENCH_PI*rand()/RAND_MAX;
+		for (int i = 0; i < 2*BENCH_SAMPLES; ++i) {
+			double x = 2*BENCH_PI*signal->frequency*(i/2)/600 + phase;
+			double value = 2048 + BENCH_AMPLITUDE*(sin(x)
+						 + signal->harmonic*sin(3*x))
+						 + signal->noise*BENCH_gauss();
+			BENCH_samples[f][i] = (uint16_t)fmin(fmax(lround(value), 0),
+												 4095);
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Measure all frames of a case with one engine
+ * @param [in] engine
+ * @param [in] name of the CSV line
+ * @return statistics of the amplitudes of both channels
+ *****************************************************************************/
+static BENCH_result_t BENCH_measure(MEAS_engine_t engine, const char* name)
+{
+	BENCH_result_t result;
+	MEAS_frame_t frame;
+	double sum = 0;
+	double squares = 0;
+	MEAS_engine = engine;
+	PROF_reset();
+	for (int f = 0; f < BENCH_FRAMES; ++f) {
+		PROF_BEGIN(PROF_MEAS_ANALYSE);
+		MEAS_analyse_data(BENCH_samples[f], &frame);
+		PROF_END(PROF_MEAS_ANALYSE);
+		sum += frame.amplitude_left + frame.amplitude_right;
+		squares += (double)frame.amplitude_left*frame.amplitude_left
+				 + (double)frame.amplitude_right*frame.amplitude_right;
+	}
+	result.mean = sum/(2*BENCH_FRAMES);
+	result.deviation = sqrt(squares/(2*BENCH_FRAMES)
+							- result.mean*result.mean);
+	result.us = PROF_mean_us(PROF_MEAS_ANALYSE);
+	BENCH_csvLength += PROF_csv_probe(PROF_MEAS_ANALYSE, name,
+									  &BENCH_csv[BENCH_csvLength],
+									  BENCH_CSV_SIZE - BENCH_csvLength);
+	return result;
+}
+
+
+/** ***************************************************************************
+ * @brief Run all cases
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	MOCK_reset();
+	MEAS_nominal = MEAS_MAINS_FREQ;
+	MEAS_config_preset(MEAS_PRESET_STANDARD);
+	MEAS_goertzel_init(MEAS_MAINS_FREQ);
+	srand(11);
+	BENCH_csvLength = PROF_csv_header(BENCH_csv, BENCH_CSV_SIZE);
+
+	printf("%-24s  %17s  %17s  %13s\n", "", "peak mean/sd",
+		   "goertzel mean/sd", "us/frame");
+	for (unsigned c = 0; c < sizeof(BENCH_cases)/sizeof(BENCH_case_t); ++c) {
+		const BENCH_case_t* signal = &BENCH_cases[c];
+		BENCH_fill(signal);
+		char name[40];
+		snprintf(name, sizeof(name), "peak %s", signal->name);
+		BENCH_result_t peak = BENCH_measure(MEAS_ENGINE_PEAK, name);
+		snprintf(name, sizeof(name), "goertzel %s", signal->name);
+		BENCH_result_t goertzel = BENCH_measure(MEAS_ENGINE_GOERTZEL, name);
+		printf("%-24s  %8.1f %8.2f  %8.1f %8.2f  %6.2f %6.2f\n",
+			   signal->name, peak.mean, peak.deviation, goertzel.mean,
+			   goertzel.deviation, peak.us, goertzel.us);
+
+		if (signal->noise >= 5) {
+			CHECK(goertzel.deviation < peak.deviation);
+		}
+		if (signal->frequency == MEAS_MAINS_FREQ) {
+			CHECK_NEAR(goertzel.mean, BENCH_AMPLITUDE, 0.01*BENCH_AMPLITUDE);
+		}
+	}
+	printf("%s", BENCH_csv);
+	UNIT_EXIT();
+}
@@ -0,0 +1,246 @@
+/** ***************************************************************************
+ * @file
+ * @brief Segment engine of CALC_Distance() against the linear LUT scan
+ *
+ * The reference is CALC_Distance() of the original firmware, which scans
+ * the whole LUT for an equal or enclosing entry and interpolates, with the
+ * LUT size as parameter instead of CALC_LUTSIZE.
+ * @n Both convert every point of the LUTs of all modes and a dense sweep
+ * between and beyond them. The results may only differ by the rounding of
+ * the precomputed segments. A strength repeated over several points gives
+ * the distance of the last of them in both.
+ * @n The bench prints the time per conversion of the 11 point LUTs and of
+ * a calibration LUT of CALC_LUTMAXSIZE points. A conversion is too short
+ * for the clock, the "ANA" probe times sweeps of BENCH_SWEEP conversions
+ * instead, its statistics follow as CSV.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdio.h>
+
+#include "unit.h"
+#include "analytics.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define BENCH_TOLERANCE		1e-3	///< Allowed difference [mm]
+#define BENCH_STEP			0.01f	///< Step of the sweep [digits]
+#define BENCH_CALLS			2000000	///< Conversions per timing
+#define BENCH_SWEEP			1000	///< Conversions per probe run
+#define BENCH_CSV_SIZE		4096	///< Characters of the CSV report
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static float BENCH_distance[CALC_LUTMAXSIZE];	///< Calibration distances
+static float BENCH_strength[CALC_LUTMAXSIZE];	///< Calibration strengths
+static volatile float BENCH_sink;				///< Keeps results alive
+static char BENCH_csv[BENCH_CSV_SIZE];			///< CSV report
+static uint32_t BENCH_csvLength;				///< Characters in BENCH_csv
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Distance of the original firmware, linear scan of the LUT
+ * @param [in] pointer to distance LUT
+ * @param [in] pointer to amplitude strength LUT
+ * @param [in] number of points
+ * @param [in] measurement
+ * @return calculated distance
+ *****************************************************************************/
+static float BENCH_linear(const float* lutDistance, const float* lutStrenght,
+						  int size, float measurement)
+{
+	int t,d,s;
+	float distance = -1;
+	t=0;
+	s=-10;
+	d=-10;
+
+	// Catch to high and to low values
+	if(lutStrenght[size-1]>measurement){
+		measurement = lutStrenght[size-1];
+	} else if (measurement>lutStrenght[0]) {
+		measurement = lutStrenght[0];
+	}
+
+	// Go through LUT
+	for(int i=0; i < size ; i++ ){
+		if (measurement == lutStrenght[i]){
+			t = i;
+			s=t;
+		}
+		if ( (measurement < lutStrenght[i])&& (measurement > lutStrenght[i+1])){
+			t = i;
+			d=t;
+		}
+	}
+
+	if(t==d){
+		float a = (lutDistance[t+1]-lutDistance[t])/(lutStrenght[t+1]-lutStrenght[t]);
+		distance = a*(measurement-lutStrenght[t]) + lutDistance[t];
+	}
+
+	if(t==s){
+		distance = lutDistance[t];
+	}
+
+	return distance;
+}
+
+
+/** ***************************************************************************
+ * @brief Compare both on the points of a LUT and a sweep across it
+ * @param [in] LUT engine
+ * @param [in] distance LUT
+ * @param [in] strength LUT
+ * @param [in] number of points
+ * @return largest difference [mm]
+ *****************************************************************************/
+static double BENCH_compare(const CALC_lut_t* lut, const float* distance,
+							const float* strength, int size)
+{
+	double worst = 0;
+	for (int i = 0; i < size; ++i) {
+		float engine = CALC_Distance(lut, strength[i]);
+		float linear = BENCH_linear(distance, strength, size, strength[i]);
+		CHECK_NEAR(engine, linear, BENCH_TOLERANCE);
+		if ((i == size-1) || (strength[i+1] < strength[i])) {
+			CHECK_NEAR(engine, distance[i], BENCH_TOLERANCE);
+		}									// else plateau, its last point
+		worst = fmax(worst, fabs(engine - linear));
+	}
+	unsigned failed = 0;
+	for (float m = strength[size-1] - 10; m <= strength[0] + 10;
+			m += BENCH_STEP) {
+		double difference = fabs(CALC_Distance(lut, m)
+								 - BENCH_linear(distance, strength, size, m));
+		failed += (difference > BENCH_TOLERANCE);
+		worst = fmax(worst, difference);
+	}
+	CHECK_EQUAL(failed, 0);
+	return worst;
+}
+
+
+/** ***************************************************************************
+ * @brief Add the statistics of the "ANA" probe to the CSV report
+ * @param [in] name of the LUT
+ * @param [in] name of the conversion
+ *****************************************************************************/
+static void BENCH_report(const char* lut, const char* conversion)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%s %s", lut, conversion);
+	BENCH_csvLength += PROF_csv_probe(PROF_ANA_HANDLER, name,
+									  &BENCH_csv[BENCH_csvLength],
+									  BENCH_CSV_SIZE - BENCH_csvLength);
+}
+
+
+/** ***************************************************************************
+ * @brief Time both on a LUT
+ * @param [in] name of the LUT
+ * @param [in] LUT engine
+ * @param [in] distance LUT
+ * @param [in] strength LUT
+ * @param [in] number of points
+ * @param [out] time per conversion of the linear scan [s]
+ * @param [out] time per conversion of the engine [s]
+ *
+ * Each probe run sweeps the whole range of the LUT.
+ *****************************************************************************/
+static void BENCH_time(const char* name, const CALC_lut_t* lut,
+					   const float* distance, const float* strength, int size,
+					   double* linear, double* engine)
+{
+	float low = strength[size-1];
+	float step = (strength[0] - low)/BENCH_SWEEP;
+	int sweeps = BENCH_CALLS/size/BENCH_SWEEP + 1;
+
+	PROF_reset();
+	for (int s = 0; s < sweeps; ++s) {
+		PROF_BEGIN(PROF_ANA_HANDLER);
+		for (int i = 0; i < BENCH_SWEEP; ++i) {
+			BENCH_sink = BENCH_linear(distance, strength, size, low + step*i);
+		}
+		PROF_END(PROF_ANA_HANDLER);
+	}
+	*linear = PROF_mean_us(PROF_ANA_HANDLER)*1e-6/BENCH_SWEEP;
+	BENCH_report(name, "linear");
+
+	sweeps = BENCH_CALLS/BENCH_SWEEP;
+	PROF_reset();
+	for (int s = 0; s < sweeps; ++s) {
+		PROF_BEGIN(PROF_ANA_HANDLER);
+		for (int i = 0; i < BENCH_SWEEP; ++i) {
+			BENCH_sink = CALC_Distance(lut, low + step*i);
+		}
+		PROF_END(PROF_ANA_HANDLER);
+	}
+	*engine = PROF_mean_us(PROF_ANA_HANDLER)*1e-6/BENCH_SWEEP;
+	BENCH_report(name, "engine");
+}
+
+
+/** ***************************************************************************
+ * @brief Compare and time all LUTs
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	static const char* modes[CALC_MODES] = {"L", "LN", "LNPE"};
+	double linear, engine;
+	char name[16];
+	ANA_Init();
+	BENCH_csvLength = PROF_csv_header(BENCH_csv, BENCH_CSV_SIZE);
+
+	printf("LUT          worst [mm]  linear [ns]  engine [ns]\n");
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		for (int side = 0; side < 2; ++side) {
+			const CALC_lut_t* lut = side ? &CALC_lutRight[mode]
+										 : &CALC_lutLeft[mode];
+			const float* strength = side ? CALC_wpcRight[mode]
+										 : CALC_wpcLeft[mode];
+			double worst = BENCH_compare(lut, CALC_distanceLUT, strength,
+										 CALC_LUTSIZE);
+			snprintf(name, sizeof(name), "%s %s", modes[mode],
+					 side ? "right" : "left");
+			BENCH_time(name, lut, CALC_distanceLUT, strength, CALC_LUTSIZE,
+					   &linear, &engine);
+			printf("%-4s %-5s  %12.2e  %11.1f  %11.1f\n", modes[mode],
+				   side ? "right" : "left", worst, linear*1e9, engine*1e9);
+		}
+	}
+
+	// Calibration LUT of the wizard, 1 mm steps with a plateau
+	static CALC_lut_t lut;
+	for (int i = 0; i < CALC_LUTMAXSIZE; ++i) {
+		BENCH_distance[i] = (float)i;
+		BENCH_strength[i] = 900.0f/(1.0f + i/40.0f) + 100.0f;
+		if ((i > 100) && (i < 110)) {
+			BENCH_strength[i] = BENCH_strength[100];
+		}
+	}
+	CHECK(CALC_LutInit(&lut, BENCH_distance, BENCH_strength,
+					   CALC_LUTMAXSIZE));
+	double worst = BENCH_compare(&lut, BENCH_distance, BENCH_strength,
+								 CALC_LUTMAXSIZE);
+	BENCH_time("256 points", &lut, BENCH_distance, BENCH_strength,
+			   CALC_LUTMAXSIZE, &linear, &engine);
+	printf("%-10s  %12.2e  %11.1f  %11.1f\n", "256 points", worst,
+		   linear*1e9, engine*1e9);
+	printf("%s", BENCH_csv);
+	UNIT_EXIT();
+}
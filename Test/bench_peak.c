@@ -0,0 +1,207 @@
+/** ***************************************************************************
+ * @file
+ * @brief Peak extraction against the sorting of the original firmware
+ *
+ * The reference is MEAS_analyse_data() as it was before the peak engine:
+ * both channels are copied and sorted completely, the 5 lowest and 5
+ * highest values give the amplitude. It is generalised from the fixed 60
+ * samples to ADC_NUMS by taking the highest values from the end.
+ * @n Both run on the same frames of 60, 600 and 6000 samples per channel,
+ * the amplitudes must be bit identical. The bench prints the time per
+ * frame of both, each frame timed with the "Analyse" probe like on the
+ * target, and the statistics of the probe as CSV.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define BENCH_MAX_SAMPLES	6000	///< Longest frame per channel
+#define BENCH_FRAMES		8		///< Different frames per length
+#define BENCH_ADC_MAX		4095	///< Maximum value of ADC output
+#define BENCH_PI			3.14159265358979	///< Pi
+#define BENCH_CSV_SIZE		2048	///< Characters of the CSV report
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t BENCH_samples[BENCH_FRAMES][2*BENCH_MAX_SAMPLES];	///< Data
+static uint32_t BENCH_left[BENCH_MAX_SAMPLES];	///< Sort buffer left
+static uint32_t BENCH_right[BENCH_MAX_SAMPLES];	///< Sort buffer right
+static char BENCH_csv[BENCH_CSV_SIZE];			///< CSV report
+static uint32_t BENCH_csvLength;				///< Characters in BENCH_csv
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Amplitudes of the original firmware, sorting both channels
+ * @param [in] interleaved samples of both channels
+ * @param [in] samples per channel
+ * @param [out] left amplitude
+ * @param [out] right amplitude
+ *****************************************************************************/
+static void BENCH_sorted(const uint16_t* samples, int n, uint32_t* left,
+						 uint32_t* right)
+{
+	for (int i = 0; i < n; ++i) {
+		BENCH_left[i] = samples[2*i];
+		BENCH_right[i] = samples[(2*i)+1];
+	}
+	//sort arrays from low to high
+	for (int i = 0; i < n; ++i) {
+		for (int j = i+1; j < n; ++j) {
+			if (BENCH_left[i] > BENCH_left[j]) {
+				uint32_t temp = BENCH_left[i];
+				BENCH_left[i] = BENCH_left[j];
+				BENCH_left[j] = temp;
+			}
+			if (BENCH_right[i] > BENCH_right[j]) {
+				uint32_t temp = BENCH_right[i];
+				BENCH_right[i] = BENCH_right[j];
+				BENCH_right[j] = temp;
+			}
+		}
+	}
+	//5 lowest values converted to high values and 5 highest values
+	uint32_t sum_left = 0;
+	uint32_t sum_right = 0;
+	for (int i = 0; i < 5; ++i) {
+		sum_left += BENCH_ADC_MAX - BENCH_left[i];
+		sum_right += BENCH_ADC_MAX - BENCH_right[i];
+		sum_left += BENCH_left[n-5+i];
+		sum_right += BENCH_right[n-5+i];
+	}
+	*left = sum_left/10 - (BENCH_ADC_MAX/2);
+	*right = sum_right/10 - (BENCH_ADC_MAX/2);
+}
+
+
+/** ***************************************************************************
+ * @brief Fill the frames with noisy sines of random amplitude and clipping
+ *
+ * Frame 0 is constant, frame 1 pure noise over the full ADC range, so
+ * ties and extreme values are covered.
+ *****************************************************************************/
+static void BENCH_fill(void)
+{
+	srand(7);
+	for (int f = 0; f < BENCH_FRAMES; ++f) {
+		int amplitude = rand() % 2500;
+		for (int i = 0; i < 2*BENCH_MAX_SAMPLES; ++i) {
+			int value;
+			if (f == 0) {
+				value = 2048;
+			} else if (f == 1) {
+				value = rand() % (BENCH_ADC_MAX+1);
+			} else {				// 50 Hz at 600 Hz, right channel shifted
+				double wave = sin(2*BENCH_PI*((i/2)/12.0 + (i & 1)/8.0));
+				value = 2048 + (int)lround(amplitude*wave)
+					  + (rand() % 21) - 10;
+			}
+			if (value < 0) {
+				value = 0;
+			} else if (value > BENCH_ADC_MAX) {
+				value = BENCH_ADC_MAX;
+			}
+			BENCH_samples[f][i] = (uint16_t)value;
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Add the statistics of the "Analyse" probe to the CSV report
+ * @param [in] name of the line
+ *****************************************************************************/
+static void BENCH_report(const char* name)
+{
+	BENCH_csvLength += PROF_csv_probe(PROF_MEAS_ANALYSE, name,
+									  &BENCH_csv[BENCH_csvLength],
+									  BENCH_CSV_SIZE - BENCH_csvLength);
+}
+
+
+/** ***************************************************************************
+ * @brief Compare and time both at one frame length
+ * @param [in] samples per channel
+ *
+ * MEAS_config.samples is ADC_NUMS of the driver, it is set beyond
+ * MEAS_MAX_SAMPLES here on purpose, MEAS_analyse_data() only reads the
+ * given samples.
+ *****************************************************************************/
+static void BENCH_run(int n)
+{
+	MEAS_frame_t frame;
+	uint32_t left, right;
+	MEAS_config.samples = (uint16_t)n;
+	MEAS_config.rate = (uint32_t)(10*n);	// 100 ms frames
+
+	for (int f = 0; f < BENCH_FRAMES; ++f) {
+		BENCH_sorted(BENCH_samples[f], n, &left, &right);
+		MEAS_analyse_data(BENCH_samples[f], &frame);
+		CHECK_EQUAL(frame.amplitude_left, left);
+		CHECK_EQUAL(frame.amplitude_right, right);
+	}
+
+	char name[16];
+	int repetitions = 3000000/(n*n/60 + 1) + 1;
+	PROF_reset();
+	for (int r = 0; r < repetitions; ++r) {
+		PROF_BEGIN(PROF_MEAS_ANALYSE);
+		BENCH_sorted(BENCH_samples[r % BENCH_FRAMES], n, &left, &right);
+		PROF_END(PROF_MEAS_ANALYSE);
+	}
+	double sorted = PROF_mean_us(PROF_MEAS_ANALYSE);
+	snprintf(name, sizeof(name), "sort %d", n);
+	BENCH_report(name);
+
+	repetitions *= 10;
+	if (repetitions < 20000) {
+		repetitions = 20000;
+	}
+	PROF_reset();
+	for (int r = 0; r < repetitions; ++r) {
+		PROF_BEGIN(PROF_MEAS_ANALYSE);
+		MEAS_analyse_data(BENCH_samples[r % BENCH_FRAMES], &frame);
+		PROF_END(PROF_MEAS_ANALYSE);
+	}
+	double peaks = PROF_mean_us(PROF_MEAS_ANALYSE);
+	snprintf(name, sizeof(name), "peak %d", n);
+	BENCH_report(name);
+	printf("%5d samples  sort %10.1f us  peak %8.2f us  speedup %8.1f\n",
+		   n, sorted, peaks, sorted/peaks);
+}
+
+
+/** ***************************************************************************
+ * @brief Run the bench at all frame lengths
+ * @return 0 if all amplitudes were identical
+ *****************************************************************************/
+int main(void)
+{
+	MOCK_reset();
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	BENCH_fill();
+	BENCH_csvLength = PROF_csv_header(BENCH_csv, BENCH_CSV_SIZE);
+	BENCH_run(60);
+	BENCH_run(600);
+	BENCH_run(6000);
+	printf("%s", BENCH_csv);
+	UNIT_EXIT();
+}
@@ -0,0 +1,539 @@
+/** ***************************************************************************
+ * @file
+ * @brief Host model of the display path of the STM32F429 Discovery
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - SDRAM mapped at its target address, the frame buffers live there
+ * - DMA2D running its transfers and CLUT loads in host memory
+ * - LTDC shadow register reload, immediate or in the vertical blanking
+ * - The panel image, the frame buffer of the visible layer
+ * - Stubs of the BSP bus functions behind the LCD
+ * - The STMPE811 touch controller behind the interrupt driven I2C transfers
+ *
+ * lcd_gui.c and the BSP LCD driver are compiled unchanged against this
+ * model, together with the HAL LTDC and DMA2D drivers.
+ *
+ * A register write can not be trapped on the host. The DMA2D therefore runs
+ * a started transfer at the next access through the DMA2D pointer, see
+ * mock/include/stm32f4xx.h, or when a HAL driver polls with a timeout and
+ * reads HAL_GetTick(). Both happen before the code under test can see the
+ * START bit, so every transfer appears complete at the first check.
+ *
+ * Modelled are the modes and formats the firmware uses: register to
+ * memory, memory to memory and memory to memory with conversion from
+ * ARGB8888, RGB888 or L8 with an ARGB8888 CLUT, all to ARGB8888 and without
+ * alpha modification. Anything else ends the test.
+ *
+ * The LTDC layers are opaque and cover the whole screen, as set up by
+ * GUI_LCD_Init(). The screen shows the upper enabled layer.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "display.h"
+#include "stm32f429i_discovery_lcd.h"
+#include "stm32f429i_discovery_ts.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_SDRAM_SIZE		0x800000	///< SDRAM of the board [bytes]
+#define MOCK_DMA2D_M2M		0		///< Memory to memory
+#define MOCK_DMA2D_M2M_PFC	1		///< Memory to memory with conversion
+#define MOCK_DMA2D_R2M		3		///< Register to memory
+#define MOCK_CM_ARGB8888	0		///< Colour mode ARGB8888
+#define MOCK_CM_RGB888		1		///< Colour mode RGB888
+#define MOCK_CM_L8			5		///< Colour mode L8
+#define MOCK_LAYERS			2		///< Layers of the LTDC
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+uint32_t MOCK_dma2d_transfers = 0;		///< Transfers run by the DMA2D model
+
+static bool MOCK_mapped = false;		///< SDRAM mapped
+static bool MOCK_shown[MOCK_LAYERS];	///< Active layer enable bits
+static uint32_t MOCK_shownAddress[MOCK_LAYERS];	///< Active frame buffers
+
+/// Layer registers of the LTDC
+static LTDC_Layer_TypeDef* const MOCK_layer[MOCK_LAYERS] = {
+		LTDC_Layer1, LTDC_Layer2
+};
+
+I2C_HandleTypeDef I2cHandle;			///< Touch controller bus of the BSP
+MOCK_ts_write_t MOCK_tsWrites[MOCK_TS_WRITES];	///< Writes to the STMPE811
+uint32_t MOCK_tsWriteCount = 0;			///< Entries in MOCK_tsWrites
+bool MOCK_tsBlocked = false;			///< Bus refuses to start transfers
+
+static MOCK_ts_transfer_t MOCK_tsTransfer;	///< Running transfer
+static uint8_t MOCK_tsRegister[256];	///< Registers of the STMPE811
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief End the test on a DMA2D setup the model does not cover
+ * @param [in] what is not modelled
+ *****************************************************************************/
+static void MOCK_unsupported(const char* what)
+{
+	fprintf(stderr, "MOCK: DMA2D %s not modelled\n", what);
+	abort();
+}
+
+
+/** ***************************************************************************
+ * @brief Map the SDRAM and clear the state of the display model
+ *
+ * Call after MOCK_reset(), the SDRAM keeps its content like on the target.
+ *****************************************************************************/
+void MOCK_display_init(void)
+{
+	if (!MOCK_mapped) {
+		void* sdram = mmap((void*)(uintptr_t)LCD_FRAME_BUFFER,
+						   MOCK_SDRAM_SIZE, PROT_READ | PROT_WRITE,
+						   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+						   -1, 0);
+		if (sdram != (void*)(uintptr_t)LCD_FRAME_BUFFER) {
+			fprintf(stderr, "MOCK: SDRAM not mapped at 0x%08lX\n",
+					(unsigned long)LCD_FRAME_BUFFER);
+			abort();
+		}
+		MOCK_mapped = true;
+	}
+	memset(MOCK_shown, 0, sizeof(MOCK_shown));
+	memset(MOCK_shownAddress, 0, sizeof(MOCK_shownAddress));
+	MOCK_dma2d_transfers = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Load the foreground CLUT into the DMA2D
+ * @param [in,out] DMA2D registers
+ *
+ * The colours are copied into FGCLUT, later changes in memory have no
+ * effect until the next load.
+ *****************************************************************************/
+static void MOCK_dma2d_clut(DMA2D_TypeDef* dma2d)
+{
+	const uint32_t* clut = (const uint32_t*)(uintptr_t)dma2d->FGCMAR;
+	uint32_t count = ((dma2d->FGPFCCR & DMA2D_FGPFCCR_CS_Msk)
+					  >> DMA2D_FGPFCCR_CS_Pos) + 1;
+	if (dma2d->FGPFCCR & DMA2D_FGPFCCR_CCM) {
+		MOCK_unsupported("RGB888 CLUT");
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		dma2d->FGCLUT[i] = clut[i];
+	}
+	dma2d->FGPFCCR &= ~DMA2D_FGPFCCR_START;
+	dma2d->ISR |= DMA2D_ISR_CTCIF;
+}
+
+
+/** ***************************************************************************
+ * @brief Read a foreground pixel and convert it to ARGB8888
+ * @param [in] DMA2D registers
+ * @param [in] pixel index from FGMAR, offsets included
+ * @return colour
+ *****************************************************************************/
+static uint32_t MOCK_dma2d_pixel(DMA2D_TypeDef* dma2d, uint32_t index)
+{
+	const uint8_t* source = (const uint8_t*)(uintptr_t)dma2d->FGMAR;
+	switch (dma2d->FGPFCCR & DMA2D_FGPFCCR_CM_Msk) {
+	case MOCK_CM_ARGB8888:
+		return ((const uint32_t*)source)[index];
+	case MOCK_CM_RGB888:
+		source += 3*index;
+		return 0xFF000000 | (source[2] << 16) | (source[1] << 8) | source[0];
+	case MOCK_CM_L8:
+		return dma2d->FGCLUT[source[index]];
+	default:
+		MOCK_unsupported("input colour mode");
+		return 0;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Run a started transfer
+ * @param [in,out] DMA2D registers
+ *****************************************************************************/
+static void MOCK_dma2d_transfer(DMA2D_TypeDef* dma2d)
+{
+	uint32_t mode = (dma2d->CR & DMA2D_CR_MODE_Msk) >> DMA2D_CR_MODE_Pos;
+	uint32_t width = (dma2d->NLR & DMA2D_NLR_PL_Msk) >> DMA2D_NLR_PL_Pos;
+	uint32_t height = dma2d->NLR & DMA2D_NLR_NL_Msk;
+	uint32_t* output = (uint32_t*)(uintptr_t)dma2d->OMAR;
+
+	if ((dma2d->OPFCCR & DMA2D_OPFCCR_CM_Msk) != MOCK_CM_ARGB8888) {
+		MOCK_unsupported("output colour mode");
+	}
+	if ((mode != MOCK_DMA2D_R2M) && (dma2d->FGPFCCR & DMA2D_FGPFCCR_AM_Msk)) {
+		MOCK_unsupported("alpha mode");
+	}
+	if ((mode == MOCK_DMA2D_M2M)
+		&& ((dma2d->FGPFCCR & DMA2D_FGPFCCR_CM_Msk) != MOCK_CM_ARGB8888)) {
+		MOCK_unsupported("copy without conversion from other than ARGB8888");
+	}
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint32_t* pixel = &output[y*(width + dma2d->OOR) + x];
+			switch (mode) {
+			case MOCK_DMA2D_M2M:
+			case MOCK_DMA2D_M2M_PFC:
+				*pixel = MOCK_dma2d_pixel(dma2d,
+										  y*(width + dma2d->FGOR) + x);
+				break;
+			case MOCK_DMA2D_R2M:
+				*pixel = dma2d->OCOLR;
+				break;
+			default:
+				MOCK_unsupported("blending");
+			}
+		}
+	}
+	dma2d->CR &= ~DMA2D_CR_START;
+	dma2d->ISR |= DMA2D_ISR_TCIF;
+	MOCK_dma2d_transfers++;
+}
+
+
+/** ***************************************************************************
+ * @brief Let the DMA2D run what was started since the last access
+ *
+ * Also called by HAL_GetTick(), see mock.c.
+ *****************************************************************************/
+void MOCK_dma2d_poll(void)
+{
+	DMA2D_TypeDef* dma2d = (DMA2D_TypeDef*)DMA2D_BASE;
+	dma2d->ISR &= ~dma2d->IFCR;			// Flags cleared with a write of 1
+	dma2d->IFCR = 0;
+	if (dma2d->FGPFCCR & DMA2D_FGPFCCR_START) {
+		MOCK_dma2d_clut(dma2d);
+	}
+	if (dma2d->CR & DMA2D_CR_START) {
+		MOCK_dma2d_transfer(dma2d);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief DMA2D registers, after running a started transfer
+ * @return registers at DMA2D_BASE
+ *
+ * Replaces the DMA2D pointer of the device header.
+ *****************************************************************************/
+DMA2D_TypeDef* MOCK_dma2d(void)
+{
+	MOCK_dma2d_poll();
+	return (DMA2D_TypeDef*)DMA2D_BASE;
+}
+
+
+/** ***************************************************************************
+ * @brief Copy the layer shadow registers to the active ones
+ *****************************************************************************/
+static void MOCK_ltdc_reload(void)
+{
+	for (int l = 0; l < MOCK_LAYERS; ++l) {
+		MOCK_shown[l] = MOCK_layer[l]->CR & LTDC_LxCR_LEN;
+		MOCK_shownAddress[l] = MOCK_layer[l]->CFBAR;
+	}
+	LTDC->SRCR = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Vertical blanking of the LTDC
+ *
+ * A requested reload is done and signalled by the register reload
+ * interrupt, like on the target.
+ *****************************************************************************/
+void MOCK_vsync(void)
+{
+	LTDC->ISR &= ~LTDC->ICR;			// Flags cleared with a write of 1
+	LTDC->ICR = 0;
+	if (LTDC->SRCR & LTDC_SRCR_IMR) {
+		MOCK_ltdc_reload();
+	}
+	if (LTDC->SRCR & LTDC_SRCR_VBR) {
+		MOCK_ltdc_reload();
+		LTDC->ISR |= LTDC_ISR_RRIF;
+		if (LTDC->IER & LTDC_IER_RRIE) {
+			MOCK_irq(LTDC_IRQn);
+		}
+	}
+	LTDC->ISR &= ~LTDC->ICR;
+	LTDC->ICR = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Image on the panel
+ * @return frame buffer of the visible layer, NULL if none is enabled
+ *
+ * An immediate reload requested since the last frame takes effect first.
+ *****************************************************************************/
+const uint32_t* MOCK_screen(void)
+{
+	if (LTDC->SRCR & LTDC_SRCR_IMR) {
+		MOCK_ltdc_reload();
+	}
+	for (int l = MOCK_LAYERS-1; l >= 0; --l) {
+		if (MOCK_shown[l]) {
+			return (const uint32_t*)(uintptr_t)MOCK_shownAddress[l];
+		}
+	}
+	return NULL;
+}
+
+
+/** ***************************************************************************
+ * @brief LCD bus of the BSP, the ILI9341 is not modelled
+ *****************************************************************************/
+void LCD_IO_Init(void)
+{
+}
+
+
+/** ***************************************************************************
+ * @brief LCD bus of the BSP, the ILI9341 is not modelled
+ * @param [in] data
+ *****************************************************************************/
+void LCD_IO_WriteData(uint16_t RegValue)
+{
+	(void)RegValue;
+}
+
+
+/** ***************************************************************************
+ * @brief LCD bus of the BSP, the ILI9341 is not modelled
+ * @param [in] register
+ *****************************************************************************/
+void LCD_IO_WriteReg(uint8_t Reg)
+{
+	(void)Reg;
+}
+
+
+/** ***************************************************************************
+ * @brief LCD bus of the BSP, the ILI9341 is not modelled
+ * @param [in] register
+ * @param [in] bytes to read
+ * @return 0
+ *****************************************************************************/
+uint32_t LCD_IO_ReadData(uint16_t RegValue, uint8_t ReadSize)
+{
+	(void)RegValue;
+	(void)ReadSize;
+	return 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Delay of the LCD driver, the HAL tick advances
+ * @param [in] delay [ms]
+ *****************************************************************************/
+void LCD_Delay(uint32_t Delay)
+{
+	MOCK_tick += Delay;
+}
+
+
+/** ***************************************************************************
+ * @brief Delay of the HAL, the HAL tick advances
+ * @param [in] delay [ms]
+ *****************************************************************************/
+void HAL_Delay(uint32_t Delay)
+{
+	MOCK_tick += Delay;
+}
+
+
+/** ***************************************************************************
+ * @brief SDRAM controller of the BSP, the SDRAM is mapped instead
+ * @return SDRAM_OK
+ *****************************************************************************/
+uint8_t BSP_SDRAM_Init(void)
+{
+	return SDRAM_OK;
+}
+
+
+/** ***************************************************************************
+ * @brief LTDC clock of the BSP, the PLLSAI is not modelled
+ * @param [in] clock configuration
+ * @return HAL_OK
+ *****************************************************************************/
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(
+		RCC_PeriphCLKInitTypeDef* PeriphClkInit)
+{
+	(void)PeriphClkInit;
+	return HAL_OK;
+}
+
+
+/** ***************************************************************************
+ * @brief Touch controller interrupt of the BSP
+ * @return TS_OK
+ *****************************************************************************/
+uint8_t BSP_TS_ITConfig(void)
+{
+	return TS_OK;
+}
+
+
+/** ***************************************************************************
+ * @brief Touch state of the BSP, never touched
+ * @param [out] state
+ *****************************************************************************/
+void BSP_TS_GetState(TS_StateTypeDef* TsState)
+{
+	memset(TsState, 0, sizeof(TS_StateTypeDef));
+}
+
+
+/** ***************************************************************************
+ * @brief Start a transfer on the touch controller bus
+ * @param [in] true to read
+ * @param [in] register address
+ * @param [in,out] data
+ * @param [in] size
+ * @return HAL_BUSY while a transfer runs or the bus is blocked
+ *****************************************************************************/
+static HAL_StatusTypeDef MOCK_ts_start(bool read, uint16_t reg,
+									   uint8_t* data, uint16_t size)
+{
+	if (MOCK_tsTransfer.running || MOCK_tsBlocked) {
+		return HAL_BUSY;
+	}
+	MOCK_tsTransfer.running = true;
+	MOCK_tsTransfer.read = read;
+	MOCK_tsTransfer.reg = reg;
+	MOCK_tsTransfer.data = data;
+	MOCK_tsTransfer.size = size;
+	return HAL_OK;
+}
+
+
+/** ***************************************************************************
+ * @brief Touch controller read with interrupt, see HAL_I2C_Mem_Read_IT()
+ * @return HAL_OK if started
+ *****************************************************************************/
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c,
+		uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+		uint8_t* pData, uint16_t Size)
+{
+	(void)DevAddress;
+	(void)MemAddSize;
+	if (hi2c != &I2cHandle) {
+		return HAL_ERROR;
+	}
+	return MOCK_ts_start(true, MemAddress, pData, Size);
+}
+
+
+/** ***************************************************************************
+ * @brief Touch controller write with interrupt, see HAL_I2C_Mem_Write_IT()
+ * @return HAL_OK if started
+ *****************************************************************************/
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c,
+		uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize,
+		uint8_t* pData, uint16_t Size)
+{
+	(void)DevAddress;
+	(void)MemAddSize;
+	if (hi2c != &I2cHandle) {
+		return HAL_ERROR;
+	}
+	return MOCK_ts_start(false, MemAddress, pData, Size);
+}
+
+
+/** ***************************************************************************
+ * @brief Clear the touch controller model, not touched and bus idle
+ *****************************************************************************/
+void MOCK_ts_init(void)
+{
+	memset(&MOCK_tsTransfer, 0, sizeof(MOCK_tsTransfer));
+	memset(MOCK_tsRegister, 0, sizeof(MOCK_tsRegister));
+	memset(MOCK_tsWrites, 0, sizeof(MOCK_tsWrites));
+	MOCK_tsWriteCount = 0;
+	MOCK_tsBlocked = false;
+}
+
+
+/** ***************************************************************************
+ * @brief Set the touch state of the STMPE811
+ * @param [in] touched
+ * @param [in] raw X of the FIFO sample, 12 bit
+ * @param [in] raw Y of the FIFO sample, 12 bit
+ *****************************************************************************/
+void MOCK_ts_touch(bool touched, uint16_t x, uint16_t y)
+{
+	uint32_t xyz = ((uint32_t)(x & 0x0FFF) << 20)
+				 | ((uint32_t)(y & 0x0FFF) << 8);
+	MOCK_tsRegister[STMPE811_REG_TSC_CTRL] = touched
+										   ? STMPE811_TS_CTRL_STATUS : 0;
+	for (int i = 0; i < 4; ++i) {
+		MOCK_tsRegister[STMPE811_REG_TSC_DATA_NON_INC + i] =
+			(uint8_t)(xyz >> (24 - 8*i));
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Running transfer on the touch controller bus
+ * @return transfer, NULL if the bus is idle
+ *****************************************************************************/
+const MOCK_ts_transfer_t* MOCK_ts_running(void)
+{
+	return MOCK_tsTransfer.running ? &MOCK_tsTransfer : NULL;
+}
+
+
+/** ***************************************************************************
+ * @brief End the running transfer like the I2C3 interrupts would
+ * @param [in] true to end it with a bus error
+ * @return false if no transfer was running
+ *
+ * A read copies the registers of the STMPE811 into the buffer, a write
+ * is added to MOCK_tsWrites. Then the HAL callback of lcd_gui.c runs.
+ *****************************************************************************/
+bool MOCK_ts_complete(bool error)
+{
+	MOCK_ts_transfer_t transfer = MOCK_tsTransfer;
+	if (!transfer.running) {
+		return false;
+	}
+	MOCK_tsTransfer.running = false;
+	if (error) {
+		HAL_I2C_ErrorCallback(&I2cHandle);
+	} else if (transfer.read) {
+		for (uint16_t i = 0; i < transfer.size; ++i) {
+			transfer.data[i] = MOCK_tsRegister[(transfer.reg + i) & 0xFF];
+		}
+		HAL_I2C_MemRxCpltCallback(&I2cHandle);
+	} else {
+		if (MOCK_tsWriteCount < MOCK_TS_WRITES) {
+			MOCK_tsWrites[MOCK_tsWriteCount].reg = transfer.reg;
+			MOCK_tsWrites[MOCK_tsWriteCount].value = transfer.data[0];
+			MOCK_tsWriteCount++;
+		}
+		HAL_I2C_MemTxCpltCallback(&I2cHandle);
+	}
+	return true;
+}
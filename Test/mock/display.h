@@ -0,0 +1,69 @@
+/** ***************************************************************************
+ * @file
+ * @brief See display.c
+ *
+ * Prefix MOCK
+ *
+ *****************************************************************************/
+
+#ifndef MOCK_DISPLAY_H_
+#define MOCK_DISPLAY_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mock.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_LCD_WIDTH		240		///< Columns of the panel
+#define MOCK_LCD_HEIGHT		320		///< Rows of the panel
+#define MOCK_TS_WRITES		16		///< Register writes kept by the model
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Transfer on the touch controller bus */
+typedef struct {
+	bool running;					///< Started and not completed
+	bool read;						///< Read, else write
+	uint16_t reg;					///< Register address
+	uint8_t* data;					///< Buffer of the HAL call
+	uint16_t size;					///< Bytes
+} MOCK_ts_transfer_t;
+
+/** Register write to the touch controller */
+typedef struct {
+	uint16_t reg;					///< Register address
+	uint8_t value;					///< Written value
+} MOCK_ts_write_t;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t MOCK_dma2d_transfers;	///< Transfers run by the DMA2D model
+extern MOCK_ts_write_t MOCK_tsWrites[MOCK_TS_WRITES];///< Writes to STMPE811
+extern uint32_t MOCK_tsWriteCount;		///< Entries in MOCK_tsWrites
+extern bool MOCK_tsBlocked;				///< Bus refuses to start transfers
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void MOCK_display_init(void);
+void MOCK_vsync(void);
+const uint32_t* MOCK_screen(void);
+void MOCK_ts_init(void);
+void MOCK_ts_touch(bool touched, uint16_t x, uint16_t y);
+const MOCK_ts_transfer_t* MOCK_ts_running(void);
+bool MOCK_ts_complete(bool error);
+
+
+#endif /* MOCK_DISPLAY_H_ */
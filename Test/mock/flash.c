@@ -0,0 +1,96 @@
+/** ***************************************************************************
+ * @file
+ * @brief Host model of the calibration flash sector
+ *
+ * Replaces Core/Src/calibration_flash.c. The sector is an array in host
+ * memory with the rules of NOR flash: erasing sets all bits, programming
+ * can only clear bits, a word programmed twice holds the AND of both.
+ * @n A power loss while saving is modelled by MOCK_flash_cut: after that
+ * many programmed words every further write fails and leaves the sector
+ * unchanged.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+
+#include "flash.h"
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+/// Content of the sector, erased at start
+uint8_t MOCK_flash[CAL_SECTOR_SIZE] __attribute__((aligned(4))) = {
+		[0 ... CAL_SECTOR_SIZE-1] = 0xFF
+};
+uint32_t MOCK_flash_erases = 0;			///< Erases of the sector
+uint32_t MOCK_flash_cut = MOCK_FLASH_NO_CUT;	///< Words before power loss
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Erased sector, no erases counted, power is not cut
+ *****************************************************************************/
+void MOCK_flash_init(void)
+{
+	memset(MOCK_flash, 0xFF, sizeof(MOCK_flash));
+	MOCK_flash_erases = 0;
+	MOCK_flash_cut = MOCK_FLASH_NO_CUT;
+}
+
+
+/** ***************************************************************************
+ * @brief Address of a location in the sector
+ * @param [in] offset in bytes
+ * @return pointer into MOCK_flash
+ *****************************************************************************/
+const void* CAL_flash_read(uint32_t offset)
+{
+	return &MOCK_flash[offset];
+}
+
+
+/** ***************************************************************************
+ * @brief Erase the whole sector
+ * @return false after a power loss
+ *****************************************************************************/
+bool CAL_flash_erase(void)
+{
+	if (MOCK_flash_cut == 0) {
+		return false;
+	}
+	memset(MOCK_flash, 0xFF, sizeof(MOCK_flash));
+	MOCK_flash_erases++;
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Program words of the sector
+ * @param [in] offset in bytes, word aligned
+ * @param [in] words
+ * @param [in] count of words
+ * @return false after a power loss
+ *****************************************************************************/
+bool CAL_flash_write(uint32_t offset, const uint32_t* words, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t word;
+		if (MOCK_flash_cut == 0) {
+			return false;
+		}
+		if (MOCK_flash_cut != MOCK_FLASH_NO_CUT) {
+			MOCK_flash_cut--;
+		}
+		memcpy(&word, &MOCK_flash[offset + 4*i], sizeof(word));
+		word &= words[i];
+		memcpy(&MOCK_flash[offset + 4*i], &word, sizeof(word));
+	}
+	return true;
+}
@@ -0,0 +1,40 @@
+/** ***************************************************************************
+ * @file
+ * @brief See flash.c
+ *
+ * Prefix MOCK
+ *
+ *****************************************************************************/
+
+#ifndef MOCK_FLASH_H_
+#define MOCK_FLASH_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+#include "calibration.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_FLASH_NO_CUT	UINT32_MAX	///< Power is never cut
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint8_t MOCK_flash[CAL_SECTOR_SIZE];	///< Content of the sector
+extern uint32_t MOCK_flash_erases;		///< Erases of the sector
+extern uint32_t MOCK_flash_cut;			///< Words programmed before power loss
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void MOCK_flash_init(void);
+
+
+#endif /* MOCK_FLASH_H_ */
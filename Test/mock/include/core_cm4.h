@@ -0,0 +1,169 @@
+/** ***************************************************************************
+ * @file
+ * @brief Host replacement of the CMSIS Cortex-M4 core header, see mock.c
+ *
+ * Prefix MOCK
+ *
+ * Found before Drivers/CMSIS/Include on the include path of the host build.
+ * Only the core functions and registers used by Core/Src are provided.
+ *****************************************************************************/
+
+#ifndef MOCK_CORE_CM4_H_
+#define MOCK_CORE_CM4_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define __CM4_CMSIS_VERSION_MAIN	5U	///< Version of the replaced header
+#define __CM4_CMSIS_VERSION_SUB		4U	///< Version of the replaced header
+#define __CORTEX_M					4U	///< Cortex-M core
+
+#define __I		volatile const			///< Read only register
+#define __O		volatile				///< Write only register
+#define __IO	volatile				///< Read and write register
+#define __IM	volatile const			///< Read only struct member
+#define __OM	volatile				///< Write only struct member
+#define __IOM	volatile				///< Read and write struct member
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE			static inline
+#endif
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE	static inline
+#endif
+
+#define DWT_CTRL_CYCCNTENA_Msk		(1UL)		///< DWT CTRL: CYCCNTENA
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24)	///< DEMCR: TRCENA
+
+#define DWT			(&MOCK_dwt)			///< Data watchpoint and trace
+#define CoreDebug	(&MOCK_core_debug)	///< Core debug registers
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Data watchpoint and trace unit, cycle counter only */
+typedef struct {
+	__IOM uint32_t CTRL;				///< Control register
+	__IOM uint32_t CYCCNT;				///< Cycle count register
+} DWT_Type;
+
+/** Core debug registers */
+typedef struct {
+	__IOM uint32_t DHCSR;				///< Halting control and status
+	__OM uint32_t DCRSR;				///< Core register selector
+	__IOM uint32_t DCRDR;				///< Core register data
+	__IOM uint32_t DEMCR;				///< Exception and monitor control
+} CoreDebug_Type;
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern DWT_Type MOCK_dwt;				///< Cycle counter, advanced by tests
+extern CoreDebug_Type MOCK_core_debug;	///< Debug registers
+extern volatile uint32_t MOCK_primask;	///< 1 while interrupts are masked
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void MOCK_nvic_enable(int32_t irq, uint32_t enable);
+void MOCK_nvic_clear(int32_t irq);
+void MOCK_masked(void);
+void MOCK_unmasked(void);
+void MOCK_wfi(void);
+
+/** Enable an interrupt line, pending interrupts are taken right away */
+__STATIC_INLINE void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	MOCK_nvic_enable(IRQn, 1);
+}
+
+/** Disable an interrupt line, it may still become pending */
+__STATIC_INLINE void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	MOCK_nvic_enable(IRQn, 0);
+}
+
+/** Drop a pending interrupt */
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+	MOCK_nvic_clear(IRQn);
+}
+
+/** Priorities are not modelled, handlers never nest */
+__STATIC_INLINE void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+	(void)IRQn;
+	(void)priority;
+}
+
+/** Get the interrupt mask */
+__STATIC_INLINE uint32_t __get_PRIMASK(void)
+{
+	return MOCK_primask;
+}
+
+/** Set the interrupt mask, unmasking takes the pending interrupts */
+__STATIC_INLINE void __set_PRIMASK(uint32_t priMask)
+{
+	MOCK_primask = priMask & 1;
+	if (MOCK_primask == 0) {
+		MOCK_unmasked();
+	} else {
+		MOCK_masked();
+	}
+}
+
+/** Mask all interrupts, see MOCK_masked() */
+__STATIC_INLINE void __disable_irq(void)
+{
+	MOCK_primask = 1;
+	MOCK_masked();
+}
+
+/** Unmask all interrupts, the pending ones are taken right away */
+__STATIC_INLINE void __enable_irq(void)
+{
+	MOCK_primask = 0;
+	MOCK_unmasked();
+}
+
+/** Wait for interrupt, see MOCK_wfi() */
+__STATIC_INLINE void __WFI(void)
+{
+	MOCK_wfi();
+}
+
+/** Memory barriers map to a full fence of the host */
+__STATIC_INLINE void __DMB(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/** Data synchronisation barrier */
+__STATIC_INLINE void __DSB(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/** Instruction synchronisation barrier */
+__STATIC_INLINE void __ISB(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/** No operation */
+__STATIC_INLINE void __NOP(void)
+{
+}
+
+
+#endif /* MOCK_CORE_CM4_H_ */
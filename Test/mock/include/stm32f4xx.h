@@ -0,0 +1,51 @@
+/** ***************************************************************************
+ * @file
+ * @brief Host replacement of the device header, see mock.c
+ *
+ * Prefix MOCK
+ *
+ * Includes the real stm32f4xx.h for the register structs, bit definitions
+ * and the HAL declarations, then moves the peripherals on the APB1, APB2
+ * and AHB1 busses into MOCK_periph. All peripheral pointers (TIM2, ADC1,
+ * DMA2, DMA2_Stream0, ...) derive from PERIPH_BASE, so they point into
+ * host memory and the drivers run unchanged.
+ * @n Accesses through the DMA2D pointer first run a started transfer of
+ * the DMA2D model, see mock/display.c.
+ *****************************************************************************/
+
+#ifndef MOCK_STM32F4XX_H_
+#define MOCK_STM32F4XX_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdint.h>
+
+#include_next "stm32f4xx.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_PERIPH_SIZE	0x30000UL	///< APB1, APB2 and AHB1 [bytes]
+
+#undef PERIPH_BASE
+#define PERIPH_BASE		((uintptr_t)MOCK_periph)	///< Registers in host RAM
+
+#undef DMA2D
+#define DMA2D			MOCK_dma2d()	///< Registers after a started transfer
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t MOCK_periph[MOCK_PERIPH_SIZE/4];	///< Peripheral registers
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+DMA2D_TypeDef* MOCK_dma2d(void);
+
+
+#endif /* MOCK_STM32F4XX_H_ */
@@ -0,0 +1,510 @@
+/** ***************************************************************************
+ * @file
+ * @brief Host model of the registers, the NVIC and the DMA2 of the STM32F429
+ *
+ * Contained functionality:
+ * ==============================================================
+ *
+ * - Peripheral registers as plain host memory, see mock/include/stm32f4xx.h
+ * - Interrupt mask, NVIC enable and pending bits, vector table
+ * - WFI returning on a pending interrupt, like with PRIMASK set
+ * - DMA2 streams between peripherals and memory with flags and interrupts
+ * - EXTI edges, HAL tick, cycle counter and SystemCoreClock
+ *
+ * The Core sources are compiled for the host against this layer. They write
+ * and read their registers as on the target, the tests then play the part
+ * of the hardware: MOCK_dma_transfer() delivers ADC results like the DMA,
+ * MOCK_dma_send() takes the bytes of the USART transmitter, MOCK_exti()
+ * presses the button, MOCK_irq() raises any other interrupt.
+ *
+ * Interrupts are taken synchronously, as soon as they are raised, enabled
+ * and not masked. Handlers never nest, an interrupt raised by a handler is
+ * taken when it returns. Flags cleared with a write of 1 (DMA LIFCR/HIFCR,
+ * EXTI PR) are cleared by the model when the handler returns.
+ *
+ * The model is not thread safe. One thread plays the hardware and runs the
+ * handlers, another thread may only use the lock-free interfaces.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mock.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_DMA_STREAMS	8		///< Streams of DMA2
+#define MOCK_DMA_TCIF		0x20	///< Transfer complete flag of stream 0
+#define MOCK_DMA_HTIF		0x10	///< Half transfer flag of stream 0
+#define MOCK_SYSTICK		MOCK_IRQ_COUNT	///< Slot of the SysTick
+#define MOCK_SLOTS			(MOCK_IRQ_COUNT+1)	///< Modelled interrupts
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+uint32_t MOCK_periph[MOCK_PERIPH_SIZE/4];	///< Peripheral registers
+DWT_Type MOCK_dwt;						///< Cycle counter, advanced by tests
+CoreDebug_Type MOCK_core_debug;			///< Debug registers
+volatile uint32_t MOCK_primask = 0;		///< 1 while interrupts are masked
+uint32_t SystemCoreClock = MOCK_CORE_CLOCK;	///< Core clock [Hz]
+uint32_t MOCK_tick = 0;					///< Value of HAL_GetTick() [ms]
+MOCK_hook_t MOCK_sleep_hook = NULL;		///< Called by __WFI() without wake up
+MOCK_hook_t MOCK_mask_hook = NULL;		///< Called when interrupts get masked
+uint32_t MOCK_dma_latency = 0;			///< Transfers before an ISR is entered
+
+static bool MOCK_enabled[MOCK_IRQ_COUNT];	///< NVIC enable bits
+static bool MOCK_pending[MOCK_SLOTS];	///< NVIC pending bits and SysTick
+static bool MOCK_active = false;		///< A handler is running
+static uint32_t MOCK_dma_ndtr[MOCK_DMA_STREAMS];	///< NDTR left by the model
+static uint32_t MOCK_dma_reload[MOCK_DMA_STREAMS];	///< NDTR at enable
+static uint32_t MOCK_dma_due[MOCK_DMA_STREAMS];	///< Transfers until the ISR
+
+/// Flag position of each stream in LISR and HISR
+static const uint8_t MOCK_dma_shift[MOCK_DMA_STREAMS] = {
+		0, 6, 16, 22, 0, 6, 16, 22
+};
+/// Interrupt line of each stream
+static const IRQn_Type MOCK_dma_irq[MOCK_DMA_STREAMS] = {
+		DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn,
+		DMA2_Stream3_IRQn, DMA2_Stream4_IRQn, DMA2_Stream5_IRQn,
+		DMA2_Stream6_IRQn, DMA2_Stream7_IRQn
+};
+
+// Handlers of the Core sources, missing ones are not linked into a test
+void EXTI0_IRQHandler(void) __attribute__((weak));
+void TIM2_IRQHandler(void) __attribute__((weak));
+void EXTI15_10_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream0_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream1_IRQHandler(void) __attribute__((weak));
+void DMA2_Stream7_IRQHandler(void) __attribute__((weak));
+void I2C3_EV_IRQHandler(void) __attribute__((weak));
+void I2C3_ER_IRQHandler(void) __attribute__((weak));
+void LTDC_IRQHandler(void) __attribute__((weak));
+void DMA2D_IRQHandler(void) __attribute__((weak));
+void MOCK_SysTick_Handler(void) __attribute__((weak));
+
+// DMA2D of the display model, not linked without it
+void MOCK_dma2d_poll(void) __attribute__((weak));
+
+/// Vector table of the device interrupts
+static void (* const MOCK_vectors[MOCK_IRQ_COUNT])(void) = {
+		[EXTI0_IRQn] = EXTI0_IRQHandler,
+		[TIM2_IRQn] = TIM2_IRQHandler,
+		[EXTI15_10_IRQn] = EXTI15_10_IRQHandler,
+		[DMA2_Stream0_IRQn] = DMA2_Stream0_IRQHandler,
+		[DMA2_Stream1_IRQn] = DMA2_Stream1_IRQHandler,
+		[DMA2_Stream7_IRQn] = DMA2_Stream7_IRQHandler,
+		[I2C3_EV_IRQn] = I2C3_EV_IRQHandler,
+		[I2C3_ER_IRQn] = I2C3_ER_IRQHandler,
+		[LTDC_IRQn] = LTDC_IRQHandler,
+		[DMA2D_IRQn] = DMA2D_IRQHandler
+};
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Clear all registers and the state of the core model
+ *
+ * Hooks and the DMA latency are reset as well.
+ *****************************************************************************/
+void MOCK_reset(void)
+{
+	memset(MOCK_periph, 0, sizeof(MOCK_periph));
+	memset(&MOCK_dwt, 0, sizeof(MOCK_dwt));
+	memset(&MOCK_core_debug, 0, sizeof(MOCK_core_debug));
+	memset(MOCK_enabled, 0, sizeof(MOCK_enabled));
+	memset(MOCK_pending, 0, sizeof(MOCK_pending));
+	memset(MOCK_dma_ndtr, 0, sizeof(MOCK_dma_ndtr));
+	memset(MOCK_dma_reload, 0, sizeof(MOCK_dma_reload));
+	memset(MOCK_dma_due, 0, sizeof(MOCK_dma_due));
+	MOCK_primask = 0;
+	MOCK_active = false;
+	MOCK_tick = 0;
+	MOCK_sleep_hook = NULL;
+	MOCK_mask_hook = NULL;
+	MOCK_dma_latency = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Clear the flags written to the DMA2 flag clear registers
+ *****************************************************************************/
+static void MOCK_dma_clear(void)
+{
+	DMA2->LISR &= ~DMA2->LIFCR;
+	DMA2->LIFCR = 0;
+	DMA2->HISR &= ~DMA2->HIFCR;
+	DMA2->HIFCR = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Index of an interrupt in the NVIC model
+ * @param [in] irq, device interrupt or SysTick_IRQn
+ * @return slot, MOCK_IRQ_COUNT if not modelled
+ *
+ * The SysTick takes the slot after the device interrupts.
+ *****************************************************************************/
+static int32_t MOCK_slot(IRQn_Type irq)
+{
+	if (irq == SysTick_IRQn) {
+		return MOCK_SYSTICK;
+	}
+	if ((irq >= 0) && (irq < MOCK_IRQ_COUNT)) {
+		return irq;
+	}
+	return MOCK_SLOTS;
+}
+
+
+/** ***************************************************************************
+ * @brief Run one interrupt handler
+ * @param [in] slot of the interrupt
+ *****************************************************************************/
+static void MOCK_handle(int32_t slot)
+{
+	MOCK_pending[slot] = false;
+	MOCK_active = true;
+	if (slot == MOCK_SYSTICK) {
+		if (MOCK_SysTick_Handler != NULL) {
+			MOCK_SysTick_Handler();
+		}
+	} else if (MOCK_vectors[slot] != NULL) {
+		MOCK_vectors[slot]();
+	}
+	MOCK_active = false;
+	MOCK_dma_clear();
+	if ((slot >= EXTI0_IRQn) && (slot <= EXTI4_IRQn)) {
+		EXTI->PR &= ~(1UL << (slot - EXTI0_IRQn));
+	} else if (slot == EXTI9_5_IRQn) {
+		EXTI->PR &= ~0x03E0UL;
+	} else if (slot == EXTI15_10_IRQn) {
+		EXTI->PR &= ~0xFC00UL;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Next pending and enabled interrupt
+ * @return slot, MOCK_SLOTS if there is none
+ *
+ * The SysTick comes first, then the lowest interrupt number, like
+ * priorities would.
+ *****************************************************************************/
+static int32_t MOCK_next(void)
+{
+	if (MOCK_pending[MOCK_SYSTICK]) {
+		return MOCK_SYSTICK;
+	}
+	for (int32_t slot = 0; slot < MOCK_IRQ_COUNT; ++slot) {
+		if (MOCK_pending[slot] && MOCK_enabled[slot]) {
+			return slot;
+		}
+	}
+	return MOCK_SLOTS;
+}
+
+
+/** ***************************************************************************
+ * @brief Take all pending and enabled interrupts, if not masked
+ *****************************************************************************/
+static void MOCK_take(void)
+{
+	int32_t slot;
+	while ((MOCK_primask == 0) && !MOCK_active
+		   && ((slot = MOCK_next()) < MOCK_SLOTS)) {
+		MOCK_handle(slot);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Enable or disable an interrupt line, see NVIC_EnableIRQ()
+ * @param [in] irq
+ * @param [in] enable
+ *****************************************************************************/
+void MOCK_nvic_enable(int32_t irq, uint32_t enable)
+{
+	if ((irq >= 0) && (irq < MOCK_IRQ_COUNT)) {
+		MOCK_enabled[irq] = enable;
+		MOCK_take();
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Drop a pending interrupt, see NVIC_ClearPendingIRQ()
+ * @param [in] irq
+ *****************************************************************************/
+void MOCK_nvic_clear(int32_t irq)
+{
+	if ((irq >= 0) && (irq < MOCK_IRQ_COUNT)) {
+		MOCK_pending[irq] = false;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupts were masked, see __disable_irq()
+ *
+ * MOCK_mask_hook may raise interrupts inside the masked section, they stay
+ * pending until the code under test unmasks again.
+ *****************************************************************************/
+void MOCK_masked(void)
+{
+	static bool inside = false;
+	if ((MOCK_mask_hook != NULL) && !inside) {
+		inside = true;
+		MOCK_mask_hook();
+		inside = false;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupts were unmasked, see __set_PRIMASK()
+ *****************************************************************************/
+void MOCK_unmasked(void)
+{
+	MOCK_take();
+}
+
+
+/** ***************************************************************************
+ * @brief Wait for an interrupt, see __WFI()
+ *
+ * Returns at once if an enabled interrupt is pending, even while PRIMASK
+ * is set, like the core does. Otherwise MOCK_sleep_hook has to raise the
+ * interrupt ending the sleep. Sleeping without any wake up is a deadlock
+ * of the code under test, it ends the test.
+ *****************************************************************************/
+void MOCK_wfi(void)
+{
+	if ((MOCK_next() == MOCK_SLOTS) && (MOCK_sleep_hook != NULL)) {
+		MOCK_sleep_hook();
+	}
+	if (MOCK_next() == MOCK_SLOTS) {
+		fprintf(stderr, "MOCK: WFI without a pending interrupt, deadlock\n");
+		abort();
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Raise an interrupt
+ * @param [in] irq, SysTick_IRQn runs MOCK_SysTick_Handler() of the test
+ *
+ * The interrupt is taken right away if it is enabled and not masked,
+ * otherwise it stays pending. The SysTick is always enabled.
+ *****************************************************************************/
+void MOCK_irq(IRQn_Type irq)
+{
+	int32_t slot = MOCK_slot(irq);
+	if (slot < MOCK_SLOTS) {
+		MOCK_pending[slot] = true;
+		MOCK_take();
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Is an interrupt line enabled in the NVIC?
+ * @param [in] irq
+ * @return true if enabled
+ *****************************************************************************/
+bool MOCK_irq_enabled(IRQn_Type irq)
+{
+	return (irq >= 0) && (irq < MOCK_IRQ_COUNT) && MOCK_enabled[irq];
+}
+
+
+/** ***************************************************************************
+ * @brief Is an interrupt pending?
+ * @param [in] irq
+ * @return true if pending
+ *****************************************************************************/
+bool MOCK_irq_pending(IRQn_Type irq)
+{
+	int32_t slot = MOCK_slot(irq);
+	return (slot < MOCK_SLOTS) && MOCK_pending[slot];
+}
+
+
+/** ***************************************************************************
+ * @brief Let a DMA2 stream transfer halfwords from its peripheral to memory
+ * @param [in] stream of DMA2
+ * @param [in] data delivered by the peripheral, one halfword per request
+ * @param [in] count of requests
+ * @return transfers done, fewer if the stream stopped
+ *
+ * Models the peripheral to memory direction with 16 bit memory size:
+ * - The item written is NDTR counted back from the value at enable.
+ * - NDTR decrements, the half transfer and transfer complete flags are set.
+ * - At the end a normal stream is disabled, a circular one reloads NDTR.
+ *   In double buffer mode the CT bit also switches M0AR and M1AR.
+ * - Enabled interrupts are raised MOCK_dma_latency transfers later, while
+ *   the stream keeps writing, like a late ISR entry on the target.
+ *
+ * A NDTR value not left by the model was written by the driver, the stream
+ * then starts from the first item.
+ *****************************************************************************/
+uint32_t MOCK_dma_transfer(DMA_Stream_TypeDef* stream, const uint16_t* data,
+						   uint32_t count)
+{
+	uint32_t s = ((uintptr_t)stream - (uintptr_t)DMA2_Stream0)
+			   / sizeof(DMA_Stream_TypeDef);
+	volatile uint32_t* isr = (s < 4) ? &DMA2->LISR : &DMA2->HISR;
+	uint32_t done = 0;
+
+	MOCK_dma_clear();
+	if (stream->NDTR != MOCK_dma_ndtr[s]) {	// Written by the driver
+		MOCK_dma_reload[s] = stream->NDTR;
+		MOCK_dma_ndtr[s] = stream->NDTR;
+	}
+	while ((done < count) && (stream->CR & DMA_SxCR_EN)
+		   && (MOCK_dma_reload[s] > 0)) {
+		bool m1 = (stream->CR & DMA_SxCR_DBM) && (stream->CR & DMA_SxCR_CT);
+		uint16_t* memory = (uint16_t*)(uintptr_t)(m1 ? stream->M1AR
+													  : stream->M0AR);
+		uint32_t raise = 0;
+		memory[MOCK_dma_reload[s] - stream->NDTR] = data[done++];
+		stream->NDTR--;
+		if (stream->NDTR == MOCK_dma_reload[s]/2) {
+			*isr |= MOCK_DMA_HTIF << MOCK_dma_shift[s];
+			raise = stream->CR & DMA_SxCR_HTIE;
+		}
+		if (stream->NDTR == 0) {
+			*isr |= MOCK_DMA_TCIF << MOCK_dma_shift[s];
+			raise = stream->CR & DMA_SxCR_TCIE;
+			if (stream->CR & DMA_SxCR_DBM) {
+				stream->CR ^= DMA_SxCR_CT;	// Switch to the other buffer
+				stream->NDTR = MOCK_dma_reload[s];
+			} else if (stream->CR & DMA_SxCR_CIRC) {
+				stream->NDTR = MOCK_dma_reload[s];
+			} else {
+				stream->CR &= ~DMA_SxCR_EN;	// Stream done
+			}
+		}
+		MOCK_dma_ndtr[s] = stream->NDTR;
+		if (raise && (MOCK_dma_due[s] == 0)) {
+			MOCK_dma_due[s] = MOCK_dma_latency + 1;
+		}
+		if ((MOCK_dma_due[s] > 0) && (--MOCK_dma_due[s] == 0)) {
+			MOCK_irq(MOCK_dma_irq[s]);
+			if (stream->NDTR != MOCK_dma_ndtr[s]) {	// Restarted by the ISR
+				MOCK_dma_reload[s] = stream->NDTR;
+				MOCK_dma_ndtr[s] = stream->NDTR;
+			}
+		}
+	}
+	if ((MOCK_dma_due[s] > 0) && !(stream->CR & DMA_SxCR_EN)) {
+		MOCK_dma_due[s] = 0;			// Stopped, nothing delays the ISR
+		MOCK_irq(MOCK_dma_irq[s]);
+	}
+	return done;
+}
+
+
+/** ***************************************************************************
+ * @brief Let a DMA2 stream transfer bytes from memory to its peripheral
+ * @param [in] stream of DMA2
+ * @param [out] data taken by the peripheral, one byte per request
+ * @param [in] count of requests
+ * @return transfers done, fewer if the stream stopped
+ *
+ * Models the memory to peripheral direction of a normal stream with 8 bit
+ * memory size, like a USART transmitter:
+ * - The item read is NDTR counted back from the value at enable.
+ * - NDTR decrements, the half transfer and transfer complete flags are set.
+ * - At the end the stream is disabled and its enabled interrupts raised.
+ *   The handler may start the stream again, the transfer goes on in the
+ *   same call.
+ *****************************************************************************/
+uint32_t MOCK_dma_send(DMA_Stream_TypeDef* stream, uint8_t* data,
+					   uint32_t count)
+{
+	uint32_t s = ((uintptr_t)stream - (uintptr_t)DMA2_Stream0)
+			   / sizeof(DMA_Stream_TypeDef);
+	volatile uint32_t* isr = (s < 4) ? &DMA2->LISR : &DMA2->HISR;
+	uint32_t done = 0;
+
+	MOCK_dma_clear();
+	while ((done < count) && (stream->CR & DMA_SxCR_EN)) {
+		if (stream->NDTR != MOCK_dma_ndtr[s]) {	// Written by the driver
+			MOCK_dma_reload[s] = stream->NDTR;
+			MOCK_dma_ndtr[s] = stream->NDTR;
+		}
+		if (MOCK_dma_reload[s] == 0) {
+			break;
+		}
+		const uint8_t* memory = (const uint8_t*)(uintptr_t)stream->M0AR;
+		uint32_t raise = 0;
+		data[done++] = memory[MOCK_dma_reload[s] - stream->NDTR];
+		stream->NDTR--;
+		MOCK_dma_ndtr[s] = stream->NDTR;
+		if (stream->NDTR == MOCK_dma_reload[s]/2) {
+			*isr |= MOCK_DMA_HTIF << MOCK_dma_shift[s];
+			raise = stream->CR & DMA_SxCR_HTIE;
+		}
+		if (stream->NDTR == 0) {
+			*isr |= MOCK_DMA_TCIF << MOCK_dma_shift[s];
+			raise = stream->CR & DMA_SxCR_TCIE;
+			stream->CR &= ~DMA_SxCR_EN;	// Stream done
+		}
+		if (raise) {
+			MOCK_irq(MOCK_dma_irq[s]);
+		}
+	}
+	return done;
+}
+
+
+/** ***************************************************************************
+ * @brief Rising edge on an EXTI line
+ * @param [in] line 0 to 15
+ *
+ * Sets the pending bit and raises the interrupt if the line is unmasked.
+ *****************************************************************************/
+void MOCK_exti(uint32_t line)
+{
+	if (!(EXTI->RTSR & (1UL << line))) {
+		return;							// Rising edge not selected
+	}
+	EXTI->PR |= 1UL << line;
+	if (EXTI->IMR & (1UL << line)) {
+		if (line <= 4) {
+			MOCK_irq((IRQn_Type)(EXTI0_IRQn + line));
+		} else if (line <= 9) {
+			MOCK_irq(EXTI9_5_IRQn);
+		} else {
+			MOCK_irq(EXTI15_10_IRQn);
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Milliseconds since start, replaces the HAL tick
+ * @return MOCK_tick
+ *
+ * The HAL drivers read the tick while they poll a flag, a started DMA2D
+ * transfer completes here.
+ *****************************************************************************/
+uint32_t HAL_GetTick(void)
+{
+	if (MOCK_dma2d_poll != NULL) {
+		MOCK_dma2d_poll();
+	}
+	return MOCK_tick;
+}
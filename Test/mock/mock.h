@@ -0,0 +1,58 @@
+/** ***************************************************************************
+ * @file
+ * @brief See mock.c
+ *
+ * Prefix MOCK
+ *
+ *****************************************************************************/
+
+#ifndef MOCK_MOCK_H_
+#define MOCK_MOCK_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32f4xx.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define MOCK_IRQ_COUNT		91		///< Interrupt lines of the STM32F429
+#define MOCK_CORE_CLOCK		168000000	///< SystemCoreClock of the board [Hz]
+
+
+/******************************************************************************
+ * Types
+ *****************************************************************************/
+/** Callback of the core model */
+typedef void (*MOCK_hook_t)(void);
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+extern uint32_t MOCK_tick;				///< Value of HAL_GetTick() [ms]
+extern MOCK_hook_t MOCK_sleep_hook;		///< Called by __WFI() without wake up
+extern MOCK_hook_t MOCK_mask_hook;		///< Called when interrupts get masked
+extern uint32_t MOCK_dma_latency;		///< Transfers before an ISR is entered
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+void MOCK_reset(void);
+void MOCK_irq(IRQn_Type irq);
+bool MOCK_irq_enabled(IRQn_Type irq);
+bool MOCK_irq_pending(IRQn_Type irq);
+uint32_t MOCK_dma_transfer(DMA_Stream_TypeDef* stream, const uint16_t* data,
+						   uint32_t count);
+uint32_t MOCK_dma_send(DMA_Stream_TypeDef* stream, uint8_t* data,
+					   uint32_t count);
+void MOCK_exti(uint32_t line);
+
+
+#endif /* MOCK_MOCK_H_ */
@@ -0,0 +1,212 @@
+/** ***************************************************************************
+ * @file
+ * @brief Sweep of simulated cables through measuring and analytics
+ *
+ * Every scenario of the grid mode x harmonic x noise x distance x angle is
+ * generated by sim.c and measured like on the board: the button starts a
+ * triple scan, the frames arrive through the DMA model and the interrupt,
+ * the frame queue hands them to ANA_Handler() which returns distance and
+ * angle.
+ *
+ * The sweep prints the errors per mode, harmonic and noise level and the
+ * scenarios per second. As a test it checks that the distances of pure
+ * sines are found and that the sweep runs at least SWEEP_MIN_RATE
+ * scenarios/s. The third harmonic lowers the peaks, the errors it causes
+ * with the peak engine are only reported.
+ *
+ *   sim_sweep [repetitions]
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "analytics.h"
+#include "events.h"
+#include "sim.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define SWEEP_ACCURACY		4		///< Frames per measurement, ANA_inOptn[3]
+#define SWEEP_HARMONICS		2		///< Harmonic contents of the grid
+#define SWEEP_NOISES		3		///< Noise levels of the grid
+#define SWEEP_MIN_RATE		1000	///< Required scenarios per second
+#define SWEEP_MAX_PASSES	64		///< Main loop passes per scenario
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t SWEEP_frame[MEAS_QUAD_STRIDE*MEAS_MAX_SAMPLES];	///< DR data
+
+static const float SWEEP_distances[] = {10, 20, 30, 40, 60, 80, 120, 180};
+static const float SWEEP_angles[] = {-20, -10, 0, 10, 20};
+static const float SWEEP_harmonics[SWEEP_HARMONICS] = {0, 0.05f};
+static const float SWEEP_noises[SWEEP_NOISES] = {0, 3, 10};	///< [digits]
+
+/** Errors of one mode, harmonic and noise level */
+typedef struct {
+	unsigned count;					///< Scenarios
+	unsigned missing;				///< Scenarios without result
+	double distance;				///< Sum of squared distance errors
+	double distance_max;			///< Largest distance error [mm]
+	double angle;					///< Sum of squared angle errors
+	double confidence;				///< Sum of the confidences
+} SWEEP_stats_t;
+
+static SWEEP_stats_t SWEEP_stats[CALC_MODES][SWEEP_HARMONICS][SWEEP_NOISES];
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Measure one scenario like main.c does
+ * @param [in] scenario
+ * @return true if the analytics delivered a result
+ *
+ * Each started triple scan gets the next frame of the scenario.
+ *****************************************************************************/
+static bool SWEEP_measure(const SIM_scenario_t* scenario)
+{
+	MEAS_frame_t frame;
+	uint32_t samples = MEAS_config.samples;
+	ANA_outDataReady = false;
+	ANA_inBtn = true;
+	for (int pass = 0; pass < SWEEP_MAX_PASSES; ++pass) {
+		if (MEAS_frame_read(&frame)) {
+			ANA_inAmpLeft = frame.amplitude_left;
+			ANA_inAmpRight = frame.amplitude_right;
+			ANA_inHallLeft = frame.amplitude_hall_in6;
+			ANA_inHallRight = frame.amplitude_hall_in11;
+			ANA_inPhase = frame.phase_right - frame.phase_left;
+			ANA_inMeasReady = true;
+		}
+		if (ANA_outStartQUAD) {
+			ADC123_quad_scan_init();
+			ADC123_triple_scan_start();
+			ANA_outStartQUAD = false;
+			SIM_quad_frame(scenario, SWEEP_frame, samples, MEAS_QUAD_STRIDE,
+						   (float)MEAS_config.rate);
+			MOCK_dma_transfer(DMA2_Stream0, SWEEP_frame,
+							  MEAS_QUAD_STRIDE*samples);
+		}
+		ANA_Handler();
+		if (ANA_outDataReady && !ANA_measBusy) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/** ***************************************************************************
+ * @brief Run the grid once
+ *****************************************************************************/
+static void SWEEP_grid(void)
+{
+	SIM_scenario_t scenario = {0, 0, 0, 5.0f, 50.0f, 0, 0, 0};
+	uint32_t seed = 1;
+	for (uint16_t mode = 0; mode < CALC_MODES; ++mode) {
+		ANA_inOptn[0] = mode;
+		scenario.mode = mode;
+		for (int h = 0; h < SWEEP_HARMONICS; ++h) {
+			scenario.harmonic = SWEEP_harmonics[h];
+			for (int n = 0; n < SWEEP_NOISES; ++n) {
+				SWEEP_stats_t* stats = &SWEEP_stats[mode][h][n];
+				scenario.noise = SWEEP_noises[n];
+				for (unsigned d = 0;
+						d < sizeof(SWEEP_distances)/sizeof(float); ++d) {
+					for (unsigned a = 0;
+							a < sizeof(SWEEP_angles)/sizeof(float); ++a) {
+						scenario.distance = SWEEP_distances[d];
+						scenario.angle = SWEEP_angles[a];
+						SIM_reset(seed++);
+						stats->count++;
+						if (!SWEEP_measure(&scenario)) {
+							stats->missing++;
+							continue;
+						}
+						double error = ANA_outResults[1] - scenario.distance;
+						stats->distance += error*error;
+						stats->distance_max = fmax(stats->distance_max,
+												   fabs(error));
+						error = ANA_outResults[0] - scenario.angle;
+						stats->angle += error*error;
+						stats->confidence += ANA_outConfidence;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Sweep, print the statistics and check them
+ * @param [in] argc
+ * @param [in] argv optional number of repetitions of the grid
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(int argc, char** argv)
+{
+	int repetitions = (argc > 1) ? atoi(argv[1]) : 10;
+	static const char* modes[CALC_MODES] = {"L", "LN", "LNPE"};
+
+	MOCK_reset();
+	MEAS_config = MEAS_presets[MEAS_PRESET_STANDARD];
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	MEAS_oversampling = false;
+	MEAS_GPIO_analog_init();
+	MEAS_timer_init();
+	ANA_Init();
+	EVT_init();
+	ANA_inOptn[3] = SWEEP_ACCURACY;
+
+	struct timespec start, stop;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int r = 0; r < repetitions; ++r) {
+		SWEEP_grid();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	double seconds = (stop.tv_sec - start.tv_sec)
+				   + (stop.tv_nsec - start.tv_nsec)*1e-9;
+
+	unsigned scenarios = 0;
+	printf("mode  harm.  noise  count  missing  distance rms/max [mm]  "
+		   "angle rms [deg]  confidence\n");
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		for (int h = 0; h < SWEEP_HARMONICS; ++h) {
+			for (int n = 0; n < SWEEP_NOISES; ++n) {
+				SWEEP_stats_t* stats = &SWEEP_stats[mode][h][n];
+				unsigned results = stats->count - stats->missing;
+				scenarios += stats->count;
+				printf("%-4s  %5.2f  %5.0f  %5u  %7u  %10.2f / %-10.2f  "
+					   "%15.2f  %10.2f\n", modes[mode], SWEEP_harmonics[h],
+					   SWEEP_noises[n], stats->count, stats->missing,
+					   sqrt(stats->distance/results), stats->distance_max,
+					   sqrt(stats->angle/results), stats->confidence/results);
+				CHECK_EQUAL(stats->missing, 0);
+			}
+		}
+		// Without noise the peak engine reproduces the LUT strengths
+		SWEEP_stats_t* pure = &SWEEP_stats[mode][0][0];
+		CHECK(sqrt(pure->distance/pure->count) < 2);
+		CHECK(sqrt(pure->angle/pure->count) < 5);
+	}
+	double rate = scenarios/seconds;
+	printf("%u scenarios in %.3f s, %.0f scenarios/s\n", scenarios, seconds,
+		   rate);
+	CHECK(rate > SWEEP_MIN_RATE);
+	UNIT_EXIT();
+}
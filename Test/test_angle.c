@@ -0,0 +1,191 @@
+/** ***************************************************************************
+ * @file
+ * @brief Angle estimation over a sweep of simulated cables
+ *
+ * sim.c gives the wpc and hall amplitudes of a cable turned from -45 to 45
+ * degrees in steps of TEST_STEP. They are rounded to whole digits like the
+ * amplitudes of the frames and converted like ANA_Handler() does, then
+ * CALC_Angle() estimates the angle.
+ * @n Where the LUTs are steep the angle has to be within a bound, of the
+ * right sign and increasing with the true angle, with and without the
+ * hall estimate. Where a LUT is flat a digit moves the angle by a lot, the
+ * confidence has to drop there. It has to stay within 0 to 1 everywhere.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+
+#include "unit.h"
+#include "analytics.h"
+#include "sim.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_LIMIT		45			///< Largest angle of the sweep [deg]
+#define TEST_STEP		5			///< Step of the sweep [deg]
+#define TEST_ANGLES		(2*TEST_LIMIT/TEST_STEP + 1)	///< Sweep points
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+// Conversions of analytics.c, not declared in analytics.h
+float CALC_DistanceMode(float measurement, uint16_t mode, bool right);
+float CALC_DistanceStep(float measurement, uint16_t mode, bool right);
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Estimate the angle of a simulated cable
+ * @param [in] scenario
+ * @param [in] phase of wpc right minus wpc left [rad]
+ * @return estimate of CALC_Angle()
+ *****************************************************************************/
+static CALC_angle_t TEST_estimate(const SIM_scenario_t* scenario,
+								  float phase)
+{
+	float amplitudes[SIM_SENSORS];
+	uint16_t mode = scenario->mode;
+
+	SIM_amplitudes(scenario, amplitudes);
+	for (int s = 0; s < SIM_SENSORS; ++s) {
+		amplitudes[s] = roundf(amplitudes[s]);	// Whole digits
+	}
+	float wpcLeft = amplitudes[SIM_WPC_LEFT];
+	float wpcRight = amplitudes[SIM_WPC_RIGHT];
+	float step = CALC_DistanceStep(wpcLeft, mode, false)
+			   + CALC_DistanceStep(wpcRight, mode, true);
+	return CALC_Angle(CALC_DistanceMode(wpcLeft, mode, false),
+					  CALC_DistanceMode(wpcRight, mode, true), step,
+					  amplitudes[SIM_HALL_IN6], amplitudes[SIM_HALL_IN11],
+					  phase, mode);
+}
+
+
+/** ***************************************************************************
+ * @brief Sweep the angle of a cable
+ * @param [in] cable type
+ * @param [in] distance [mm]
+ * @param [in] load current [A], 0 for the wpc estimate only
+ * @param [out] estimates from -TEST_LIMIT to TEST_LIMIT
+ *
+ * The confidence has to be within 0 and 1 at every angle.
+ *****************************************************************************/
+static void TEST_sweep(uint16_t mode, float distance, float current,
+					   CALC_angle_t* estimates)
+{
+	SIM_scenario_t scenario = {mode, distance, 0, current, 50, 0, 0, 0};
+	for (int a = 0; a < TEST_ANGLES; ++a) {
+		scenario.angle = (float)(a*TEST_STEP - TEST_LIMIT);
+		estimates[a] = TEST_estimate(&scenario, 0);
+		CHECK(estimates[a].confidence >= 0);
+		CHECK(estimates[a].confidence <= 1);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Error, sign and monotonicity of a sweep
+ * @param [in] estimates of TEST_sweep()
+ * @param [in] largest error [deg]
+ * @param [in] lowest confidence
+ *****************************************************************************/
+static void TEST_accurate(const CALC_angle_t* estimates, float error,
+						  float confidence)
+{
+	for (int a = 0; a < TEST_ANGLES; ++a) {
+		float angle = (float)(a*TEST_STEP - TEST_LIMIT);
+		CHECK_NEAR(estimates[a].angle, angle, error);
+		if (angle != 0) {
+			CHECK(estimates[a].angle*angle > 0);
+		}
+		if (a > 0) {
+			CHECK(estimates[a].angle > estimates[a-1].angle);
+		}
+		CHECK(estimates[a].confidence >= confidence);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Wpc estimate alone, the hall amplitudes are below CALC_HALLMIN
+ *
+ * L cable at 100 mm, the LUTs move by 0.6 to 1.7 mm per digit.
+ *****************************************************************************/
+static void test_wpc(void)
+{
+	CALC_angle_t estimates[TEST_ANGLES];
+	TEST_sweep(0, 100, 0, estimates);
+	TEST_accurate(estimates, 3, 0.8f);
+}
+
+
+/** ***************************************************************************
+ * @brief Wpc and hall estimate averaged
+ *
+ * Single conductor with 1/r and conductor pair with 1/r^2, the currents
+ * give hall amplitudes of about 100 digits.
+ *****************************************************************************/
+static void test_hall(void)
+{
+	CALC_angle_t estimates[TEST_ANGLES];
+	TEST_sweep(0, 100, 5, estimates);
+	TEST_accurate(estimates, 2, 0.8f);
+
+	TEST_sweep(2, 60, 60, estimates);
+	TEST_accurate(estimates, 3, 0.5f);
+}
+
+
+/** ***************************************************************************
+ * @brief Flat LUT segments lower the confidence
+ *
+ * The LN left LUT falls by 3 digits from 100 mm to 150 mm. At 125 mm one
+ * digit moves the left distance by about 17 mm, the confidence must be
+ * well below that of the steep L LUTs at every angle.
+ *****************************************************************************/
+static void test_flat(void)
+{
+	CALC_angle_t flat[TEST_ANGLES];
+	CALC_angle_t steep[TEST_ANGLES];
+	TEST_sweep(1, 125, 0, flat);
+	TEST_sweep(0, 125, 0, steep);
+	for (int a = 0; a < TEST_ANGLES; ++a) {
+		CHECK(flat[a].confidence < 0.5f*steep[a].confidence);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Wpc signals out of phase are not a single cable
+ *****************************************************************************/
+static void test_phase(void)
+{
+	SIM_scenario_t scenario = {0, 100, 20, 0, 50, 0, 0, 0};
+	float inPhase = TEST_estimate(&scenario, 0).confidence;
+	CHECK(TEST_estimate(&scenario, 1.0f).confidence < 0.6f*inPhase);
+	CHECK_EQUAL(TEST_estimate(&scenario, 3.1f).confidence, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	ANA_Init();
+	UNIT_RUN(test_wpc);
+	UNIT_RUN(test_hall);
+	UNIT_RUN(test_flat);
+	UNIT_RUN(test_phase);
+	UNIT_EXIT();
+}
@@ -0,0 +1,356 @@
+/** ***************************************************************************
+ * @file
+ * @brief Calibration record, fit and flash storage
+ *
+ * The CRC-32 against its check value and every single bit error of a
+ * record, the fit against a brute force isotonic regression and the slot
+ * log of the sector on the RAM model of mock/flash.c: rotation through all
+ * slots and recovery after a power loss at every word of a save.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "flash.h"
+#include "unit.h"
+#include "calibration.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_WORDS		(sizeof(CAL_record_t)/4)	///< Words of a record
+#define TEST_FITS		1000		///< Random vectors for the fit
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Fill all tables in use with values derived from a tag
+ * @param [in] tag
+ *****************************************************************************/
+static void TEST_tables(float tag)
+{
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		for (int i = 0; i < CALC_LUTSIZE; ++i) {
+			CALC_wpcLeft[mode][i] = tag*1000 - 10*i - mode;
+			CALC_wpcRight[mode][i] = tag*2000 - 20*i - mode;
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Check if the tables in use are the ones of a tag
+ * @param [in] tag
+ * @return true if all values match
+ *****************************************************************************/
+static bool TEST_tables_are(float tag)
+{
+	bool equal = true;
+	for (int mode = 0; mode < CALC_MODES; ++mode) {
+		for (int i = 0; i < CALC_LUTSIZE; ++i) {
+			equal = equal && (CALC_wpcLeft[mode][i] == tag*1000 - 10*i - mode)
+					&& (CALC_wpcRight[mode][i] == tag*2000 - 20*i - mode);
+		}
+	}
+	return equal;
+}
+
+
+/** ***************************************************************************
+ * @brief Record in a slot of the sector
+ * @param [in] slot
+ * @return record, may be invalid
+ *****************************************************************************/
+static const CAL_record_t* TEST_slot(uint32_t slot)
+{
+	return (const CAL_record_t*)&MOCK_flash[slot*CAL_SLOT_SIZE];
+}
+
+
+/** ***************************************************************************
+ * @brief Power on after a reset, the built-in tables are overwritten
+ * @return result of CAL_load()
+ *****************************************************************************/
+static bool TEST_boot(void)
+{
+	TEST_tables(-1);
+	CAL_sequence = 0;
+	MOCK_flash_cut = MOCK_FLASH_NO_CUT;
+	return CAL_load();
+}
+
+
+/** ***************************************************************************
+ * @brief Isotonic regression by the min-max formula
+ * @param [in] x measured values
+ * @param [out] y non-increasing least squares fit
+ * @param [in] n number of values
+ *
+ * y[i] is the minimum over j <= i of the maximum over k >= i of the mean of
+ * x[j] to x[k].
+ *****************************************************************************/
+static void TEST_isotonic(const float* x, float* y, int n)
+{
+	double sum[CALC_LUTMAXSIZE+1] = {0};
+	for (int i = 0; i < n; ++i) {
+		sum[i+1] = sum[i] + x[i];
+	}
+	for (int i = 0; i < n; ++i) {
+		double best = INFINITY;
+		for (int j = 0; j <= i; ++j) {
+			double worst = -INFINITY;
+			for (int k = i; k < n; ++k) {
+				worst = fmax(worst, (sum[k+1] - sum[j])/(k - j + 1));
+			}
+			best = fmin(best, worst);
+		}
+		y[i] = (float)best;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief CRC-32 check value and detection of all single bit errors
+ *****************************************************************************/
+static void test_crc(void)
+{
+	CAL_record_t record;
+	uint8_t* bytes = (uint8_t*)&record;
+	uint32_t undetected = 0;
+
+	CHECK_EQUAL(CAL_crc32("123456789", 9), 0xCBF43926);
+	CHECK_EQUAL(CAL_crc32("", 0), 0);
+
+	TEST_tables(1);
+	CAL_record_fill(&record, 7);
+	CHECK(CAL_record_valid(&record));
+	for (uint32_t i = 0; i < offsetof(CAL_record_t, crc) + 4; ++i) {
+		for (int b = 0; b < 8; ++b) {
+			bytes[i] ^= 1 << b;
+			undetected += CAL_record_valid(&record);
+			bytes[i] ^= 1 << b;
+		}
+	}
+	CHECK_EQUAL(undetected, 0);
+	CHECK(CAL_record_valid(&record));
+
+	// Foreign records with a correct CRC
+	record.version = CAL_VERSION + 1;
+	record.crc = CAL_crc32(&record, offsetof(CAL_record_t, crc));
+	CHECK(!CAL_record_valid(&record));
+	CAL_record_fill(&record, 7);
+	record.points = CALC_LUTSIZE - 1;
+	record.crc = CAL_crc32(&record, offsetof(CAL_record_t, crc));
+	CHECK(!CAL_record_valid(&record));
+}
+
+
+/** ***************************************************************************
+ * @brief Pooling of adjacent violators equals the isotonic regression
+ *****************************************************************************/
+static void test_fit(void)
+{
+	float falling[] = {900, 700, 700, 400, 100};
+	float bump[] = {10, 8, 9, 7};
+	float rising[] = {1, 2, 3, 4};
+	float x[CALC_LUTMAXSIZE];
+	float y[CALC_LUTMAXSIZE];
+	float fit[CALC_LUTMAXSIZE];
+	float error = 0;
+	uint32_t rises = 0;
+
+	CAL_fit(falling, 5);
+	CHECK_EQUAL(falling[0], 900);
+	CHECK_EQUAL(falling[2], 700);
+	CHECK_EQUAL(falling[4], 100);
+	CAL_fit(bump, 4);
+	CHECK_EQUAL(bump[0], 10);
+	CHECK_EQUAL(bump[1], 8.5f);
+	CHECK_EQUAL(bump[2], 8.5f);
+	CHECK_EQUAL(bump[3], 7);
+	CAL_fit(rising, 4);
+	for (int i = 0; i < 4; ++i) {
+		CHECK_EQUAL(rising[i], 2.5f);
+	}
+
+	// Noisy falling tables as measured by the wizard, and the longest table
+	srand(20);
+	for (int run = 0; run < TEST_FITS; ++run) {
+		int n = (run == 0) ? CALC_LUTMAXSIZE : 1 + rand() % CALC_LUTSIZE;
+		for (int i = 0; i < n; ++i) {
+			x[i] = 4000.0f/(1 + i) + (rand() % 1000)*0.5f;
+			fit[i] = x[i];
+		}
+		CAL_fit(fit, (uint16_t)n);
+		TEST_isotonic(x, y, n);
+		for (int i = 0; i < n; ++i) {
+			error = fmaxf(error, fabsf(fit[i] - y[i]));
+			rises += (i > 0) && (fit[i] > fit[i-1]);
+		}
+	}
+	printf("  %d fits, largest difference to the reference %g\n", TEST_FITS,
+		   error);
+	CHECK_NEAR(error, 0, 1e-3);
+	CHECK_EQUAL(rises, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Saves fill the slots in turn, the newest record is loaded
+ *****************************************************************************/
+static void test_rotation(void)
+{
+	MOCK_flash_init();
+	CHECK(!TEST_boot());
+	CHECK(TEST_tables_are(-1));
+
+	for (uint32_t slot = 0; slot < CAL_SLOTS; ++slot) {
+		TEST_tables(slot);
+		CHECK(CAL_save());
+		CHECK_EQUAL(CAL_sequence, slot + 1);
+	}
+	CHECK_EQUAL(MOCK_flash_erases, 0);
+	CHECK_EQUAL(TEST_slot(CAL_SLOTS-1)->sequence, CAL_SLOTS);
+	CHECK(TEST_boot());
+	CHECK_EQUAL(CAL_sequence, CAL_SLOTS);
+	CHECK(TEST_tables_are(CAL_SLOTS-1));
+
+	// Sector full, erased and the log starts over
+	TEST_tables(1000);
+	CHECK(CAL_save());
+	CHECK_EQUAL(MOCK_flash_erases, 1);
+	CHECK(CAL_record_valid(TEST_slot(0)));
+	CHECK_EQUAL(TEST_slot(0)->sequence, CAL_SLOTS + 1);
+	CHECK(!CAL_record_valid(TEST_slot(1)));
+	CHECK(TEST_boot());
+	CHECK_EQUAL(CAL_sequence, CAL_SLOTS + 1);
+	CHECK(TEST_tables_are(1000));
+
+	TEST_tables(1001);
+	CHECK(CAL_save());
+	CHECK_EQUAL(TEST_slot(1)->sequence, CAL_SLOTS + 2);
+	CHECK(TEST_boot());
+	CHECK(TEST_tables_are(1001));
+}
+
+
+/** ***************************************************************************
+ * @brief Power loss at every word of a save, and a corrupted record
+ *
+ * The previous record stays in use, the next save takes the slot after
+ * the broken one.
+ *****************************************************************************/
+static void test_recovery(void)
+{
+	uint32_t kept = 0;
+	uint32_t next = 0;
+
+	for (uint32_t cut = 0; cut < TEST_WORDS; ++cut) {
+		MOCK_flash_init();
+		CAL_sequence = 0;
+		TEST_tables(1);
+		CAL_save();
+		TEST_tables(2);
+		CAL_save();
+
+		TEST_tables(3);
+		MOCK_flash_cut = cut;
+		CHECK(!CAL_save());
+		kept += TEST_boot() && (CAL_sequence == 2) && TEST_tables_are(2);
+
+		TEST_tables(4);
+		next += CAL_save() && CAL_record_valid(TEST_slot((cut == 0) ? 2 : 3))
+				&& TEST_boot() && (CAL_sequence == 3) && TEST_tables_are(4);
+	}
+	CHECK_EQUAL(kept, TEST_WORDS);
+	CHECK_EQUAL(next, TEST_WORDS);
+
+	// A bit of the newest record flipped
+	MOCK_flash[3*CAL_SLOT_SIZE + offsetof(CAL_record_t, left)] ^= 0x04;
+	CHECK(TEST_boot());
+	CHECK_EQUAL(CAL_sequence, 2);
+	CHECK(TEST_tables_are(2));
+
+	// Power loss while the full sector is erased
+	MOCK_flash_init();
+	CAL_sequence = 0;
+	for (uint32_t slot = 0; slot < CAL_SLOTS; ++slot) {
+		TEST_tables(slot);
+		CAL_save();
+	}
+	TEST_tables(5000);
+	MOCK_flash_cut = 0;
+	CHECK(!CAL_save());
+	CHECK(TEST_boot());
+	CHECK_EQUAL(CAL_sequence, CAL_SLOTS);
+	CHECK(TEST_tables_are(CAL_SLOTS-1));
+}
+
+
+/** ***************************************************************************
+ * @brief The wizard fits the points of a mode and saves them
+ *****************************************************************************/
+static void test_wizard(void)
+{
+	static const uint32_t left[CALC_LUTSIZE] = {
+			3000, 2500, 2600, 1800, 1500, 1200, 900, 950, 600, 400, 300
+	};
+	float fitted[CALC_LUTSIZE];
+
+	MOCK_flash_init();
+	TEST_boot();
+	CAL_wizard_start(1);
+	for (int point = 0; point < CALC_LUTSIZE; ++point) {
+		CHECK_EQUAL(CAL_wizard.state, CAL_WAIT);
+		CAL_wizard_capture();
+		CAL_wizard_sample(left[point] - 10, 2*left[point]);
+		CAL_wizard_sample(left[point] + 10, 2*left[point]);
+		CAL_wizard_complete();
+		fitted[point] = left[point];
+	}
+	CHECK_EQUAL(CAL_wizard.state, CAL_SAVED);
+	CAL_fit(fitted, CALC_LUTSIZE);
+
+	TEST_tables(-1);
+	CHECK(CAL_load());
+	CHECK_EQUAL(CAL_sequence, 1);
+	for (int i = 0; i < CALC_LUTSIZE; ++i) {
+		CHECK_EQUAL(CALC_wpcLeft[1][i], fitted[i]);
+		CHECK_EQUAL(CALC_wpcRight[1][i], 2*fitted[i]);
+	}
+	CHECK_EQUAL(CALC_wpcLeft[0][0], -1000);
+
+	// Saving fails
+	CAL_wizard_start(0);
+	MOCK_flash_cut = 0;
+	for (int point = 0; point < CALC_LUTSIZE; ++point) {
+		CAL_wizard_capture();
+		CAL_wizard_sample(1000 - point, 1000 - point);
+		CAL_wizard_complete();
+	}
+	CHECK_EQUAL(CAL_wizard.state, CAL_FAILED);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_crc);
+	UNIT_RUN(test_fit);
+	UNIT_RUN(test_rotation);
+	UNIT_RUN(test_recovery);
+	UNIT_RUN(test_wizard);
+	UNIT_EXIT();
+}
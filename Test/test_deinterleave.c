@@ -0,0 +1,248 @@
+/** ***************************************************************************
+ * @file
+ * @brief Channel separation of the interleaved ADC buffers
+ *
+ * Every conversion slot of a trigger carries a pattern of its own, a ramp
+ * starting at a slot specific offset. The raw waveforms of the frame show
+ * which slot each channel was taken from and at which sample index.
+ * @n Sines of slot specific amplitudes check the same for the amplitudes,
+ * the second conversions of ADC1 and ADC2 are decoys which must not be
+ * used.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_PI		3.14159265358979	///< Pi
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t TEST_frame[MEAS_QUAD_STRIDE*MEAS_MAX_SAMPLES];	///< DR data
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Pattern of a conversion slot
+ * @param [in] slot in the trigger
+ * @param [in] trigger index
+ * @return ADC value
+ *****************************************************************************/
+static uint16_t TEST_pattern(uint32_t slot, uint32_t index)
+{
+	return (uint16_t)(600*slot + index);
+}
+
+
+/** ***************************************************************************
+ * @brief Fill a buffer with the slot patterns
+ * @param [in] triggers
+ * @param [in] conversions per trigger
+ *****************************************************************************/
+static void TEST_fill_pattern(uint32_t samples, uint32_t stride)
+{
+	for (uint32_t i = 0; i < samples; ++i) {
+		for (uint32_t j = 0; j < stride; ++j) {
+			TEST_frame[stride*i + j] = TEST_pattern(j, i);
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Fill a buffer with 50 Hz sines of different amplitude per slot
+ * @param [in] samples per channel
+ * @param [in] conversions per trigger
+ *
+ * Slot j gets the amplitude 100*(j+1).
+ *****************************************************************************/
+static void TEST_fill_sines(uint32_t samples, uint32_t stride)
+{
+	for (uint32_t i = 0; i < samples; ++i) {
+		double wave = sin(2*TEST_PI*MEAS_MAINS_FREQ*i/MEAS_config.rate);
+		for (uint32_t j = 0; j < stride; ++j) {
+			TEST_frame[stride*i + j] = (uint16_t)lround(2048
+													  + 100*(j+1)*wave);
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Select a preset and acquire the buffer as one triple scan
+ * @param [in] preset
+ * @param [out] frame analysed by the DMA interrupt
+ * @return true if the frame was delivered
+ *****************************************************************************/
+static bool TEST_acquire(MEAS_preset_t preset, MEAS_frame_t* frame)
+{
+	MEAS_config_preset(preset);
+	uint32_t stride = (MEAS_config.sequence == MEAS_SEQ_QUAD)
+					? MEAS_QUAD_STRIDE : 3;			// Wpc sequence: 3
+	uint32_t count = stride*MEAS_config.samples;
+	ADC123_quad_scan_init();
+	ADC123_triple_scan_start();
+	if (DMA2_Stream0->NDTR != count) {
+		return false;
+	}
+	MOCK_dma_transfer(DMA2_Stream0, TEST_frame, count);
+	return MEAS_frame_read(frame);
+}
+
+
+/** ***************************************************************************
+ * @brief Check the raw waveform of a channel against its slot pattern
+ * @param [in] wave of the frame
+ * @param [in] slot the channel must come from
+ * @return true if all samples match
+ *
+ * The waveforms hold MEAS_WAVE_RATE samples/s, faster frames are thinned.
+ *****************************************************************************/
+static bool TEST_wave_from(const uint16_t* wave, uint32_t slot)
+{
+	uint32_t step = MEAS_config.rate/MEAS_WAVE_RATE;
+	for (uint32_t k = 0; k < MEAS_WAVE_SAMPLES; ++k) {
+		uint32_t index = (k*step) % MEAS_config.samples;
+		if (wave[k] != TEST_pattern(slot, index)) {
+			printf("sample %u is %u, expected %u\n", k, wave[k],
+				   TEST_pattern(slot, index));
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Bring up the drivers like main() does
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	MEAS_oversampling = false;
+	MEAS_nominal = MEAS_MAINS_FREQ;
+	MEAS_config_preset(MEAS_PRESET_STANDARD);
+	MEAS_GPIO_analog_init();
+	MEAS_timer_init();
+	MEAS_frame_flush();
+}
+
+
+/** ***************************************************************************
+ * @brief Quad sequence, every channel from its slot
+ *****************************************************************************/
+static void test_quad_channels(void)
+{
+	MEAS_frame_t frame;
+	TEST_init();
+	TEST_fill_pattern(60, MEAS_QUAD_STRIDE);
+	CHECK(TEST_acquire(MEAS_PRESET_STANDARD, &frame));
+	CHECK(TEST_wave_from(frame.wave[0], MEAS_QUAD_WPC_LEFT));
+	CHECK(TEST_wave_from(frame.wave[1], MEAS_QUAD_WPC_RIGHT));
+	CHECK(TEST_wave_from(frame.wave[2], MEAS_QUAD_HALL_IN11));
+	CHECK(TEST_wave_from(frame.wave[3], MEAS_QUAD_HALL_IN6));
+}
+
+
+/** ***************************************************************************
+ * @brief Longer frames at a higher rate keep the channel order
+ *****************************************************************************/
+static void test_quad_precision(void)
+{
+	MEAS_frame_t frame;
+	TEST_init();
+	TEST_fill_pattern(240, MEAS_QUAD_STRIDE);
+	CHECK(TEST_acquire(MEAS_PRESET_PRECISION, &frame));
+	CHECK(TEST_wave_from(frame.wave[0], MEAS_QUAD_WPC_LEFT));
+	CHECK(TEST_wave_from(frame.wave[1], MEAS_QUAD_WPC_RIGHT));
+	CHECK(TEST_wave_from(frame.wave[2], MEAS_QUAD_HALL_IN11));
+	CHECK(TEST_wave_from(frame.wave[3], MEAS_QUAD_HALL_IN6));
+}
+
+
+/** ***************************************************************************
+ * @brief Wpc sequence, three conversions per trigger and no hall
+ *****************************************************************************/
+static void test_wpc_channels(void)
+{
+	MEAS_frame_t frame;
+	TEST_init();
+	TEST_fill_pattern(48, 3);
+	CHECK(TEST_acquire(MEAS_PRESET_FAST, &frame));
+	CHECK(TEST_wave_from(frame.wave[0], MEAS_QUAD_WPC_LEFT));
+	CHECK(TEST_wave_from(frame.wave[1], MEAS_QUAD_WPC_RIGHT));
+	CHECK_EQUAL(frame.wave[2][7], 0);
+	CHECK_EQUAL(frame.wave[3][7], 0);
+	CHECK_EQUAL(frame.amplitude_hall_in11, 0);
+	CHECK_EQUAL(frame.amplitude_hall_in6, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Amplitudes come from the slots of their channels
+ *****************************************************************************/
+static void test_quad_amplitudes(void)
+{
+	MEAS_frame_t frame;
+	TEST_init();
+	TEST_fill_sines(60, MEAS_QUAD_STRIDE);
+	CHECK(TEST_acquire(MEAS_PRESET_STANDARD, &frame));
+	CHECK_EQUAL(frame.amplitude_left, 100*(MEAS_QUAD_WPC_LEFT+1));
+	CHECK_EQUAL(frame.amplitude_right, 100*(MEAS_QUAD_WPC_RIGHT+1));
+	CHECK_EQUAL(frame.amplitude_hall_in11, 100*(MEAS_QUAD_HALL_IN11+1));
+	CHECK_EQUAL(frame.amplitude_hall_in6, 100*(MEAS_QUAD_HALL_IN6+1));
+}
+
+
+/** ***************************************************************************
+ * @brief Sequential ADC3 scans, two conversions per trigger
+ *****************************************************************************/
+static void test_dual_channels(void)
+{
+	MEAS_frame_t frame;
+	TEST_init();
+	TEST_fill_pattern(60, 2);
+	MEAS_analyse_data(TEST_frame, &frame);
+	CHECK(TEST_wave_from(frame.wave[0], 0));
+	CHECK(TEST_wave_from(frame.wave[1], 1));
+	CHECK_EQUAL(frame.wave[2][0], 0);
+	CHECK_EQUAL(frame.wave[3][0], 0);
+
+	TEST_fill_sines(60, 2);
+	MEAS_analyse_data(TEST_frame, &frame);
+	CHECK_EQUAL(frame.amplitude_left, 100);
+	CHECK_EQUAL(frame.amplitude_right, 200);
+	CHECK_EQUAL(frame.amplitude_hall_in11, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_quad_channels);
+	UNIT_RUN(test_quad_precision);
+	UNIT_RUN(test_wpc_channels);
+	UNIT_RUN(test_quad_amplitudes);
+	UNIT_RUN(test_dual_channels);
+	UNIT_EXIT();
+}
@@ -0,0 +1,141 @@
+/** ***************************************************************************
+ * @file
+ * @brief C fallbacks of the signal processing kernels
+ *
+ * The host build has no ARM_MATH_CM4, so dsp.c runs its portable versions.
+ * Each kernel is compared with a straightforward double precision loop on
+ * random blocks of every length up to TEST_COUNT, including the empty block
+ * and a single sample.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <stdlib.h>
+
+#include "unit.h"
+#include "dsp.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_COUNT		64			///< Longest block
+#define TEST_RANGE		4096		///< Samples between -RANGE and RANGE
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static float TEST_samples[2*TEST_COUNT];	///< Random block, also complex
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Fill TEST_samples with random values
+ *
+ * A large offset makes the naive sum of squares of the variance lose
+ * precision, the tolerances below cover the float result.
+ *****************************************************************************/
+static void TEST_fill(void)
+{
+	for (int i = 0; i < 2*TEST_COUNT; ++i) {
+		TEST_samples[i] = (float)(rand() % (2*TEST_RANGE) - TEST_RANGE)/8
+						+ 300;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Mean compared with a scalar sum
+ *****************************************************************************/
+static void test_mean(void)
+{
+	CHECK_EQUAL(DSP_mean_f32(TEST_samples, 0), 0);
+	for (uint32_t count = 1; count <= TEST_COUNT; ++count) {
+		TEST_fill();
+		double sum = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			sum += TEST_samples[i];
+		}
+		CHECK_NEAR(DSP_mean_f32(TEST_samples, count), sum/count, 1e-2);
+	}
+	TEST_samples[0] = 17.5f;
+	CHECK_EQUAL(DSP_mean_f32(TEST_samples, 1), 17.5f);
+}
+
+
+/** ***************************************************************************
+ * @brief Sample variance compared with the two pass formula
+ *****************************************************************************/
+static void test_var(void)
+{
+	CHECK_EQUAL(DSP_var_f32(TEST_samples, 0), 0);
+	CHECK_EQUAL(DSP_var_f32(TEST_samples, 1), 0);
+	for (uint32_t count = 2; count <= TEST_COUNT; ++count) {
+		TEST_fill();
+		double mean = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			mean += TEST_samples[i];
+		}
+		mean /= count;
+		double var = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			var += (TEST_samples[i] - mean)*(TEST_samples[i] - mean);
+		}
+		var /= count - 1;
+		CHECK_NEAR(DSP_var_f32(TEST_samples, count), var, 1e-3*var + 0.5);
+	}
+
+	// Equal samples, no spread
+	for (int i = 0; i < TEST_COUNT; ++i) {
+		TEST_samples[i] = 42;
+	}
+	CHECK_NEAR(DSP_var_f32(TEST_samples, TEST_COUNT), 0, 1e-3);
+}
+
+
+/** ***************************************************************************
+ * @brief Magnitudes compared with hypot()
+ *****************************************************************************/
+static void test_cmplx_mag(void)
+{
+	float magnitude[TEST_COUNT+1];
+
+	magnitude[0] = -1;
+	DSP_cmplx_mag_f32(TEST_samples, magnitude, 0);
+	CHECK_EQUAL(magnitude[0], -1);		// Nothing written
+
+	for (uint32_t count = 1; count <= TEST_COUNT; ++count) {
+		TEST_fill();
+		magnitude[count] = -1;
+		DSP_cmplx_mag_f32(TEST_samples, magnitude, count);
+		for (uint32_t i = 0; i < count; ++i) {
+			double expected = hypot(TEST_samples[2*i], TEST_samples[2*i+1]);
+			CHECK_NEAR(magnitude[i], expected, 1e-6*expected);
+		}
+		CHECK_EQUAL(magnitude[count], -1);	// Not beyond the block
+	}
+
+	float value[2] = {3, -4};
+	DSP_cmplx_mag_f32(value, magnitude, 1);
+	CHECK_EQUAL(magnitude[0], 5);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	srand(1);
+	UNIT_RUN(test_mean);
+	UNIT_RUN(test_var);
+	UNIT_RUN(test_cmplx_mag);
+	UNIT_EXIT();
+}
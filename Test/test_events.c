@@ -0,0 +1,230 @@
+/** ***************************************************************************
+ * @file
+ * @brief Event queue and sleep of the main loop
+ *
+ * The SysTick of the test counts the HAL tick and calls EVT_tick() like
+ * SysTick_Handler() of the firmware, or posts a chosen event.
+ * MOCK_sleep_hook plays the time passing in the sleep, MOCK_mask_hook
+ * raises interrupts in the window between the queue check and the WFI.
+ * A lost wake up ends in the deadlock check of MOCK_wfi().
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "mock.h"
+#include "unit.h"
+#include "events.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_CYCLES_MS	(MOCK_CORE_CLOCK/1000)	///< Core cycles per ms
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static EVT_t TEST_isr_event = EVT_NONE;	///< Posted by the SysTick, or tick
+static uint32_t TEST_sleeps = 0;		///< Calls of the sleep hook
+static uint32_t TEST_masks = 0;			///< Calls of the mask hook
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief SysTick of the test
+ *****************************************************************************/
+void MOCK_SysTick_Handler(void)
+{
+	if (TEST_isr_event != EVT_NONE) {
+		EVT_post(TEST_isr_event);
+	} else {
+		MOCK_tick++;
+		EVT_tick();
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Sleep for the rest of a millisecond until the next SysTick
+ *****************************************************************************/
+static void TEST_sleep_ms(void)
+{
+	TEST_sleeps++;
+	DWT->CYCCNT += TEST_CYCLES_MS;
+	MOCK_irq(SysTick_IRQn);
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt right after the main loop masked the interrupts
+ *
+ * Fires once, at the first masking.
+ *****************************************************************************/
+static void TEST_late_irq(void)
+{
+	if (TEST_masks++ == 0) {
+		MOCK_irq(SysTick_IRQn);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Reset the core model and the queue
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	EVT_init();
+	EVT_overflow = 0;
+	TEST_isr_event = EVT_NONE;
+	TEST_sleeps = 0;
+	TEST_masks = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Events come out in the order they were posted
+ *****************************************************************************/
+static void test_fifo_order(void)
+{
+	static const EVT_t events[] = {
+			EVT_BUTTON, EVT_MEAS, EVT_TOUCH, EVT_MEAS, EVT_TOUCH_DATA,
+			EVT_TICK, EVT_BUTTON
+	};
+	TEST_init();
+	for (unsigned round = 0; round < 5; ++round) {	// Indexes wrap around
+		for (unsigned i = 0; i < sizeof(events)/sizeof(EVT_t); ++i) {
+			EVT_post(events[i]);
+		}
+		for (unsigned i = 0; i < sizeof(events)/sizeof(EVT_t); ++i) {
+			CHECK_EQUAL(EVT_wait(), events[i]);
+		}
+	}
+	CHECK_EQUAL(EVT_overflow, 0);
+	CHECK_EQUAL(MOCK_primask, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief A full queue drops new events and keeps the old ones
+ *****************************************************************************/
+static void test_overflow(void)
+{
+	TEST_init();
+	for (int i = 0; i < EVT_QUEUE_SIZE; ++i) {
+		EVT_post((i & 1) ? EVT_MEAS : EVT_BUTTON);
+	}
+	EVT_post(EVT_TOUCH);
+	EVT_post(EVT_TOUCH);
+	CHECK_EQUAL(EVT_overflow, 2);
+	for (int i = 0; i < EVT_QUEUE_SIZE; ++i) {
+		CHECK_EQUAL(EVT_wait(), (i & 1) ? EVT_MEAS : EVT_BUTTON);
+	}
+	EVT_post(EVT_TOUCH);					// Room again
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH);
+}
+
+
+/** ***************************************************************************
+ * @brief Empty queue, the main loop sleeps until the tick event
+ *
+ * EVT_TICK_PERIOD SysTicks with a sleep each.
+ *****************************************************************************/
+static void test_sleep_until_tick(void)
+{
+	TEST_init();
+	MOCK_sleep_hook = TEST_sleep_ms;
+	CHECK_EQUAL(EVT_wait(), EVT_TICK);
+	CHECK_EQUAL(TEST_sleeps, EVT_TICK_PERIOD);
+	CHECK_EQUAL(MOCK_tick, EVT_TICK_PERIOD);
+	CHECK_EQUAL(MOCK_primask, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Interrupt between the queue check and the WFI is not lost
+ *
+ * The interrupt stays pending while masked, the WFI returns at once and
+ * the event is served without any sleep.
+ *****************************************************************************/
+static void test_no_lost_wakeup(void)
+{
+	TEST_init();
+	TEST_isr_event = EVT_TOUCH;
+	MOCK_mask_hook = TEST_late_irq;		// Without sleep hook: no wake up
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH);
+	CHECK(TEST_masks >= 2);				// Checked the queue again
+	CHECK_EQUAL(TEST_sleeps, 0);
+	CHECK_EQUAL(MOCK_primask, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief An interrupt inside EVT_post() of the main loop posts after it
+ *
+ * EVT_post() restores the mask of its caller, the pending interrupt is
+ * taken then and its event queued behind the one of the main loop.
+ *****************************************************************************/
+static void test_post_from_main_and_isr(void)
+{
+	TEST_init();
+	TEST_isr_event = EVT_MEAS;
+	MOCK_mask_hook = TEST_late_irq;
+	EVT_post(EVT_BUTTON);
+	MOCK_mask_hook = NULL;
+	CHECK_EQUAL(MOCK_primask, 0);
+	CHECK_EQUAL(EVT_wait(), EVT_BUTTON);
+	CHECK_EQUAL(EVT_wait(), EVT_MEAS);
+
+	__disable_irq();						// Called with masked interrupts
+	EVT_post(EVT_TOUCH);
+	CHECK_EQUAL(MOCK_primask, 1);			// Mask of the caller restored
+	__enable_irq();
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH);
+}
+
+
+/** ***************************************************************************
+ * @brief Idle percentage counts only the cycles between wake up and sleep
+ *
+ * Each pass of the main loop on a tick event takes 10 % of the tick
+ * period, the clock keeps running in the sleep but is not counted.
+ * The window is EVT_LOAD_WINDOW/EVT_TICK_PERIOD = 50 ticks.
+ *****************************************************************************/
+static void test_idle_percentage(void)
+{
+	uint32_t busy = TEST_CYCLES_MS*EVT_TICK_PERIOD/10;
+	TEST_init();
+	MOCK_sleep_hook = TEST_sleep_ms;
+	while (MOCK_tick < EVT_LOAD_WINDOW) {
+		CHECK_EQUAL(EVT_wait(), EVT_TICK);
+		DWT->CYCCNT += busy;				// Pass of the main loop
+	}
+	// 49 passes, the pass of the last tick belongs to the next window
+	CHECK_NEAR(EVT_idle_percent, 100 - 49*10.0/50, 0.01);
+	EVT_wait();
+	CHECK_EQUAL(EVT_pass_cycles, busy);		// Sleep is not part of a pass
+	CHECK(EVT_pass_max >= busy);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_fifo_order);
+	UNIT_RUN(test_overflow);
+	UNIT_RUN(test_sleep_until_tick);
+	UNIT_RUN(test_no_lost_wakeup);
+	UNIT_RUN(test_post_from_main_and_isr);
+	UNIT_RUN(test_idle_percentage);
+	UNIT_EXIT();
+}
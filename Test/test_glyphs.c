@@ -0,0 +1,261 @@
+/** ***************************************************************************
+ * @file
+ * @brief Text output of the DMA2D against a software glyph renderer
+ *
+ * GUI_LCD_DisplayChar() expands a glyph to L8 and lets the DMA2D convert it
+ * with a two entry CLUT of back and text colour. The reference renders the
+ * same character straight from the bitmap of the sFONT, one bit per pixel
+ * with the MSB at the left, into a copy of the frame buffer.
+ * @n Every printable character of every font is drawn on a frame filled
+ * with a marker colour. The whole frame must equal the reference, so a
+ * wrong pixel, a wrong line offset or a write next to the glyph shows up.
+ * The first pass fills the glyph cache and overflows into the scratch
+ * glyph, the second one draws from the cache.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+
+#include "display.h"
+#include "unit.h"
+#include "lcd_gui.h"
+#include "stm32f429i_discovery_lcd.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_PIXELS		(MOCK_LCD_WIDTH*MOCK_LCD_HEIGHT)	///< Per frame
+#define TEST_MARKER		0x12345678	///< Frame content around the glyphs
+#define TEST_FIRST		' '			///< First printable character
+#define TEST_LAST		'~'			///< Last printable character
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+/// Hidden layer after GUI_LCD_Init(), drawn by the GUI and the BSP
+static uint32_t* const TEST_frame =
+		(uint32_t*)(uintptr_t)(LCD_FRAME_BUFFER + 4*TEST_PIXELS);
+static uint32_t TEST_expected[TEST_PIXELS];	///< Reference frame
+
+static sFONT* const TEST_fonts[] = {		///< All fonts of the BSP
+		&Font8, &Font12, &Font16, &Font20, &Font24
+};
+
+/// Text and back colour pairs
+static const uint32_t TEST_colors[][2] = {
+		{LCD_COLOR_BLACK, LCD_COLOR_WHITE},
+		{LCD_COLOR_WHITE, LCD_COLOR_BLUE},
+		{LCD_COLOR_RED, LCD_COLOR_TRANSPARENT},
+};
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+// Wrappers of lcd_gui.c, not declared in lcd_gui.h
+void GUI_LCD_DisplayChar(uint16_t Xpos, uint16_t Ypos, uint8_t Ascii);
+void GUI_LCD_DisplayStringAt(uint16_t X, uint16_t Y, uint8_t* pText,
+							 Text_AlignModeTypdef mode);
+
+
+/** ***************************************************************************
+ * @brief Set up the BSP, the GUI layers and the display model
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	MOCK_display_init();
+	BSP_LCD_Init();
+	GUI_LCD_Init();
+}
+
+
+/** ***************************************************************************
+ * @brief Fill the frame and the reference with the marker
+ *****************************************************************************/
+static void TEST_clear(void)
+{
+	for (int i = 0; i < TEST_PIXELS; ++i) {
+		TEST_frame[i] = TEST_MARKER;
+		TEST_expected[i] = TEST_MARKER;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Render a character into the reference frame
+ * @param [in] font
+ * @param [in] X position
+ * @param [in] Y position
+ * @param [in] ASCII character
+ * @param [in] text colour
+ * @param [in] back colour
+ *****************************************************************************/
+static void TEST_render(const sFONT* font, uint16_t x, uint16_t y,
+						uint8_t ascii, uint32_t text, uint32_t back)
+{
+	uint32_t bytes = (font->Width + 7)/8;
+	const uint8_t* bitmap = &font->table[(ascii - ' ')*font->Height*bytes];
+	for (uint32_t row = 0; row < font->Height; ++row) {
+		for (uint32_t column = 0; column < font->Width; ++column) {
+			uint8_t bits = bitmap[row*bytes + column/8];
+			TEST_expected[(y + row)*MOCK_LCD_WIDTH + x + column] =
+					(bits & (0x80 >> (column % 8))) ? text : back;
+		}
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Compare the frame with the reference
+ * @return pixels that differ
+ *****************************************************************************/
+static uint32_t TEST_differences(void)
+{
+	uint32_t count = 0;
+	for (int i = 0; i < TEST_PIXELS; ++i) {
+		count += (TEST_frame[i] != TEST_expected[i]);
+	}
+	return count;
+}
+
+
+/** ***************************************************************************
+ * @brief Draw every character of every font in all colours, twice
+ *
+ * The position moves across the screen and includes the last column and
+ * row a glyph fits in. Each character takes exactly one DMA2D transfer.
+ *****************************************************************************/
+static void test_all_glyphs(void)
+{
+	uint32_t wrong = 0;
+	uint32_t fallbacks = 0;
+	TEST_init();
+	for (int pass = 0; pass < 2; ++pass) {
+		for (unsigned f = 0; f < sizeof(TEST_fonts)/sizeof(sFONT*); ++f) {
+			sFONT* font = TEST_fonts[f];
+			uint16_t xLast = MOCK_LCD_WIDTH - font->Width;
+			uint16_t yLast = MOCK_LCD_HEIGHT - font->Height;
+			BSP_LCD_SetFont(font);
+			for (unsigned c = 0; c < sizeof(TEST_colors)/sizeof(TEST_colors[0]);
+					++c) {
+				BSP_LCD_SetTextColor(TEST_colors[c][0]);
+				BSP_LCD_SetBackColor(TEST_colors[c][1]);
+				for (uint8_t ascii = TEST_FIRST; ascii <= TEST_LAST; ++ascii) {
+					uint16_t x = (ascii*7 + 13*c) % (xLast + 1);
+					uint16_t y = (ascii*11 + 29*f) % (yLast + 1);
+					if (ascii == TEST_LAST) {
+						x = xLast;
+						y = yLast;
+					}
+					uint32_t transfers = MOCK_dma2d_transfers;
+					TEST_clear();
+					GUI_LCD_DisplayChar(x, y, ascii);
+					TEST_render(font, x, y, ascii, TEST_colors[c][0],
+								TEST_colors[c][1]);
+					wrong += (TEST_differences() > 0);
+					fallbacks += (MOCK_dma2d_transfers != transfers + 1);
+				}
+			}
+		}
+	}
+	CHECK_EQUAL(wrong, 0);
+	CHECK_EQUAL(fallbacks, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Colour changes between characters reload the CLUT
+ *
+ * Two characters each in the same colours. BSP_LCD_FillRect() in between
+ * reconfigures the DMA2D for register to memory, the next glyph must set
+ * its own input format again, even if the CLUT is still loaded.
+ *****************************************************************************/
+static void test_colour_changes(void)
+{
+	static const char text[] = "Cable 42mm";
+	TEST_init();
+	TEST_clear();
+	BSP_LCD_SetFont(&Font16);
+	for (unsigned i = 0; i < sizeof(text)-1; ++i) {
+		uint16_t x = 10 + i*Font16.Width;
+		uint32_t color = TEST_colors[(i/2) % 3][0];
+		uint32_t back = TEST_colors[(i/2) % 3][1];
+		BSP_LCD_SetTextColor(back);
+		BSP_LCD_FillRect(x, 100, Font16.Width, 2*Font16.Height);
+		BSP_LCD_SetTextColor(color);
+		BSP_LCD_SetBackColor(back);
+		GUI_LCD_DisplayChar(x, 100, text[i]);
+		for (uint16_t row = 0; row < 2*Font16.Height; ++row) {
+			for (uint16_t column = 0; column < Font16.Width; ++column) {
+				TEST_expected[(100 + row)*MOCK_LCD_WIDTH + x + column] = back;
+			}
+		}
+		TEST_render(&Font16, x, 100, text[i], color, back);
+	}
+	CHECK_EQUAL(TEST_differences(), 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Strings come out like the ones of the BSP
+ *
+ * All alignments, a string cut at the right edge and a glyph that does not
+ * fit, which falls back to BSP_LCD_DisplayChar().
+ *****************************************************************************/
+static void test_strings_like_bsp(void)
+{
+	static const char* texts[] = {
+			"Distance:  123.4 mm", "L", "LNPE", "",
+			"A line that is much longer than the screen is wide"
+	};
+	static const Text_AlignModeTypdef modes[] = {
+			LEFT_MODE, CENTER_MODE, RIGHT_MODE
+	};
+	TEST_init();
+	BSP_LCD_SetTextColor(LCD_COLOR_DARKBLUE);
+	BSP_LCD_SetBackColor(LCD_COLOR_LIGHTGRAY);
+	for (unsigned f = 0; f < sizeof(TEST_fonts)/sizeof(sFONT*); ++f) {
+		BSP_LCD_SetFont(TEST_fonts[f]);
+		for (unsigned t = 0; t < sizeof(texts)/sizeof(char*); ++t) {
+			for (unsigned m = 0; m < sizeof(modes)/sizeof(modes[0]); ++m) {
+				TEST_clear();
+				BSP_LCD_DisplayStringAt(0, 40, (uint8_t*)texts[t], modes[m]);
+				memcpy(TEST_expected, TEST_frame, sizeof(TEST_expected));
+				for (int i = 0; i < TEST_PIXELS; ++i) {
+					TEST_frame[i] = TEST_MARKER;
+				}
+				GUI_LCD_DisplayStringAt(0, 40, (uint8_t*)texts[t], modes[m]);
+				CHECK_EQUAL(TEST_differences(), 0);
+			}
+		}
+	}
+
+	TEST_clear();
+	BSP_LCD_SetFont(&Font24);
+	BSP_LCD_DisplayChar(MOCK_LCD_WIDTH - 10, 0, 'W');	// Does not fit
+	memcpy(TEST_expected, TEST_frame, sizeof(TEST_expected));
+	for (int i = 0; i < TEST_PIXELS; ++i) {
+		TEST_frame[i] = TEST_MARKER;
+	}
+	GUI_LCD_DisplayChar(MOCK_LCD_WIDTH - 10, 0, 'W');
+	CHECK_EQUAL(TEST_differences(), 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_all_glyphs);
+	UNIT_RUN(test_colour_changes);
+	UNIT_RUN(test_strings_like_bsp);
+	UNIT_EXIT();
+}
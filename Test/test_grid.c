@@ -0,0 +1,210 @@
+/** ***************************************************************************
+ * @file
+ * @brief Mains frequency tracking on simulated frames
+ *
+ * The frames are sampled at the rate of MEAS_config scaled by
+ * GRID_track/GRID_nominal, like the retuned timer does, and resampled to the
+ * raw waveform like MEAS_wave() does, short frames repeated. Frames follow
+ * each other without gaps, a retune is passed to GRID_settle() with the
+ * sequence MEAS_track() would return.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#include "unit.h"
+#include "grid.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_PI			3.14159265358979	///< Pi
+#define TEST_AMPLITUDE	500				///< Mains amplitude [digits]
+#define TEST_SETTLE		40				///< Frames to lock in
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static double TEST_time;				///< Start of the next frame [s]
+static uint32_t TEST_sequence;			///< Sequence of the next frame
+static uint32_t TEST_retunes;			///< Retunes requested by the tracking
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start tracking and a stream with an acquisition preset
+ * @param [in] preset
+ *****************************************************************************/
+static void TEST_init(MEAS_preset_t preset)
+{
+	MEAS_config = MEAS_presets[preset];
+	MEAS_nominal = MEAS_MAINS_FREQ;
+	GRID_init(MEAS_MAINS_FREQ);
+	TEST_time = 0;
+	TEST_sequence = 0;
+	TEST_retunes = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Sample one frame and pass it to the tracking
+ * @param [in] mains frequency [Hz]
+ *****************************************************************************/
+static void TEST_frame(double mains)
+{
+	static MEAS_frame_t frame;
+	uint32_t step = MEAS_config.rate/MEAS_WAVE_RATE;
+	double rate = (double)MEAS_config.rate*GRID_track/GRID_nominal;
+
+	memset(&frame, 0, sizeof(frame));
+	for (uint32_t i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+		double t = TEST_time + (i*step % MEAS_config.samples)/rate;
+		frame.wave[0][i] = (uint16_t)lround(2048 + TEST_AMPLITUDE
+											* sin(2*TEST_PI*mains*t + 1));
+	}
+	TEST_time += MEAS_config.samples/rate;
+	frame.sequence = TEST_sequence++;
+	frame.continued = frame.sequence > 0;
+	if (GRID_update(&frame)) {
+		TEST_retunes++;
+		GRID_settle(TEST_sequence + 1);	// Next frame mixes both rates
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Run the stream for some frames
+ * @param [in] mains frequency [Hz]
+ * @param [in] frames
+ *****************************************************************************/
+static void TEST_run(double mains, uint32_t frames)
+{
+	for (uint32_t i = 0; i < frames; ++i) {
+		TEST_frame(mains);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief The sampling locks to an off-nominal mains frequency
+ *****************************************************************************/
+static void test_lock(void)
+{
+	static const double mains[] = {50.0, 50.3, 49.2, 53.5};
+	for (unsigned m = 0; m < sizeof(mains)/sizeof(mains[0]); ++m) {
+		TEST_init(MEAS_PRESET_STANDARD);
+		TEST_run(mains[m], TEST_SETTLE);
+		printf("  %.1f Hz: measured %.3f Hz, tuned to %.3f Hz, %lu retunes\n",
+			   mains[m], GRID_frequency, GRID_track,
+			   (unsigned long)TEST_retunes);
+		CHECK_NEAR(GRID_frequency, mains[m], 0.02);
+		CHECK_NEAR(GRID_track, mains[m], 0.03);
+		CHECK_EQUAL(GRID_nominal, 50);
+	}
+
+	// Beyond the tracking range the sampling stays at its limit
+	TEST_init(MEAS_PRESET_STANDARD);
+	TEST_run(54.5, TEST_SETTLE);
+	CHECK_NEAR(GRID_track, 50 + GRID_TRACK_RANGE, 1e-3);
+}
+
+
+/** ***************************************************************************
+ * @brief Long frames lock to a deviation their phase advance aliases
+ *
+ * The precision frames span 10 periods, from one to the next the phase
+ * advance is unambiguous for 2.5 Hz only. At 53.5 Hz it wraps to -0.3
+ * turns, which alone reads as 48.5 Hz.
+ *****************************************************************************/
+static void test_precision(void)
+{
+	static const double mains[] = {50.2, 52.0, 53.5, 46.5};
+	for (unsigned m = 0; m < sizeof(mains)/sizeof(mains[0]); ++m) {
+		TEST_init(MEAS_PRESET_PRECISION);
+		TEST_run(mains[m], TEST_SETTLE);
+		printf("  %.1f Hz: measured %.3f Hz, tuned to %.3f Hz, %lu retunes\n",
+			   mains[m], GRID_frequency, GRID_track,
+			   (unsigned long)TEST_retunes);
+		CHECK_NEAR(GRID_frequency, mains[m], 0.02);
+		CHECK_NEAR(GRID_track, mains[m], 0.03);
+	}
+
+	// Beyond the tracking range the sampling stays at its limit
+	TEST_init(MEAS_PRESET_PRECISION);
+	TEST_run(54.5, TEST_SETTLE);
+	CHECK_NEAR(GRID_track, 50 + GRID_TRACK_RANGE, 1e-3);
+}
+
+
+/** ***************************************************************************
+ * @brief A new stream after a retune is tracked right away
+ *
+ * The last retune of a long stream waits for a high sequence. The next
+ * stream counts from 0 again, its frames have to be used.
+ *****************************************************************************/
+static void test_restart(void)
+{
+	TEST_init(MEAS_PRESET_STANDARD);
+	TEST_run(50.0, 500);
+	TEST_run(50.4, TEST_SETTLE);		// Last retune waits for ~540
+	CHECK_NEAR(GRID_track, 50.4, 0.03);
+
+	TEST_sequence = 0;					// Stream stopped and started again
+	uint32_t retunes = TEST_retunes;
+	TEST_run(49.6, TEST_SETTLE);
+	CHECK(TEST_retunes > retunes);
+	CHECK_NEAR(GRID_frequency, 49.6, 0.02);
+	CHECK_NEAR(GRID_track, 49.6, 0.03);
+}
+
+
+/** ***************************************************************************
+ * @brief Switch to 60 Hz mains, only if the frames fit
+ *
+ * The standard frames of 100 ms are 6 periods at 60 Hz. The fast frames of
+ * 2 periods at 50 Hz are 2.4 periods at 60 Hz, the nominal frequency must
+ * stay and the sampling within the range of 50 Hz.
+ *****************************************************************************/
+static void test_nominal(void)
+{
+	TEST_init(MEAS_PRESET_STANDARD);
+	TEST_run(60.0, GRID_DETECT);
+	CHECK_EQUAL(GRID_nominal, 60);
+	CHECK(MEAS_config_whole(&MEAS_config, GRID_nominal));
+	MEAS_nominal = GRID_nominal;		// MEAS_track() of the main loop
+	TEST_run(60.2, TEST_SETTLE);
+	CHECK_NEAR(GRID_frequency, 60.2, 0.02);
+	CHECK_NEAR(GRID_track, 60.2, 0.03);
+
+	TEST_init(MEAS_PRESET_FAST);
+	TEST_run(60.0, 5*GRID_DETECT);
+	CHECK_EQUAL(GRID_nominal, 50);
+	CHECK(GRID_track <= 50 + GRID_TRACK_RANGE);
+
+	TEST_init(MEAS_PRESET_PRECISION);
+	TEST_run(60.0, GRID_DETECT);
+	CHECK_EQUAL(GRID_nominal, 60);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_lock);
+	UNIT_RUN(test_precision);
+	UNIT_RUN(test_restart);
+	UNIT_RUN(test_nominal);
+	UNIT_EXIT();
+}
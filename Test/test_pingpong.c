@@ -0,0 +1,209 @@
+/** ***************************************************************************
+ * @file
+ * @brief Double buffered streaming of the triple mode
+ *
+ * Every streamed frame is stamped, all its samples hold the frame number.
+ * The DMA model enters the interrupt MOCK_dma_latency transfers after the
+ * buffer switch, while the stream already writes the next frame into the
+ * other buffer. A frame analysed from the buffer the DMA is filling would
+ * show samples of two frames.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "events.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_SAMPLES	60			///< Samples per channel of the standard
+#define TEST_COUNT		(MEAS_QUAD_STRIDE*TEST_SAMPLES)	///< Halfwords/frame
+#define TEST_STAMP		100			///< Sample value of frame 0
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t TEST_frame[TEST_COUNT];	///< DR data of one frame
+static uint32_t TEST_sent = 0;			///< Frames delivered to the DMA
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start streaming like the main loop does on ANA_outStartStream
+ *****************************************************************************/
+static void TEST_start(void)
+{
+	MOCK_reset();
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	MEAS_oversampling = false;
+	MEAS_nominal = MEAS_MAINS_FREQ;
+	MEAS_config_preset(MEAS_PRESET_STANDARD);
+	MEAS_GPIO_analog_init();
+	MEAS_timer_init();
+	MEAS_frame_flush();
+	EVT_init();
+	ADC123_quad_stream_init();
+	ADC123_triple_scan_start();
+	TEST_sent = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Deliver the next stamped frame through the DMA
+ *****************************************************************************/
+static void TEST_send(void)
+{
+	for (uint32_t i = 0; i < TEST_COUNT; ++i) {
+		TEST_frame[i] = (uint16_t)(TEST_STAMP + TEST_sent);
+	}
+	MOCK_dma_transfer(DMA2_Stream0, TEST_frame, TEST_COUNT);
+	TEST_sent++;
+}
+
+
+/** ***************************************************************************
+ * @brief Check that a frame comes from one buffer content only
+ * @param [in] frame read from the queue
+ * @return frame number of the stamp
+ *****************************************************************************/
+static uint32_t TEST_stamp(const MEAS_frame_t* frame)
+{
+	uint16_t stamp = frame->wave[0][0];
+	bool whole = true;
+	for (int c = 0; c < MEAS_WAVE_CHANNELS; ++c) {
+		for (int i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+			whole = whole && (frame->wave[c][i] == stamp);
+		}
+	}
+	CHECK(whole);
+	return stamp - TEST_STAMP;
+}
+
+
+/** ***************************************************************************
+ * @brief The DMA target alternates between both buffers
+ *****************************************************************************/
+static void test_buffers_alternate(void)
+{
+	TEST_start();
+	CHECK(DMA2_Stream0->CR & DMA_SxCR_DBM);
+	CHECK(DMA2_Stream0->M0AR != DMA2_Stream0->M1AR);
+	CHECK(!(DMA2_Stream0->CR & DMA_SxCR_CT));
+	TEST_send();
+	CHECK(DMA2_Stream0->CR & DMA_SxCR_CT);	// Filling memory 1
+	TEST_send();
+	CHECK(!(DMA2_Stream0->CR & DMA_SxCR_CT));	// Filling memory 0
+	CHECK(DMA2_Stream0->CR & DMA_SxCR_EN);
+	CHECK(TIM2->CR1 & TIM_CR1_CEN);
+}
+
+
+/** ***************************************************************************
+ * @brief Late interrupts analyse the completed buffer, each frame once
+ *
+ * Latencies up to almost a frame, the main loop reads after every frame.
+ *****************************************************************************/
+static void test_late_interrupt(void)
+{
+	static const uint32_t latencies[] = {0, 1, TEST_COUNT/2, TEST_COUNT-1};
+	for (unsigned l = 0; l < sizeof(latencies)/sizeof(uint32_t); ++l) {
+		MEAS_frame_t frame;
+		uint32_t expected = 0;
+		TEST_start();
+		MOCK_dma_latency = latencies[l];
+		for (int k = 0; k < 20; ++k) {
+			TEST_send();
+			while (MEAS_frame_read(&frame)) {
+				CHECK_EQUAL(TEST_stamp(&frame), expected);
+				CHECK_EQUAL(frame.sequence, expected);
+				CHECK_EQUAL(frame.continued, expected > 0);
+				expected++;
+			}
+		}
+		// The interrupt of the last frame is still due, or just taken
+		CHECK(expected >= TEST_sent - 1);
+		CHECK_EQUAL(MEAS_frames_dropped, 0);
+		ADC123_stream_stop();
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief A full queue drops and counts new frames, the sequence shows gaps
+ *****************************************************************************/
+static void test_drops_counted(void)
+{
+	MEAS_frame_t frame;
+	TEST_start();
+	MOCK_dma_latency = TEST_COUNT/3;
+	for (int k = 0; k < MEAS_QUEUE_SIZE+5+1; ++k) {	// +1 for the latency
+		TEST_send();
+	}
+	CHECK_EQUAL(MEAS_frames_dropped, 5);
+	CHECK_EQUAL(MEAS_frame_count, MEAS_QUEUE_SIZE+5);
+	for (uint32_t expected = 0; expected < MEAS_QUEUE_SIZE; ++expected) {
+		CHECK(MEAS_frame_read(&frame));
+		CHECK_EQUAL(TEST_stamp(&frame), expected);
+		CHECK_EQUAL(frame.sequence, expected);
+	}
+	CHECK(!MEAS_frame_read(&frame));
+
+	TEST_send();							// Queue has room again
+	CHECK(MEAS_frame_read(&frame));
+	CHECK_EQUAL(TEST_stamp(&frame), MEAS_QUEUE_SIZE+5);
+	CHECK_EQUAL(frame.sequence, MEAS_QUEUE_SIZE+5);
+	CHECK_EQUAL(MEAS_frames_dropped, 5);
+	ADC123_stream_stop();
+}
+
+
+/** ***************************************************************************
+ * @brief Stop ends the stream, a restart begins with frame 0 again
+ *****************************************************************************/
+static void test_stop_restart(void)
+{
+	MEAS_frame_t frame;
+	TEST_start();
+	TEST_send();
+	TEST_send();
+	ADC123_stream_stop();
+	CHECK(!(DMA2_Stream0->CR & DMA_SxCR_EN));
+	CHECK(!(DMA2_Stream0->CR & DMA_SxCR_DBM));
+	CHECK(!MOCK_irq_enabled(DMA2_Stream0_IRQn));
+	CHECK(!(TIM2->CR1 & TIM_CR1_CEN));
+	MEAS_frame_flush();
+
+	ADC123_quad_stream_init();
+	ADC123_triple_scan_start();
+	TEST_sent = 0;
+	TEST_send();
+	CHECK(MEAS_frame_read(&frame));
+	CHECK_EQUAL(TEST_stamp(&frame), 0);
+	CHECK_EQUAL(frame.sequence, 0);
+	CHECK(!frame.continued);
+	ADC123_stream_stop();
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_buffers_alternate);
+	UNIT_RUN(test_late_interrupt);
+	UNIT_RUN(test_drops_counted);
+	UNIT_RUN(test_stop_restart);
+	UNIT_EXIT();
+}
@@ -0,0 +1,226 @@
+/** ***************************************************************************
+ * @file
+ * @brief Measurement pipeline from the button to the analysed distance
+ *
+ * The test plays the hardware: it presses the user button, delivers the
+ * ADC results through the DMA model and runs the main loop pass of main.c
+ * between the interrupts. The frames are pure sines, so the peak engine
+ * gives their amplitudes exactly.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "analytics.h"
+#include "events.h"
+#include "pushbutton.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_PI		3.14159265358979	///< Pi
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t TEST_frame[MEAS_QUAD_STRIDE*MEAS_MAX_SAMPLES];	///< DR data
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Fill a triple mode frame with 50 Hz sines
+ * @param [in] amplitudes wpc left, wpc right, hall IN11, hall IN6
+ * @param [in] samples per channel
+ * @param [in] sampling frequency [Hz]
+ *
+ * Both conversions of ADC1 and ADC2 convert the same input.
+ *****************************************************************************/
+static void TEST_fill(const float* amplitudes, uint32_t samples, uint32_t rate)
+{
+	for (uint32_t i = 0; i < samples; ++i) {
+		double wave = sin(2*TEST_PI*MEAS_MAINS_FREQ*i/rate);
+		uint16_t* trigger = &TEST_frame[MEAS_QUAD_STRIDE*i];
+		trigger[0] = (uint16_t)lround(2048 + amplitudes[0]*wave);	// ADC1
+		trigger[1] = (uint16_t)lround(2048 + amplitudes[2]*wave);	// ADC2
+		trigger[2] = (uint16_t)lround(2048 + amplitudes[1]*wave);	// ADC3
+		trigger[3] = trigger[0];
+		trigger[4] = trigger[1];
+		trigger[5] = (uint16_t)lround(2048 + amplitudes[3]*wave);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief One pass of the main loop of main.c without the GUI
+ *
+ * Measurement frames go to the analytics, its start events to the drivers
+ * in the same pass.
+ *****************************************************************************/
+static void TEST_main_pass(void)
+{
+	MEAS_frame_t frame;
+	if (PB_pressed()) {
+		ANA_inBtn = true;
+	}
+	if (MEAS_frame_read(&frame)) {
+		ANA_inAmpLeft = frame.amplitude_left;
+		ANA_inAmpRight = frame.amplitude_right;
+		ANA_inHallLeft = frame.amplitude_hall_in6;
+		ANA_inHallRight = frame.amplitude_hall_in11;
+		ANA_inPhase = frame.phase_right - frame.phase_left;
+		ANA_inMeasReady = true;
+	}
+	ANA_Handler();
+	if (ANA_Pending()) {
+		EVT_post(EVT_ANALYTICS);
+	}
+	if (ANA_outStartQUAD) {
+		ADC123_quad_scan_init();
+		ADC123_triple_scan_start();
+		ANA_outStartQUAD = false;
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Bring up the drivers like main() does
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	MEAS_config = MEAS_presets[MEAS_PRESET_STANDARD];
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	MEAS_oversampling = false;
+	PB_init();
+	PB_enableIRQ();
+	MEAS_GPIO_analog_init();
+	MEAS_timer_init();
+	ANA_Init();
+	EVT_init();
+}
+
+
+/** ***************************************************************************
+ * @brief The timer triggers the ADC at the sampling frequency
+ *****************************************************************************/
+static void test_timer_setup(void)
+{
+	TEST_init();
+	CHECK_EQUAL(TIM2->PSC, 0);
+	CHECK_EQUAL(TIM2->ARR, 84000000/600 - 1);
+	CHECK(TIM2->CR2 & TIM_CR2_MMS_1);		// TRGO on update
+	CHECK(MOCK_irq_enabled(TIM2_IRQn));
+	CHECK((GPIOF->MODER & GPIO_MODER_MODER6_Msk) == GPIO_MODER_MODER6_Msk);
+	CHECK((GPIOC->MODER & GPIO_MODER_MODER3_Msk) == GPIO_MODER_MODER3_Msk);
+}
+
+
+/** ***************************************************************************
+ * @brief The button interrupt wakes up the main loop
+ *****************************************************************************/
+static void test_button_event(void)
+{
+	TEST_init();
+	MOCK_exti(0);
+	CHECK_EQUAL(EVT_wait(), EVT_BUTTON);
+	CHECK(PB_pressed());
+	CHECK(!PB_pressed());
+	CHECK_EQUAL(EXTI->PR, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Button, triple scan, DMA interrupt, frame queue and analytics
+ *
+ * The amplitudes are the LUT strengths at 30 mm of mode L.
+ *****************************************************************************/
+static void test_single_measurement(void)
+{
+	float amplitudes[4] = {570, 565, 300, 200};
+	TEST_init();
+	TEST_fill(amplitudes, 60, 600);
+
+	MOCK_exti(0);							// User presses the button
+	CHECK_EQUAL(EVT_wait(), EVT_BUTTON);
+	TEST_main_pass();						// Requested and started
+	CHECK(ANA_measBusy);
+	CHECK(DMA2_Stream0->CR & DMA_SxCR_EN);
+	CHECK(TIM2->CR1 & TIM_CR1_CEN);
+	CHECK_EQUAL(DMA2_Stream0->NDTR, MEAS_QUAD_STRIDE*60);
+	CHECK_EQUAL((ADC->CCR & ADC_CCR_MULTI) >> ADC_CCR_MULTI_Pos, 22);
+
+	CHECK_EQUAL(MOCK_dma_transfer(DMA2_Stream0, TEST_frame,
+								  MEAS_QUAD_STRIDE*60), MEAS_QUAD_STRIDE*60);
+	CHECK(!(DMA2_Stream0->CR & DMA_SxCR_EN));	// Single scan stopped
+	CHECK(!(TIM2->CR1 & TIM_CR1_CEN));
+	CHECK(!MOCK_irq_enabled(DMA2_Stream0_IRQn));
+	CHECK_EQUAL(EVT_wait(), EVT_MEAS);
+
+	TEST_main_pass();						// Frame to the analytics
+	CHECK_EQUAL(ANA_inAmpLeft, 570);
+	CHECK_EQUAL(ANA_inAmpRight, 565);
+	CHECK_EQUAL(ANA_inHallLeft, 200);
+	CHECK_EQUAL(ANA_inHallRight, 300);
+	CHECK(ANA_outDataReady);				// Analysed in the same pass
+	CHECK_NEAR(ANA_outResults[1], 30, 0.01);
+	CHECK(!ANA_measBusy);
+}
+
+
+/** ***************************************************************************
+ * @brief Measurement of several frames without any tick
+ *
+ * The SysTick never fires, each pass has to be woken by the frame or by the
+ * analytics themselves. A step waiting for the tick would sleep without a
+ * pending interrupt, which ends the test in the deadlock check of the model.
+ *****************************************************************************/
+static void test_cycles_without_tick(void)
+{
+	float amplitudes[4] = {570, 565, 300, 200};
+	uint32_t scans = 0;
+	TEST_init();
+	TEST_fill(amplitudes, 60, 600);
+	ANA_inOptn[3] = 5;
+
+	MOCK_exti(0);
+	do {
+		EVT_t event = EVT_wait();
+		CHECK(event != EVT_TICK);
+		TEST_main_pass();
+		if (DMA2_Stream0->CR & DMA_SxCR_EN) {	// Scan started, deliver it
+			scans++;
+			MOCK_dma_transfer(DMA2_Stream0, TEST_frame, MEAS_QUAD_STRIDE*60);
+		}
+	} while (ANA_measBusy && (scans <= 5));
+	CHECK_EQUAL(scans, 5);
+	CHECK(ANA_outDataReady);
+	CHECK_NEAR(ANA_outResults[1], 30, 0.01);
+	CHECK_NEAR(ANA_outResults[2], 0, 0.01);
+	ANA_inOptn[3] = 1;
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_timer_setup);
+	UNIT_RUN(test_button_event);
+	UNIT_RUN(test_single_measurement);
+	UNIT_RUN(test_cycles_without_tick);
+	UNIT_EXIT();
+}
@@ -0,0 +1,236 @@
+/** ***************************************************************************
+ * @file
+ * @brief Statistics and CSV report of the run time probes
+ *
+ * The host clock of PROF_now() is replaced by TEST_clock, so the probes
+ * record exactly the durations the tests step the clock by. The
+ * statistics are checked against the recorded runs, the histogram at the
+ * edges of its power of 2 bins and the CSV report character by character,
+ * including output cut off by a short buffer.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+#include <time.h>
+
+#include "unit.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint64_t TEST_clock;			///< Host clock of PROF_now() [ns]
+
+/// Header line of the CSV report
+static const char TEST_header[] = "probe,count,min_us,mean_us,max_us,"
+		"bin0,bin1,bin2,bin3,bin4,bin5,bin6,bin7,bin8,bin9,bin10,bin11,"
+		"bin12,bin13,bin14,bin15\n";
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Host clock of PROF_now(), set by the tests
+ * @param [in] clock, ignored
+ * @param [out] time TEST_clock
+ * @return 0
+ *****************************************************************************/
+int clock_gettime(clockid_t clock, struct timespec* time)
+{
+	(void)clock;
+	time->tv_sec = TEST_clock / 1000000000u;
+	time->tv_nsec = TEST_clock % 1000000000u;
+	return 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Bin of the only run recorded since the reset
+ * @param [in] probe
+ * @return bin, -1 if not exactly one run is in the histogram
+ *****************************************************************************/
+static int TEST_bin(PROF_probe_t probe)
+{
+	int bin = -1;
+	uint32_t runs = 0;
+	for (int b = 0; b < PROF_BINS; ++b) {
+		runs += PROF_stats[probe].histogram[b];
+		if (PROF_stats[probe].histogram[b] > 0) {
+			bin = b;
+		}
+	}
+	return (runs == 1) ? bin : -1;
+}
+
+
+/** ***************************************************************************
+ * @brief Count, min, max, sum and mean of the recorded runs
+ *****************************************************************************/
+static void test_statistics(void)
+{
+	static const uint32_t runs[] = {500, 120, 9000, 120, 7};
+	PROF_stat_t* stat = &PROF_stats[PROF_ANA_HANDLER];
+
+	PROF_init();
+	CHECK_EQUAL(stat->count, 0);
+	CHECK_EQUAL(stat->min, UINT32_MAX);
+	CHECK_EQUAL(stat->max, 0);
+	CHECK_EQUAL(PROF_mean_us(PROF_ANA_HANDLER), 0);
+
+	for (unsigned i = 0; i < sizeof(runs)/sizeof(uint32_t); ++i) {
+		PROF_record(PROF_ANA_HANDLER, runs[i]);
+	}
+	CHECK_EQUAL(stat->count, 5);
+	CHECK_EQUAL(stat->min, 7);
+	CHECK_EQUAL(stat->max, 9000);
+	CHECK_EQUAL(stat->sum, 9747);
+	CHECK_NEAR(PROF_mean_us(PROF_ANA_HANDLER), 9747/5e3, 1e-6);
+	CHECK_EQUAL(PROF_stats[PROF_GUI_SITE].count, 0);	// Others untouched
+
+	PROF_reset();
+	CHECK_EQUAL(stat->count, 0);
+	CHECK_EQUAL(stat->sum, 0);
+	CHECK_EQUAL(stat->min, UINT32_MAX);
+}
+
+
+/** ***************************************************************************
+ * @brief PROF_BEGIN() and PROF_END() record the time in between
+ *
+ * The counts wrap at 2^32, a run across the wrap has its true duration.
+ *****************************************************************************/
+static void test_markers(void)
+{
+	PROF_reset();
+	TEST_clock = 5000000000u;
+	{
+		PROF_BEGIN(PROF_GUI_SITE);
+		TEST_clock += 250;
+		PROF_END(PROF_GUI_SITE);
+	}
+	TEST_clock = (1ull << 32) - 100;
+	{
+		PROF_BEGIN(PROF_GUI_SITE);
+		TEST_clock += 300;
+		PROF_END(PROF_GUI_SITE);
+	}
+	CHECK_EQUAL(PROF_stats[PROF_GUI_SITE].count, 2);
+	CHECK_EQUAL(PROF_stats[PROF_GUI_SITE].min, 250);
+	CHECK_EQUAL(PROF_stats[PROF_GUI_SITE].max, 300);
+	CHECK_EQUAL(PROF_us(PROF_stats[PROF_GUI_SITE].max), 0.3f);
+}
+
+
+/** ***************************************************************************
+ * @brief Runs fall into the bins at their powers of 2
+ *****************************************************************************/
+static void test_histogram(void)
+{
+	static const struct {
+		uint32_t counts;
+		int bin;
+	} runs[] = {
+		{0, 0}, {1, 0}, {127, 0},
+		{128, 1}, {255, 1},
+		{256, 2}, {511, 2},
+		{512, 3},
+		{1u << 20, 14}, {(1u << 21) - 1, 14},
+		{1u << 21, 15}, {1u << 22, 15}, {UINT32_MAX, 15}
+	};
+
+	for (unsigned i = 0; i < sizeof(runs)/sizeof(runs[0]); ++i) {
+		PROF_reset();
+		PROF_record(PROF_MEAS_ISR, runs[i].counts);
+		CHECK_EQUAL(TEST_bin(PROF_MEAS_ISR), runs[i].bin);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Header and probe lines, times in microseconds
+ *****************************************************************************/
+static void test_csv(void)
+{
+	char buffer[1024];
+
+	CHECK_EQUAL(PROF_csv_header(buffer, sizeof(buffer)),
+				strlen(TEST_header));
+	CHECK(strcmp(buffer, TEST_header) == 0);
+
+	PROF_reset();
+	PROF_record(PROF_GUI_TS, 1000);			// Bin 3
+	PROF_record(PROF_GUI_TS, 3000);			// Bin 5
+	static const char line[] = "Touch,2,1.00,2.00,3.00,"
+			"0,0,0,1,0,1,0,0,0,0,0,0,0,0,0,0\n";
+	CHECK_EQUAL(PROF_csv_probe(PROF_GUI_TS, PROF_name[PROF_GUI_TS], buffer,
+							   sizeof(buffer)), strlen(line));
+	CHECK(strcmp(buffer, line) == 0);
+
+	static const char unused[] = "sort 60,0,0.00,0.00,0.00,"
+			"0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0\n";
+	PROF_csv_probe(PROF_ANA_HANDLER, "sort 60", buffer, sizeof(buffer));
+	CHECK(strcmp(buffer, unused) == 0);		// No runs, min shown as 0
+
+	// Whole report: header and the probes in their order
+	uint32_t length = PROF_csv(buffer, sizeof(buffer));
+	CHECK_EQUAL(length, strlen(buffer));
+	CHECK(strncmp(buffer, TEST_header, strlen(TEST_header)) == 0);
+	const char* row = buffer;
+	for (int i = 0; i < PROF_COUNT; ++i) {
+		row = strchr(row, '\n') + 1;
+		CHECK(strncmp(row, PROF_name[i], strlen(PROF_name[i])) == 0);
+		CHECK_EQUAL(row[strlen(PROF_name[i])], ',');
+	}
+	CHECK(strstr(buffer, line) != NULL);
+	CHECK_EQUAL(strchr(row, '\n') - buffer + 1, length);	// Nothing more
+}
+
+
+/** ***************************************************************************
+ * @brief A short buffer cuts the report off, terminated
+ *****************************************************************************/
+static void test_csv_cut(void)
+{
+	char buffer[256];
+	uint32_t header = strlen(TEST_header);
+
+	PROF_reset();
+	memset(buffer, 'x', sizeof(buffer));
+	CHECK_EQUAL(PROF_csv(buffer, 10), 9);
+	CHECK(strcmp(buffer, "probe,cou") == 0);
+
+	CHECK_EQUAL(PROF_csv(buffer, 1), 0);
+	CHECK_EQUAL(buffer[0], 0);
+
+	// Cut in the first probe line
+	memset(buffer, 'x', sizeof(buffer));
+	CHECK_EQUAL(PROF_csv(buffer, header+5), header+4);
+	CHECK(strncmp(buffer, TEST_header, header) == 0);
+	CHECK(strcmp(&buffer[header], "Anal") == 0);
+	CHECK_EQUAL(buffer[header+5], 'x');		// Nothing beyond the buffer
+
+	// Exactly the header, the terminating 0 does not fit
+	CHECK_EQUAL(PROF_csv(buffer, header), header-1);
+	CHECK_EQUAL(strlen(buffer), header-1);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_statistics);
+	UNIT_RUN(test_markers);
+	UNIT_RUN(test_histogram);
+	UNIT_RUN(test_csv);
+	UNIT_RUN(test_csv_cut);
+	UNIT_EXIT();
+}
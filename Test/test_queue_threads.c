@@ -0,0 +1,186 @@
+/** ***************************************************************************
+ * @file
+ * @brief Frame queue under a concurrent producer and consumer
+ *
+ * A producer thread plays the hardware of a stream: it delivers stamped
+ * frames through the DMA model, the DMA interrupt runs in this thread and
+ * writes the queue. The main thread is the main loop and reads frames with
+ * MEAS_frame_read() as fast as it can. Paced, the producer keeps the queue
+ * from overflowing, unpaced it is full most of the time and drops frames.
+ * @n All samples of a frame hold its number, which equals the sequence
+ * number of a stream started at 0. A frame copied while the interrupt
+ * writes its slot would mix stamps or disagree with its sequence.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "measuring.h"
+#include "events.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_SAMPLES	60			///< Samples per channel of the standard
+#define TEST_COUNT		(MEAS_QUAD_STRIDE*TEST_SAMPLES)	///< Halfwords/frame
+#define TEST_FRAMES		20000		///< Frames per run
+#define TEST_STAMP_MASK	0x0FFF		///< Stamps are 12 bit ADC values
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint16_t TEST_frame[TEST_COUNT];	///< DR data of one frame
+static atomic_bool TEST_done;			///< Producer finished
+static atomic_uint TEST_received;		///< Frames read by the consumer
+static bool TEST_paced;					///< Producer waits for queue space
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Producer, the DMA delivers TEST_FRAMES stamped frames
+ * @param [in] unused
+ * @return NULL
+ *
+ * Paced, the next frame is only sent when the queue has space for it, like
+ * a main loop keeping up with the 100 ms frames of the hardware.
+ *****************************************************************************/
+static void* TEST_producer(void* unused)
+{
+	(void)unused;
+	for (uint32_t k = 0; k < TEST_FRAMES; ++k) {
+		while (TEST_paced
+			   && ((k - atomic_load(&TEST_received)) >= MEAS_QUEUE_SIZE)) {
+			sched_yield();
+		}
+		for (uint32_t i = 0; i < TEST_COUNT; ++i) {
+			TEST_frame[i] = (uint16_t)(k & TEST_STAMP_MASK);
+		}
+		MOCK_dma_transfer(DMA2_Stream0, TEST_frame, TEST_COUNT);
+	}
+	atomic_store(&TEST_done, true);
+	return NULL;
+}
+
+
+/** ***************************************************************************
+ * @brief Check that a frame holds one stamp matching its sequence
+ * @param [in] frame read from the queue
+ * @return true if the frame is consistent
+ *****************************************************************************/
+static bool TEST_whole(const MEAS_frame_t* frame)
+{
+	uint16_t stamp = (uint16_t)(frame->sequence & TEST_STAMP_MASK);
+	for (int c = 0; c < MEAS_WAVE_CHANNELS; ++c) {
+		for (int i = 0; i < MEAS_WAVE_SAMPLES; ++i) {
+			if (frame->wave[c][i] != stamp) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+/** ***************************************************************************
+ * @brief Run producer and consumer concurrently
+ * @param [in] true if the producer waits for queue space
+ *
+ * Every frame is either received once or counted as dropped.
+ *****************************************************************************/
+static void TEST_run(bool paced)
+{
+	MEAS_frame_t frame;
+	pthread_t producer;
+	uint32_t received = 0;
+	uint32_t torn = 0;
+	uint32_t disorder = 0;
+	uint32_t gaps = 0;
+	uint32_t next = 0;
+
+	MOCK_reset();
+	MEAS_engine = MEAS_ENGINE_PEAK;
+	MEAS_oversampling = false;
+	MEAS_nominal = MEAS_MAINS_FREQ;
+	MEAS_config_preset(MEAS_PRESET_STANDARD);
+	MEAS_GPIO_analog_init();
+	MEAS_timer_init();
+	MEAS_frame_flush();
+	EVT_init();
+	ADC123_quad_stream_init();
+	ADC123_triple_scan_start();
+	atomic_store(&TEST_done, false);
+	atomic_store(&TEST_received, 0);
+	TEST_paced = paced;
+	CHECK(pthread_create(&producer, NULL, TEST_producer, NULL) == 0);
+
+	bool done = false;
+	while (!done) {
+		done = atomic_load(&TEST_done);	// Drain once more after the end
+		while (MEAS_frame_read(&frame)) {
+			torn += !TEST_whole(&frame);
+			if (frame.sequence < next) {
+				disorder++;
+			} else {
+				gaps += frame.sequence - next;
+			}
+			next = frame.sequence + 1;
+			received++;
+			atomic_store(&TEST_received, received);
+		}
+		sched_yield();					// Queue empty
+	}
+	pthread_join(producer, NULL);
+	ADC123_stream_stop();
+	gaps += TEST_FRAMES - next;			// Dropped after the last one read
+
+	printf("  %u received, %u dropped\n", received, MEAS_frames_dropped);
+	CHECK_EQUAL(torn, 0);
+	CHECK_EQUAL(disorder, 0);
+	CHECK_EQUAL(gaps, MEAS_frames_dropped);
+	CHECK_EQUAL(received + MEAS_frames_dropped, TEST_FRAMES);
+	CHECK_EQUAL(MEAS_frame_count, TEST_FRAMES);
+}
+
+
+/** ***************************************************************************
+ * @brief Consumer keeps up, nothing may be dropped
+ *****************************************************************************/
+static void test_paced(void)
+{
+	TEST_run(true);
+	CHECK_EQUAL(MEAS_frames_dropped, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Producer runs freely, full queues drop and count frames
+ *****************************************************************************/
+static void test_unpaced(void)
+{
+	TEST_run(false);
+	CHECK(MEAS_frames_dropped > 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_paced);
+	UNIT_RUN(test_unpaced);
+	UNIT_EXIT();
+}
@@ -0,0 +1,308 @@
+/** ***************************************************************************
+ * @file
+ * @brief Golden images of all sites of the GUI
+ *
+ * The GUI is driven like by the main loop: button presses, touches
+ * evaluated by GUI_TSEvaluate() and new results, each followed by a pass of
+ * GUI_SiteHandler() and a vertical blanking of the LTDC. The image on the
+ * panel is then compared pixel by pixel with a PNG in Test/golden.
+ * @n On a difference the image is written as <name>_actual.png into the
+ * working directory. After an intended change of the GUI the golden images
+ * are written again by running the test with UPDATE_GOLDEN=1.
+ * @n All inputs are fixed. The cycle counter of the mock and the host clock
+ * of the probes stand still, so the timings on the debug site are 0.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <png.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "display.h"
+#include "unit.h"
+#include "lcd_gui.h"
+#include "calibration.h"
+#include "history.h"
+#include "stm32f429i_discovery_lcd.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_PIXELS		(MOCK_LCD_WIDTH*MOCK_LCD_HEIGHT)	///< Per frame
+#define TEST_PATH		256			///< Length of file names
+#define TEST_RESULTS	300			///< Entries in the history
+#define TEST_TAP		250			///< Time between two touches [ms]
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint8_t TEST_image[3*TEST_PIXELS];	///< Screen as RGB
+static uint8_t TEST_golden[3*TEST_PIXELS];	///< Golden image as RGB
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Host clock of PROF_now(), stands still for reproducible images
+ * @param [in] clock, ignored
+ * @param [out] time, always 0
+ * @return 0
+ *****************************************************************************/
+int clock_gettime(clockid_t clock, struct timespec* time)
+{
+	(void)clock;
+	time->tv_sec = 0;
+	time->tv_nsec = 0;
+	return 0;
+}
+
+
+/** ***************************************************************************
+ * @brief One pass of the main loop with the given inputs, then a vblank
+ *
+ * Every pass with an input shows a new frame.
+ *****************************************************************************/
+static void TEST_pass(void)
+{
+	uint32_t flips = GUI_flipCount;
+	GUI_SiteHandler();
+	MOCK_vsync();
+	CHECK_EQUAL(GUI_flipCount, flips + 1);
+}
+
+
+/** ***************************************************************************
+ * @brief Press the user button
+ *****************************************************************************/
+static void TEST_button(void)
+{
+	GUI_inputBtn = true;
+	TEST_pass();
+}
+
+
+/** ***************************************************************************
+ * @brief Touch the screen and release it again
+ * @param [in] X position
+ * @param [in] Y position
+ *
+ * The touch comes TEST_TAP after the previous one, past the hold-off of
+ * the option area.
+ *****************************************************************************/
+static void TEST_touch(uint16_t x, uint16_t y)
+{
+	MOCK_tick += TEST_TAP;
+	GUI_TSEvaluate(true, x, y);
+	TEST_pass();
+	GUI_TSEvaluate(false, x, y);
+}
+
+
+/** ***************************************************************************
+ * @brief A new result is ready
+ *****************************************************************************/
+static void TEST_result(void)
+{
+	GUI_inputMeasReady = true;
+	TEST_pass();
+}
+
+
+/** ***************************************************************************
+ * @brief Compare the screen with a golden image
+ * @param [in] name of the image, without extension
+ *
+ * The colours are opaque, the alpha channel is dropped.
+ *****************************************************************************/
+static void TEST_golden_check(const char* name)
+{
+	const uint32_t* screen = MOCK_screen();
+	char path[TEST_PATH];
+	png_image png;
+	uint32_t differences = 0;
+
+	CHECK(screen != NULL);
+	if (screen == NULL) {
+		return;
+	}
+	for (int i = 0; i < TEST_PIXELS; ++i) {
+		TEST_image[3*i] = (uint8_t)(screen[i] >> 16);
+		TEST_image[3*i+1] = (uint8_t)(screen[i] >> 8);
+		TEST_image[3*i+2] = (uint8_t)screen[i];
+	}
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	png.width = MOCK_LCD_WIDTH;
+	png.height = MOCK_LCD_HEIGHT;
+	png.format = PNG_FORMAT_RGB;
+
+	snprintf(path, sizeof(path), "%s/%s.png", TEST_GOLDEN_DIR, name);
+	if (getenv("UPDATE_GOLDEN") != NULL) {
+		CHECK(png_image_write_to_file(&png, path, 0, TEST_image, 0, NULL));
+		printf("  %s written\n", path);
+		return;
+	}
+
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, path)) {
+		printf("  %s: %s\n", path, png.message);
+		CHECK(false);
+		return;
+	}
+	png.format = PNG_FORMAT_RGB;
+	CHECK_EQUAL(png.width, MOCK_LCD_WIDTH);
+	CHECK_EQUAL(png.height, MOCK_LCD_HEIGHT);
+	if ((png.width != MOCK_LCD_WIDTH) || (png.height != MOCK_LCD_HEIGHT)) {
+		png_image_free(&png);
+		return;
+	}
+	CHECK(png_image_finish_read(&png, NULL, TEST_golden, 0, NULL));
+	for (int i = 0; i < TEST_PIXELS; ++i) {
+		differences += (memcmp(&TEST_image[3*i], &TEST_golden[3*i], 3) != 0);
+	}
+	if (differences > 0) {
+		printf("  %s: %u pixels differ\n", name, differences);
+		snprintf(path, sizeof(path), "%s_actual.png", name);
+		png.format = PNG_FORMAT_RGB;
+		png_image_write_to_file(&png, path, 0, TEST_image, 0, NULL);
+	}
+	CHECK_EQUAL(differences, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Set up the BSP, the GUI and fixed inputs of all sites
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	MOCK_display_init();
+	BSP_LCD_Init();
+	GUI_LCD_Init();
+
+	for (int c = 0; c < GUI_SCOPE_CHANNELS; ++c) {
+		for (int i = 0; i < GUI_SCOPE_SAMPLES; ++i) {
+			int32_t phase = (i*4 + c*3) % 24;	// Triangle, 12 samples period
+			int32_t level = (phase < 12) ? phase : 24 - phase;
+			GUI_scopeWave[c][i] = (uint16_t)(2048 + (level - 6)*(60 + 40*c));
+		}
+	}
+	HIST_init();
+	for (int i = 0; i < TEST_RESULTS; ++i) {
+		bool cable = (i % 50) < 40;			// Gaps without a cable
+		HIST_add(100*i, cable ? 20.0f + (i % 97) : -1.0f,
+				 cable ? 2.0f + (i % 23)*0.5f : -1.0f, 0);
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Hint, main and measurement site
+ *****************************************************************************/
+static void test_measurement(void)
+{
+	TEST_pass();
+	TEST_golden_check("hint");
+
+	TEST_button();
+	TEST_golden_check("main");
+
+	GUI_angle = 12.5f;
+	GUI_angleConfidence = 0.8f;
+	GUI_distance = 8.5f;
+	GUI_current = 3.2f;
+	GUI_cable_detected = true;
+	TEST_result();
+	TEST_golden_check("measurement");
+
+	TEST_touch(120, 300);					// Mode LN
+	GUI_angle = -30.0f;
+	GUI_distance = 42.3f;
+	GUI_distanceDeviation = 0.4f;
+	GUI_options[2].active = 1;
+	GUI_cable_not_detected = true;
+	TEST_result();
+	TEST_golden_check("measurement_ln");
+}
+
+
+/** ***************************************************************************
+ * @brief Options and raw site
+ *
+ * A touch right after the one of the option area is ignored.
+ *****************************************************************************/
+static void test_options(void)
+{
+	TEST_touch(200, 20);					// Options
+	TEST_golden_check("options");
+	GUI_TSEvaluate(true, 180, 100);
+	GUI_TSEvaluate(false, 180, 100);
+	CHECK_EQUAL(GUI_options[0].active, 0);	// Still analysed data
+
+	TEST_touch(180, 100);					// Display raw data
+	TEST_golden_check("options_raw");
+
+	GUI_rawHallLeft = 1.25f;
+	GUI_rawHallRight = 0.75f;
+	GUI_rawWpcLeft = 312.5f;
+	GUI_rawWpcRight = 287.0f;
+	TEST_touch(200, 20);					// Back to the measurement
+	TEST_golden_check("raw");
+
+	TEST_touch(200, 20);					// Options
+	TEST_touch(60, 100);					// Display analysed data
+}
+
+
+/** ***************************************************************************
+ * @brief Debug, scope, trend and calibration site, opened by the button
+ *****************************************************************************/
+static void test_button_sites(void)
+{
+	TEST_button();
+	TEST_golden_check("debug");
+
+	TEST_button();
+	TEST_golden_check("scope");
+
+	TEST_button();
+	TEST_golden_check("trend");
+
+	for (int i = 0; i < 30; ++i) {		// Scrolled by the new results
+		HIST_add(100*(TEST_RESULTS + i), 150.0f, 10.0f, 0);
+	}
+	TEST_result();
+	TEST_golden_check("trend_scrolled");
+
+	TEST_button();
+	TEST_golden_check("calibration");
+
+	CAL_wizard.point = 3;					// Three points measured
+	CAL_wizard.left[2] = 1234.5f;
+	CAL_wizard.right[2] = 987.6f;
+	TEST_result();
+	TEST_golden_check("calibration_point");
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	TEST_init();
+	UNIT_RUN(test_measurement);
+	UNIT_RUN(test_options);
+	UNIT_RUN(test_button_sites);
+	UNIT_EXIT();
+}
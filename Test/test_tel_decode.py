@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Decode the capture of test_telemetry with Tools/tel_decode.py
+
+The payload layouts of the decoder are written out by hand and must follow
+Core/Inc/telemetry.h. test_telemetry queues one message of each type with
+known values and writes the sent bytes to a file, this test decodes them
+and compares every field, so a layout changed on one side only fails.
+
+    test_tel_decode.py Tools/tel_decode.py telemetry.bin
+
+Only the Python standard library is used.
+"""
+
+import importlib.util
+import struct
+import sys
+
+
+def load(path):
+    """Import the decoder from its file"""
+    spec = importlib.util.spec_from_file_location("tel_decode", path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def main():
+    decoder = load(sys.argv[1])
+    stats = {"messages": 0, "crc_errors": 0, "unknown": 0}
+    decoded = {}
+    with open(sys.argv[2], "rb") as stream:
+        for kind, payload in decoder.messages(stream, stats):
+            if kind == decoder.TEXT:
+                decoded["text"] = payload.decode("ascii")
+                continue
+            name, fmt, fields = decoder.MESSAGES[kind]
+            if len(payload) != struct.calcsize(fmt):
+                stats["unknown"] += 1
+                continue
+            decoded[name] = dict(zip(fields, struct.unpack(fmt, payload)))
+
+    failures = []
+
+    def check(condition, text):
+        if not condition:
+            failures.append(text)
+
+    check(stats == {"messages": 4, "crc_errors": 0, "unknown": 0},
+          "stats %s" % stats)
+    check(decoded.get("frame") == {
+        "sequence": 7, "tick": 1234, "wpc_left": 1000, "wpc_right": 2000,
+        "hall_left": 3000, "hall_right": 4000}, "frame %s"
+          % decoded.get("frame"))
+    check(decoded.get("result") == {
+        "tick": 5678, "distance": 42.5, "angle": -12.25, "current": 3.5,
+        "deviation": 0.75, "mode": 2, "detected": 1, "confidence": 0.875},
+          "result %s" % decoded.get("result"))
+    wave = decoded.get("wave", {})
+    check(wave.get("sequence") == 9, "wave sequence %s"
+          % wave.get("sequence"))
+    check(all(wave.get("c%d_s%d" % (c, s)) == 1000 * c + s
+              for c in range(decoder.WAVE_CHANNELS)
+              for s in range(decoder.WAVE_SAMPLES)), "wave samples")
+    check(decoded.get("text", "").startswith("probe,count,"),
+          "text %r" % decoded.get("text"))
+
+    for text in failures:
+        print("check failed: " + text)
+    print("%d messages, %d failed" % (stats["messages"], len(failures)))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
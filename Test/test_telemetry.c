@@ -0,0 +1,301 @@
+/** ***************************************************************************
+ * @file
+ * @brief Framing, transmit ring and drop policy of the telemetry
+ *
+ * telemetry.c runs on the register model, MOCK_dma_send() plays USART1
+ * and takes the bytes DMA2 Stream7 sends. Each message type is queued
+ * once, the bytes handed to the DMA are checked field by field against
+ * telemetry.h and a CRC-16/CCITT computed here. A stalled DMA fills the
+ * ring until a message is dropped, the stream must still hold complete
+ * messages only, also across the end of the ring.
+ *
+ *   test_telemetry [capture]
+ *
+ * The messages of each type are written to the capture file, by default
+ * telemetry.bin, which test_tel_decode.py decodes with Tools/tel_decode.py.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <string.h>
+
+#include "mock.h"
+#include "unit.h"
+#include "telemetry.h"
+#include "profile.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_OVERHEAD	7			///< Sync, type, length and CRC
+#define TEST_CAPTURE	(2*TEL_BUFFER_SIZE)	///< Bytes of the buffers
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static uint8_t TEST_sent[TEST_CAPTURE];	///< Bytes of the last drain
+static uint8_t TEST_capture[TEST_CAPTURE];	///< One message of each type
+static uint32_t TEST_captured;				///< Bytes in TEST_capture
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start with an idle USART and an empty ring
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	TEL_init();
+	TEL_dropped = 0;
+	TEL_bytes = 0;
+}
+
+
+/** ***************************************************************************
+ * @brief Reference CRC-16/CCITT, polynomial 0x1021, start 0xFFFF
+ * @param [in] data
+ * @param [in] length
+ * @return crc
+ *****************************************************************************/
+static uint16_t TEST_crc(const uint8_t* data, uint32_t length)
+{
+	uint16_t crc = 0xFFFF;
+	for (uint32_t i = 0; i < length; ++i) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (int b = 0; b < 8; ++b) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021)
+								 : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+/** ***************************************************************************
+ * @brief Check one framed message
+ * @param [in] bytes of the message
+ * @param [in] type
+ * @param [in] expected payload
+ * @param [in] payload length
+ *****************************************************************************/
+static void TEST_message(const uint8_t* bytes, TEL_msg_t type,
+						 const void* payload, uint16_t length)
+{
+	CHECK_EQUAL(bytes[0], TEL_SYNC0);
+	CHECK_EQUAL(bytes[1], TEL_SYNC1);
+	CHECK_EQUAL(bytes[2], type);
+	CHECK_EQUAL(bytes[3] | (bytes[4] << 8), length);
+	CHECK(memcmp(&bytes[5], payload, length) == 0);
+	uint16_t crc = TEST_crc(&bytes[2], length + 3);
+	CHECK_EQUAL(bytes[5+length], crc & 0xFF);
+	CHECK_EQUAL(bytes[6+length], crc >> 8);
+}
+
+
+/** ***************************************************************************
+ * @brief Let the USART take everything the DMA sends
+ * @return bytes sent, in TEST_sent
+ *****************************************************************************/
+static uint32_t TEST_drain(void)
+{
+	return MOCK_dma_send(DMA2_Stream7, TEST_sent, TEST_CAPTURE);
+}
+
+
+/** ***************************************************************************
+ * @brief Check the message handed to the idle DMA, send and keep it
+ * @param [in] type
+ * @param [in] expected payload
+ * @param [in] payload length
+ *****************************************************************************/
+static void TEST_sent_message(TEL_msg_t type, const void* payload,
+							  uint16_t length)
+{
+	// The ring holds the message, the DMA points at it
+	const uint8_t* ring = (const uint8_t*)(uintptr_t)DMA2_Stream7->M0AR;
+	CHECK(DMA2_Stream7->CR & DMA_SxCR_EN);
+	CHECK_EQUAL(DMA2_Stream7->NDTR, length + TEST_OVERHEAD);
+	TEST_message(ring, type, payload, length);
+
+	uint32_t sent = TEST_drain();
+	CHECK_EQUAL(sent, length + TEST_OVERHEAD);
+	TEST_message(TEST_sent, type, payload, length);
+	CHECK(!(DMA2_Stream7->CR & DMA_SxCR_EN));
+	memcpy(&TEST_capture[TEST_captured], TEST_sent, sent);
+	TEST_captured += sent;
+}
+
+
+/** ***************************************************************************
+ * @brief The reference CRC gives the check value of the CRC catalogue
+ *****************************************************************************/
+static void test_crc(void)
+{
+	CHECK_EQUAL(TEST_crc((const uint8_t*)"123456789", 9), 0x29B1);
+}
+
+
+/** ***************************************************************************
+ * @brief Configuration of USART1 and of its DMA stream
+ *****************************************************************************/
+static void test_init(void)
+{
+	TEST_init();
+	CHECK(USART1->CR1 & USART_CR1_UE);
+	CHECK(USART1->CR1 & USART_CR1_TE);
+	CHECK(USART1->CR3 & USART_CR3_DMAT);
+	CHECK_EQUAL(USART1->BRR, 91);			// 84 MHz / 921600, rounded
+	CHECK_EQUAL(DMA2_Stream7->PAR, (uint32_t)(uintptr_t)&USART1->DR);
+	CHECK_EQUAL(DMA2_Stream7->CR & DMA_SxCR_DIR, DMA_SxCR_DIR_0);
+	CHECK_EQUAL(DMA2_Stream7->CR & DMA_SxCR_CHSEL,
+				4u << DMA_SxCR_CHSEL_Pos);	// USART1_TX
+	CHECK(!(DMA2_Stream7->CR & DMA_SxCR_EN));	// Idle without messages
+	CHECK(MOCK_irq_enabled(DMA2_Stream7_IRQn));
+}
+
+
+/** ***************************************************************************
+ * @brief One message of each type with the payloads of telemetry.h
+ *****************************************************************************/
+static void test_messages(void)
+{
+	TEST_init();
+	TEST_captured = 0;
+
+	MEAS_frame_t frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.sequence = 7;
+	frame.tick = 1234;
+	frame.amplitude_left = 1000;
+	frame.amplitude_right = 2000;
+	frame.amplitude_hall_in6 = 3000;		// Left
+	frame.amplitude_hall_in11 = 4000;		// Right
+	TEL_frame(&frame);
+	TEL_frame_msg_t frameMsg = {7, 1234, {1000, 2000, 3000, 4000}};
+	TEST_sent_message(TEL_MSG_FRAME, &frameMsg, 24);
+
+	TEL_result_msg_t result = {5678, 42.5f, -12.25f, 3.5f, 0.75f, 2, 1,
+							   0.875f};
+	TEL_result(&result);
+	TEST_sent_message(TEL_MSG_RESULT, &result, 26);
+
+	static TEL_wave_msg_t wave;
+	wave.sequence = 9;
+	for (int c = 0; c < MEAS_WAVE_CHANNELS; ++c) {
+		for (int s = 0; s < MEAS_WAVE_SAMPLES; ++s) {
+			wave.wave[c][s] = (uint16_t)(1000*c + s);
+		}
+	}
+	CHECK(TEL_send(TEL_MSG_WAVE, &wave, sizeof(wave)));
+	TEST_sent_message(TEL_MSG_WAVE, &wave,
+					  4 + 2*MEAS_WAVE_CHANNELS*MEAS_WAVE_SAMPLES);
+
+	// The profile report, after TEL_PROFILE_TICKS ticks
+	for (int t = 1; t < TEL_PROFILE_TICKS; ++t) {
+		TEL_tick();
+	}
+	CHECK(!(DMA2_Stream7->CR & DMA_SxCR_EN));
+	TEL_tick();
+	char text[1024];
+	uint16_t length = (uint16_t)PROF_csv(text, sizeof(text));
+	TEST_sent_message(TEL_MSG_TEXT, text, length);
+	CHECK(strncmp(text, "probe,", 6) == 0);
+
+	CHECK_EQUAL(TEL_dropped, 0);
+	CHECK_EQUAL(TEL_bytes, TEST_captured);
+}
+
+
+/** ***************************************************************************
+ * @brief A full ring drops whole messages, the stream stays intact
+ *
+ * The DMA takes nothing until the ring is full, the sent bytes are then
+ * the queued messages one after the other. The next message wraps around
+ * the end of the ring and is sent in two DMA transfers.
+ *****************************************************************************/
+static void test_full(void)
+{
+	TEL_frame_msg_t msg = {0, 0, {1, 2, 3, 4}};
+	uint32_t size = sizeof(msg) + TEST_OVERHEAD;
+	uint32_t fit = TEL_BUFFER_SIZE/size;
+
+	TEST_init();
+	for (msg.sequence = 0; msg.sequence < fit; ++msg.sequence) {
+		CHECK(TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg)));
+	}
+	CHECK(!TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg)));
+	CHECK(!TEL_send(TEL_MSG_TEXT, "", 0));	// Not even the overhead fits
+	CHECK_EQUAL(TEL_dropped, 2);
+	CHECK_EQUAL(TEL_bytes, fit*size);
+
+	CHECK_EQUAL(TEST_drain(), fit*size);
+	for (uint32_t i = 0; i < fit; ++i) {
+		msg.sequence = i;
+		TEST_message(&TEST_sent[i*size], TEL_MSG_FRAME, &msg, sizeof(msg));
+	}
+
+	// Room again, this one crosses the end of the ring
+	msg.sequence = 1000;
+	CHECK(TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg)));
+	CHECK_EQUAL(DMA2_Stream7->NDTR, TEL_BUFFER_SIZE - fit*size);
+	CHECK_EQUAL(TEST_drain(), size);
+	TEST_message(TEST_sent, TEL_MSG_FRAME, &msg, sizeof(msg));
+	CHECK_EQUAL(TEL_dropped, 2);
+}
+
+
+/** ***************************************************************************
+ * @brief Messages queued while the DMA runs follow without a gap
+ *****************************************************************************/
+static void test_queued(void)
+{
+	TEL_frame_msg_t msg = {0, 0, {5, 6, 7, 8}};
+	uint32_t size = sizeof(msg) + TEST_OVERHEAD;
+
+	TEST_init();
+	for (msg.sequence = 0; msg.sequence < 3; ++msg.sequence) {
+		CHECK(TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg)));
+	}
+	CHECK_EQUAL(DMA2_Stream7->NDTR, size);	// First one only
+	CHECK_EQUAL(MOCK_dma_send(DMA2_Stream7, TEST_sent, 10), 10);
+	msg.sequence = 3;
+	CHECK(TEL_send(TEL_MSG_FRAME, &msg, sizeof(msg)));
+	CHECK_EQUAL(MOCK_dma_send(DMA2_Stream7, &TEST_sent[10], TEST_CAPTURE),
+				4*size - 10);
+	for (uint32_t i = 0; i < 4; ++i) {
+		msg.sequence = i;
+		TEST_message(&TEST_sent[i*size], TEL_MSG_FRAME, &msg, sizeof(msg));
+	}
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests and write the capture
+ * @param [in] argc
+ * @param [in] argv optional path of the capture
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(int argc, char** argv)
+{
+	UNIT_RUN(test_crc);
+	UNIT_RUN(test_init);
+	UNIT_RUN(test_messages);
+	UNIT_RUN(test_full);
+	UNIT_RUN(test_queued);
+
+	FILE* capture = fopen((argc > 1) ? argv[1] : "telemetry.bin", "wb");
+	CHECK(capture != NULL);
+	if (capture != NULL) {
+		CHECK_EQUAL(fwrite(TEST_capture, 1, TEST_captured, capture),
+					TEST_captured);
+		fclose(capture);
+	}
+	UNIT_EXIT();
+}
@@ -0,0 +1,194 @@
+/** ***************************************************************************
+ * @file
+ * @brief Timer math and validation of the acquisition configuration
+ *
+ * Every preset has to hit its sampling frequency and the oversampled one
+ * exactly, the registers of TIM2 and the NDTR of the triple mode DMA are
+ * checked after applying it. Configurations the timer can not hit, frames
+ * that do not span whole mains periods and triggers faster than the ADCs
+ * are rejected.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "mock.h"
+#include "unit.h"
+#include "decimate.h"
+#include "measuring.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_TIM_CLOCK	84000000	///< TIM_CLOCK of measuring.c [Hz]
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Check a configuration given by its fields
+ * @param [in] rate [Hz]
+ * @param [in] samples per frame
+ * @param [in] sequence
+ * @return result of MEAS_config_valid()
+ *****************************************************************************/
+static bool TEST_valid(uint32_t rate, uint16_t samples,
+					   MEAS_sequence_t sequence)
+{
+	MEAS_config_t config = {rate, samples, sequence};
+	return MEAS_config_valid(&config);
+}
+
+
+/** ***************************************************************************
+ * @brief Registers of TIM2 and DMA2 stream 0 for every preset
+ *
+ * With and without oversampling, the timer runs at the rate of the preset
+ * resp. DEC_RATIO times that.
+ *****************************************************************************/
+static void test_presets(void)
+{
+	MOCK_reset();
+	MEAS_nominal = 50;
+	for (int p = 0; p < MEAS_PRESET_COUNT; ++p) {
+		const MEAS_config_t* preset = &MEAS_presets[p];
+		uint32_t stride = (preset->sequence == MEAS_SEQ_QUAD)
+						? MEAS_QUAD_STRIDE : 3;
+		uint32_t psc = 1, arr = 0;
+		uint32_t pscOs = 1, arrOs = 0;
+
+		CHECK(MEAS_config_valid(preset));
+		CHECK(MEAS_timer_calc(preset->rate, &psc, &arr));
+		CHECK(MEAS_timer_calc(preset->rate*DEC_RATIO, &pscOs, &arrOs));
+		CHECK_EQUAL((uint64_t)(psc + 1)*(arr + 1)*preset->rate,
+					TEST_TIM_CLOCK);
+		CHECK_EQUAL((uint64_t)(pscOs + 1)*(arrOs + 1)*preset->rate*DEC_RATIO,
+					TEST_TIM_CLOCK);
+		CHECK_EQUAL((preset->samples*MEAS_nominal) % preset->rate, 0);
+		printf("  preset %d: %5lu Hz ARR %6lu, oversampled ARR %4lu, "
+			   "%3u samples = %lu mains periods\n", p,
+			   (unsigned long)preset->rate, (unsigned long)arr,
+			   (unsigned long)arrOs, preset->samples,
+			   (unsigned long)(preset->samples*MEAS_nominal/preset->rate));
+
+		MEAS_oversampling = false;
+		CHECK(MEAS_config_preset(p));
+		ADC123_quad_scan_init();
+		CHECK_EQUAL(TIM2->PSC, psc);
+		CHECK_EQUAL(TIM2->ARR, arr);
+		CHECK_EQUAL(DMA2_Stream0->NDTR, stride*preset->samples);
+
+		MEAS_oversampling = true;
+		ADC123_quad_scan_init();
+		CHECK_EQUAL(TIM2->PSC, pscOs);
+		CHECK_EQUAL(TIM2->ARR, arrOs);
+		CHECK_EQUAL(DMA2_Stream0->NDTR, 2*DEC_BLOCK*stride);
+	}
+	MEAS_oversampling = MEAS_DEFAULT_OVERSAMPLING;
+	CHECK(!MEAS_config_preset(MEAS_PRESET_COUNT));
+}
+
+
+/** ***************************************************************************
+ * @brief Frequencies the timer does not hit exactly
+ *
+ * 4800 Hz divides the timer clock, 4800 Hz times DEC_RATIO does not. With
+ * 96 samples the frame spans 1 period, so the oversampled rate alone makes
+ * the configuration invalid.
+ *****************************************************************************/
+static void test_inexact(void)
+{
+	MEAS_config_t before;
+	MEAS_config_t config = {4800, 96, MEAS_SEQ_QUAD};
+	uint32_t psc, arr;
+
+	MOCK_reset();
+	MEAS_nominal = 50;
+	CHECK(MEAS_timer_calc(7, &psc, &arr));
+	CHECK_EQUAL(arr, TEST_TIM_CLOCK/7 - 1);
+	CHECK(!MEAS_timer_calc(11, &psc, &arr));
+	CHECK(!MEAS_timer_calc(0, &psc, &arr));
+	CHECK(!MEAS_timer_calc(TEST_TIM_CLOCK, &psc, &arr));
+
+	CHECK(MEAS_timer_calc(config.rate, &psc, &arr));
+	CHECK(!MEAS_timer_calc(config.rate*DEC_RATIO, &psc, &arr));
+	CHECK(!MEAS_config_valid(&config));
+
+	CHECK(MEAS_config_preset(MEAS_PRESET_STANDARD));
+	before = MEAS_config;
+	arr = TIM2->ARR;
+	CHECK(!MEAS_config_set(&config));
+	CHECK_EQUAL(MEAS_config.rate, before.rate);
+	CHECK_EQUAL(MEAS_config.samples, before.samples);
+	CHECK_EQUAL(TIM2->ARR, arr);
+}
+
+
+/** ***************************************************************************
+ * @brief Frames have to span whole mains periods of the nominal frequency
+ *****************************************************************************/
+static void test_whole_periods(void)
+{
+	MEAS_nominal = 50;
+	CHECK(TEST_valid(600, 60, MEAS_SEQ_QUAD));		// 5 periods
+	CHECK(!TEST_valid(600, 61, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(600, 66, MEAS_SEQ_QUAD));		// 5.5 periods
+	CHECK(TEST_valid(600, 72, MEAS_SEQ_QUAD));		// 6 periods
+	CHECK(TEST_valid(1200, 48, MEAS_SEQ_WPC));		// 2 periods
+
+	MEAS_nominal = 60;
+	CHECK(TEST_valid(600, 60, MEAS_SEQ_QUAD));		// 6 periods
+	CHECK(!TEST_valid(600, 66, MEAS_SEQ_QUAD));		// 6.6 periods
+	CHECK(!TEST_valid(1200, 48, MEAS_SEQ_WPC));		// 2.4 periods
+	CHECK(TEST_valid(1200, 40, MEAS_SEQ_WPC));		// 2 periods
+	CHECK(TEST_valid(1200, 240, MEAS_SEQ_QUAD));	// 12 periods
+	MEAS_nominal = 50;
+}
+
+
+/** ***************************************************************************
+ * @brief Limits of rate and frame length, conversion time of the ADCs
+ *
+ * The raw waveforms take every n-th sample, rates that are no multiple of
+ * MEAS_WAVE_RATE are rejected even if the timer hits them. The fastest
+ * valid rate is 16.8 kHz, oversampled the triggers come every 1.49 us,
+ * time for two conversions of 15 ADC clocks at 21 MHz.
+ *****************************************************************************/
+static void test_limits(void)
+{
+	MEAS_nominal = 50;
+	CHECK(TEST_valid(MEAS_RATE_MIN, 12, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(MEAS_RATE_MIN - 1, 12, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(MEAS_RATE_MAX + 1000, 420, MEAS_SEQ_WPC));
+	CHECK(!TEST_valid(MEAS_RATE_MIN, 2, MEAS_SEQ_QUAD));	// Too short
+	CHECK(TEST_valid(600, MEAS_MAX_SAMPLES, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(600, MEAS_MAX_SAMPLES + 12, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(600, 60, MEAS_SEQ_WPC + 1));
+
+	CHECK(!TEST_valid(100, 12, MEAS_SEQ_QUAD));		// Below the raw rate
+	CHECK(!TEST_valid(1000, 100, MEAS_SEQ_QUAD));	// Step of 1.67 samples
+	CHECK(!TEST_valid(1000, 100, MEAS_SEQ_WPC));
+	CHECK(TEST_valid(1200, 120, MEAS_SEQ_QUAD));
+
+	CHECK(TEST_valid(16800, 336, MEAS_SEQ_WPC));
+	CHECK(TEST_valid(16800, 336, MEAS_SEQ_QUAD));
+	CHECK(!TEST_valid(MEAS_RATE_MAX, 400, MEAS_SEQ_WPC));
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_presets);
+	UNIT_RUN(test_inexact);
+	UNIT_RUN(test_whole_periods);
+	UNIT_RUN(test_limits);
+	UNIT_EXIT();
+}
@@ -0,0 +1,269 @@
+/** ***************************************************************************
+ * @file
+ * @brief Non-blocking readout of the touch controller
+ *
+ * GUI_TSHandler() is driven like by the main loop, the STMPE811 model of
+ * mock/display.c plays the controller and the I2C3 interrupts. Each started
+ * transfer is checked, then completed through the HAL callbacks of
+ * lcd_gui.c, which have to wake up the main loop with EVT_TOUCH_DATA.
+ * @n A touch is read as control register, FIFO sample, FIFO reset, FIFO
+ * enable and interrupt acknowledge. A failed or refused transfer aborts the
+ * readout, which is counted and started again.
+ *****************************************************************************/
+
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include "display.h"
+#include "unit.h"
+#include "events.h"
+#include "lcd_gui.h"
+#include "stm32f429i_discovery_lcd.h"
+#include "stm32f429i_discovery_ts.h"
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+#define TEST_RAW_X		2970		///< Raw X giving GUI X = 240 - 60
+#define TEST_RAW_Y		1460		///< Raw Y giving GUI Y = 100
+#define TEST_X			180			///< GUI X of TEST_RAW_X
+#define TEST_Y			100			///< GUI Y of TEST_RAW_Y
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+// State of lcd_gui.c, not declared in lcd_gui.h
+extern TS_StateTypeDef GUI_previousTSstate;
+extern bool GUI_inputTS;
+
+
+/******************************************************************************
+ * Functions
+ *****************************************************************************/
+
+/** ***************************************************************************
+ * @brief Start with an idle bus, an untouched screen and no inputs
+ *
+ * Every test leaves the readout idle.
+ *****************************************************************************/
+static void TEST_init(void)
+{
+	MOCK_reset();
+	MOCK_display_init();
+	BSP_LCD_Init();						// Panel size for the decoding
+	GUI_TSerrors = 0;
+	GUI_previousTSstate.TouchDetected = 0;
+	GUI_inputTS = false;
+	GUI_inputTSInt = false;
+	GUI_inputTick = false;
+	MOCK_ts_init();
+	EVT_init();
+}
+
+
+/** ***************************************************************************
+ * @brief Check the running transfer
+ * @param [in] true for a read
+ * @param [in] register address
+ * @param [in] bytes to read, ignored for a write
+ * @return true if it is the expected one
+ *****************************************************************************/
+static bool TEST_running(bool read, uint16_t reg, uint16_t size)
+{
+	const MOCK_ts_transfer_t* transfer = MOCK_ts_running();
+	return (transfer != NULL) && (transfer->read == read)
+		&& (transfer->reg == reg) && (!read || (transfer->size == size));
+}
+
+
+/** ***************************************************************************
+ * @brief Complete the running transfer and run the next pass
+ *
+ * The callback must post EVT_TOUCH_DATA, the pass then starts the next
+ * step.
+ *****************************************************************************/
+static void TEST_step(void)
+{
+	CHECK(MOCK_ts_complete(false));
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH_DATA);
+	GUI_TSHandler();
+}
+
+
+/** ***************************************************************************
+ * @brief Check the last three writes of a finished readout
+ *****************************************************************************/
+static void TEST_acknowledged(void)
+{
+	uint32_t n = MOCK_tsWriteCount;
+	CHECK(n >= 3);
+	if (n < 3) {
+		return;
+	}
+	CHECK_EQUAL(MOCK_tsWrites[n-3].reg, STMPE811_REG_FIFO_STA);
+	CHECK_EQUAL(MOCK_tsWrites[n-3].value, 0x01);	// Reset
+	CHECK_EQUAL(MOCK_tsWrites[n-2].reg, STMPE811_REG_FIFO_STA);
+	CHECK_EQUAL(MOCK_tsWrites[n-2].value, 0x00);	// Enable
+	CHECK_EQUAL(MOCK_tsWrites[n-1].reg, STMPE811_REG_INT_STA);
+	CHECK_EQUAL(MOCK_tsWrites[n-1].value, STMPE811_TS_IT);
+}
+
+
+/** ***************************************************************************
+ * @brief The INT line of the controller wakes up the main loop
+ *****************************************************************************/
+static void test_interrupt(void)
+{
+	TEST_init();
+	EXTI->RTSR |= EXTI_RTSR_TR15;		// As BSP_TS_ITConfig()
+	EXTI->IMR |= EXTI_IMR_MR15;
+	NVIC_EnableIRQ(EXTI15_10_IRQn);
+	MOCK_exti(15);
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH);
+	CHECK_EQUAL(EXTI->PR, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief Nothing is read without an input, a touch is read step by step
+ *****************************************************************************/
+static void test_touch(void)
+{
+	TEST_init();
+	GUI_TSHandler();
+	CHECK(MOCK_ts_running() == NULL);	// No interrupt, no tick
+
+	MOCK_ts_touch(true, TEST_RAW_X, TEST_RAW_Y);
+	GUI_inputTSInt = true;
+	GUI_TSHandler();
+	CHECK(!GUI_inputTSInt);
+	CHECK(TEST_running(true, STMPE811_REG_TSC_CTRL, 1));
+	GUI_TSHandler();					// Nothing done while it runs
+	CHECK(TEST_running(true, STMPE811_REG_TSC_CTRL, 1));
+
+	TEST_step();
+	CHECK(TEST_running(true, STMPE811_REG_TSC_DATA_NON_INC, 4));
+	TEST_step();
+	CHECK(TEST_running(false, STMPE811_REG_FIFO_STA, 0));
+	TEST_step();
+	CHECK(TEST_running(false, STMPE811_REG_FIFO_STA, 0));
+	TEST_step();
+	CHECK(TEST_running(false, STMPE811_REG_INT_STA, 0));
+	CHECK(!GUI_inputTS);				// Evaluated at the end only
+	TEST_step();
+	CHECK(MOCK_ts_running() == NULL);
+
+	TEST_acknowledged();
+	CHECK_EQUAL(MOCK_tsWriteCount, 3);
+	CHECK(GUI_inputTS);
+	CHECK(GUI_previousTSstate.TouchDetected);
+	CHECK_EQUAL(GUI_previousTSstate.X, TEST_X);
+	CHECK_EQUAL(GUI_previousTSstate.Y, TEST_Y);
+	CHECK_EQUAL(GUI_TSerrors, 0);
+}
+
+
+/** ***************************************************************************
+ * @brief While touched, the tick reads again until the release
+ *****************************************************************************/
+static void test_release(void)
+{
+	TEST_init();
+	MOCK_ts_touch(true, TEST_RAW_X, TEST_RAW_Y);
+	GUI_inputTSInt = true;
+	GUI_TSHandler();
+	while (MOCK_ts_running() != NULL) {
+		TEST_step();
+	}
+	CHECK(GUI_previousTSstate.TouchDetected);
+
+	GUI_inputTSInt = false;
+	GUI_inputTick = true;				// Held, polled with the tick
+	MOCK_ts_touch(false, 0, 0);
+	GUI_TSHandler();
+	GUI_inputTick = false;
+	CHECK(TEST_running(true, STMPE811_REG_TSC_CTRL, 1));
+	TEST_step();						// Released, no FIFO sample read
+	CHECK(TEST_running(false, STMPE811_REG_FIFO_STA, 0));
+	TEST_step();
+	TEST_step();
+	TEST_step();
+	CHECK(MOCK_ts_running() == NULL);
+	TEST_acknowledged();
+	CHECK(!GUI_previousTSstate.TouchDetected);
+
+	GUI_inputTick = true;				// Released, the tick reads nothing
+	GUI_TSHandler();
+	GUI_inputTick = false;
+	CHECK(MOCK_ts_running() == NULL);
+}
+
+
+/** ***************************************************************************
+ * @brief A failed transfer aborts the readout, it starts again
+ *****************************************************************************/
+static void test_bus_error(void)
+{
+	TEST_init();
+	MOCK_ts_touch(true, TEST_RAW_X, TEST_RAW_Y);
+	GUI_inputTSInt = true;
+	GUI_TSHandler();
+	TEST_step();
+	CHECK(TEST_running(true, STMPE811_REG_TSC_DATA_NON_INC, 4));
+
+	CHECK(MOCK_ts_complete(true));		// Error interrupt
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH_DATA);
+	GUI_TSHandler();
+	CHECK_EQUAL(GUI_TSerrors, 1);
+	CHECK(!GUI_inputTS);				// Nothing evaluated
+	CHECK(TEST_running(true, STMPE811_REG_TSC_CTRL, 1));	// Retried
+
+	while (MOCK_ts_running() != NULL) {
+		TEST_step();
+	}
+	CHECK(GUI_inputTS);
+	CHECK_EQUAL(GUI_TSerrors, 1);
+}
+
+
+/** ***************************************************************************
+ * @brief A transfer the HAL refuses to start is an error as well
+ *****************************************************************************/
+static void test_bus_busy(void)
+{
+	TEST_init();
+	MOCK_ts_touch(true, TEST_RAW_X, TEST_RAW_Y);
+	MOCK_tsBlocked = true;
+	GUI_inputTSInt = true;
+	GUI_TSHandler();
+	CHECK(MOCK_ts_running() == NULL);
+	CHECK_EQUAL(EVT_wait(), EVT_TOUCH_DATA);	// Posted by the start
+
+	MOCK_tsBlocked = false;
+	GUI_TSHandler();
+	CHECK_EQUAL(GUI_TSerrors, 1);
+	CHECK(TEST_running(true, STMPE811_REG_TSC_CTRL, 1));
+	while (MOCK_ts_running() != NULL) {
+		TEST_step();
+	}
+	CHECK(GUI_inputTS);
+	CHECK_EQUAL(GUI_previousTSstate.X, TEST_X);
+}
+
+
+/** ***************************************************************************
+ * @brief Run all tests
+ * @return 0 if all checks passed
+ *****************************************************************************/
+int main(void)
+{
+	UNIT_RUN(test_interrupt);
+	UNIT_RUN(test_touch);
+	UNIT_RUN(test_release);
+	UNIT_RUN(test_bus_error);
+	UNIT_RUN(test_bus_busy);
+	UNIT_EXIT();
+}
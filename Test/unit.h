@@ -0,0 +1,85 @@
+/** ***************************************************************************
+ * @file
+ * @brief Checks of the host unit tests
+ *
+ * Prefix UNIT
+ *
+ * Every test is an executable of its own. A failed check prints its
+ * location and the test carries on, UNIT_EXIT() returns the result to
+ * ctest.
+ *****************************************************************************/
+
+#ifndef TEST_UNIT_H_
+#define TEST_UNIT_H_
+
+/******************************************************************************
+ * Includes
+ *****************************************************************************/
+#include <math.h>
+#include <stdio.h>
+
+
+/******************************************************************************
+ * Variables
+ *****************************************************************************/
+static unsigned UNIT_checks = 0;		///< Checks done
+static unsigned UNIT_failures = 0;		///< Checks failed
+
+
+/******************************************************************************
+ * Defines
+ *****************************************************************************/
+/** Check a condition */
+#define CHECK(condition) do { \
+		UNIT_checks++; \
+		if (!(condition)) { \
+			UNIT_failures++; \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+				   #condition); \
+			fflush(stdout); \
+		} \
+	} while (0)
+
+/** Check two numbers for equality, prints both on failure */
+#define CHECK_EQUAL(actual, expected) do { \
+		double UNIT_a = (double)(actual); \
+		double UNIT_e = (double)(expected); \
+		UNIT_checks++; \
+		if (UNIT_a != UNIT_e) { \
+			UNIT_failures++; \
+			printf("%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, \
+				   #actual, UNIT_a, UNIT_e); \
+			fflush(stdout); \
+		} \
+	} while (0)
+
+/** Check a number against a tolerance, prints both on failure */
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+		double UNIT_a = (double)(actual); \
+		double UNIT_e = (double)(expected); \
+		UNIT_checks++; \
+		if (!(fabs(UNIT_a - UNIT_e) <= (tolerance))) { \
+			UNIT_failures++; \
+			printf("%s:%d: %s is %g, expected %g +- %g\n", __FILE__, \
+				   __LINE__, #actual, UNIT_a, UNIT_e, (double)(tolerance)); \
+			fflush(stdout); \
+		} \
+	} while (0)
+
+/** Run one test function */
+#define UNIT_RUN(test) do { \
+		unsigned UNIT_before = UNIT_failures; \
+		test(); \
+		printf("%-40s %s\n", #test, \
+			   (UNIT_failures == UNIT_before) ? "ok" : "FAILED"); \
+		fflush(stdout); \
+	} while (0)
+
+/** Print the summary and leave main() with the result */
+#define UNIT_EXIT() do { \
+		printf("%u checks, %u failed\n", UNIT_checks, UNIT_failures); \
+		return (UNIT_failures == 0) ? 0 : 1; \
+	} while (0)
+
+
+#endif /* TEST_UNIT_H_ */
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""Design and check the decimation front end, see Core/Src/decimate.c
+
+Prints the compensation FIR as C initializer and compares the amplitude of
+the mains bin measured by
+
+  - direct sampling at the analysis rate (the acquisition without
+    oversampling) and
+  - oversampling, CIC and compensation FIR, modelled like decimate.c
+
+for a noisy input with harmonics and an interferer above the analysis
+Nyquist frequency, which aliases onto the mains bin without the filter.
+
+    dec_design.py                 # coefficients, response and SNR gain
+    dec_design.py --trials 200    # more noise realisations
+
+The cycles per input sample are measured on the target with the "Decim"
+probe of the debug site, see profile.c.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import math
+import random
+
+RATE = 600                              # Analysis rate [Hz], MEAS_config.rate
+CIC_ORDER = 3                           # DEC_CIC_ORDER
+CIC_RATIO = 20                          # DEC_CIC_RATIO
+FIR_RATIO = 2                           # DEC_FIR_RATIO
+FIR_TAPS = 21                           # DEC_FIR_TAPS
+PASS = 200                              # Passband edge [Hz], compensated
+STOP = 400                              # Stopband edge [Hz], aliases > 200 Hz
+MAINS = 50                              # MEAS_MAINS_FREQ [Hz]
+SAMPLES = 60                            # Analysis samples per frame
+ADC_MAX = 4095
+
+
+def cic_response(f, fs):
+    """Magnitude of the CIC at f, fs is the CIC input rate"""
+    x = math.pi * f / fs
+    if x == 0:
+        return 1.0
+    return abs(math.sin(CIC_RATIO * x) / (CIC_RATIO * math.sin(x))) ** CIC_ORDER
+
+
+def solve(a, b):
+    """Gaussian elimination with partial pivoting"""
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for c in range(n):
+        p = max(range(c, n), key=lambda r: abs(m[r][c]))
+        m[c], m[p] = m[p], m[c]
+        for r in range(c + 1, n):
+            k = m[r][c] / m[c][c]
+            for j in range(c, n + 1):
+                m[r][j] -= k * m[c][j]
+    x = [0.0] * n
+    for r in reversed(range(n)):
+        x[r] = (m[r][n] - sum(m[r][j] * x[j] for j in range(r + 1, n))) \
+            / m[r][r]
+    return x
+
+
+def design():
+    """Linear phase least squares FIR with inverse CIC passband"""
+    fs_cic = RATE * FIR_RATIO * CIC_RATIO
+    fs = RATE * FIR_RATIO
+    half = FIR_TAPS // 2
+    grid = [fs / 2 * i / 400 for i in range(401)]
+    a = [[0.0] * (half + 1) for _ in range(half + 1)]
+    b = [0.0] * (half + 1)
+    for f in grid:
+        if PASS < f < STOP:
+            continue                    # Transition band unweighted
+        want = 1 / cic_response(f, fs_cic) if f <= PASS else 0.0
+        weight = 1.0 if f <= PASS else 10.0
+        w = 2 * math.pi * f / fs
+        basis = [1.0] + [2 * math.cos(w * k) for k in range(1, half + 1)]
+        for i in range(half + 1):
+            b[i] += weight * basis[i] * want
+            for j in range(half + 1):
+                a[i][j] += weight * basis[i] * basis[j]
+    h = solve(a, b)
+    taps = [h[abs(k - half)] for k in range(FIR_TAPS)]
+    gain = sum(taps)
+    return [t / gain for t in taps]
+
+
+def response(taps, f):
+    """Magnitude of CIC and FIR at f"""
+    fs = RATE * FIR_RATIO
+    re = sum(t * math.cos(2 * math.pi * f * k / fs) for k, t in enumerate(taps))
+    im = sum(t * math.sin(2 * math.pi * f * k / fs) for k, t in enumerate(taps))
+    return math.hypot(re, im) * cic_response(f, fs * CIC_RATIO)
+
+
+class Decimator:
+    """Integer CIC and float FIR, as decimate.c"""
+
+    def __init__(self, taps):
+        self.taps = taps
+        self.integ = [0] * CIC_ORDER
+        self.comb = [0] * CIC_ORDER
+        self.phase = 0
+        self.line = [0.0] * len(taps)
+        self.fir_phase = 0
+
+    def push(self, x):
+        for i in range(CIC_ORDER):
+            x = (x + self.integ[i]) & 0xFFFFFFFF
+            self.integ[i] = x
+        self.phase += 1
+        if self.phase < CIC_RATIO:
+            return None
+        self.phase = 0
+        y = self.integ[-1]
+        for i in range(CIC_ORDER):
+            y, self.comb[i] = (y - self.comb[i]) & 0xFFFFFFFF, y
+        self.line = [y / CIC_RATIO ** CIC_ORDER] + self.line[:-1]
+        self.fir_phase += 1
+        if self.fir_phase < FIR_RATIO:
+            return None
+        self.fir_phase = 0
+        y = sum(t * v for t, v in zip(self.taps, self.line))
+        return min(max(int(y + 0.5), 0), ADC_MAX)  # Back to ADC samples
+
+
+def goertzel(samples, fs):
+    """Amplitude of the mains bin, as MEAS_goertzel_amplitude()"""
+    n = len(samples)
+    re = sum(s * math.cos(2 * math.pi * MAINS * i / fs)
+             for i, s in enumerate(samples))
+    im = sum(s * math.sin(2 * math.pi * MAINS * i / fs)
+             for i, s in enumerate(samples))
+    return 2 * math.hypot(re, im) / n
+
+
+def signal(t, amplitude, phase):
+    """Mains with 3rd harmonic, an interferer at RATE+MAINS and DC offset"""
+    w = 2 * math.pi * MAINS
+    return (ADC_MAX / 2 + amplitude * math.sin(w * t + phase)
+            + 0.2 * amplitude * math.sin(3 * w * t + 2 * phase)
+            + 0.3 * amplitude * math.sin(2 * math.pi * (RATE + MAINS) * t))
+
+
+def adc(value, noise, rng):
+    """Noise and 12 bit quantisation"""
+    return min(max(int(value + rng.gauss(0, noise) + 0.5), 0), ADC_MAX)
+
+
+def snr(errors, amplitude):
+    rms = math.sqrt(sum(e * e for e in errors) / len(errors))
+    return 20 * math.log10(amplitude / rms) if rms > 0 else float("inf")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--trials", type=int, default=40)
+    parser.add_argument("--amplitude", type=float, default=300)
+    parser.add_argument("--noise", type=float, default=20, help="ADC rms")
+    args = parser.parse_args()
+
+    taps = design()
+    print("static const float DEC_fir[DEC_FIR_TAPS] = {")
+    for i in range(0, FIR_TAPS, 5):
+        print("\t\t" + " ".join("%.8ff," % t for t in taps[i:i + 5]))
+    print("};")
+    for f in (0, 50, 100, 150, 200, 300, 400, 550, 650, 1150, 1250):
+        print("%5d Hz %7.2f dB" % (f, 20 * math.log10(response(taps, f)
+                                                       + 1e-12)))
+
+    rng = random.Random(1)
+    fs_in = RATE * FIR_RATIO * CIC_RATIO
+    settle = (CIC_ORDER + FIR_TAPS + 1) // FIR_RATIO
+    direct, filtered = [], []
+    for _ in range(args.trials):
+        phase = rng.uniform(0, 2 * math.pi)
+        start = rng.uniform(0, 1)
+        samples = [adc(signal(start + i / RATE, args.amplitude, phase),
+                       args.noise, rng) for i in range(SAMPLES)]
+        direct.append(goertzel(samples, RATE) - args.amplitude)
+        dec = Decimator(taps)
+        out = []
+        i = 0
+        while len(out) < settle + SAMPLES:
+            y = dec.push(adc(signal(start + i / fs_in, args.amplitude, phase),
+                             args.noise, rng))
+            if y is not None:
+                out.append(y)
+            i += 1
+        gain = response(taps, MAINS)
+        filtered.append(goertzel(out[settle:], RATE) / gain - args.amplitude)
+    a = snr(direct, args.amplitude)
+    b = snr(filtered, args.amplitude)
+    print("SNR direct %5d Hz:      %6.1f dB" % (RATE, a))
+    print("SNR oversampled %5d Hz: %6.1f dB" % (fs_in, b))
+    print("Gain:                        %6.1f dB" % (b - a))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry of the cable monitor, see Core/Src/telemetry.c
+
+Reads the stream from the ST-LINK virtual COM port, a pty or a recorded
+file and writes one table per message type, either as CSV files or as
+columns (one little endian array per field plus schema.json).
+
+    tel_decode.py /dev/ttyACM0 -o log            # log_frame.csv, ...
+    tel_decode.py capture.bin -o log -f columns  # log_frame/distance.bin, ...
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import csv
+import json
+import os
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<BH")           # type, payload length
+WAVE_CHANNELS = 4                       # MEAS_WAVE_CHANNELS
+WAVE_SAMPLES = 60                       # MEAS_WAVE_SAMPLES
+
+# type: (name, struct format of the payload, field names), the payloads of
+# Core/Inc/telemetry.h. Test/test_tel_decode.py decodes the messages the host
+# build of telemetry.c sends and fails if they differ.
+MESSAGES = {
+    1: ("frame", "<II4I",
+        ["sequence", "tick", "wpc_left", "wpc_right",
+         "hall_left", "hall_right"]),
+    2: ("result", "<IffffBBf",
+        ["tick", "distance", "angle", "current", "deviation",
+         "mode", "detected", "confidence"]),
+    3: ("wave", "<I%dH" % (WAVE_CHANNELS * WAVE_SAMPLES),
+        ["sequence"] + ["c%d_s%d" % (c, s) for c in range(WAVE_CHANNELS)
+                        for s in range(WAVE_SAMPLES)]),
+}
+TEXT = 4
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT, polynomial 0x1021, as TEL_crc()"""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def open_input(path, baud):
+    """Open a file, or a serial device in raw mode at the given baud rate"""
+    stream = open(path, "rb", buffering=0)
+    if os.isatty(stream.fileno()):
+        import termios
+        import tty
+        tty.setraw(stream.fileno())
+        attrs = termios.tcgetattr(stream.fileno())
+        speed = getattr(termios, "B%d" % baud)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(stream.fileno(), termios.TCSANOW, attrs)
+    return stream
+
+
+def messages(stream, stats):
+    """Yield (type, payload) of all messages with a valid CRC"""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        buffer += chunk
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                del buffer[:-1]         # keep a possible first sync byte
+                break
+            del buffer[:start]
+            if len(buffer) < 2 + HEADER.size:
+                break
+            kind, length = HEADER.unpack_from(buffer, 2)
+            total = 2 + HEADER.size + length + 2
+            if len(buffer) < total:
+                break
+            body = bytes(buffer[2:total - 2])
+            crc, = struct.unpack_from("<H", buffer, total - 2)
+            if crc16(body) != crc:
+                stats["crc_errors"] += 1
+                del buffer[:1]          # resynchronize after the sync bytes
+                continue
+            del buffer[:total]
+            stats["messages"] += 1
+            yield kind, body[HEADER.size:]
+
+
+class CsvWriter:
+    """One CSV file per message type"""
+
+    def __init__(self, prefix):
+        self.prefix = prefix
+        self.files = {}
+        self.text = None
+
+    def row(self, name, fields, values):
+        if name not in self.files:
+            handle = open("%s_%s.csv" % (self.prefix, name), "w", newline="")
+            writer = csv.writer(handle)
+            writer.writerow(fields)
+            self.files[name] = (handle, writer)
+        self.files[name][1].writerow(values)
+
+    def text_message(self, text):
+        if self.text is None:
+            self.text = open("%s_text.txt" % self.prefix, "w")
+        self.text.write(text)
+
+    def close(self):
+        for handle, _ in self.files.values():
+            handle.close()
+        if self.text is not None:
+            self.text.close()
+
+
+class ColumnWriter(CsvWriter):
+    """One directory per message type, one raw array file per field"""
+
+    def row(self, name, fields, values):
+        if name not in self.files:
+            directory = "%s_%s" % (self.prefix, name)
+            os.makedirs(directory, exist_ok=True)
+            fmt = MESSAGES_BY_NAME[name][1]
+            codes = expand(fmt)
+            with open(os.path.join(directory, "schema.json"), "w") as schema:
+                json.dump({f: "<" + c for f, c in zip(fields, codes)},
+                          schema, indent=1)
+            handles = [open(os.path.join(directory, f + ".bin"), "wb")
+                       for f in fields]
+            self.files[name] = (codes, handles)
+        codes, handles = self.files[name]
+        for code, handle, value in zip(codes, handles, values):
+            handle.write(struct.pack("<" + code, value))
+
+    def close(self):
+        for _, handles in self.files.values():
+            for handle in handles:
+                handle.close()
+        if self.text is not None:
+            self.text.close()
+
+
+def expand(fmt):
+    """Struct format to one code per field, '<II4I' -> ['I', 'I', 'I', ...]"""
+    codes = []
+    count = ""
+    for char in fmt.lstrip("<"):
+        if char.isdigit():
+            count += char
+        else:
+            codes += [char] * int(count or 1)
+            count = ""
+    return codes
+
+
+MESSAGES_BY_NAME = {m[0]: m for m in MESSAGES.values()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="serial device, pty or recorded file")
+    parser.add_argument("-o", "--output", default="telemetry",
+                        help="prefix of the output files")
+    parser.add_argument("-f", "--format", choices=["csv", "columns"],
+                        default="csv")
+    parser.add_argument("-b", "--baud", type=int, default=921600,
+                        help="baud rate of a serial device, TEL_BAUDRATE")
+    args = parser.parse_args()
+
+    writer = (ColumnWriter if args.format == "columns" else CsvWriter)(
+        args.output)
+    stats = {"messages": 0, "crc_errors": 0, "unknown": 0}
+    try:
+        with open_input(args.input, args.baud) as stream:
+            for kind, payload in messages(stream, stats):
+                if kind == TEXT:
+                    writer.text_message(payload.decode("ascii", "replace"))
+                elif kind in MESSAGES:
+                    name, fmt, fields = MESSAGES[kind]
+                    if len(payload) != struct.calcsize(fmt):
+                        stats["unknown"] += 1
+                        continue
+                    writer.row(name, fields, struct.unpack(fmt, payload))
+                else:
+                    stats["unknown"] += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        writer.close()
+    print("%(messages)d messages, %(crc_errors)d CRC errors, "
+          "%(unknown)d unknown" % stats, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()